@@ -141,6 +141,14 @@ protected:
 						attr->set(&obj, value);
 					}
 				}
+				else if (value.type() == typeid(int))
+				{
+					auto* ui_value = stdext::any_cast<int>(&value);
+					if (ImGui::InputInt(attr->name().data(), ui_value))
+					{
+						attr->set(&obj, value);
+					}
+				}
 				else if (value.type() == typeid(float))
 				{
 					auto* ui_value = stdext::any_cast<float>(&value);
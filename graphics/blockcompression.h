@@ -0,0 +1,848 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "mipmaps.h"
+#include "parallel.h"
+#include "simd.h"
+
+//! Block-compressed formats with 4x4 texel blocks
+enum class BcFormat : uint32_t
+{
+	//! RGB with 5:6:5 endpoints and four colours, 8 bytes per block
+	BC1,
+
+	//! One channel with 8-bit endpoints and eight values, 8 bytes per block
+	BC4,
+
+	//! Two BC4 channels, 16 bytes per block
+	BC5,
+
+	//! RGBA using mode 6 (one subset) and mode 1 (two subsets), 16 bytes per block
+	BC7
+};
+
+//! Trade-off between the speed of the encoders and their quality
+enum class BcQuality : uint32_t
+{
+	//! Endpoints from the bounding box of the block
+	Fast,
+
+	//! Endpoints along the principal axis, refined once by least squares
+	Normal,
+
+	//! Refined twice, BC7 additionally tries the most promising two-subset partitions
+	High
+};
+
+//! Bytes per 4x4 block
+inline size_t bcBlockSize(BcFormat format)
+{
+	return format == BcFormat::BC1 || format == BcFormat::BC4 ? 8 : 16;
+}
+
+//! Bytes of a level with partial blocks rounded up
+inline size_t bcLevelSize(BcFormat format, uint32_t width, uint32_t height)
+{
+	return size_t{ (width + 3) / 4 } * ((height + 3) / 4) * bcBlockSize(format);
+}
+
+//! Encoded levels of a texture, the finest first. Offsets are in bytes.
+struct CompressedMipChain
+{
+	BcFormat Format{ BcFormat::BC1 };
+	std::vector<MipLevelLayout> Levels;
+	std::vector<uint8_t> Data;
+
+	const uint8_t* level(size_t l) const { return Data.data() + Levels[l].Offset; }
+	size_t levelSize(size_t l) const { return bcLevelSize(Format, Levels[l].Width, Levels[l].Height); }
+};
+
+namespace BcDetail
+{
+	using Simd::FloatV;
+
+	//! Up to 16 texels with channels in separate rows, values in [0, 255]
+	struct Texels
+	{
+		alignas(32) float V[4][16];
+		int Count{ 16 };
+	};
+
+	//! Decoded colours an encoding can select from
+	struct Palette
+	{
+		float Entries[16][4];
+		int Size{ 0 };
+	};
+
+	//! Little-endian bit stream of a 128-bit block
+	struct BitWriter
+	{
+		uint64_t Bits[2]{ 0, 0 };
+		int Pos{ 0 };
+
+		void put(uint32_t value, int nr_bits)
+		{
+			for (int b = 0; b < nr_bits; b++, Pos++)
+				Bits[Pos / 64] |= uint64_t{ (value >> b) & 1u } << (Pos % 64);
+		}
+
+		void store(uint8_t* out) const
+		{
+			for (int i = 0; i < 16; i++)
+				out[i] = static_cast<uint8_t>(Bits[i / 8] >> (8 * (i % 8)));
+		}
+	};
+
+	/*!
+	 * Closest palette entry of each texel, returns the summed squared error.
+	 * Each SIMD lane handles one texel. Lanes beyond 'Count' hold copies and
+	 * are not counted.
+	 */
+	inline float selectIndices(const Texels& t, int channels, const Palette& palette, uint8_t* indices)
+	{
+		float error = 0;
+		for (int first = 0; first < t.Count; first += FloatV::Width)
+		{
+			FloatV best = FloatV::set(std::numeric_limits<float>::max());
+			FloatV best_index = FloatV::set(0.0f);
+			for (int e = 0; e < palette.Size; e++)
+			{
+				FloatV d = FloatV::set(0.0f);
+				for (int c = 0; c < channels; c++)
+				{
+					const FloatV diff = FloatV::load(t.V[c] + first) - FloatV::set(palette.Entries[e][c]);
+					d = madd(diff, diff, d);
+				}
+				const FloatV closer = d < best;
+				best = select(closer, d, best);
+				best_index = select(closer, FloatV::set(static_cast<float>(e)), best_index);
+			}
+
+			alignas(32) float dist[FloatV::Width];
+			alignas(32) float index[FloatV::Width];
+			best.store(dist);
+			best_index.store(index);
+			for (int l = 0; l < FloatV::Width && first + l < t.Count; l++)
+			{
+				indices[first + l] = static_cast<uint8_t>(index[l]);
+				error += dist[l];
+			}
+		}
+		return error;
+	}
+
+	/*!
+	 * Initial endpoints of the line through the texels. 'Fast' uses the
+	 * corners of the bounding box, oriented by the covariance with the widest
+	 * channel and inset by 1/16 of the range. Otherwise the extent of the
+	 * texels along the principal axis is used.
+	 */
+	inline void fitLine(const Texels& t, int channels, BcQuality quality, float (&lo)[4], float (&hi)[4])
+	{
+		float mean[4] = {};
+		for (int c = 0; c < channels; c++)
+		{
+			for (int i = 0; i < t.Count; i++)
+				mean[c] += t.V[c][i];
+			mean[c] /= t.Count;
+		}
+
+		float cov[4][4] = {};
+		for (int i = 0; i < t.Count; i++)
+			for (int a = 0; a < channels; a++)
+				for (int b = a; b < channels; b++)
+					cov[a][b] += (t.V[a][i] - mean[a]) * (t.V[b][i] - mean[b]);
+		for (int a = 0; a < channels; a++)
+			for (int b = 0; b < a; b++)
+				cov[a][b] = cov[b][a];
+
+		if (quality == BcQuality::Fast)
+		{
+			int widest = 0;
+			for (int c = 1; c < channels; c++)
+				if (cov[c][c] > cov[widest][widest])
+					widest = c;
+			for (int c = 0; c < channels; c++)
+			{
+				float mn = 255, mx = 0;
+				for (int i = 0; i < t.Count; i++)
+				{
+					mn = std::min(mn, t.V[c][i]);
+					mx = std::max(mx, t.V[c][i]);
+				}
+				const float inset = (mx - mn) / 16.0f;
+				lo[c] = mn + inset;
+				hi[c] = mx - inset;
+				if (cov[c][widest] < 0)
+					std::swap(lo[c], hi[c]);
+			}
+			return;
+		}
+
+		// Power iteration starting from the variances
+		float axis[4] = {};
+		for (int c = 0; c < channels; c++)
+			axis[c] = cov[c][c];
+		for (int it = 0; it < 8; it++)
+		{
+			float next[4] = {};
+			float len2 = 0;
+			for (int a = 0; a < channels; a++)
+			{
+				for (int b = 0; b < channels; b++)
+					next[a] += cov[a][b] * axis[b];
+				len2 += next[a] * next[a];
+			}
+			if (len2 < 1e-12f)
+				break;
+			const float inv_len = 1.0f / std::sqrt(len2);
+			for (int c = 0; c < channels; c++)
+				axis[c] = next[c] * inv_len;
+		}
+
+		float t_min = 0, t_max = 0;
+		for (int i = 0; i < t.Count; i++)
+		{
+			float d = 0;
+			for (int c = 0; c < channels; c++)
+				d += (t.V[c][i] - mean[c]) * axis[c];
+			t_min = std::min(t_min, d);
+			t_max = std::max(t_max, d);
+		}
+		for (int c = 0; c < channels; c++)
+		{
+			lo[c] = std::min(std::max(mean[c] + t_min * axis[c], 0.0f), 255.0f);
+			hi[c] = std::min(std::max(mean[c] + t_max * axis[c], 0.0f), 255.0f);
+		}
+	}
+
+	/*!
+	 * Least-squares endpoints for fixed indices, 'weights' is the position of
+	 * each palette entry between the endpoints. Returns false if the system is
+	 * singular, i.e. all texels use the same weight.
+	 */
+	inline bool refineLine(const Texels& t, int channels, const uint8_t* indices, const float* weights, float (&lo)[4], float (&hi)[4])
+	{
+		float aa = 0, ab = 0, bb = 0;
+		float ap[4] = {}, bp[4] = {};
+		for (int i = 0; i < t.Count; i++)
+		{
+			const float w = weights[indices[i]];
+			aa += (1 - w) * (1 - w);
+			ab += (1 - w) * w;
+			bb += w * w;
+			for (int c = 0; c < channels; c++)
+			{
+				ap[c] += (1 - w) * t.V[c][i];
+				bp[c] += w * t.V[c][i];
+			}
+		}
+
+		const float det = aa * bb - ab * ab;
+		if (std::abs(det) < 1e-6f)
+			return false;
+		for (int c = 0; c < channels; c++)
+		{
+			lo[c] = std::min(std::max((bb * ap[c] - ab * bp[c]) / det, 0.0f), 255.0f);
+			hi[c] = std::min(std::max((aa * bp[c] - ab * ap[c]) / det, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+	/*!
+	 * Fit the endpoints of one line of the palette. 'Quantizer::quantize'
+	 * rounds the endpoints to the precision of the format and builds the
+	 * palette, 'Quantizer::weights' are the positions of the palette entries.
+	 * The best quantized endpoints and their indices are returned in
+	 * 'endpoints' and 'indices'.
+	 */
+	template<typename Quantizer>
+	float fitEndpoints(const Texels& t, BcQuality quality, typename Quantizer::Endpoints& endpoints, uint8_t* indices)
+	{
+		float lo[4] = {}, hi[4] = {};
+		fitLine(t, Quantizer::Channels, quality, lo, hi);
+
+		Palette palette;
+		Quantizer::quantize(lo, hi, endpoints, palette);
+		float best = selectIndices(t, Quantizer::Channels, palette, indices);
+
+		const int refinements = quality == BcQuality::Fast ? 0 : (quality == BcQuality::Normal ? 1 : 2);
+		for (int it = 0; it < refinements && best > 0; it++)
+		{
+			if (!refineLine(t, Quantizer::Channels, indices, Quantizer::weights(), lo, hi))
+				break;
+
+			typename Quantizer::Endpoints refined;
+			uint8_t candidate[16];
+			Quantizer::quantize(lo, hi, refined, palette);
+			const float error = selectIndices(t, Quantizer::Channels, palette, candidate);
+			if (error >= best)
+				break;
+
+			best = error;
+			endpoints = refined;
+			std::copy(candidate, candidate + t.Count, indices);
+		}
+		return best;
+	}
+
+	//! Colours 0 and 1 are the endpoints, 2 and 3 at one and two thirds
+	struct Bc1Quantizer
+	{
+		struct Endpoints { uint16_t C[2]; };
+		static const int Channels = 3;
+		static const float* weights()
+		{
+			static const float w[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			return w;
+		}
+
+		static uint16_t pack(const float (&c)[4])
+		{
+			const uint32_t r = static_cast<uint32_t>(c[0] * (31.0f / 255.0f) + 0.5f);
+			const uint32_t g = static_cast<uint32_t>(c[1] * (63.0f / 255.0f) + 0.5f);
+			const uint32_t b = static_cast<uint32_t>(c[2] * (31.0f / 255.0f) + 0.5f);
+			return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		static void unpack(uint16_t v, float* c)
+		{
+			const uint32_t r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+			c[0] = static_cast<float>((r << 3) | (r >> 2));
+			c[1] = static_cast<float>((g << 2) | (g >> 4));
+			c[2] = static_cast<float>((b << 3) | (b >> 2));
+			c[3] = 255.0f;
+		}
+
+		static void quantize(const float (&lo)[4], const float (&hi)[4], Endpoints& e, Palette& palette)
+		{
+			e.C[0] = pack(lo);
+			e.C[1] = pack(hi);
+			unpack(e.C[0], palette.Entries[0]);
+			unpack(e.C[1], palette.Entries[1]);
+			for (int c = 0; c < 4; c++)
+			{
+				palette.Entries[2][c] = (2 * palette.Entries[0][c] + palette.Entries[1][c]) / 3;
+				palette.Entries[3][c] = (palette.Entries[0][c] + 2 * palette.Entries[1][c]) / 3;
+			}
+
+			// Equal endpoints select the three-colour mode, only index 0 is safe
+			palette.Size = e.C[0] == e.C[1] ? 1 : 4;
+		}
+	};
+
+	//! Values 0 and 1 are the endpoints, 2 to 7 in sevenths between them
+	struct Bc4Quantizer
+	{
+		struct Endpoints { uint8_t A[2]; };
+		static const int Channels = 1;
+		static const float* weights()
+		{
+			static const float w[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+			return w;
+		}
+
+		static void quantize(const float (&lo)[4], const float (&hi)[4], Endpoints& e, Palette& palette)
+		{
+			e.A[0] = static_cast<uint8_t>(lo[0] + 0.5f);
+			e.A[1] = static_cast<uint8_t>(hi[0] + 0.5f);
+			for (int i = 0; i < 8; i++)
+				palette.Entries[i][0] = (1 - weights()[i]) * e.A[0] + weights()[i] * e.A[1];
+
+			// Equal endpoints select the six-value mode, only index 0 is safe
+			palette.Size = e.A[0] == e.A[1] ? 1 : 8;
+		}
+	};
+
+	//! BC7 interpolation weights of 3-bit and 4-bit indices, in 64ths
+	constexpr int Bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	constexpr int Bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	inline float bc7Interpolate(int e0, int e1, int w)
+	{
+		return static_cast<float>(((64 - w) * e0 + w * e1 + 32) >> 6);
+	}
+
+	//! Mode 6: RGBA endpoints with 7 bits and a p-bit each, 4-bit indices
+	struct Bc7Mode6Quantizer
+	{
+		struct Endpoints { uint8_t V[2][4]; uint8_t P[2]; };
+		static const int Channels = 4;
+		static const float* weights()
+		{
+			static const float w[16] = {
+				0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f, 30 / 64.0f,
+				34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 64 / 64.0f
+			};
+			return w;
+		}
+
+		//! Choose the p-bit of each endpoint with the smaller rounding error
+		static void quantize(const float (&lo)[4], const float (&hi)[4], Endpoints& e, Palette& palette)
+		{
+			const float* src[2] = { lo, hi };
+			int full[2][4];
+			for (int k = 0; k < 2; k++)
+			{
+				float best = std::numeric_limits<float>::max();
+				for (int p = 0; p < 2; p++)
+				{
+					int v[4];
+					float error = 0;
+					for (int c = 0; c < 4; c++)
+					{
+						v[c] = std::min(std::max(static_cast<int>(std::floor((src[k][c] - p) / 2 + 0.5f)), 0), 127);
+						const float d = src[k][c] - static_cast<float>((v[c] << 1) | p);
+						error += d * d;
+					}
+					if (error < best)
+					{
+						best = error;
+						e.P[k] = static_cast<uint8_t>(p);
+						for (int c = 0; c < 4; c++)
+						{
+							e.V[k][c] = static_cast<uint8_t>(v[c]);
+							full[k][c] = (v[c] << 1) | p;
+						}
+					}
+				}
+			}
+
+			for (int i = 0; i < 16; i++)
+				for (int c = 0; c < 4; c++)
+					palette.Entries[i][c] = bc7Interpolate(full[0][c], full[1][c], Bc7Weights4[i]);
+			palette.Size = 16;
+		}
+	};
+
+	//! Mode 1: RGB endpoints with 6 bits and a p-bit shared by both endpoints, 3-bit indices
+	struct Bc7Mode1Quantizer
+	{
+		struct Endpoints { uint8_t V[2][3]; uint8_t P; };
+		static const int Channels = 3;
+		static const float* weights()
+		{
+			static const float w[8] = { 0 / 64.0f, 9 / 64.0f, 18 / 64.0f, 27 / 64.0f, 37 / 64.0f, 46 / 64.0f, 55 / 64.0f, 64 / 64.0f };
+			return w;
+		}
+
+		static int expand(int v6, int p)
+		{
+			const int v7 = (v6 << 1) | p;
+			return (v7 << 1) | (v7 >> 6);
+		}
+
+		static void quantize(const float (&lo)[4], const float (&hi)[4], Endpoints& e, Palette& palette)
+		{
+			const float* src[2] = { lo, hi };
+			float best = std::numeric_limits<float>::max();
+			for (int p = 0; p < 2; p++)
+			{
+				Endpoints candidate;
+				candidate.P = static_cast<uint8_t>(p);
+				float error = 0;
+				for (int k = 0; k < 2; k++)
+				{
+					for (int c = 0; c < 3; c++)
+					{
+						// Expansion is monotonic, test the neighbours of the estimate
+						const int estimate = static_cast<int>(std::floor((src[k][c] * (127.0f / 255.0f) - p) / 2 + 0.5f));
+						float best_d = std::numeric_limits<float>::max();
+						for (int v = std::max(estimate - 1, 0); v <= std::min(estimate + 1, 63); v++)
+						{
+							const float d = src[k][c] - static_cast<float>(expand(v, p));
+							if (d * d < best_d)
+							{
+								best_d = d * d;
+								candidate.V[k][c] = static_cast<uint8_t>(v);
+							}
+						}
+						error += best_d;
+					}
+				}
+				if (error < best)
+				{
+					best = error;
+					e = candidate;
+				}
+			}
+
+			for (int i = 0; i < 8; i++)
+			{
+				for (int c = 0; c < 3; c++)
+					palette.Entries[i][c] = bc7Interpolate(expand(e.V[0][c], e.P), expand(e.V[1][c], e.P), Bc7Weights3[i]);
+				palette.Entries[i][3] = 255.0f;
+			}
+			palette.Size = 8;
+		}
+	};
+
+	/*!
+	 * Two-subset partitions shared by BC6H and BC7, bit i is the subset of
+	 * texel i in row-major order.
+	 */
+	constexpr uint16_t Bc7Partitions2[64] = {
+		0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+		0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+		0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+		0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+		0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+		0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+		0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+		0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+	};
+
+	//! Texel of subset 1 whose index omits its most significant bit
+	constexpr uint8_t Bc7Anchors2[64] = {
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+		15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+		6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+	};
+
+	inline void encodeBc1(const Texels& t, BcQuality quality, uint8_t* out)
+	{
+		Bc1Quantizer::Endpoints e;
+		uint8_t indices[16];
+		fitEndpoints<Bc1Quantizer>(t, quality, e, indices);
+
+		// The four-colour mode requires c0 > c1, equal endpoints keep all indices at 0
+		uint16_t c0 = e.C[0], c1 = e.C[1];
+		uint32_t bits = 0;
+		if (c0 != c1)
+		{
+			static const uint8_t swapped[4] = { 1, 0, 3, 2 };
+			const bool swap = c0 < c1;
+			if (swap)
+				std::swap(c0, c1);
+			for (int i = 0; i < 16; i++)
+				bits |= uint32_t{ swap ? swapped[indices[i]] : indices[i] } << (2 * i);
+		}
+
+		out[0] = static_cast<uint8_t>(c0);
+		out[1] = static_cast<uint8_t>(c0 >> 8);
+		out[2] = static_cast<uint8_t>(c1);
+		out[3] = static_cast<uint8_t>(c1 >> 8);
+		for (int i = 0; i < 4; i++)
+			out[4 + i] = static_cast<uint8_t>(bits >> (8 * i));
+	}
+
+	//! Encode row 'channel' of the texels
+	inline void encodeBc4(const Texels& t, int channel, BcQuality quality, uint8_t* out)
+	{
+		Texels single;
+		std::copy(t.V[channel], t.V[channel] + 16, single.V[0]);
+
+		Bc4Quantizer::Endpoints e;
+		uint8_t indices[16];
+		fitEndpoints<Bc4Quantizer>(single, quality, e, indices);
+
+		// The eight-value mode requires a0 > a1, equal endpoints keep all indices at 0
+		uint8_t a0 = e.A[0], a1 = e.A[1];
+		uint64_t bits = 0;
+		if (a0 != a1)
+		{
+			const bool swap = a0 < a1;
+			if (swap)
+				std::swap(a0, a1);
+			for (int i = 0; i < 16; i++)
+			{
+				const uint32_t index = indices[i];
+				const uint32_t stored = !swap ? index : (index < 2 ? 1 - index : 9 - index);
+				bits |= uint64_t{ stored } << (3 * i);
+			}
+		}
+
+		out[0] = a0;
+		out[1] = a1;
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+	}
+
+	//! Mode 6, returns the squared error of the block
+	inline float encodeBc7Mode6(const Texels& t, BcQuality quality, uint8_t* out)
+	{
+		Bc7Mode6Quantizer::Endpoints e;
+		uint8_t indices[16];
+		const float error = fitEndpoints<Bc7Mode6Quantizer>(t, quality, e, indices);
+
+		// The most significant bit of the first index is implicitly 0
+		if (indices[0] & 8)
+		{
+			std::swap(e.V[0], e.V[1]);
+			std::swap(e.P[0], e.P[1]);
+			for (int i = 0; i < 16; i++)
+				indices[i] = 15 - indices[i];
+		}
+
+		BitWriter bits;
+		bits.put(1u << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			bits.put(e.V[0][c], 7);
+			bits.put(e.V[1][c], 7);
+		}
+		bits.put(e.P[0], 1);
+		bits.put(e.P[1], 1);
+		for (int i = 0; i < 16; i++)
+			bits.put(indices[i], i == 0 ? 3 : 4);
+		bits.store(out);
+		return error;
+	}
+
+	//! Sums of the colours and their products of a set of texels
+	struct Moments
+	{
+		float N{ 0 };
+		float Sum[3]{};
+		float Sum2[6]{};
+
+		void add(const Texels& t, int i)
+		{
+			const float* products[6][2] = { { t.V[0], t.V[0] }, { t.V[0], t.V[1] }, { t.V[0], t.V[2] }, { t.V[1], t.V[1] }, { t.V[1], t.V[2] }, { t.V[2], t.V[2] } };
+			N += 1;
+			for (int a = 0; a < 3; a++)
+				Sum[a] += t.V[a][i];
+			for (int k = 0; k < 6; k++)
+				Sum2[k] += products[k][0][i] * products[k][1][i];
+		}
+
+		//! Squared distance of the texels to their principal axis
+		float residual() const
+		{
+			float cov[6];
+			const int pairs[6][2] = { { 0, 0 }, { 0, 1 }, { 0, 2 }, { 1, 1 }, { 1, 2 }, { 2, 2 } };
+			for (int k = 0; k < 6; k++)
+				cov[k] = Sum2[k] - Sum[pairs[k][0]] * Sum[pairs[k][1]] / N;
+
+			// The largest eigenvalue is the variance along the axis
+			float axis[3] = { 1, 1, 1 };
+			float lambda = 0;
+			for (int it = 0; it < 4; it++)
+			{
+				const float next[3] = {
+					cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+					cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+					cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]
+				};
+				const float len = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+				if (len < 1e-6f)
+					break;
+				lambda = len;
+				for (int a = 0; a < 3; a++)
+					axis[a] = next[a] / len;
+			}
+			return cov[0] + cov[3] + cov[5] - lambda;
+		}
+	};
+
+	//! Mode 1 with the given partition, returns the squared error of the block
+	inline float encodeBc7Mode1(const Texels& t, int partition, BcQuality quality, uint8_t* out)
+	{
+		const uint16_t mask = Bc7Partitions2[partition];
+		const int anchors[2] = { 0, Bc7Anchors2[partition] };
+
+		Bc7Mode1Quantizer::Endpoints e[2];
+		uint8_t indices[16];
+		float error = 0;
+		for (int s = 0; s < 2; s++)
+		{
+			Texels subset;
+			int members[16];
+			subset.Count = 0;
+			for (int i = 0; i < 16; i++)
+			{
+				if (((mask >> i) & 1) != s)
+					continue;
+				for (int c = 0; c < 4; c++)
+					subset.V[c][subset.Count] = t.V[c][i];
+				members[subset.Count++] = i;
+			}
+			for (int i = subset.Count; i < 16; i++)
+				for (int c = 0; c < 4; c++)
+					subset.V[c][i] = subset.V[c][0];
+
+			uint8_t subset_indices[16];
+			error += fitEndpoints<Bc7Mode1Quantizer>(subset, quality, e[s], subset_indices);
+
+			// The most significant bit of the anchor index is implicitly 0
+			const int anchor = static_cast<int>(std::find(members, members + subset.Count, anchors[s]) - members);
+			const bool swap = (subset_indices[anchor] & 4) != 0;
+			if (swap)
+				std::swap(e[s].V[0], e[s].V[1]);
+			for (int k = 0; k < subset.Count; k++)
+				indices[members[k]] = swap ? 7 - subset_indices[k] : subset_indices[k];
+		}
+
+		BitWriter bits;
+		bits.put(1u << 1, 2);
+		bits.put(static_cast<uint32_t>(partition), 6);
+		for (int c = 0; c < 3; c++)
+			for (int s = 0; s < 2; s++)
+			{
+				bits.put(e[s].V[0][c], 6);
+				bits.put(e[s].V[1][c], 6);
+			}
+		bits.put(e[0].P, 1);
+		bits.put(e[1].P, 1);
+		for (int i = 0; i < 16; i++)
+			bits.put(indices[i], i == anchors[0] || i == anchors[1] ? 2 : 3);
+		bits.store(out);
+		return error;
+	}
+
+	/*!
+	 * Mode 6 for all blocks. 'High' also encodes opaque blocks with the
+	 * partitions of mode 1 that leave the smallest residual to a line per
+	 * subset and keeps the best of all encodings.
+	 */
+	inline void encodeBc7(const Texels& t, BcQuality quality, uint8_t* out)
+	{
+		float best = encodeBc7Mode6(t, quality, out);
+		if (quality != BcQuality::High || best <= 0)
+			return;
+		for (int i = 0; i < 16; i++)
+			if (t.V[3][i] < 255.0f)
+				return;
+
+		const int candidates = 4;
+		// Rank the partitions by the residual of a line through each subset
+		Moments total;
+		for (int i = 0; i < 16; i++)
+			total.add(t, i);
+		std::pair<float, int> ranked[64];
+		for (int p = 0; p < 64; p++)
+		{
+			Moments subsets[2];
+			for (int i = 0; i < 16; i++)
+				if ((Bc7Partitions2[p] >> i) & 1)
+					subsets[1].add(t, i);
+			subsets[0].N = total.N - subsets[1].N;
+			for (int a = 0; a < 3; a++)
+				subsets[0].Sum[a] = total.Sum[a] - subsets[1].Sum[a];
+			for (int k = 0; k < 6; k++)
+				subsets[0].Sum2[k] = total.Sum2[k] - subsets[1].Sum2[k];
+			ranked[p] = { subsets[0].residual() + subsets[1].residual(), p };
+		}
+		std::partial_sort(ranked, ranked + candidates, ranked + 64);
+
+		for (int k = 0; k < candidates; k++)
+		{
+			uint8_t block[16];
+			const float error = encodeBc7Mode1(t, ranked[k].second, quality, block);
+			if (error < best)
+			{
+				best = error;
+				std::copy(block, block + 16, out);
+			}
+		}
+	}
+
+	/*!
+	 * Texels of the block at (bx, by) scaled to [0, 255]. Texels outside the
+	 * level repeat the last row and column, missing channels are 0 for green
+	 * and blue and 255 for alpha, as the GL expands smaller formats.
+	 */
+	template<typename T>
+	void loadBlock(const T* level, uint32_t width, uint32_t height, uint32_t channels, uint32_t bx, uint32_t by, Texels& t)
+	{
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			const uint32_t x = std::min(bx * 4 + i % 4, width - 1);
+			const uint32_t y = std::min(by * 4 + i / 4, height - 1);
+			const T* texel = level + (size_t{ y } * width + x) * channels;
+			for (uint32_t c = 0; c < 4; c++)
+				t.V[c][i] = c < channels ? 255.0f * MipDetail::toFloat(texel[c]) : (c == 3 ? 255.0f : 0.0f);
+		}
+	}
+
+	template<typename T>
+	void compressLevel(const T* level, uint32_t width, uint32_t height, uint32_t channels, BcFormat format, BcQuality quality, uint8_t* out)
+	{
+		const uint32_t blocks_x = (width + 3) / 4;
+		const uint32_t blocks_y = (height + 3) / 4;
+		const size_t block_size = bcBlockSize(format);
+
+		// Rows of blocks are independent, a chunk should hold at least 256 blocks
+		const size_t grain = std::max<size_t>(1, 256 / blocks_x);
+		parallelFor(0, blocks_y, grain, [&](size_t, size_t begin, size_t end)
+		{
+			Texels t;
+			for (size_t by = begin; by < end; by++)
+			{
+				uint8_t* dst = out + by * blocks_x * block_size;
+				for (uint32_t bx = 0; bx < blocks_x; bx++, dst += block_size)
+				{
+					loadBlock(level, width, height, channels, bx, static_cast<uint32_t>(by), t);
+					switch (format)
+					{
+					case BcFormat::BC1: encodeBc1(t, quality, dst); break;
+					case BcFormat::BC4: encodeBc4(t, 0, quality, dst); break;
+					case BcFormat::BC5: encodeBc4(t, 0, quality, dst); encodeBc4(t, 1, quality, dst + 8); break;
+					case BcFormat::BC7: encodeBc7(t, quality, dst); break;
+					}
+				}
+			}
+		});
+	}
+}
+
+/*!
+ * Encode all levels of 'chain'. Blocks are gathered with the channels of 16
+ * texels side by side, so that the SIMD lanes compare texels against palette
+ * entries. Rows of blocks are distributed over the workers of 'parallelFor'.
+ */
+template<typename T>
+CompressedMipChain compressMipChain(const MipChain<T>& chain, BcFormat format, BcQuality quality)
+{
+	CompressedMipChain compressed;
+	compressed.Format = format;
+
+	size_t size = 0;
+	for (const auto& level : chain.Levels)
+	{
+		compressed.Levels.push_back({ level.Width, level.Height, size });
+		size += bcLevelSize(format, level.Width, level.Height);
+	}
+	compressed.Data.resize(size);
+
+	for (size_t l = 0; l < chain.Levels.size(); l++)
+	{
+		const auto& level = chain.Levels[l];
+		BcDetail::compressLevel(chain.level(l), level.Width, level.Height, chain.Channels, format, quality, compressed.Data.data() + compressed.Levels[l].Offset);
+	}
+	return compressed;
+}
@@ -0,0 +1,247 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+// Black-body colours computed at compile time by integrating Planck's law
+// against the CIE 1931 2-degree standard observer and converting the resulting
+// XYZ tristimulus values to linear sRGB (D65).
+namespace Blackbody
+{
+	//! Temperature range covered by the table (same as the fitted GLSL curve)
+	constexpr double MinTemperature = 1000.0;
+	constexpr double MaxTemperature = 40000.0;
+
+	//! Number of table entries. Entries are spaced uniformly in mired
+	//! (1e6 / T), which is close to perceptually uniform.
+	constexpr size_t TableSize = 128;
+
+	//! CIE 1931 2-degree colour matching functions, 380nm - 780nm, 10nm steps
+	constexpr double CieWavelengthMin = 380.0;
+	constexpr double CieWavelengthStep = 10.0;
+	constexpr size_t CieSamples = 41;
+	constexpr double CieXYZ[CieSamples][3] =
+	{
+		{ 0.001368, 0.000039, 0.006450 }, { 0.004243, 0.000120, 0.020050 },
+		{ 0.014310, 0.000396, 0.067850 }, { 0.043510, 0.001210, 0.207400 },
+		{ 0.134380, 0.004000, 0.645600 }, { 0.283900, 0.011600, 1.385600 },
+		{ 0.348280, 0.023000, 1.747060 }, { 0.336200, 0.038000, 1.772110 },
+		{ 0.290800, 0.060000, 1.669200 }, { 0.195360, 0.090980, 1.287640 },
+		{ 0.095640, 0.139020, 0.812950 }, { 0.032010, 0.208020, 0.465180 },
+		{ 0.004900, 0.323000, 0.272000 }, { 0.009300, 0.503000, 0.158200 },
+		{ 0.063270, 0.710000, 0.078250 }, { 0.165500, 0.862000, 0.042160 },
+		{ 0.290400, 0.954000, 0.020300 }, { 0.433450, 0.994950, 0.008750 },
+		{ 0.594500, 0.995000, 0.003900 }, { 0.762100, 0.952000, 0.002100 },
+		{ 0.916300, 0.870000, 0.001650 }, { 1.026300, 0.757000, 0.001100 },
+		{ 1.062200, 0.631000, 0.000800 }, { 1.002600, 0.503000, 0.000340 },
+		{ 0.854450, 0.381000, 0.000190 }, { 0.642400, 0.265000, 0.000050 },
+		{ 0.447900, 0.175000, 0.000020 }, { 0.283500, 0.107000, 0.000000 },
+		{ 0.164900, 0.061000, 0.000000 }, { 0.087400, 0.032000, 0.000000 },
+		{ 0.046770, 0.017000, 0.000000 }, { 0.022700, 0.008210, 0.000000 },
+		{ 0.011359, 0.004102, 0.000000 }, { 0.005790, 0.002091, 0.000000 },
+		{ 0.002899, 0.001047, 0.000000 }, { 0.001440, 0.000520, 0.000000 },
+		{ 0.000690, 0.000249, 0.000000 }, { 0.000332, 0.000120, 0.000000 },
+		{ 0.000166, 0.000060, 0.000000 }, { 0.000083, 0.000030, 0.000000 },
+		{ 0.000042, 0.000015, 0.000000 }
+	};
+
+	//! Linear sRGB (D65) from CIE XYZ
+	constexpr double XYZToLinearSRGB[3][3] =
+	{
+		{  3.2404542, -1.5371385, -0.4985314 },
+		{ -0.9692660,  1.8760108,  0.0415560 },
+		{  0.0556434, -0.2040259,  1.0572252 }
+	};
+
+	//! Table of linear sRGB colours (RGBA, alpha unused), normalized such
+	//! that the largest component is one
+	struct Table
+	{
+		float Rgba[TableSize][4];
+	};
+
+	namespace Detail
+	{
+		//! Exponential function usable in constant expressions
+		constexpr double exp(double x)
+		{
+			// Range reduction, x = k * ln(2) + r with 0 <= r < ln(2)
+			const double ln2 = 0.69314718055994530942;
+			int k = static_cast<int>(x / ln2);
+			if (x < 0)
+				k -= 1;
+			const double r = x - k * ln2;
+
+			double term = 1;
+			double sum = 1;
+			for (int n = 1; n < 16; n++)
+			{
+				term *= r / n;
+				sum += term;
+			}
+
+			double base = k < 0 ? 0.5 : 2.0;
+			int e = k < 0 ? -k : k;
+			double scale = 1;
+			while (e > 0)
+			{
+				if (e & 1)
+					scale *= base;
+				base *= base;
+				e >>= 1;
+			}
+
+			return sum * scale;
+		}
+
+		//! Spectral radiance of a black body up to a constant factor
+		//! \param lambda Wavelength in nm
+		//! \param T Temperature in Kelvin
+		constexpr double planck(double lambda, double T)
+		{
+			// Second radiation constant hc/k in nm K
+			const double c2 = 1.438776877e7;
+			const double l5 = lambda * lambda * lambda * lambda * lambda;
+			return 1e15 / (l5 * (exp(c2 / (lambda * T)) - 1.0));
+		}
+	}
+
+	//! Temperature represented by the table entry 'i'
+	constexpr double temperature(size_t i)
+	{
+		const double min_mired = 1e6 / MaxTemperature;
+		const double max_mired = 1e6 / MinTemperature;
+		const double mired = max_mired + (min_mired - max_mired) * static_cast<double>(i) / (TableSize - 1);
+		return 1e6 / mired;
+	}
+
+	//! Fractional table index of the temperature 'T'
+	inline float tableIndex(float T)
+	{
+		const float min_mired = static_cast<float>(1e6 / MaxTemperature);
+		const float max_mired = static_cast<float>(1e6 / MinTemperature);
+		const float mired = 1e6f / std::min(std::max(T, static_cast<float>(MinTemperature)), static_cast<float>(MaxTemperature));
+		return (mired - max_mired) / (min_mired - max_mired) * (TableSize - 1);
+	}
+
+	constexpr Table makeTable()
+	{
+		Table table{};
+		for (size_t i = 0; i < TableSize; i++)
+		{
+			const double T = temperature(i);
+
+			double xyz[3] = { 0, 0, 0 };
+			for (size_t s = 0; s < CieSamples; s++)
+			{
+				const double L = Detail::planck(CieWavelengthMin + s * CieWavelengthStep, T);
+				xyz[0] += L * CieXYZ[s][0];
+				xyz[1] += L * CieXYZ[s][1];
+				xyz[2] += L * CieXYZ[s][2];
+			}
+
+			// Convert to linear sRGB and clip the negative, out-of-gamut lobes
+			double rgb[3] = { 0, 0, 0 };
+			double max_c = 0;
+			for (size_t c = 0; c < 3; c++)
+			{
+				rgb[c] = XYZToLinearSRGB[c][0] * xyz[0] + XYZToLinearSRGB[c][1] * xyz[1] + XYZToLinearSRGB[c][2] * xyz[2];
+				rgb[c] = rgb[c] < 0 ? 0 : rgb[c];
+				max_c = rgb[c] > max_c ? rgb[c] : max_c;
+			}
+
+			for (size_t c = 0; c < 3; c++)
+				table.Rgba[i][c] = static_cast<float>(rgb[c] / max_c);
+			table.Rgba[i][3] = 1.0f;
+		}
+
+		return table;
+	}
+
+	//! Table evaluated by the compiler
+	constexpr Table LinearSRGB = makeTable();
+
+	// Sanity checks of the generated white points
+	static_assert(LinearSRGB.Rgba[0][0] == 1.0f && LinearSRGB.Rgba[0][2] < 0.01f, "1000K must be deep red");
+	static_assert(LinearSRGB.Rgba[TableSize - 1][2] == 1.0f, "40000K must be blue");
+
+	//! Linearly interpolated table lookup
+	inline std::array<float, 3> linearSRGB(float T)
+	{
+		const float idx = tableIndex(T);
+		const size_t i0 = std::min(static_cast<size_t>(idx), TableSize - 2);
+		const float a = idx - i0;
+
+		const auto& c0 = LinearSRGB.Rgba[i0];
+		const auto& c1 = LinearSRGB.Rgba[i0 + 1];
+		return
+		{
+			(1 - a) * c0[0] + a * c1[0],
+			(1 - a) * c0[1] + a * c1[1],
+			(1 - a) * c0[2] + a * c1[2]
+		};
+	}
+
+	//! sRGB transfer function
+	inline float encodeSRGB(float c)
+	{
+		return c <= 0.0031308f ? 12.92f * c : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	}
+
+	//! CPU version of the fitted curve by Tanner Helland used in
+	//! 'colourtemperature.glsl'. Returns gamma encoded sRGB.
+	inline std::array<float, 3> fittedSRGB(float T)
+	{
+		const auto saturate = [](float v) { return std::min(std::max(v, 0.0f), 1.0f); };
+
+		std::array<float, 3> rgb;
+		T = std::min(std::max(T, 1000.0f), 40000.0f) / 100.0f;
+		if (T <= 66.0f)
+		{
+			rgb[0] = 1.0f;
+			rgb[1] = saturate(0.39008157876901960784f * std::log(T) - 0.63184144378862745098f);
+		}
+		else
+		{
+			const float t = T - 60.0f;
+			rgb[0] = saturate(1.29293618606274509804f * std::pow(t, -0.1332047592f));
+			rgb[1] = saturate(1.12989086089529411765f * std::pow(t, -0.0755148492f));
+		}
+
+		if (T >= 66.0f)
+			rgb[2] = 1.0f;
+		else if (T <= 19.0f)
+			rgb[2] = 0.0f;
+		else
+			rgb[2] = saturate(0.54320678911019607843f * std::log(T - 10.0f) - 1.19625408914f);
+
+		return rgb;
+	}
+}
@@ -35,10 +35,12 @@
 #include <iostream>
 
 // VCL
+#include <vcl/core/enum.h>
 #include <vcl/graphics/opengl/glsl/uniformbuffer.h>
 #include <vcl/graphics/opengl/context.h>
 #include <vcl/graphics/runtime/opengl/resource/shader.h>
 #include <vcl/graphics/runtime/opengl/resource/texture2d.h>
+#include <vcl/graphics/runtime/opengl/state/sampler.h>
 #include <vcl/graphics/runtime/opengl/state/pipelinestate.h>
 #include <vcl/graphics/runtime/opengl/graphicsengine.h>
 #include <vcl/graphics/camera.h>
@@ -46,6 +48,8 @@
 
 #include "../application.h"
 #include "../basescene.h"
+#include "../uploadring.h"
+#include "blackbody.h"
 
 #include "shaders/temperature.h"
 #include "temperature.vert.spv.h"
@@ -59,6 +63,12 @@ extern "C"
 
 using ImageType = std::unique_ptr<uint8_t[], void(*)(void*)>;
 
+VCL_DECLARE_ENUM(TemperatureMethod,
+	Fitted,
+	Blackbody,
+	Comparison
+)
+
 class WrinkledSurfacesExample : public BaseScene
 {
 	VCL_DECLARE_METAOBJECT(WrinkledSurfacesExample)
@@ -67,13 +77,20 @@ public:
 	{
 		using Vcl::Graphics::Runtime::OpenGL::PipelineState;
 		using Vcl::Graphics::Runtime::OpenGL::RasterizerState;
+		using Vcl::Graphics::Runtime::OpenGL::Sampler;
 		using Vcl::Graphics::Runtime::OpenGL::Shader;
 		using Vcl::Graphics::Runtime::OpenGL::ShaderProgramDescription;
 		using Vcl::Graphics::Runtime::OpenGL::ShaderProgram;
+		using Vcl::Graphics::Runtime::OpenGL::Texture2D;
 		using Vcl::Graphics::Runtime::FillModeMethod;
+		using Vcl::Graphics::Runtime::FilterType;
 		using Vcl::Graphics::Runtime::PipelineStateDescription;
 		using Vcl::Graphics::Runtime::RasterizerDescription;
+		using Vcl::Graphics::Runtime::SamplerDescription;
 		using Vcl::Graphics::Runtime::ShaderType;
+		using Vcl::Graphics::Runtime::Texture2DDescription;
+		using Vcl::Graphics::Runtime::TextureAddressMode;
+		using Vcl::Graphics::Runtime::TextureResource;
 		using Vcl::Graphics::Camera;
 		using Vcl::Graphics::SurfaceFormat;
 
@@ -81,6 +98,7 @@ public:
 		Vcl::Graphics::OpenGL::Context::initExtensions();
 		Vcl::Graphics::OpenGL::Context::setupDebugMessaging();
 		_engine = std::make_unique<Vcl::Graphics::Runtime::OpenGL::GraphicsEngine>();
+		_uploadRing = std::make_unique<UploadRing>();
 
 		// Check availability of features
 		if (!Shader::isSpirvSupported())
@@ -100,6 +118,28 @@ public:
 		temperature_ps_desc.VertexShader = &temperature_vert;
 		temperature_ps_desc.FragmentShader = &temperature_frag;
 		_temperaturePS = std::make_unique<PipelineState>(temperature_ps_desc);
+
+		// Upload the black-body table generated at compile time
+		Texture2DDescription blackbody_tex_desc;
+		blackbody_tex_desc.Width = Blackbody::TableSize;
+		blackbody_tex_desc.Height = 1;
+		blackbody_tex_desc.MipLevels = 1;
+		blackbody_tex_desc.ArraySize = 1;
+		blackbody_tex_desc.Format = SurfaceFormat::R32G32B32A32_FLOAT;
+
+		TextureResource blackbody_res;
+		blackbody_res.Width = Blackbody::TableSize;
+		blackbody_res.Height = 1;
+		blackbody_res.Format = SurfaceFormat::R32G32B32A32_FLOAT;
+		blackbody_res.Data = stdext::make_span(reinterpret_cast<const uint8_t*>(Blackbody::LinearSRGB.Rgba), sizeof(Blackbody::LinearSRGB.Rgba));
+		_blackbodyMap = std::make_unique<Texture2D>(blackbody_tex_desc, &blackbody_res);
+
+		// Interpolate between neighbouring table entries
+		SamplerDescription sampler_desc;
+		sampler_desc.Filter = FilterType::MinMagLinearMipPoint;
+		sampler_desc.AddressU = TextureAddressMode::Clamp;
+		sampler_desc.AddressV = TextureAddressMode::Clamp;
+		_linearSampler = std::make_unique<Sampler>(sampler_desc);
 	}
 
 public:
@@ -114,12 +154,13 @@ public:
 		}
 
 		_engine->beginFrame();
+		_uploadRing->beginFrame();
 
 		_engine->clear(0, Eigen::Vector4f{0.0f, 0.0f, 0.0f, 1.0f});
 		_engine->clear(1.0f);
 
 		// View on the scene
-		auto cbuf_temp = _engine->requestPerFrameConstantBuffer<ColourTemperature>();
+		auto cbuf_temp = _uploadRing->allocate<ColourTemperature>();
 		if (_animate)
 		{
 			cbuf_temp->Temperature = 1000 + (5500 - 1000) * _animation_value;
@@ -130,10 +171,12 @@ public:
 			cbuf_temp->Temperature = 1000 + (5500 - 1000) * _colour_temperature;
 			cbuf_temp->Value = 0.5f + 0.5f * _colour_value;
 		}
-		_engine->setConstantBuffer(0, std::move(cbuf_temp));
+		cbuf_temp->Method = static_cast<int>(_method);
+		_uploadRing->bind(0, cbuf_temp);
 
 		renderScene(Vcl::Graphics::Runtime::PrimitiveType::Trianglelist, _engine.get(), _temperaturePS);
 		
+		_uploadRing->endFrame();
 		_engine->endFrame();
 	}
 	
@@ -146,6 +189,47 @@ public:
 	float colourValue() const { return _colour_value; }
 	void setColourValue(float v) { _colour_value = v; }
 
+	TemperatureMethod method() const { return _method; }
+	void setMethod(TemperatureMethod m) { _method = m; }
+
+	void drawUI(Application& app) override
+	{
+		BaseScene::drawUI(app);
+
+		// Compare the fitted curve against the black-body table on the CPU
+		ImGuiWindowFlags corner =
+			ImGuiWindowFlags_NoMove |
+			ImGuiWindowFlags_NoResize |
+			ImGuiWindowFlags_NoCollapse |
+			ImGuiWindowFlags_NoSavedSettings |
+			ImGuiWindowFlags_AlwaysAutoResize |
+			ImGuiWindowFlags_NoTitleBar;
+
+		ImGui::Begin("Comparison", nullptr, corner);
+		ImGui::SetWindowPos({ 10, (float)app.height() - 200 });
+		ImGui::Text("Temperature  Fitted  Black-body  Max. error");
+		for (float T : { 1500.0f, 2700.0f, 4000.0f, 5500.0f, 6500.0f, 10000.0f, 20000.0f })
+		{
+			const auto fitted = Blackbody::fittedSRGB(T);
+			auto blackbody = Blackbody::linearSRGB(T);
+			for (auto& c : blackbody)
+				c = Blackbody::encodeSRGB(c);
+
+			float error = 0;
+			for (int c = 0; c < 3; c++)
+				error = std::max(error, std::abs(fitted[c] - blackbody[c]));
+
+			ImGui::Text("%8.0fK  ", T);
+			ImGui::SameLine();
+			ImGui::ColorButton("Fitted", { fitted[0], fitted[1], fitted[2], 1 });
+			ImGui::SameLine();
+			ImGui::ColorButton("Black-body", { blackbody[0], blackbody[1], blackbody[2], 1 });
+			ImGui::SameLine();
+			ImGui::Text("  %.3f", error);
+		}
+		ImGui::End();
+	}
+
 private:
 	void renderScene
 	(
@@ -157,6 +241,10 @@ private:
 		// Configure the layout
 		cmd_queue->setPipelineState(ps);
 
+		// Black-body lookup table
+		cmd_queue->setSampler(0, *_linearSampler);
+		cmd_queue->setTexture(0, *_blackbodyMap);
+
 		// Render the quad
 		cmd_queue->setPrimitiveType(primitive_type, 3);
 		cmd_queue->draw(6);
@@ -165,6 +253,9 @@ private:
 private:
 	std::unique_ptr<Vcl::Graphics::Runtime::GraphicsEngine> _engine;
 
+	//! Per-frame constant data
+	std::unique_ptr<UploadRing> _uploadRing;
+
 private:
 	std::unique_ptr<Vcl::Graphics::TrackballCameraController> _cameraController;
 
@@ -189,6 +280,14 @@ private:
 	//! Colour value
 	float _colour_value{ 1 };
 
+	//! Method used to convert temperatures to colours
+	TemperatureMethod _method{ TemperatureMethod::Fitted };
+
+	//! Black-body colours (linear sRGB) indexed by mired
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D> _blackbodyMap;
+
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Sampler> _linearSampler;
+
 	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _temperaturePS;
 };
 
@@ -201,7 +300,8 @@ VCL_RTTI_CTOR_TABLE_END(WrinkledSurfacesExample)
 VCL_RTTI_ATTR_TABLE_BEGIN(WrinkledSurfacesExample)
 	Vcl::RTTI::Attribute<WrinkledSurfacesExample, bool>{ "Animate", &WrinkledSurfacesExample::animate, &WrinkledSurfacesExample::setAnimate },
 	Vcl::RTTI::Attribute<WrinkledSurfacesExample, float>{ "ColourTemperature", &WrinkledSurfacesExample::colourTemperatur, &WrinkledSurfacesExample::setColourTemperatur },
-	Vcl::RTTI::Attribute<WrinkledSurfacesExample, float>{ "ColourValue", &WrinkledSurfacesExample::colourValue, &WrinkledSurfacesExample::setColourValue }
+	Vcl::RTTI::Attribute<WrinkledSurfacesExample, float>{ "ColourValue", &WrinkledSurfacesExample::colourValue, &WrinkledSurfacesExample::setColourValue },
+	Vcl::RTTI::Attribute<WrinkledSurfacesExample, TemperatureMethod>{ "Method", &WrinkledSurfacesExample::method, &WrinkledSurfacesExample::setMethod }
 VCL_RTTI_ATTR_TABLE_END(WrinkledSurfacesExample)
 
 VCL_DEFINE_METAOBJECT(WrinkledSurfacesExample)
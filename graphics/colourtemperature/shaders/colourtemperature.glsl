@@ -72,4 +72,25 @@ vec3 ColorTemperatureToRGB(float temperatureInKelvins)
 	return retColor;
 }
 
+// Look-up of the black-body colour table generated by 'blackbody.h'.
+// The table is indexed uniformly in mired (1e6 / T) and stores linear sRGB.
+vec3 BlackbodyToRGB(sampler2D table, float temperatureInKelvins)
+{
+	const float min_mired = 1e6 / 40000.0;
+	const float max_mired = 1e6 / 1000.0;
+	const float mired = 1e6 / clamp(temperatureInKelvins, 1000.0, 40000.0);
+	const float size = float(textureSize(table, 0).x);
+
+	float u = (mired - max_mired) / (min_mired - max_mired);
+	u = (u * (size - 1.0) + 0.5) / size;
+	return texture(table, vec2(u, 0.5)).rgb;
+}
+
+vec3 linearToSRGB(vec3 c)
+{
+	vec3 lo = 12.92 * c;
+	vec3 hi = 1.055 * pow(c, vec3(1.0 / 2.4)) - 0.055;
+	return mix(hi, lo, lessThanEqual(c, vec3(0.0031308)));
+}
+
 #endif // GLSL_COLOURTEMPERATURE
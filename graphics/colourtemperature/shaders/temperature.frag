@@ -28,11 +28,25 @@
 #include "temperature.h"
 #include "colourtemperature.glsl"
 
+////////////////////////////////////////////////////////////////////////////////
+// Shader Input
+////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) in VertexData
+{
+	// Horizontal position in device coordinates
+	float ScreenX;
+} In;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Shader Output
 ////////////////////////////////////////////////////////////////////////////////
 layout(location = 0) out vec4 FragColour;
 
+////////////////////////////////////////////////////////////////////////////////
+// Shader Constants
+////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) uniform sampler2D BlackbodyMap;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -57,7 +71,16 @@ vec3 hsv2rgb(vec3 c)
 
 void main(void)
 {
-	vec3 rgb = ColorTemperatureToRGB(Temperature);
+	// In comparison mode the left half shows the fitted curve,
+	// the right half the black-body table
+	bool use_table = Method == 1 || (Method == 2 && In.ScreenX > 0);
+
+	vec3 rgb;
+	if (use_table)
+		rgb = linearToSRGB(BlackbodyToRGB(BlackbodyMap, Temperature));
+	else
+		rgb = ColorTemperatureToRGB(Temperature);
+
 	vec3 hsv = rgb2hsv(rgb);
 	hsv.z = Value;
 
@@ -38,6 +38,9 @@ UNIFORM_BUFFER(0) ColourTemperature
 	
 	// Colour value
 	float Value;
+
+	// Conversion method (0: fitted curve, 1: black-body table, 2: comparison)
+	int Method;
 };
 
 #endif // GLSL_WRINKLEDSURFACES_H
@@ -27,6 +27,15 @@
 
 #include "temperature.h"
 
+////////////////////////////////////////////////////////////////////////////////
+// Shader Output
+////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) out VertexData
+{
+	// Horizontal position in device coordinates
+	float ScreenX;
+} Out;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -45,5 +54,6 @@ void main()
 	int node_id = gl_VertexID % 6;
 
 	// Position in device coordinates
+	Out.ScreenX = vertices[node_id].x;
 	gl_Position = vec4(vertices[node_id], 1);
 }
@@ -0,0 +1,323 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/global.h>
+#include <vcl/config/opengl.h>
+
+// C++ standard library
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+// VCL
+#include <vcl/graphics/runtime/graphicsengine.h>
+
+#include "parallel.h"
+#include "uploadring.h"
+
+class CommandList;
+
+//! Constant data recorded into a 'CommandList'. The data stays patchable
+//! until the list is reset.
+template<typename T>
+struct RecordedBlock
+{
+	//! List owning the data
+	CommandList* List;
+
+	//! Offset of the data in the constants of the list
+	size_t Offset;
+
+	T* data() const;
+	T& operator*() const { return *data(); }
+	T* operator->() const { return data(); }
+};
+
+//! Size of a recorded 'CommandList'
+struct CommandListStatistics
+{
+	//! Recorded commands
+	uint32_t Commands{ 0 };
+
+	//! Recorded draws
+	uint32_t Draws{ 0 };
+
+	//! Constant data uploaded per replay
+	uint32_t ConstantBytes{ 0 };
+};
+
+/*!
+ * Engine commands recorded once and replayed in later frames. The list
+ * mirrors the state-setting methods of the 'GraphicsEngine' and stores the
+ * constant data of the commands in one block. A replay copies that block
+ * into the upload ring in one piece and binds ranges of it, so constants
+ * which changed since the recording are patched in place through their
+ * 'RecordedBlock' without recording the commands again.
+ */
+class CommandList
+{
+	using PipelineState = Vcl::Graphics::Runtime::PipelineState;
+	using PrimitiveType = Vcl::Graphics::Runtime::PrimitiveType;
+	using Sampler = Vcl::Graphics::Runtime::Sampler;
+	using Texture = Vcl::Graphics::Runtime::Texture;
+
+	enum class Op : uint32_t
+	{
+		PipelineState,
+		PrimitiveType,
+		Sampler,
+		Texture,
+		Constants,
+		Draw
+	};
+
+	struct Command
+	{
+		Op Code;
+
+		//! Binding point, vertex count of draws, pipeline index
+		uint32_t Slot{ 0 };
+
+		//! Offset of constants, first vertex of draws
+		uint32_t Offset{ 0 };
+
+		//! Size of constants, vertices per patch
+		uint32_t Size{ 0 };
+
+		//! Bound sampler or texture
+		const void* Object{ nullptr };
+
+		PrimitiveType Primitive{ PrimitiveType::Trianglelist };
+	};
+
+public:
+	//! Remove all commands. 'alignment' is the alignment of the upload ring
+	//! the list will be replayed with.
+	void reset(size_t alignment)
+	{
+		_commands.clear();
+		_pipelines.clear();
+		_constants.clear();
+		_alignment = alignment;
+		_stats = {};
+	}
+
+	void setPipelineState(Vcl::ref_ptr<PipelineState> pipeline)
+	{
+		_pipelines.push_back(pipeline);
+		push({ Op::PipelineState, static_cast<uint32_t>(_pipelines.size() - 1) });
+	}
+
+	void setPrimitiveType(PrimitiveType type, int nr_vertices = 0)
+	{
+		push({ Op::PrimitiveType, 0, 0, static_cast<uint32_t>(nr_vertices), nullptr, type });
+	}
+
+	void setSampler(int slot, const Sampler& sampler)
+	{
+		push({ Op::Sampler, static_cast<uint32_t>(slot), 0, 0, &sampler });
+	}
+
+	void setTexture(int slot, const Texture& texture)
+	{
+		push({ Op::Texture, static_cast<uint32_t>(slot), 0, 0, &texture });
+	}
+
+	//! Allocate constant data in the list
+	template<typename T>
+	RecordedBlock<T> allocate()
+	{
+		const size_t offset = (_constants.size() + _alignment - 1) / _alignment * _alignment;
+		_constants.resize(offset + sizeof(T));
+		new (_constants.data() + offset) T;
+		_stats.ConstantBytes = static_cast<uint32_t>(_constants.size());
+		return { this, offset };
+	}
+
+	//! Bind recorded constants to the uniform buffer binding point 'index'
+	template<typename T>
+	void bind(GLuint index, const RecordedBlock<T>& block)
+	{
+		push({ Op::Constants, index, static_cast<uint32_t>(block.Offset), static_cast<uint32_t>(sizeof(T)) });
+	}
+
+	void draw(int count, int first = 0)
+	{
+		push({ Op::Draw, static_cast<uint32_t>(count), static_cast<uint32_t>(first) });
+		_stats.Draws++;
+	}
+
+	//! Issue the recorded commands
+	void replay(Vcl::Graphics::Runtime::GraphicsEngine* cmd_queue, UploadRing& ring) const
+	{
+		if (ring.alignment() > _alignment)
+			throw std::runtime_error("Command list was recorded for a smaller constant alignment.");
+
+		auto constants = ring.allocate<uint8_t>(_constants.size());
+		if (!_constants.empty())
+			std::memcpy(constants.Data, _constants.data(), _constants.size());
+
+		for (const Command& cmd : _commands)
+		{
+			switch (cmd.Code)
+			{
+			case Op::PipelineState:
+				cmd_queue->setPipelineState(_pipelines[cmd.Slot]);
+				break;
+			case Op::PrimitiveType:
+				cmd_queue->setPrimitiveType(cmd.Primitive, cmd.Size);
+				break;
+			case Op::Sampler:
+				cmd_queue->setSampler(cmd.Slot, *static_cast<const Sampler*>(cmd.Object));
+				break;
+			case Op::Texture:
+				cmd_queue->setTexture(cmd.Slot, *static_cast<const Texture*>(cmd.Object));
+				break;
+			case Op::Constants:
+				ring.bind(cmd.Slot, UploadBlock<uint8_t>{ constants.Data + cmd.Offset, constants.Offset + cmd.Offset, cmd.Size });
+				break;
+			case Op::Draw:
+				cmd_queue->draw(cmd.Slot, cmd.Offset);
+				break;
+			}
+		}
+	}
+
+	const CommandListStatistics& statistics() const { return _stats; }
+
+private:
+	template<typename T>
+	friend struct RecordedBlock;
+
+	void push(const Command& cmd)
+	{
+		_commands.push_back(cmd);
+		_stats.Commands++;
+	}
+
+	//! Recorded commands
+	std::vector<Command> _commands;
+
+	//! Pipelines referenced by the commands
+	std::vector<Vcl::ref_ptr<PipelineState>> _pipelines;
+
+	//! Constant data of the commands
+	std::vector<uint8_t> _constants;
+
+	//! Alignment of the blocks in '_constants'
+	size_t _alignment{ 256 };
+
+	//! Size of the list
+	CommandListStatistics _stats;
+};
+
+template<typename T>
+T* RecordedBlock<T>::data() const
+{
+	return reinterpret_cast<T*>(List->_constants.data() + Offset);
+}
+
+//! Timing of a frame recorded by a 'ParallelRecorder'
+struct ParallelRecordingStatistics
+{
+	//! Command lists which received a range
+	uint32_t Lists{ 0 };
+
+	//! Sum over the lists
+	CommandListStatistics Commands;
+
+	//! Wall time of recording all lists in ms
+	double RecordMs{ 0 };
+
+	//! Time of replaying the lists on the context thread in ms
+	double ReplayMs{ 0 };
+};
+
+/*!
+ * Fork/join recording of a frame. 'record' splits the items of the frame
+ * into contiguous ranges, records each range into its own command list on
+ * a worker thread and returns when all lists are complete. Only the thread
+ * owning the GL context calls 'replay', which issues the lists in the
+ * order of their ranges, so the result matches recording on one thread.
+ */
+class ParallelRecorder
+{
+public:
+	/*!
+	 * Record the items [0, nr_items) with up to 'nr_threads' threads by
+	 * invoking 'func(range, list, begin, end)' per range. 'alignment' is the
+	 * alignment of the upload ring used for the replay.
+	 */
+	template<typename Func>
+	void record(size_t nr_items, size_t nr_threads, size_t alignment, Func&& func)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		nr_threads = std::max<size_t>(1, nr_threads);
+		if (_lists.size() < nr_threads)
+			_lists.resize(nr_threads);
+		for (auto& list : _lists)
+			list.reset(alignment);
+
+		parallelChunks(0, nr_items, nr_threads, [this, &func](size_t chunk, size_t begin, size_t end)
+		{
+			func(chunk, _lists[chunk], begin, end);
+		});
+
+		_stats = {};
+		_stats.Lists = static_cast<uint32_t>(std::min(nr_threads, std::max<size_t>(1, nr_items)));
+		for (const auto& list : _lists)
+		{
+			_stats.Commands.Commands += list.statistics().Commands;
+			_stats.Commands.Draws += list.statistics().Draws;
+			_stats.Commands.ConstantBytes += list.statistics().ConstantBytes;
+		}
+		_stats.RecordMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//! Issue the recorded lists in order, must be called on the context thread
+	void replay(Vcl::Graphics::Runtime::GraphicsEngine* cmd_queue, UploadRing& ring)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (size_t l = 0; l < _stats.Lists; l++)
+			_lists[l].replay(cmd_queue, ring);
+		_stats.ReplayMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	const ParallelRecordingStatistics& statistics() const { return _stats; }
+
+private:
+	//! One list per range of the frame
+	std::vector<CommandList> _lists;
+
+	//! Counters of the last frame
+	ParallelRecordingStatistics _stats;
+};
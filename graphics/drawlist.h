@@ -0,0 +1,241 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*!
+ * Layout of the 64-bit keys ordering the draws of a 'DrawList', from the
+ * most significant bits: pass, pipeline, material and depth. Sorting by the
+ * key groups draws sharing a pipeline, then draws sharing a material within
+ * it, and orders the draws of a group by depth.
+ */
+namespace DrawKey
+{
+	const int PassBits = 4;
+	const int PipelineBits = 10;
+	const int MaterialBits = 18;
+	const int DepthBits = 32;
+
+	const int MaterialShift = DepthBits;
+	const int PipelineShift = MaterialShift + MaterialBits;
+	const int PassShift = PipelineShift + PipelineBits;
+
+	//! Bits of a depth which sort like the depth itself, or inversely for
+	//! back-to-front passes. Negative depths are clamped to zero.
+	inline uint32_t depthBits(float depth, bool back_to_front = false)
+	{
+		uint32_t bits = 0;
+		if (depth > 0)
+			std::memcpy(&bits, &depth, sizeof(bits));
+		return back_to_front ? ~bits : bits;
+	}
+
+	inline uint64_t make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t depth_bits)
+	{
+		return
+			(uint64_t(pass     & ((1u << PassBits) - 1)) << PassShift) |
+			(uint64_t(pipeline & ((1u << PipelineBits) - 1)) << PipelineShift) |
+			(uint64_t(material & ((1u << MaterialBits) - 1)) << MaterialShift) |
+			uint64_t(depth_bits);
+	}
+
+	inline uint32_t pass(uint64_t key) { return uint32_t(key >> PassShift) & ((1u << PassBits) - 1); }
+	inline uint32_t pipeline(uint64_t key) { return uint32_t(key >> PipelineShift) & ((1u << PipelineBits) - 1); }
+	inline uint32_t material(uint64_t key) { return uint32_t(key >> MaterialShift) & ((1u << MaterialBits) - 1); }
+}
+
+//! Activity of a 'DrawList' in the last submission
+struct DrawListStatistics
+{
+	//! Submitted draws
+	uint32_t Draws{ 0 };
+
+	//! Pipeline and material changes issued
+	uint32_t PipelineChanges{ 0 };
+	uint32_t MaterialChanges{ 0 };
+
+	//! Changes saved compared to submitting in the order of 'add', zero if
+	//! the sorted order needed more (e.g. when ranges are submitted apart)
+	uint32_t PipelineChangesAvoided{ 0 };
+	uint32_t MaterialChangesAvoided{ 0 };
+
+	//! CPU time of sorting the draws in ms
+	double SortMs{ 0 };
+};
+
+/*!
+ * Draws collected in any order and submitted ordered by their sort keys.
+ * The list only holds the keys and an object index per draw. The pipeline
+ * and material encoded in the key are bound through callbacks when they
+ * differ from those of the previous draw.
+ */
+class DrawList
+{
+public:
+	struct Item
+	{
+		uint64_t Key;
+		uint32_t Object;
+	};
+
+	size_t size() const { return _items.size(); }
+	const std::vector<Item>& items() const { return _items; }
+
+	void clear()
+	{
+		_items.clear();
+		_sorted = false;
+		_insertionPipelineChanges = 0;
+		_insertionMaterialChanges = 0;
+	}
+
+	//! Queue a draw of 'object', the key is built with 'DrawKey::make'
+	void add(uint64_t key, uint32_t object)
+	{
+		// State changes if the draws were submitted in this order
+		if (_items.empty() || DrawKey::pipeline(_items.back().Key) != DrawKey::pipeline(key))
+			_insertionPipelineChanges++;
+		if (_items.empty() || DrawKey::material(_items.back().Key) != DrawKey::material(key))
+			_insertionMaterialChanges++;
+
+		_items.push_back({ key, object });
+		_sorted = false;
+	}
+
+	//! Stable least-significant-digit radix sort of the draws by key. Bytes
+	//! which are equal in all keys are skipped.
+	void sort()
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		// Histograms of all eight bytes in one pass
+		std::array<std::array<uint32_t, 256>, 8> counts{};
+		for (const Item& item : _items)
+			for (int d = 0; d < 8; d++)
+				counts[d][(item.Key >> (8 * d)) & 0xff]++;
+
+		_scratch.resize(_items.size());
+		for (int d = 0; d < 8; d++)
+		{
+			auto& count = counts[d];
+			if (_items.empty() || count[(_items.front().Key >> (8 * d)) & 0xff] == _items.size())
+				continue;
+
+			uint32_t offset = 0;
+			for (auto& c : count)
+			{
+				const uint32_t n = c;
+				c = offset;
+				offset += n;
+			}
+			for (const Item& item : _items)
+				_scratch[count[(item.Key >> (8 * d)) & 0xff]++] = item;
+			_items.swap(_scratch);
+		}
+
+		_sorted = true;
+		_stats.SortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/*!
+	 * Issue the draws in the order of the list. 'bind_pipeline(pipeline)'
+	 * and 'bind_material(material)' are called when the respective part of
+	 * the key changes, 'draw(object)' for every draw.
+	 */
+	template<typename BindPipeline, typename BindMaterial, typename Draw>
+	void submit(BindPipeline&& bind_pipeline, BindMaterial&& bind_material, Draw&& draw)
+	{
+		DrawListStatistics stats;
+		submit(0, _items.size(), bind_pipeline, bind_material, draw, stats);
+		complete(stats);
+	}
+
+	/*!
+	 * Issue the draws [begin, end) and add them to the counters in 'stats'.
+	 * The state before 'begin' is treated as unknown, such that ranges can
+	 * be submitted to separate command lists concurrently.
+	 */
+	template<typename BindPipeline, typename BindMaterial, typename Draw>
+	void submit(size_t begin, size_t end, BindPipeline&& bind_pipeline, BindMaterial&& bind_material, Draw&& draw, DrawListStatistics& stats) const
+	{
+		stats.Draws += static_cast<uint32_t>(end - begin);
+		for (size_t i = begin; i < end; i++)
+		{
+			const uint64_t key = _items[i].Key;
+			if (i == begin || DrawKey::pipeline(_items[i - 1].Key) != DrawKey::pipeline(key))
+			{
+				bind_pipeline(DrawKey::pipeline(key));
+				stats.PipelineChanges++;
+			}
+			if (i == begin || DrawKey::material(_items[i - 1].Key) != DrawKey::material(key))
+			{
+				bind_material(DrawKey::material(key));
+				stats.MaterialChanges++;
+			}
+			draw(_items[i].Object);
+		}
+	}
+
+	//! Store the counters of a submission, which may consist of several ranges
+	void complete(DrawListStatistics stats)
+	{
+		stats.SortMs = _sorted ? _stats.SortMs : 0.0;
+		stats.PipelineChangesAvoided = avoidedChanges(_insertionPipelineChanges, stats.PipelineChanges);
+		stats.MaterialChangesAvoided = avoidedChanges(_insertionMaterialChanges, stats.MaterialChanges);
+		_stats = stats;
+	}
+
+	const DrawListStatistics& statistics() const { return _stats; }
+
+private:
+	//! Changes saved by the sorted order, clamped such that it cannot wrap
+	static uint32_t avoidedChanges(uint32_t insertion, uint32_t issued)
+	{
+		return insertion - std::min(issued, insertion);
+	}
+
+	//! Queued draws
+	std::vector<Item> _items;
+
+	//! Double buffer of the radix sort
+	std::vector<Item> _scratch;
+
+	//! Whether '_items' is ordered by key
+	bool _sorted{ false };
+
+	//! Changes required by the order in which the draws were added
+	uint32_t _insertionPipelineChanges{ 0 };
+	uint32_t _insertionMaterialChanges{ 0 };
+
+	//! Counters of the last submission
+	DrawListStatistics _stats;
+};
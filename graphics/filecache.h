@@ -0,0 +1,196 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#	include <direct.h>
+#	include <process.h>
+#else
+#	include <unistd.h>
+#endif
+
+#include "mappedfile.h"
+#include "parallel.h"
+
+/*!
+ * Helpers shared by the on-disk caches of the demos: content keys of source
+ * files and the directory the cache files are stored in.
+ */
+namespace FileCache
+{
+	namespace Detail
+	{
+		inline uint64_t rotl(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+
+		//! Final mix of a 64-bit hash, every input bit affects every output bit
+		inline uint64_t avalanche(uint64_t h)
+		{
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdull;
+			h ^= h >> 33;
+			h *= 0xc4ceb9fe1a85ec53ull;
+			h ^= h >> 33;
+			return h;
+		}
+	}
+
+	/*!
+	 * 64-bit hash of 'size' bytes. Consumes eight bytes per step, which
+	 * keeps hashing a mapped file close to the speed of reading it.
+	 */
+	inline uint64_t hash(const void* data, size_t size, uint64_t seed = 0)
+	{
+		using Detail::rotl;
+
+		const uint64_t k1 = 0x9e3779b185ebca87ull;
+		const uint64_t k2 = 0xc2b2ae3d27d4eb4full;
+		const auto* bytes = static_cast<const uint8_t*>(data);
+
+		uint64_t h = seed ^ (static_cast<uint64_t>(size) * k1);
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t w;
+			std::memcpy(&w, bytes + i, 8);
+			h ^= rotl(w * k2, 31) * k1;
+			h = rotl(h, 27) * k1 + 0x52dce729;
+		}
+		for (; i < size; i++)
+		{
+			h ^= bytes[i] * k1;
+			h = rotl(h, 11) * k2;
+		}
+		return Detail::avalanche(h);
+	}
+
+	/*!
+	 * Hash of the entire content of the file 'path', zero if it cannot be
+	 * read. The file is mapped and hashed in blocks on all threads.
+	 */
+	inline uint64_t hashFile(const std::string& path)
+	{
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0)
+			return 0;
+
+		MappedFile file{ path };
+		const size_t block_size = 4 << 20;
+		const size_t nr_blocks = (file.size() + block_size - 1) / block_size;
+		std::vector<uint64_t> blocks(nr_blocks);
+		parallelFor(0, nr_blocks, 1, [&](size_t, size_t b, size_t e)
+		{
+			for (size_t blk = b; blk < e; blk++)
+			{
+				const size_t offset = blk * block_size;
+				blocks[blk] = hash(file.data() + offset, std::min(block_size, file.size() - offset), blk);
+			}
+		});
+		return hash(blocks.data(), blocks.size() * sizeof(uint64_t), file.size());
+	}
+
+	namespace Detail
+	{
+		inline void makeDirectory(const std::string& path)
+		{
+#ifdef _WIN32
+			_mkdir(path.c_str());
+#else
+			mkdir(path.c_str(), 0755);
+#endif
+		}
+	}
+
+	/*!
+	 * Directory 'name' in the cache directory of the user, e.g.
+	 * '~/.cache/vcl/<name>' or '%LOCALAPPDATA%/vcl/<name>'. The directories
+	 * are created if necessary. Falls back to the working directory if the
+	 * user has no cache directory.
+	 */
+	inline std::string directory(const std::string& name)
+	{
+		std::string base;
+#ifdef _WIN32
+		if (const char* local = std::getenv("LOCALAPPDATA"))
+			base = local;
+#else
+		if (const char* xdg = std::getenv("XDG_CACHE_HOME"))
+			base = xdg;
+		else if (const char* home = std::getenv("HOME"))
+			base = std::string{ home } + "/.cache";
+#endif
+		if (base.empty())
+			base = ".";
+
+		// Existing directories are left untouched
+		const std::string path = base + "/vcl/" + name;
+		Detail::makeDirectory(base);
+		Detail::makeDirectory(base + "/vcl");
+		Detail::makeDirectory(path);
+		return path;
+	}
+
+	/*!
+	 * Name of a temporary file next to 'path', unique per process and call.
+	 * Cache files are written there first and moved into place by 'replace'.
+	 */
+	inline std::string temporaryPath(const std::string& path)
+	{
+		static std::atomic<unsigned> counter{ 0 };
+#ifdef _WIN32
+		const int pid = _getpid();
+#else
+		const int pid = static_cast<int>(getpid());
+#endif
+		return path + "." + std::to_string(pid) + "." + std::to_string(counter++) + ".tmp";
+	}
+
+	/*!
+	 * Move the completely written file 'tmp' over 'path'. The rename is
+	 * atomic, readers see either the old or the new file but never a partial
+	 * one. Removes 'tmp' and returns false on failure.
+	 */
+	inline bool replace(const std::string& tmp, const std::string& path)
+	{
+#ifdef _WIN32
+		const bool ok = MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		const bool ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+#endif
+		if (!ok)
+			std::remove(tmp.c_str());
+		return ok;
+	}
+}
@@ -0,0 +1,147 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/opengl.h>
+
+// C++ standard library
+#include <array>
+#include <cstdint>
+
+/*!
+ * Counts GPU events between 'begin' and 'end' using queries of the given
+ * target, e.g. GL_VERTEX_SHADER_INVOCATIONS_ARB. Like 'GpuTimer', results
+ * are only read once the GPU reports them available, and a frame is skipped
+ * if all queries are in flight. Each query keeps the tag passed to 'begin',
+ * such that a count several frames old is related to the work it measured.
+ * Counters of the same target must not be nested.
+ */
+class GpuCounter
+{
+public:
+	//! Number of frames a query result may lag behind
+	static const int NrQueries = 4;
+
+	explicit GpuCounter(GLenum target)
+	: _target(target)
+	{
+		glGenQueries(NrQueries, _queries.data());
+	}
+	~GpuCounter()
+	{
+		glDeleteQueries(NrQueries, _queries.data());
+	}
+	GpuCounter(const GpuCounter&) = delete;
+	GpuCounter& operator=(const GpuCounter&) = delete;
+
+	//! Start counting, 'tag' is returned with the result of this query
+	void begin(uint64_t tag = 0)
+	{
+		collect();
+
+		// All queries are still in flight
+		_active = !_issued[_current];
+		if (_active)
+		{
+			_tags[_current] = tag;
+			glBeginQuery(_target, _queries[_current]);
+		}
+	}
+
+	void end()
+	{
+		if (!_active)
+			return;
+
+		glEndQuery(_target);
+		_issued[_current] = true;
+		_current = (_current + 1) % NrQueries;
+		_active = false;
+	}
+
+	//! Indicate whether 'count' contains a measurement
+	bool hasResult() const { return _hasResult; }
+
+	//! Most recently collected count
+	uint64_t count() const { return _count; }
+
+	//! Tag of the query 'count' was read from
+	uint64_t tag() const { return _tag; }
+
+private:
+	//! Read the available results, the oldest pending query is the first
+	//! issued one starting at the current
+	void collect()
+	{
+		for (int i = 0; i < NrQueries; i++)
+		{
+			const int q = (_current + i) % NrQueries;
+			if (!_issued[q])
+				continue;
+
+			// Queries complete in order
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(_queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available == GL_FALSE)
+				break;
+
+			GLuint64 count = 0;
+			glGetQueryObjectui64v(_queries[q], GL_QUERY_RESULT, &count);
+			_issued[q] = false;
+
+			_count = count;
+			_tag = _tags[q];
+			_hasResult = true;
+		}
+	}
+
+	//! Query target
+	GLenum _target;
+
+	//! Queries used in round robin
+	std::array<GLuint, NrQueries> _queries;
+
+	//! Tags passed to 'begin' for each query
+	std::array<uint64_t, NrQueries> _tags{};
+
+	//! Queries which contain a pending result
+	std::array<bool, NrQueries> _issued{ { false, false, false, false } };
+
+	//! Next query to use
+	int _current{ 0 };
+
+	//! Indicate whether the current 'begin' started a query
+	bool _active{ false };
+
+	//! Indicate whether '_count' contains a measurement
+	bool _hasResult{ false };
+
+	//! Last collected count
+	uint64_t _count{ 0 };
+
+	//! Tag of the last collected count
+	uint64_t _tag{ 0 };
+};
@@ -0,0 +1,86 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/opengl.h>
+
+// C++ standard library
+#include <array>
+#include <cstdint>
+
+/*!
+ * Reads back a few 32-bit counters written by the GPU, e.g. the instance
+ * count of an indirect draw. Copies are recycled in a ring, such that the
+ * CPU only reads copies the GPU has finished several frames ago.
+ */
+template<int NrValues>
+class GpuReadback
+{
+public:
+	//! Number of frames a result may lag behind
+	static const int NrCopies = 4;
+
+	GpuReadback()
+	{
+		glCreateBuffers(NrCopies, _buffers.data());
+		for (const auto buffer : _buffers)
+			glNamedBufferStorage(buffer, sizeof(_values), nullptr, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+	}
+	~GpuReadback()
+	{
+		glDeleteBuffers(NrCopies, _buffers.data());
+	}
+	GpuReadback(const GpuReadback&) = delete;
+	GpuReadback& operator=(const GpuReadback&) = delete;
+
+	//! Copy 'NrValues' counters starting at 'offset' bytes in 'buffer'
+	void copy(GLuint buffer, GLintptr offset)
+	{
+		// Collect the oldest copy before reusing it
+		if (_issued[_current])
+			glGetNamedBufferSubData(_buffers[_current], 0, sizeof(_values), _values.data());
+
+		glCopyNamedBufferSubData(buffer, _buffers[_current], offset, 0, sizeof(_values));
+		_issued[_current] = true;
+		_current = (_current + 1) % NrCopies;
+	}
+
+	//! Latest counters read back
+	uint32_t operator[](int i) const { return _values[i]; }
+
+private:
+	//! Buffers used in round robin
+	std::array<GLuint, NrCopies> _buffers;
+
+	//! Buffers which contain a pending copy
+	std::array<bool, NrCopies> _issued{ { false, false, false, false } };
+
+	//! Next buffer to use
+	int _current{ 0 };
+
+	//! Last values read back
+	std::array<uint32_t, NrValues> _values{};
+};
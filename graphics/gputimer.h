@@ -0,0 +1,125 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/opengl.h>
+
+// C++ standard library
+#include <array>
+
+/*!
+ * Measures the GPU time spent between 'begin' and 'end' using timer queries.
+ * Queries are recycled in a ring and their results are only read once the
+ * GPU reports them available, so the timer never stalls the pipeline it
+ * measures. If the GPU lags so far behind that no query is free, the
+ * measurement of the frame is skipped. Timers must not be nested.
+ */
+class GpuTimer
+{
+public:
+	//! Number of frames a query result may lag behind
+	static const int NrQueries = 4;
+
+	GpuTimer()
+	{
+		glGenQueries(NrQueries, _queries.data());
+	}
+	~GpuTimer()
+	{
+		glDeleteQueries(NrQueries, _queries.data());
+	}
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	void begin()
+	{
+		collect();
+
+		// All queries are still in flight
+		_active = !_issued[_current];
+		if (_active)
+			glBeginQuery(GL_TIME_ELAPSED, _queries[_current]);
+	}
+
+	void end()
+	{
+		if (!_active)
+			return;
+
+		glEndQuery(GL_TIME_ELAPSED);
+		_issued[_current] = true;
+		_current = (_current + 1) % NrQueries;
+		_active = false;
+	}
+
+	//! Smoothed GPU time in milliseconds
+	double elapsed() const { return _elapsed; }
+
+private:
+	//! Read the available results, the oldest pending query is the first
+	//! issued one starting at the current
+	void collect()
+	{
+		for (int i = 0; i < NrQueries; i++)
+		{
+			const int q = (_current + i) % NrQueries;
+			if (!_issued[q])
+				continue;
+
+			// Queries complete in order
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(_queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available == GL_FALSE)
+				break;
+
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(_queries[q], GL_QUERY_RESULT, &ns);
+			_issued[q] = false;
+
+			const double ms = static_cast<double>(ns) * 1e-6;
+			_elapsed = _hasResult ? 0.9 * _elapsed + 0.1 * ms : ms;
+			_hasResult = true;
+		}
+	}
+
+	//! Timer queries used in round robin
+	std::array<GLuint, NrQueries> _queries;
+
+	//! Queries which contain a pending result
+	std::array<bool, NrQueries> _issued{ { false, false, false, false } };
+
+	//! Next query to use
+	int _current{ 0 };
+
+	//! Indicate whether the current 'begin' started a query
+	bool _active{ false };
+
+	//! Indicate whether '_elapsed' contains a measurement
+	bool _hasResult{ false };
+
+	//! Smoothed elapsed time
+	double _elapsed{ 0 };
+};
@@ -0,0 +1,144 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#	ifndef WIN32_LEAN_AND_MEAN
+#		define WIN32_LEAN_AND_MEAN
+#	endif
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+/*!
+ * Read-only memory mapping of an entire file. Pages are loaded on demand by
+ * the operating system, the content is never copied into user memory.
+ */
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string& path)
+	{
+#ifdef _WIN32
+		_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (_file == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Could not open file: " + path);
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(_file, &size))
+		{
+			CloseHandle(_file);
+			throw std::runtime_error("Could not query the size of file: " + path);
+		}
+		_size = static_cast<size_t>(size.QuadPart);
+		if (_size == 0)
+			return;
+
+		_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (_mapping == nullptr)
+		{
+			CloseHandle(_file);
+			throw std::runtime_error("Could not map file: " + path);
+		}
+		_data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+		if (_data == nullptr)
+		{
+			CloseHandle(_mapping);
+			CloseHandle(_file);
+			throw std::runtime_error("Could not map file: " + path);
+		}
+#else
+		_file = open(path.c_str(), O_RDONLY);
+		if (_file < 0)
+			throw std::runtime_error("Could not open file: " + path);
+
+		struct stat st;
+		if (fstat(_file, &st) != 0)
+		{
+			close(_file);
+			throw std::runtime_error("Could not query the size of file: " + path);
+		}
+		_size = static_cast<size_t>(st.st_size);
+		if (_size == 0)
+			return;
+
+		void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _file, 0);
+		if (data == MAP_FAILED)
+		{
+			close(_file);
+			throw std::runtime_error("Could not map file: " + path);
+		}
+		madvise(data, _size, MADV_SEQUENTIAL);
+		_data = static_cast<const char*>(data);
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (_data)
+			UnmapViewOfFile(_data);
+		if (_mapping)
+			CloseHandle(_mapping);
+		CloseHandle(_file);
+#else
+		if (_data)
+			munmap(const_cast<char*>(_data), _size);
+		close(_file);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data() const { return _data; }
+	size_t size() const { return _size; }
+
+private:
+#ifdef _WIN32
+	HANDLE _file{ INVALID_HANDLE_VALUE };
+	HANDLE _mapping{ nullptr };
+#else
+	int _file{ -1 };
+#endif
+
+	//! Begin of the mapped file content
+	const char* _data{ nullptr };
+
+	//! Size of the file in bytes
+	size_t _size{ 0 };
+};
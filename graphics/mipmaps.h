@@ -0,0 +1,322 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "parallel.h"
+#include "simd.h"
+
+//! Reduction of 2x2 texels to one texel of the next mip level
+enum class MipFilter
+{
+	//! Average of all channels, e.g. for height maps
+	Average,
+
+	//! Average of the colour in linear light, alpha is averaged as is
+	Srgb,
+
+	//! Average of the first three channels as normals mapped to [0, 1], renormalized
+	Normal,
+
+	//! Maximum of all channels, a conservative bound for height maps
+	Maximum
+};
+
+//! Size and location of a level in 'MipChain::Data'
+struct MipLevelLayout
+{
+	uint32_t Width;
+	uint32_t Height;
+
+	//! Index of the first element of the level
+	size_t Offset;
+};
+
+//! All levels of a texture with interleaved channels, the finest first
+template<typename T>
+struct MipChain
+{
+	uint32_t Channels{ 0 };
+	std::vector<MipLevelLayout> Levels;
+	std::vector<T> Data;
+
+	const T* level(size_t l) const { return Data.data() + Levels[l].Offset; }
+	size_t levelSize(size_t l) const { return size_t{ Levels[l].Width } * Levels[l].Height * Channels; }
+};
+
+//! Number of levels down to 1x1
+inline uint32_t mipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+		levels++;
+	return levels;
+}
+
+namespace MipDetail
+{
+	inline float toFloat(uint8_t v) { return v * (1.0f / 255.0f); }
+	inline float toFloat(uint16_t v) { return v * (1.0f / 65535.0f); }
+	inline float toFloat(float v) { return v; }
+
+	inline void fromFloat(float f, uint8_t& v) { v = static_cast<uint8_t>(std::min(std::max(f, 0.0f), 1.0f) * 255.0f + 0.5f); }
+	inline void fromFloat(float f, uint16_t& v) { v = static_cast<uint16_t>(std::min(std::max(f, 0.0f), 1.0f) * 65535.0f + 0.5f); }
+	inline void fromFloat(float f, float& v) { v = f; }
+
+	inline float srgbToLinear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+	inline float linearToSrgb(float c)
+	{
+		c = std::min(std::max(c, 0.0f), 1.0f);
+		return c <= 0.0031308f ? 12.92f * c : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	}
+
+	//! Linear value of each 8-bit sRGB value
+	inline const std::array<float, 256>& srgbTable()
+	{
+		static const std::array<float, 256> table = []()
+		{
+			std::array<float, 256> t;
+			for (int i = 0; i < 256; i++)
+				t[i] = srgbToLinear(i / 255.0f);
+			return t;
+		}();
+		return table;
+	}
+
+	//! Linear values half-way between consecutive 8-bit sRGB values
+	inline const std::array<float, 255>& srgbThresholds()
+	{
+		static const std::array<float, 255> table = []()
+		{
+			std::array<float, 255> t;
+			for (int i = 0; i < 255; i++)
+				t[i] = srgbToLinear((i + 0.5f) / 255.0f);
+			return t;
+		}();
+		return table;
+	}
+
+	inline float decode(uint8_t v, bool srgb) { return srgb ? srgbTable()[v] : toFloat(v); }
+	template<typename T>
+	float decode(T v, bool srgb) { return srgb ? srgbToLinear(toFloat(v)) : toFloat(v); }
+
+	//! 8-bit sRGB values are found by bisection instead of a power per value
+	inline void encode(float f, bool srgb, uint8_t& v)
+	{
+		if (!srgb)
+			return fromFloat(f, v);
+
+		const auto& thresholds = srgbThresholds();
+		v = static_cast<uint8_t>(std::upper_bound(thresholds.begin(), thresholds.end(), f) - thresholds.begin());
+	}
+	template<typename T>
+	void encode(float f, bool srgb, T& v) { fromFloat(srgb ? linearToSrgb(f) : f, v); }
+
+	//! Decode channel 'c' of a row, 'row' points to the channel of the first texel
+	template<typename T>
+	void decodeRow(const T* row, uint32_t width, uint32_t channels, bool srgb, float* out)
+	{
+		for (uint32_t x = 0; x < width; x++)
+			out[x] = decode(row[x * channels], srgb);
+	}
+
+	//! Rows per parallel chunk, such that a chunk covers at least 16k texels
+	inline size_t rowGrain(uint32_t width)
+	{
+		return std::max<size_t>(1, 16384 / std::max<uint32_t>(width, 1));
+	}
+
+	/*!
+	 * Reduce one row of a channel plane. 'r0' and 'r1' are the two source
+	 * rows, which are the same for sources of height one.
+	 */
+	inline void reduceRow(const float* r0, const float* r1, uint32_t src_width, float* out, uint32_t width, bool maximum)
+	{
+		using Simd::FloatV;
+
+		uint32_t x = 0;
+		if (src_width >= 2)
+		{
+			const FloatV quarter = FloatV::set(0.25f);
+			for (; x + FloatV::Width <= width; x += FloatV::Width)
+			{
+				const FloatV a0 = FloatV::load(r0 + 2 * x);
+				const FloatV a1 = FloatV::load(r0 + 2 * x + FloatV::Width);
+				const FloatV b0 = FloatV::load(r1 + 2 * x);
+				const FloatV b1 = FloatV::load(r1 + 2 * x + FloatV::Width);
+
+				FloatV even, odd;
+				if (maximum)
+				{
+					Simd::deinterleave(max(a0, b0), max(a1, b1), even, odd);
+					max(even, odd).store(out + x);
+				}
+				else
+				{
+					Simd::deinterleave(a0 + b0, a1 + b1, even, odd);
+					((even + odd) * quarter).store(out + x);
+				}
+			}
+		}
+
+		// Tail, and sources of width one which use their column twice
+		for (; x < width; x++)
+		{
+			const uint32_t c0 = std::min(2 * x, src_width - 1);
+			const uint32_t c1 = std::min(2 * x + 1, src_width - 1);
+			if (maximum)
+				out[x] = std::max(std::max(r0[c0], r0[c1]), std::max(r1[c0], r1[c1]));
+			else
+				out[x] = 0.25f * (r0[c0] + r0[c1] + r1[c0] + r1[c1]);
+		}
+	}
+
+	//! Renormalize the normals of a row given as three planes with values in [0, 1]
+	inline void renormalizeRow(float* nx, float* ny, float* nz, uint32_t width)
+	{
+		using Simd::FloatV;
+
+		const FloatV one = FloatV::set(1.0f);
+		const FloatV two = FloatV::set(2.0f);
+		const FloatV half = FloatV::set(0.5f);
+		const FloatV eps = FloatV::set(1e-12f);
+		uint32_t x = 0;
+		for (; x + FloatV::Width <= width; x += FloatV::Width)
+		{
+			const FloatV x0 = madd(two, FloatV::load(nx + x), FloatV::set(-1.0f));
+			const FloatV y0 = madd(two, FloatV::load(ny + x), FloatV::set(-1.0f));
+			const FloatV z0 = madd(two, FloatV::load(nz + x), FloatV::set(-1.0f));
+			const FloatV len2 = madd(x0, x0, madd(y0, y0, z0 * z0));
+			const FloatV valid = len2 > eps;
+			const FloatV scale = select(valid, half / sqrt(select(valid, len2, one)), FloatV::set(0.0f));
+			madd(x0, scale, half).store(nx + x);
+			madd(y0, scale, half).store(ny + x);
+			select(valid, madd(z0, scale, half), one).store(nz + x);
+		}
+		for (; x < width; x++)
+		{
+			const float x0 = 2 * nx[x] - 1, y0 = 2 * ny[x] - 1, z0 = 2 * nz[x] - 1;
+			const float len2 = x0 * x0 + y0 * y0 + z0 * z0;
+			const float scale = len2 > 1e-12f ? 0.5f / std::sqrt(len2) : 0.0f;
+			nx[x] = x0 * scale + 0.5f;
+			ny[x] = y0 * scale + 0.5f;
+			nz[x] = len2 > 1e-12f ? z0 * scale + 0.5f : 1.0f;
+		}
+	}
+}
+
+/*!
+ * Compute all mip levels of an image with 'channels' interleaved channels.
+ * The levels are reduced in floating point from one another, in linear
+ * light for sRGB colours. Each intermediate level is kept as one plane per
+ * channel, such that a row of a plane is reduced with SIMD, and the rows of
+ * a level are processed in parallel chunks. Odd sizes drop their last row
+ * or column. The finest level is copied as is.
+ */
+template<typename T>
+MipChain<T> generateMipChain(const T* src, uint32_t width, uint32_t height, uint32_t channels, MipFilter filter)
+{
+	MipChain<T> chain;
+	chain.Channels = channels;
+
+	const uint32_t nr_levels = mipLevelCount(width, height);
+	size_t size = 0;
+	for (uint32_t l = 0, w = width, h = height; l < nr_levels; l++, w = std::max(1u, w / 2), h = std::max(1u, h / 2))
+	{
+		chain.Levels.push_back({ w, h, size });
+		size += size_t{ w } * h * channels;
+	}
+	chain.Data.resize(size);
+	std::copy(src, src + chain.levelSize(0), chain.Data.begin());
+	if (nr_levels == 1)
+		return chain;
+
+	// Colour channels are filtered in linear light, alpha is linear
+	const uint32_t srgb_channels = filter == MipFilter::Srgb ? std::min(channels, 3u) : 0;
+	const bool maximum = filter == MipFilter::Maximum;
+	const bool normals = filter == MipFilter::Normal && channels >= 3;
+
+	// The finest level is decoded row by row while it is reduced, coarser
+	// levels are reduced from the planes of the previous one
+	std::vector<float> planes, next;
+	for (uint32_t l = 1; l < nr_levels; l++)
+	{
+		const MipLevelLayout& prev = chain.Levels[l - 1];
+		const MipLevelLayout& curr = chain.Levels[l];
+		next.resize(size_t{ curr.Width } * curr.Height * channels);
+
+		parallelFor(0, curr.Height, MipDetail::rowGrain(curr.Width), [&](size_t, size_t begin, size_t end)
+		{
+			std::vector<float> decoded(l == 1 ? 2 * size_t{ width } : 0);
+			for (size_t y = begin; y < end; y++)
+			{
+				const size_t y0 = std::min<size_t>(2 * y, prev.Height - 1);
+				const size_t y1 = std::min<size_t>(2 * y + 1, prev.Height - 1);
+				for (uint32_t c = 0; c < channels; c++)
+				{
+					const float* r0;
+					const float* r1;
+					if (l == 1)
+					{
+						MipDetail::decodeRow(src + y0 * width * channels + c, width, channels, c < srgb_channels, decoded.data());
+						MipDetail::decodeRow(src + y1 * width * channels + c, width, channels, c < srgb_channels, decoded.data() + width);
+						r0 = decoded.data();
+						r1 = decoded.data() + width;
+					}
+					else
+					{
+						const float* src_plane = planes.data() + c * size_t{ prev.Width } * prev.Height;
+						r0 = src_plane + y0 * prev.Width;
+						r1 = src_plane + y1 * prev.Width;
+					}
+					float* dst_row = next.data() + (c * size_t{ curr.Height } + y) * curr.Width;
+					MipDetail::reduceRow(r0, r1, prev.Width, dst_row, curr.Width, maximum);
+				}
+
+				const size_t plane_size = size_t{ curr.Width } * curr.Height;
+				if (normals)
+					MipDetail::renormalizeRow(next.data() + y * curr.Width, next.data() + plane_size + y * curr.Width, next.data() + 2 * plane_size + y * curr.Width, curr.Width);
+
+				T* dst = chain.Data.data() + curr.Offset + y * curr.Width * channels;
+				for (uint32_t x = 0; x < curr.Width; x++)
+					for (uint32_t c = 0; c < channels; c++)
+						MipDetail::encode(next[(c * size_t{ curr.Height } + y) * curr.Width + x], c < srgb_channels, dst[x * channels + c]);
+			}
+		});
+		std::swap(planes, next);
+	}
+
+	return chain;
+}
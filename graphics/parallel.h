@@ -0,0 +1,74 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "threadpool.h"
+
+/*!
+ * Split the range [begin, end) into at most 'nr_chunks' contiguous chunks of
+ * similar size and invoke 'func(chunk, chunk_begin, chunk_end)' for each of
+ * them in parallel. Returns after all chunks are processed. 'func' must not
+ * throw.
+ */
+template<typename Func>
+void parallelChunks(size_t begin, size_t end, size_t nr_chunks, Func&& func)
+{
+	const size_t n = end > begin ? end - begin : 0;
+	nr_chunks = std::max<size_t>(1, std::min(nr_chunks, n));
+	const size_t chunk_size = (n + nr_chunks - 1) / nr_chunks;
+
+	ThreadPool& pool = ThreadPool::instance();
+	std::atomic<size_t> remaining{ nr_chunks - 1 };
+	for (size_t c = 1; c < nr_chunks; c++)
+	{
+		const size_t b = begin + std::min(n, c * chunk_size);
+		const size_t e = begin + std::min(n, (c + 1) * chunk_size);
+		pool.push([&func, &remaining, c, b, e]()
+		{
+			func(c, b, e);
+			remaining--;
+		}, &remaining);
+	}
+	func(size_t{ 0 }, begin, begin + std::min(n, chunk_size));
+
+	pool.wait(remaining, &remaining);
+}
+
+/*!
+ * Split the range [begin, end) into at most 'hardwareThreads()' contiguous
+ * chunks of at least 'grain' elements and process them with 'parallelChunks'.
+ */
+template<typename Func>
+void parallelFor(size_t begin, size_t end, size_t grain, Func&& func)
+{
+	const size_t n = end > begin ? end - begin : 0;
+	parallelChunks(begin, end, std::min<size_t>(hardwareThreads(), n / std::max<size_t>(1, grain)), std::forward<Func>(func));
+}
@@ -0,0 +1,235 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+// SIMD
+#if defined(__AVX__)
+#	include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define VCL_SIMD_SSE2
+#endif
+
+/*!
+ * Thin wrappers around the widest float vectors the compiler targets: AVX
+ * if enabled (VCL_DEMOS_AVX2 in CMake), SSE2 otherwise, and plain floats on
+ * targets without either, e.g. ARM. Comparisons return lane masks which are
+ * combined with the bitwise operators and consumed by 'select', 'any' and
+ * 'movemask'. 'madd' computes a * b + c, fused if FMA is enabled. 'transpose'
+ * converts between structure-of-arrays and array-of-structures layout,
+ * 'deinterleave' splits pairs of lanes, e.g. neighbouring texels.
+ */
+namespace Simd
+{
+#if defined(__AVX__)
+	//! Eight float lanes
+	struct FloatV
+	{
+		static const int Width = 8;
+
+		__m256 v;
+
+		static FloatV set(float f) { return { _mm256_set1_ps(f) }; }
+		static FloatV lanes() { return { _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7) }; }
+		static FloatV load(const float* p) { return { _mm256_loadu_ps(p) }; }
+		void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+		friend FloatV operator+(FloatV a, FloatV b) { return { _mm256_add_ps(a.v, b.v) }; }
+		friend FloatV operator-(FloatV a, FloatV b) { return { _mm256_sub_ps(a.v, b.v) }; }
+		friend FloatV operator*(FloatV a, FloatV b) { return { _mm256_mul_ps(a.v, b.v) }; }
+		friend FloatV operator/(FloatV a, FloatV b) { return { _mm256_div_ps(a.v, b.v) }; }
+#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+		friend FloatV madd(FloatV a, FloatV b, FloatV c) { return { _mm256_fmadd_ps(a.v, b.v, c.v) }; }
+#else
+		friend FloatV madd(FloatV a, FloatV b, FloatV c) { return { _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v) }; }
+#endif
+		friend FloatV operator&(FloatV a, FloatV b) { return { _mm256_and_ps(a.v, b.v) }; }
+		friend FloatV operator|(FloatV a, FloatV b) { return { _mm256_or_ps(a.v, b.v) }; }
+		friend FloatV min(FloatV a, FloatV b) { return { _mm256_min_ps(a.v, b.v) }; }
+		friend FloatV max(FloatV a, FloatV b) { return { _mm256_max_ps(a.v, b.v) }; }
+		friend FloatV sqrt(FloatV a) { return { _mm256_sqrt_ps(a.v) }; }
+		friend FloatV operator<(FloatV a, FloatV b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+		friend FloatV operator>(FloatV a, FloatV b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+		friend FloatV operator>=(FloatV a, FloatV b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+		friend FloatV operator<=(FloatV a, FloatV b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+		friend FloatV select(FloatV mask, FloatV a, FloatV b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+		friend int movemask(FloatV mask) { return _mm256_movemask_ps(mask.v); }
+		friend bool any(FloatV mask) { return _mm256_movemask_ps(mask.v) != 0; }
+	};
+
+	//! Transpose eight vectors, lane j of row i becomes lane i of row j
+	inline void transpose(FloatV (&rows)[FloatV::Width])
+	{
+		const __m256 t0 = _mm256_unpacklo_ps(rows[0].v, rows[1].v);
+		const __m256 t1 = _mm256_unpackhi_ps(rows[0].v, rows[1].v);
+		const __m256 t2 = _mm256_unpacklo_ps(rows[2].v, rows[3].v);
+		const __m256 t3 = _mm256_unpackhi_ps(rows[2].v, rows[3].v);
+		const __m256 t4 = _mm256_unpacklo_ps(rows[4].v, rows[5].v);
+		const __m256 t5 = _mm256_unpackhi_ps(rows[4].v, rows[5].v);
+		const __m256 t6 = _mm256_unpacklo_ps(rows[6].v, rows[7].v);
+		const __m256 t7 = _mm256_unpackhi_ps(rows[6].v, rows[7].v);
+		const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+		const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+		const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+		const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+		rows[0].v = _mm256_permute2f128_ps(s0, s4, 0x20);
+		rows[1].v = _mm256_permute2f128_ps(s1, s5, 0x20);
+		rows[2].v = _mm256_permute2f128_ps(s2, s6, 0x20);
+		rows[3].v = _mm256_permute2f128_ps(s3, s7, 0x20);
+		rows[4].v = _mm256_permute2f128_ps(s0, s4, 0x31);
+		rows[5].v = _mm256_permute2f128_ps(s1, s5, 0x31);
+		rows[6].v = _mm256_permute2f128_ps(s2, s6, 0x31);
+		rows[7].v = _mm256_permute2f128_ps(s3, s7, 0x31);
+	}
+
+	//! Split the sixteen lanes of 'a' followed by 'b' into the even and the odd ones
+	inline void deinterleave(FloatV a, FloatV b, FloatV& even, FloatV& odd)
+	{
+		const __m256 lo = _mm256_permute2f128_ps(a.v, b.v, 0x20);
+		const __m256 hi = _mm256_permute2f128_ps(a.v, b.v, 0x31);
+		even.v = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+		odd.v = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+	}
+#elif defined(VCL_SIMD_SSE2)
+	//! Four float lanes
+	struct FloatV
+	{
+		static const int Width = 4;
+
+		__m128 v;
+
+		static FloatV set(float f) { return { _mm_set1_ps(f) }; }
+		static FloatV lanes() { return { _mm_setr_ps(0, 1, 2, 3) }; }
+		static FloatV load(const float* p) { return { _mm_loadu_ps(p) }; }
+		void store(float* p) const { _mm_storeu_ps(p, v); }
+
+		friend FloatV operator+(FloatV a, FloatV b) { return { _mm_add_ps(a.v, b.v) }; }
+		friend FloatV operator-(FloatV a, FloatV b) { return { _mm_sub_ps(a.v, b.v) }; }
+		friend FloatV operator*(FloatV a, FloatV b) { return { _mm_mul_ps(a.v, b.v) }; }
+		friend FloatV operator/(FloatV a, FloatV b) { return { _mm_div_ps(a.v, b.v) }; }
+		friend FloatV madd(FloatV a, FloatV b, FloatV c) { return { _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v) }; }
+		friend FloatV operator&(FloatV a, FloatV b) { return { _mm_and_ps(a.v, b.v) }; }
+		friend FloatV operator|(FloatV a, FloatV b) { return { _mm_or_ps(a.v, b.v) }; }
+		friend FloatV min(FloatV a, FloatV b) { return { _mm_min_ps(a.v, b.v) }; }
+		friend FloatV max(FloatV a, FloatV b) { return { _mm_max_ps(a.v, b.v) }; }
+		friend FloatV sqrt(FloatV a) { return { _mm_sqrt_ps(a.v) }; }
+		friend FloatV operator<(FloatV a, FloatV b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+		friend FloatV operator>(FloatV a, FloatV b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+		friend FloatV operator>=(FloatV a, FloatV b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+		friend FloatV operator<=(FloatV a, FloatV b) { return { _mm_cmple_ps(a.v, b.v) }; }
+		friend FloatV select(FloatV mask, FloatV a, FloatV b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+		friend int movemask(FloatV mask) { return _mm_movemask_ps(mask.v); }
+		friend bool any(FloatV mask) { return _mm_movemask_ps(mask.v) != 0; }
+	};
+
+	//! Transpose four vectors, lane j of row i becomes lane i of row j
+	inline void transpose(FloatV (&rows)[FloatV::Width])
+	{
+		_MM_TRANSPOSE4_PS(rows[0].v, rows[1].v, rows[2].v, rows[3].v);
+	}
+
+	//! Split the eight lanes of 'a' followed by 'b' into the even and the odd ones
+	inline void deinterleave(FloatV a, FloatV b, FloatV& even, FloatV& odd)
+	{
+		even.v = _mm_shuffle_ps(a.v, b.v, _MM_SHUFFLE(2, 0, 2, 0));
+		odd.v = _mm_shuffle_ps(a.v, b.v, _MM_SHUFFLE(3, 1, 3, 1));
+	}
+#else
+	//! Four float lanes without vector instructions, masks are all bits set
+	struct FloatV
+	{
+		static const int Width = 4;
+
+		float v[4];
+
+		static FloatV set(float f) { return { { f, f, f, f } }; }
+		static FloatV lanes() { return { { 0, 1, 2, 3 } }; }
+		static FloatV load(const float* p) { FloatV r; std::memcpy(r.v, p, sizeof(r.v)); return r; }
+		void store(float* p) const { std::memcpy(p, v, sizeof(v)); }
+
+		template<typename Op>
+		static FloatV map(FloatV a, FloatV b, Op op) { FloatV r; for (int i = 0; i < Width; i++) r.v[i] = op(a.v[i], b.v[i]); return r; }
+
+		static uint32_t bits(float f) { uint32_t u; std::memcpy(&u, &f, sizeof(u)); return u; }
+		static float fromBits(uint32_t u) { float f; std::memcpy(&f, &u, sizeof(f)); return f; }
+		static float mask(bool b) { return fromBits(b ? 0xffffffffu : 0u); }
+
+		friend FloatV operator+(FloatV a, FloatV b) { return map(a, b, [](float x, float y) { return x + y; }); }
+		friend FloatV operator-(FloatV a, FloatV b) { return map(a, b, [](float x, float y) { return x - y; }); }
+		friend FloatV operator*(FloatV a, FloatV b) { return map(a, b, [](float x, float y) { return x * y; }); }
+		friend FloatV operator/(FloatV a, FloatV b) { return map(a, b, [](float x, float y) { return x / y; }); }
+		friend FloatV madd(FloatV a, FloatV b, FloatV c) { return a * b + c; }
+		friend FloatV operator&(FloatV a, FloatV b) { return map(a, b, [](float x, float y) { return fromBits(bits(x) & bits(y)); }); }
+		friend FloatV operator|(FloatV a, FloatV b) { return map(a, b, [](float x, float y) { return fromBits(bits(x) | bits(y)); }); }
+		friend FloatV min(FloatV a, FloatV b) { return map(a, b, [](float x, float y) { return y < x ? y : x; }); }
+		friend FloatV max(FloatV a, FloatV b) { return map(a, b, [](float x, float y) { return y > x ? y : x; }); }
+		friend FloatV sqrt(FloatV a) { return map(a, a, [](float x, float) { return std::sqrt(x); }); }
+		friend FloatV operator<(FloatV a, FloatV b) { return map(a, b, [](float x, float y) { return mask(x < y); }); }
+		friend FloatV operator>(FloatV a, FloatV b) { return map(a, b, [](float x, float y) { return mask(x > y); }); }
+		friend FloatV operator>=(FloatV a, FloatV b) { return map(a, b, [](float x, float y) { return mask(x >= y); }); }
+		friend FloatV operator<=(FloatV a, FloatV b) { return map(a, b, [](float x, float y) { return mask(x <= y); }); }
+		friend FloatV select(FloatV mask, FloatV a, FloatV b)
+		{
+			FloatV r;
+			for (int i = 0; i < Width; i++)
+				r.v[i] = bits(mask.v[i]) >> 31 ? a.v[i] : b.v[i];
+			return r;
+		}
+		friend int movemask(FloatV mask)
+		{
+			int m = 0;
+			for (int i = 0; i < Width; i++)
+				m |= static_cast<int>(bits(mask.v[i]) >> 31) << i;
+			return m;
+		}
+		friend bool any(FloatV mask) { return movemask(mask) != 0; }
+	};
+
+	//! Transpose four vectors, lane j of row i becomes lane i of row j
+	inline void transpose(FloatV (&rows)[FloatV::Width])
+	{
+		for (int i = 0; i < FloatV::Width; i++)
+			for (int j = i + 1; j < FloatV::Width; j++)
+				std::swap(rows[i].v[j], rows[j].v[i]);
+	}
+
+	//! Split the eight lanes of 'a' followed by 'b' into the even and the odd ones
+	inline void deinterleave(FloatV a, FloatV b, FloatV& even, FloatV& odd)
+	{
+		even = { { a.v[0], a.v[2], b.v[0], b.v[2] } };
+		odd = { { a.v[1], a.v[3], b.v[1], b.v[3] } };
+	}
+#endif
+}
@@ -0,0 +1,590 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/eigen.h>
+
+// C++ standard library
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../parallel.h"
+#include "../simd.h"
+#include "mesh.h"
+
+//! Node of a bounding volume hierarchy. Siblings are stored next to each
+//! other, such that both children of a node share a 64-byte cache line.
+struct BvhNode
+{
+	//! Minimum corner of the bounds
+	float Min[3];
+
+	//! Inner node: index of the first child, the second follows it.
+	//! Leaf: first entry in the triangle order of the BVH.
+	uint32_t Offset;
+
+	//! Maximum corner of the bounds
+	float Max[3];
+
+	//! Number of triangles of a leaf, zero for inner nodes
+	uint32_t Count;
+};
+static_assert(sizeof(BvhNode) == 32, "BVH nodes are expected to be 32 bytes.");
+
+//! Closest intersection along a ray
+struct RayHit
+{
+	//! Triangle of the mesh, ~0 if the ray misses
+	uint32_t Triangle{ ~0u };
+
+	//! Distance along the ray in units of the ray direction
+	float T{ 0 };
+
+	//! Barycentric coordinates of the second and third vertex
+	float U{ 0 }, V{ 0 };
+
+	bool valid() const { return Triangle != ~0u; }
+};
+
+//! Rays traced together, one per SIMD lane
+struct RayPacket
+{
+	static const int Size = Simd::FloatV::Width;
+
+	float Origin[3][Size];
+	float Direction[3][Size];
+
+	//! Largest distance of an intersection
+	float MaxT[Size];
+};
+
+//! Properties of a BVH
+struct BvhStatistics
+{
+	uint32_t Nodes{ 0 };
+	uint32_t Leaves{ 0 };
+	uint32_t Depth{ 0 };
+	double BuildMs{ 0 };
+};
+
+namespace BvhDetail
+{
+	//! Largest number of bins per axis used to evaluate the surface area
+	//! heuristic. Small nodes use one bin per triangle.
+	const int NrBins = 16;
+
+	//! Depth after which nodes are split at the median, which bounds the
+	//! depth of degenerate inputs
+	const uint32_t MaxSahDepth = 48;
+
+	inline float area(const Eigen::AlignedBox3f& box)
+	{
+		if (box.isEmpty())
+			return 0;
+		const Eigen::Vector3f s = box.sizes();
+		return 2 * (s.x() * s.y() + s.y() * s.z() + s.z() * s.x());
+	}
+
+	//! Triangles referenced by the nodes during the build
+	struct BuildData
+	{
+		std::vector<Eigen::AlignedBox3f> Boxes;
+		std::vector<Eigen::Vector3f> Centroids;
+
+		//! Triangles, partitioned in place into the ranges of the nodes
+		std::vector<uint32_t> Refs;
+	};
+
+	//! Range of triangles still to be split
+	struct Task
+	{
+		uint32_t Node;
+		uint32_t Begin, End;
+		uint32_t Depth;
+		Eigen::AlignedBox3f Bounds;
+	};
+}
+
+/*!
+ * Bounding volume hierarchy over the triangles of a mesh, split by the
+ * binned surface area heuristic. The upper levels are split sequentially
+ * until enough subtrees exist to be built in parallel. Rays are traversed
+ * in packets of one ray per SIMD lane. The hierarchy references the
+ * vertices and indices of the mesh, which must not change or be destroyed
+ * while the hierarchy is built or used.
+ */
+class Bvh
+{
+public:
+	//! Largest number of triangles in a leaf
+	static const uint32_t MaxLeafSize = 8;
+
+	//! Build the hierarchy over the triangles of 'level' of 'mesh'. If
+	//! 'cancel' becomes true during the build, the hierarchy is left empty.
+	void build(const MeshData& mesh, MeshLevel level, const std::atomic<bool>* cancel = nullptr)
+	{
+		using namespace BvhDetail;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		const uint32_t first_triangle = level.FirstIndex / 3;
+		const uint32_t nr_triangles = level.NrIndices / 3;
+
+		auto cancelled = [this, cancel]()
+		{
+			if (!cancel || !*cancel)
+				return false;
+
+			_nodes.clear();
+			_triangles.clear();
+			return true;
+		};
+
+		_nodes.clear();
+		_triangles.clear();
+		_mesh = &mesh;
+		_stats = {};
+		if (nr_triangles == 0)
+			return;
+
+		// Bounds and centroids of the triangles
+		BuildData data;
+		data.Boxes.resize(nr_triangles);
+		data.Centroids.resize(nr_triangles);
+		data.Refs.resize(nr_triangles);
+		std::vector<Eigen::AlignedBox3f> chunk_bounds(hardwareThreads());
+		parallelFor(0, nr_triangles, 4096, [&](size_t chunk, size_t begin, size_t end)
+		{
+			Eigen::AlignedBox3f bounds;
+			for (size_t t = begin; t < end; t++)
+			{
+				const uint32_t* idx = mesh.Indices.data() + 3 * (first_triangle + t);
+				Eigen::AlignedBox3f box{ mesh.Positions[idx[0]] };
+				box.extend(mesh.Positions[idx[1]]);
+				box.extend(mesh.Positions[idx[2]]);
+				data.Boxes[t] = box;
+				data.Centroids[t] = box.center();
+				data.Refs[t] = static_cast<uint32_t>(t);
+				bounds.extend(box);
+			}
+			chunk_bounds[chunk] = bounds;
+		});
+		Eigen::AlignedBox3f bounds;
+		for (const auto& box : chunk_bounds)
+			bounds.extend(box);
+		if (cancelled())
+			return;
+
+		// Split the top of the tree sequentially into subtrees
+		const size_t grain = std::max<size_t>(4096, nr_triangles / (4 * hardwareThreads()));
+		std::vector<Task> work{ { 0, 0, nr_triangles, 0, bounds } };
+		std::vector<Task> tasks;
+		_nodes.resize(1);
+		while (!work.empty())
+		{
+			if (cancelled())
+				return;
+
+			const Task task = work.back();
+			work.pop_back();
+			if (task.End - task.Begin <= grain)
+			{
+				tasks.push_back(task);
+				continue;
+			}
+
+			Eigen::AlignedBox3f left, right;
+			const uint32_t mid = split(data, task.Begin, task.End, task.Depth, task.Bounds, left, right);
+			if (mid == task.End)
+			{
+				setNode(_nodes[task.Node], task.Bounds, task.Begin, task.End - task.Begin);
+				continue;
+			}
+
+			const uint32_t child = static_cast<uint32_t>(_nodes.size());
+			setNode(_nodes[task.Node], task.Bounds, child, 0);
+			_nodes.resize(_nodes.size() + 2);
+			work.push_back({ child, task.Begin, mid, task.Depth + 1, left });
+			work.push_back({ child + 1, mid, task.End, task.Depth + 1, right });
+			_stats.Depth = std::max(_stats.Depth, task.Depth + 1);
+		}
+
+		// Build the subtrees in parallel and append them to the top
+		std::vector<std::vector<BvhNode>> subtrees(tasks.size());
+		std::vector<uint32_t> depths(tasks.size(), 0);
+		parallelFor(0, tasks.size(), 1, [&](size_t, size_t begin, size_t end)
+		{
+			for (size_t t = begin; t < end; t++)
+			{
+				if (cancel && *cancel)
+					return;
+
+				subtrees[t].resize(1);
+				buildSubtree(data, subtrees[t], 0, tasks[t].Begin, tasks[t].End, tasks[t].Depth, tasks[t].Bounds, depths[t]);
+			}
+		});
+		if (cancelled())
+			return;
+		for (size_t t = 0; t < tasks.size(); t++)
+		{
+			// The root replaces the node of the task, the remaining nodes
+			// are appended and their child offsets shifted
+			const uint32_t base = static_cast<uint32_t>(_nodes.size()) - 1;
+			auto relocate = [base](BvhNode node)
+			{
+				if (node.Count == 0)
+					node.Offset += base;
+				return node;
+			};
+			_nodes[tasks[t].Node] = relocate(subtrees[t][0]);
+			for (size_t n = 1; n < subtrees[t].size(); n++)
+				_nodes.push_back(relocate(subtrees[t][n]));
+			_stats.Depth = std::max(_stats.Depth, depths[t]);
+		}
+
+		// Triangles of the mesh in the order of the leaves
+		_triangles.resize(nr_triangles);
+		for (size_t t = 0; t < nr_triangles; t++)
+			_triangles[t] = first_triangle + data.Refs[t];
+
+		_stats.Nodes = static_cast<uint32_t>(_nodes.size());
+		_stats.Leaves = static_cast<uint32_t>(std::count_if(_nodes.begin(), _nodes.end(), [](const BvhNode& n) { return n.Count > 0; }));
+		_stats.BuildMs = 1000.0 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/*!
+	 * Find the closest triangle along each ray of 'rays'. Rays are given by
+	 * origin + t * direction, 0 < t < MaxT. The results are written to the
+	 * 'RayPacket::Size' entries of 'hits'.
+	 */
+	void intersect(const RayPacket& rays, RayHit* hits) const
+	{
+		using Simd::FloatV;
+		const int W = RayPacket::Size;
+
+		for (int i = 0; i < W; i++)
+			hits[i] = {};
+		if (_nodes.empty())
+			return;
+
+		FloatV o[3], d[3], inv_d[3];
+		for (int k = 0; k < 3; k++)
+		{
+			o[k] = FloatV::load(rays.Origin[k]);
+			d[k] = FloatV::load(rays.Direction[k]);
+			inv_d[k] = FloatV::set(1.0f) / d[k];
+		}
+		FloatV t = FloatV::load(rays.MaxT);
+		FloatV u = FloatV::set(0);
+		FloatV v = FloatV::set(0);
+		const FloatV zero = FloatV::set(0);
+		const FloatV one = FloatV::set(1);
+		const FloatV epsilon = FloatV::set(1e-7f);
+
+		std::array<uint32_t, W> slots;
+		slots.fill(~0u);
+
+		// Children are visited front to back along the first ray
+		const Eigen::Vector3f order{ rays.Direction[0][0], rays.Direction[1][0], rays.Direction[2][0] };
+
+		std::array<uint32_t, 128> stack;
+		int sp = 0;
+		stack[sp++] = 0;
+		while (sp > 0)
+		{
+			const BvhNode& node = _nodes[stack[--sp]];
+
+			// Slab test of all rays against the bounds of the node
+			FloatV t_near = zero;
+			FloatV t_far = t;
+			for (int k = 0; k < 3; k++)
+			{
+				const FloatV t0 = (FloatV::set(node.Min[k]) - o[k]) * inv_d[k];
+				const FloatV t1 = (FloatV::set(node.Max[k]) - o[k]) * inv_d[k];
+				t_near = max(t_near, min(t0, t1));
+				t_far = min(t_far, max(t0, t1));
+			}
+			if (!any(t_near <= t_far))
+				continue;
+
+			if (node.Count == 0)
+			{
+				const BvhNode& c0 = _nodes[node.Offset];
+				const BvhNode& c1 = _nodes[node.Offset + 1];
+				float dist = 0;
+				for (int k = 0; k < 3; k++)
+					dist += (c1.Min[k] + c1.Max[k] - c0.Min[k] - c0.Max[k]) * order[k];
+
+				const bool first_near = dist >= 0;
+				stack[sp++] = node.Offset + (first_near ? 1 : 0);
+				stack[sp++] = node.Offset + (first_near ? 0 : 1);
+				continue;
+			}
+
+			// Moeller-Trumbore test of all rays against the triangles of the leaf
+			for (uint32_t slot = node.Offset; slot < node.Offset + node.Count; slot++)
+			{
+				const uint32_t* idx = _mesh->Indices.data() + 3 * size_t{ _triangles[slot] };
+				const Eigen::Vector3f& p0 = _mesh->Positions[idx[0]];
+				const Eigen::Vector3f& p1 = _mesh->Positions[idx[1]];
+				const Eigen::Vector3f& p2 = _mesh->Positions[idx[2]];
+				FloatV e1[3], e2[3], s[3];
+				for (int k = 0; k < 3; k++)
+				{
+					e1[k] = FloatV::set(p1[k] - p0[k]);
+					e2[k] = FloatV::set(p2[k] - p0[k]);
+					s[k] = o[k] - FloatV::set(p0[k]);
+				}
+
+				const FloatV p[3] = {
+					d[1] * e2[2] - d[2] * e2[1],
+					d[2] * e2[0] - d[0] * e2[2],
+					d[0] * e2[1] - d[1] * e2[0]
+				};
+				const FloatV q[3] = {
+					s[1] * e1[2] - s[2] * e1[1],
+					s[2] * e1[0] - s[0] * e1[2],
+					s[0] * e1[1] - s[1] * e1[0]
+				};
+				const FloatV inv_det = one / (e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2]);
+				const FloatV tu = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv_det;
+				const FloatV tv = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv_det;
+				const FloatV tt = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+
+				const FloatV hit = (tu >= zero) & (tv >= zero) & (tu + tv <= one) & (tt > epsilon) & (tt < t);
+				const int mask = movemask(hit);
+				if (mask == 0)
+					continue;
+
+				t = select(hit, tt, t);
+				u = select(hit, tu, u);
+				v = select(hit, tv, v);
+				for (int i = 0; i < W; i++)
+					if (mask & (1 << i))
+						slots[i] = slot;
+			}
+		}
+
+		alignas(32) float ts[W], us[W], vs[W];
+		t.store(ts);
+		u.store(us);
+		v.store(vs);
+		for (int i = 0; i < W; i++)
+		{
+			if (slots[i] == ~0u)
+				continue;
+
+			hits[i].Triangle = _triangles[slots[i]];
+			hits[i].T = ts[i];
+			hits[i].U = us[i];
+			hits[i].V = vs[i];
+		}
+	}
+
+	bool empty() const { return _nodes.empty(); }
+	const std::vector<BvhNode>& nodes() const { return _nodes; }
+	const BvhStatistics& statistics() const { return _stats; }
+
+private:
+	static void setNode(BvhNode& node, const Eigen::AlignedBox3f& bounds, uint32_t offset, uint32_t count)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			node.Min[k] = bounds.min()[k];
+			node.Max[k] = bounds.max()[k];
+		}
+		node.Offset = offset;
+		node.Count = count;
+	}
+
+	/*!
+	 * Split the triangles [begin, end) with the surface area heuristic.
+	 * Returns the first triangle of the right half after partitioning, or
+	 * 'end' if a leaf is cheaper. 'left' and 'right' receive the bounds of
+	 * the halves.
+	 */
+	static uint32_t split
+	(
+		BvhDetail::BuildData& data, uint32_t begin, uint32_t end, uint32_t depth,
+		const Eigen::AlignedBox3f& bounds, Eigen::AlignedBox3f& left, Eigen::AlignedBox3f& right
+	)
+	{
+		using namespace BvhDetail;
+
+		const uint32_t n = end - begin;
+		if (n <= 1)
+			return end;
+
+		Eigen::AlignedBox3f centroid_bounds;
+		for (uint32_t r = begin; r < end; r++)
+			centroid_bounds.extend(data.Centroids[data.Refs[r]]);
+
+		// Bin the triangles along all axes in a single pass
+		const Eigen::Vector3f extent = centroid_bounds.sizes();
+		const bool use_sah = depth < MaxSahDepth && extent.maxCoeff() > 0;
+		const int nr_bins = std::min<int>(NrBins, n);
+		Eigen::Vector3f scale;
+		for (int axis = 0; axis < 3; axis++)
+			scale[axis] = extent[axis] > 0 ? nr_bins / extent[axis] : 0.0f;
+		auto bin_of = [&](uint32_t ref, int axis)
+		{
+			return std::min(nr_bins - 1, int((data.Centroids[ref][axis] - centroid_bounds.min()[axis]) * scale[axis]));
+		};
+
+		std::array<std::array<Eigen::AlignedBox3f, NrBins>, 3> bin_bounds;
+		std::array<std::array<uint32_t, NrBins>, 3> bin_counts{};
+		if (use_sah)
+		{
+			for (uint32_t r = begin; r < end; r++)
+			{
+				const uint32_t ref = data.Refs[r];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const int bin = bin_of(ref, axis);
+					bin_bounds[axis][bin].extend(data.Boxes[ref]);
+					bin_counts[axis][bin]++;
+				}
+			}
+		}
+
+		// Evaluate the planes between the bins
+		float best_cost = std::numeric_limits<float>::max();
+		int best_axis = -1;
+		int best_plane = 0;
+		for (int axis = 0; axis < 3 && use_sah; axis++)
+		{
+			if (!(extent[axis] > 0))
+				continue;
+
+			std::array<float, NrBins> right_cost;
+			std::array<Eigen::AlignedBox3f, NrBins> right_bounds;
+			Eigen::AlignedBox3f acc;
+			uint32_t count = 0;
+			for (int b = nr_bins - 1; b > 0; b--)
+			{
+				acc.extend(bin_bounds[axis][b]);
+				count += bin_counts[axis][b];
+				right_cost[b] = count * area(acc);
+				right_bounds[b] = acc;
+			}
+
+			acc.setEmpty();
+			count = 0;
+			for (int plane = 1; plane < nr_bins; plane++)
+			{
+				acc.extend(bin_bounds[axis][plane - 1]);
+				count += bin_counts[axis][plane - 1];
+				if (count == 0 || count == n)
+					continue;
+
+				const float cost = count * area(acc) + right_cost[plane];
+				if (cost < best_cost)
+				{
+					best_cost = cost;
+					best_axis = axis;
+					best_plane = plane;
+					left = acc;
+					right = right_bounds[plane];
+				}
+			}
+		}
+
+		// A leaf costs one intersection per triangle, a split one traversal
+		// step plus the intersections weighted by the probability of a hit
+		const float leaf_cost = n * area(bounds);
+		const float split_cost = area(bounds) + best_cost;
+		if (n <= MaxLeafSize && (best_axis < 0 || leaf_cost <= split_cost))
+			return end;
+
+		if (best_axis >= 0)
+		{
+			const auto it = std::partition(data.Refs.begin() + begin, data.Refs.begin() + end, [&](uint32_t ref)
+			{
+				return bin_of(ref, best_axis) < best_plane;
+			});
+			return static_cast<uint32_t>(it - data.Refs.begin());
+		}
+
+		// Coincident centroids or a deep tree, split at the median along the
+		// largest extent
+		int axis = 0;
+		extent.maxCoeff(&axis);
+		const uint32_t mid = begin + n / 2;
+		std::nth_element(data.Refs.begin() + begin, data.Refs.begin() + mid, data.Refs.begin() + end, [&](uint32_t a, uint32_t b)
+		{
+			return data.Centroids[a][axis] < data.Centroids[b][axis];
+		});
+
+		left.setEmpty();
+		right.setEmpty();
+		for (uint32_t r = begin; r < mid; r++)
+			left.extend(data.Boxes[data.Refs[r]]);
+		for (uint32_t r = mid; r < end; r++)
+			right.extend(data.Boxes[data.Refs[r]]);
+		return mid;
+	}
+
+	//! Recursively build the subtree of 'node' into 'nodes'
+	static void buildSubtree
+	(
+		BvhDetail::BuildData& data, std::vector<BvhNode>& nodes, uint32_t node,
+		uint32_t begin, uint32_t end, uint32_t depth, const Eigen::AlignedBox3f& bounds, uint32_t& max_depth
+	)
+	{
+		max_depth = std::max(max_depth, depth);
+
+		Eigen::AlignedBox3f left, right;
+		const uint32_t mid = split(data, begin, end, depth, bounds, left, right);
+		if (mid == end)
+		{
+			setNode(nodes[node], bounds, begin, end - begin);
+			return;
+		}
+
+		const uint32_t child = static_cast<uint32_t>(nodes.size());
+		setNode(nodes[node], bounds, child, 0);
+		nodes.resize(nodes.size() + 2);
+		buildSubtree(data, nodes, child, begin, mid, depth + 1, left, max_depth);
+		buildSubtree(data, nodes, child + 1, mid, end, depth + 1, right, max_depth);
+	}
+
+	//! Nodes, the root first
+	std::vector<BvhNode> _nodes;
+
+	//! Triangle of the mesh for each triangle of the leaves
+	std::vector<uint32_t> _triangles;
+
+	//! Mesh the hierarchy was built for
+	const MeshData* _mesh{ nullptr };
+
+	//! Properties of the last build
+	BvhStatistics _stats;
+};
@@ -28,26 +28,65 @@
 #include <vcl/config/opengl.h>
 
 // C++ standard library
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <random>
 
 // VCL
-#include <vcl/geometry/meshfactory.h>
+#include <vcl/core/enum.h>
 #include <vcl/graphics/opengl/glsl/uniformbuffer.h>
 #include <vcl/graphics/opengl/context.h>
 #include <vcl/graphics/runtime/opengl/resource/shader.h>
 #include <vcl/graphics/runtime/opengl/resource/texture2d.h>
 #include <vcl/graphics/runtime/opengl/state/pipelinestate.h>
+#include <vcl/graphics/runtime/opengl/state/shaderprogram.h>
 #include <vcl/graphics/runtime/opengl/graphicsengine.h>
 #include <vcl/graphics/camera.h>
 #include <vcl/graphics/trackballcameracontroller.h>
 
 #include "../application.h"
 #include "../basescene.h"
+#include "../uploadring.h"
+#include "../gpucounter.h"
+#include "../gpureadback.h"
+#include "../gputimer.h"
+#include "../transformhierarchy.h"
+#include "bvh.h"
+#include "mesh.h"
+#include "meshcache.h"
+#include "meshlets.h"
+#include "meshloader.h"
+#include "meshoptimization.h"
+#include "meshsimplification.h"
+#include "occlusionculling.h"
+#include "quantization.h"
+#include "torus.h"
+#include "transformbatch.h"
+#include "visibilitybuffer.h"
 
 #include "shaders/solidwireframe.h"
 #include "solidwireframe.vert.spv.h"
 #include "solidwireframe.geom.spv.h"
 #include "solidwireframe.frag.spv.h"
+#include "solidwireframepull.vert.spv.h"
+#include "solidwireframequantized.vert.spv.h"
+#include "solidwireframepullquantized.vert.spv.h"
+#include "solidwireframeinstanced.vert.spv.h"
+#include "solidwireframeinstancedquantized.vert.spv.h"
+#include "solidwireframemeshlets.vert.spv.h"
+#include "solidwireframemeshletsquantized.vert.spv.h"
+#include "cullinstances.comp.spv.h"
+#include "cullmeshlets.comp.spv.h"
+#include "proceduraltorus.vert.spv.h"
+#include "highlight.frag.spv.h"
+#include "visibilitybuffer.frag.spv.h"
+#include "visibilityresolve.vert.spv.h"
+#include "visibilityresolve.frag.spv.h"
+#include "visibilityresolvequantized.frag.spv.h"
 
 // Force the use of the NVIDIA GPU in an Optimus system
 extern "C"
@@ -55,6 +94,76 @@ extern "C"
 	_declspec(dllexport) unsigned int NvOptimusEnablement = 0x00000001;
 }
 
+VCL_DECLARE_ENUM(RenderPath,
+	GeometryShader,
+	GeometryShaderIndexed,
+	VertexPulling,
+	MeshletCulling,
+	VisibilityBuffer,
+	ProceduralTorus
+)
+
+// Vertex streams uploaded for the geometry shader path
+VCL_DECLARE_ENUM(VertexLayout,
+	PositionNormal,
+	Position
+)
+
+// Encoding of the vertex attributes
+VCL_DECLARE_ENUM(VertexFormat,
+	Float,
+	Quantized
+)
+
+// Number of copies of the mesh rendered with GPU culling
+VCL_DECLARE_ENUM(Instancing,
+	Off,
+	Instances1000,
+	Instances10000,
+	Instances100000
+)
+
+// Culling of the instances
+VCL_DECLARE_ENUM(InstanceCulling,
+	GpuFrustum,
+	CpuOcclusion
+)
+
+//! Per-instance data, matches 'InstanceData' in instancing.glsl
+struct InstanceData
+{
+	//! Column-major transform of the instance
+	float Transform[16];
+
+	//! Bounding sphere (center, radius) after applying the transform
+	float BoundingSphere[4];
+};
+
+/*!
+ * Keeps the program bound through the graphics engine across a compute
+ * dispatch. The engine does not dispatch compute work, thus the culling
+ * binds its programs directly and must hand the previous one back.
+ */
+class ScopedComputeProgram
+{
+public:
+	explicit ScopedComputeProgram(Vcl::Graphics::Runtime::OpenGL::ShaderProgram& program)
+	{
+		glGetIntegerv(GL_CURRENT_PROGRAM, &_previous);
+		program.bind();
+	}
+	~ScopedComputeProgram()
+	{
+		glUseProgram(static_cast<GLuint>(_previous));
+	}
+	ScopedComputeProgram(const ScopedComputeProgram&) = delete;
+	ScopedComputeProgram& operator=(const ScopedComputeProgram&) = delete;
+
+private:
+	//! Program bound before the dispatch
+	GLint _previous{ 0 };
+};
+
 class SolidWireframeExample : public BaseScene
 {
 	VCL_DECLARE_METAOBJECT(SolidWireframeExample)
@@ -83,6 +192,7 @@ public:
 		Vcl::Graphics::OpenGL::Context::initExtensions();
 		Vcl::Graphics::OpenGL::Context::setupDebugMessaging();
 		_engine = std::make_unique<Vcl::Graphics::Runtime::OpenGL::GraphicsEngine>();
+		_uploadRing = std::make_unique<UploadRing>(ConstantsPerFrame + MaxInstances * sizeof(InstanceTransform));
 
 		// Check availability of features
 		if (!Shader::isSpirvSupported())
@@ -95,7 +205,9 @@ public:
 		_cameraController = std::make_unique<Vcl::Graphics::TrackballCameraController>();
 		_cameraController->setCamera(_camera.get());
 
-		// Initialize solid-wireframe shader
+		_occlusionCuller = std::make_unique<OcclusionCuller>();
+
+		// Initialize solid-wireframe shader with interleaved positions and normals
 		InputLayoutDescription layout =
 		{
 			{
@@ -117,44 +229,287 @@ public:
 		solid_wireframe_ps_desc.FragmentShader = &solid_wireframe_frag;
 		_solidwireframePS = std::make_unique<PipelineState>(solid_wireframe_ps_desc);
 
-		// Initialize the geometry
-		const auto mesh = Vcl::Geometry::TriMeshFactory::createTorus(1.0f, 0.4f, 20, 20);
-
-		struct Vertex
+		// Initialize solid-wireframe shader with positions only. The geometry
+		// shader computes face normals, the normal stream is never needed.
+		InputLayoutDescription position_layout =
 		{
-			Vertex(const Eigen::Vector3f& p, const Eigen::Vector3f& n)
-				: P(p), N(n)
-			{}
+			{
+				{ 0, 12, VertexDataClassification::VertexDataPerObject }},
+			{
+				{ "position", SurfaceFormat::R32G32B32_FLOAT, 1, 0,  0 },
+			}
+		};
 
-			Eigen::Vector3f P;
-			Eigen::Vector3f N;
+		std::array<unsigned int, 1> normals_index = { 0 };
+		std::array<unsigned int, 1> no_normals = { 0 };
+		Shader solid_wireframe_pos_vert{ ShaderType::VertexShader, 0, SolidWireframeVert, normals_index, no_normals };
+		PipelineStateDescription solid_wireframe_pos_ps_desc;
+		solid_wireframe_pos_ps_desc.InputLayout = position_layout;
+		solid_wireframe_pos_ps_desc.VertexShader = &solid_wireframe_pos_vert;
+		solid_wireframe_pos_ps_desc.GeometryShader = &solid_wireframe_geom;
+		solid_wireframe_pos_ps_desc.FragmentShader = &solid_wireframe_frag;
+		_solidwireframePosPS = std::make_unique<PipelineState>(solid_wireframe_pos_ps_desc);
+
+		// Initialize the geometry-shader-free solid-wireframe shader
+		Shader solid_wireframe_pull_vert{ ShaderType::VertexShader,   0, SolidWireframePullVert };
+		Shader solid_wireframe_pull_frag{ ShaderType::FragmentShader, 0, SolidWireframeFrag };
+		PipelineStateDescription solid_wireframe_pull_ps_desc;
+		solid_wireframe_pull_ps_desc.VertexShader = &solid_wireframe_pull_vert;
+		solid_wireframe_pull_ps_desc.FragmentShader = &solid_wireframe_pull_frag;
+		_solidwireframePullPS = std::make_unique<PipelineState>(solid_wireframe_pull_ps_desc);
+
+		// Initialize the solid-wireframe shaders reading quantized vertices.
+		// Positions are 16-bit normalized relative to the bounding box, with
+		// one component of padding, normals are octahedral encoded.
+		InputLayoutDescription quantized_layout =
+		{
+			{
+				{ 0, 12, VertexDataClassification::VertexDataPerObject },
+				{ 1, 12, VertexDataClassification::VertexDataPerObject }},
+			{
+				{ "position", SurfaceFormat::R16G16B16A16_UNORM, 1, 0, 0 },
+				{ "normal",   SurfaceFormat::R16G16_SNORM,       1, 0, 8 },
+			}
+		};
+		InputLayoutDescription quantized_position_layout =
+		{
+			{
+				{ 0, 8, VertexDataClassification::VertexDataPerObject }},
+			{
+				{ "position", SurfaceFormat::R16G16B16A16_UNORM, 1, 0, 0 },
+			}
 		};
-		std::vector<Vertex> vb;
-		vb.reserve(mesh->nrFaces() * 3);
 
-		auto faces = mesh->faces();
-		auto positions = mesh->vertices();
-		auto normals = mesh->vertexProperty<Eigen::Vector3f>("Normals");
-		for (uint32_t f = 0; f < mesh->nrFaces(); ++f)
+		Shader solid_wireframe_quant_vert{ ShaderType::VertexShader, 0, SolidWireframeQuantizedVert };
+		PipelineStateDescription solid_wireframe_quant_ps_desc;
+		solid_wireframe_quant_ps_desc.InputLayout = quantized_layout;
+		solid_wireframe_quant_ps_desc.VertexShader = &solid_wireframe_quant_vert;
+		solid_wireframe_quant_ps_desc.GeometryShader = &solid_wireframe_geom;
+		solid_wireframe_quant_ps_desc.FragmentShader = &solid_wireframe_frag;
+		_solidwireframeQuantPS = std::make_unique<PipelineState>(solid_wireframe_quant_ps_desc);
+
+		Shader solid_wireframe_quant_pos_vert{ ShaderType::VertexShader, 0, SolidWireframeQuantizedVert, normals_index, no_normals };
+		solid_wireframe_quant_ps_desc.InputLayout = quantized_position_layout;
+		solid_wireframe_quant_ps_desc.VertexShader = &solid_wireframe_quant_pos_vert;
+		_solidwireframeQuantPosPS = std::make_unique<PipelineState>(solid_wireframe_quant_ps_desc);
+
+		Shader solid_wireframe_pull_quant_vert{ ShaderType::VertexShader, 0, SolidWireframePullQuantizedVert };
+		PipelineStateDescription solid_wireframe_pull_quant_ps_desc;
+		solid_wireframe_pull_quant_ps_desc.VertexShader = &solid_wireframe_pull_quant_vert;
+		solid_wireframe_pull_quant_ps_desc.FragmentShader = &solid_wireframe_pull_frag;
+		_solidwireframePullQuantPS = std::make_unique<PipelineState>(solid_wireframe_pull_quant_ps_desc);
+
+		// Initialize the instanced solid-wireframe shaders, which pull the
+		// vertices and the transforms of the visible instances
+		Shader solid_wireframe_inst_vert{ ShaderType::VertexShader, 0, SolidWireframeInstancedVert };
+		PipelineStateDescription solid_wireframe_inst_ps_desc;
+		solid_wireframe_inst_ps_desc.VertexShader = &solid_wireframe_inst_vert;
+		solid_wireframe_inst_ps_desc.FragmentShader = &solid_wireframe_pull_frag;
+		_solidwireframeInstPS = std::make_unique<PipelineState>(solid_wireframe_inst_ps_desc);
+
+		Shader solid_wireframe_inst_quant_vert{ ShaderType::VertexShader, 0, SolidWireframeInstancedQuantizedVert };
+		solid_wireframe_inst_ps_desc.VertexShader = &solid_wireframe_inst_quant_vert;
+		_solidwireframeInstQuantPS = std::make_unique<PipelineState>(solid_wireframe_inst_ps_desc);
+
+		// Frustum culling of the instances
+		Shader cull_instances_comp{ ShaderType::ComputeShader, 0, CullInstancesComp };
+		ShaderProgramDescription cull_instances_desc;
+		cull_instances_desc.ComputeShader = &cull_instances_comp;
+		_cullInstancesProgram = std::make_unique<ShaderProgram>(cull_instances_desc);
+
+		// Initialize the solid-wireframe shaders drawing the triangles of the
+		// meshlets which passed the culling
+		Shader solid_wireframe_meshlets_vert{ ShaderType::VertexShader, 0, SolidWireframeMeshletsVert };
+		PipelineStateDescription solid_wireframe_meshlets_ps_desc;
+		solid_wireframe_meshlets_ps_desc.VertexShader = &solid_wireframe_meshlets_vert;
+		solid_wireframe_meshlets_ps_desc.FragmentShader = &solid_wireframe_pull_frag;
+		_solidwireframeMeshletsPS = std::make_unique<PipelineState>(solid_wireframe_meshlets_ps_desc);
+
+		Shader solid_wireframe_meshlets_quant_vert{ ShaderType::VertexShader, 0, SolidWireframeMeshletsQuantizedVert };
+		solid_wireframe_meshlets_ps_desc.VertexShader = &solid_wireframe_meshlets_quant_vert;
+		_solidwireframeMeshletsQuantPS = std::make_unique<PipelineState>(solid_wireframe_meshlets_ps_desc);
+
+		// Back-face and frustum culling of the meshlets
+		Shader cull_meshlets_comp{ ShaderType::ComputeShader, 0, CullMeshletsComp };
+		ShaderProgramDescription cull_meshlets_desc;
+		cull_meshlets_desc.ComputeShader = &cull_meshlets_comp;
+		_cullMeshletsProgram = std::make_unique<ShaderProgram>(cull_meshlets_desc);
+
+		// Initialize the visibility-buffer shaders. The first pass pulls the
+		// vertices like the forward path, but only writes the triangle IDs.
+		Shader visibility_frag{ ShaderType::FragmentShader, 0, VisibilityBufferFrag };
+		PipelineStateDescription visibility_ps_desc;
+		visibility_ps_desc.FragmentShader = &visibility_frag;
+		visibility_ps_desc.VertexShader = &solid_wireframe_pull_vert;
+		_visibilityPS = std::make_unique<PipelineState>(visibility_ps_desc);
+		visibility_ps_desc.VertexShader = &solid_wireframe_pull_quant_vert;
+		_visibilityQuantPS = std::make_unique<PipelineState>(visibility_ps_desc);
+		visibility_ps_desc.VertexShader = &solid_wireframe_inst_vert;
+		_visibilityInstPS = std::make_unique<PipelineState>(visibility_ps_desc);
+		visibility_ps_desc.VertexShader = &solid_wireframe_inst_quant_vert;
+		_visibilityInstQuantPS = std::make_unique<PipelineState>(visibility_ps_desc);
+
+		// The second pass shades the screen from the stored IDs
+		Shader resolve_vert{ ShaderType::VertexShader, 0, VisibilityResolveVert };
+		Shader resolve_frag{ ShaderType::FragmentShader, 0, VisibilityResolveFrag };
+		Shader resolve_quant_frag{ ShaderType::FragmentShader, 0, VisibilityResolveQuantizedFrag };
+		PipelineStateDescription resolve_ps_desc;
+		resolve_ps_desc.VertexShader = &resolve_vert;
+		resolve_ps_desc.FragmentShader = &resolve_frag;
+		_resolvePS = std::make_unique<PipelineState>(resolve_ps_desc);
+		resolve_ps_desc.FragmentShader = &resolve_quant_frag;
+		_resolveQuantPS = std::make_unique<PipelineState>(resolve_ps_desc);
+		_visibilityBuffer = std::make_unique<VisibilityBuffer>();
+
+		// Initialize the torus generated in the vertex shader
+		Shader procedural_torus_vert{ ShaderType::VertexShader, 0, ProceduralTorusVert };
+		PipelineStateDescription procedural_torus_ps_desc;
+		procedural_torus_ps_desc.VertexShader = &procedural_torus_vert;
+		procedural_torus_ps_desc.FragmentShader = &solid_wireframe_pull_frag;
+		_proceduralTorusPS = std::make_unique<PipelineState>(procedural_torus_ps_desc);
+
+		// Initialize the shaders highlighting the picked triangle
+		Shader highlight_frag{ ShaderType::FragmentShader, 0, HighlightFrag };
+		// The highlight is drawn on top of the scene
+		PipelineStateDescription highlight_ps_desc;
+		highlight_ps_desc.DepthStencil.DepthEnable = false;
+		highlight_ps_desc.VertexShader = &solid_wireframe_pull_vert;
+		highlight_ps_desc.FragmentShader = &highlight_frag;
+		_highlightPS = std::make_unique<PipelineState>(highlight_ps_desc);
+		highlight_ps_desc.VertexShader = &solid_wireframe_pull_quant_vert;
+		_highlightQuantPS = std::make_unique<PipelineState>(highlight_ps_desc);
+
+		// Initialize the geometry
+		// Parameters of the cached torus. The last entry identifies the
+		// generator, such that caches of other generators are not used.
+		const float torus_params[] = { _torusRadius0, _torusRadius1, (float)_torusRings, (float)_torusSides, 2 };
+		const uint64_t torus_key = MeshCache::hash(torus_params, sizeof(torus_params));
+		const std::string torus_cache = MeshCache::path(torus_key);
+		MeshData mesh_data;
+		auto cache = readMeshCache(torus_cache, torus_key, mesh_data);
+		if (!cache)
+		{
+			mesh_data = buildLodChain(createTorus(_torusRadius0, _torusRadius1, _torusRings, _torusSides));
+			_optimizationStats = optimizeMesh(mesh_data);
+			writeMeshCache(torus_cache, torus_key, mesh_data);
+		}
+		setMesh(std::move(mesh_data), std::move(cache));
+
+		// Profiling
+		_gsTimer = std::make_unique<GpuTimer>();
+		_gsIndexedTimer = std::make_unique<GpuTimer>();
+		if (GLEW_ARB_pipeline_statistics_query)
+			_gsInvocations = std::make_unique<GpuCounter>(GL_VERTEX_SHADER_INVOCATIONS_ARB);
+		_pullTimer = std::make_unique<GpuTimer>();
+		_cullTimer = std::make_unique<GpuTimer>();
+		_instancedTimer = std::make_unique<GpuTimer>();
+		_visibleInstances = std::make_unique<GpuReadback<1>>();
+		_meshletCullTimer = std::make_unique<GpuTimer>();
+		_meshletTimer = std::make_unique<GpuTimer>();
+		_visibleMeshlets = std::make_unique<GpuReadback<5>>();
+		_visibilityTimer = std::make_unique<GpuTimer>();
+		_resolveTimer = std::make_unique<GpuTimer>();
+		_proceduralTimer = std::make_unique<GpuTimer>();
+	}
+	~SolidWireframeExample()
+	{
+		// The build references the mesh
+		cancelBvhBuild();
+	}
+
+	//! Replace the torus by a mesh loaded from an OBJ or PLY file. A binary
+	//! cache is written to the cache directory of the user and used on
+	//! subsequent imports of the same content.
+	void importMesh(const std::string& path)
+	{
+		const uint64_t key = MeshCache::sourceKey(path);
+		const std::string cache_path = MeshCache::path(key);
+
+		MeshData mesh;
+		auto cache = readMeshCache(cache_path, key, mesh);
+		if (cache)
 		{
-			const auto face = faces[Vcl::Geometry::TriMesh::FaceId{ f }];
-			vb.emplace_back(positions[face[0]], normals[face[0]]);
-			vb.emplace_back(positions[face[1]], normals[face[1]]);
-			vb.emplace_back(positions[face[2]], normals[face[2]]);
+			std::cout << "Loaded '" << cache_path << "': "
+				<< mesh.nrVertices() << " vertices, " << mesh.nrFaces() << " triangles in "
+				<< _cacheStats.Seconds << " s" << std::endl;
 		}
+		else
+		{
+			mesh = loadMesh(path, &_loadStats);
+			std::cout << "Loaded '" << path << "': "
+				<< mesh.nrVertices() << " vertices, " << mesh.nrFaces() << " triangles, "
+				<< _loadStats.throughput() << " MB/s, peak memory "
+				<< _loadStats.PeakMemory / (1024 * 1024) << " MB" << std::endl;
+
+			const auto lod_start = std::chrono::steady_clock::now();
+			mesh = buildLodChain(mesh);
+			std::cout << "Built " << mesh.nrLevels() << " levels of detail in "
+				<< std::chrono::duration<double>(std::chrono::steady_clock::now() - lod_start).count() << " s" << std::endl;
+
+			_optimizationStats = optimizeMesh(mesh);
+			std::cout << "Optimized mesh in " << _optimizationStats.Seconds << " s: ACMR "
+				<< _optimizationStats.CacheBefore.Acmr << " -> " << _optimizationStats.CacheAfter.Acmr << ", overfetch "
+				<< _optimizationStats.OverfetchBefore << " -> " << _optimizationStats.OverfetchAfter << std::endl;
+
+			writeMeshCache(cache_path, key, mesh);
+		}
+
+		_torusActive = false;
+		_torusDirty = false;
+		setMesh(std::move(mesh), std::move(cache));
+	}
+
+	RenderPath renderPath() const { return _renderPath; }
+	void setRenderPath(RenderPath path)
+	{
+		_renderPath = path;
+
+		// Bring the data used by the path up to date
+		if (_torusDirty && path != RenderPath::ProceduralTorus)
+			rebuildTorus();
+		if (path == RenderPath::MeshletCulling)
+			ensureMeshlets();
+		if (geometryStreamStale())
+			uploadGeometryStream(_mesh);
+	}
+
+	VertexLayout vertexLayout() const { return _vertexLayout; }
+	void setVertexLayout(VertexLayout layout)
+	{
+		if (_vertexLayout == layout)
+			return;
+
+		_vertexLayout = layout;
+		uploadMesh(_mesh);
+	}
 
-		Vcl::Graphics::Runtime::BufferDescription buffer_desc;
-		buffer_desc.Usage = BufferUsage::Vertex;
-		buffer_desc.SizeInBytes = static_cast<uint32_t>(vb.size() * sizeof(Vertex));
+	VertexFormat vertexFormat() const { return _vertexFormat; }
+	void setVertexFormat(VertexFormat format)
+	{
+		if (_vertexFormat == format)
+			return;
+
+		_vertexFormat = format;
+		uploadMesh(_mesh);
+	}
 
-		BufferInitData buffer_data;
-		buffer_data.Data = vb.data();
-		buffer_data.SizeInBytes = static_cast<uint32_t>(vb.size() * sizeof(Vertex));
+	Instancing instancing() const { return _instancing; }
+	void setInstancing(Instancing instancing)
+	{
+		if (_instancing == instancing)
+			return;
 
-		_meshGeometry = std::make_unique<Buffer>(buffer_desc, &buffer_data);
-		_nrMeshVertices = vb.size();
+		_instancing = instancing;
+		createInstances();
+		frameScene();
 	}
 
+	InstanceCulling instanceCulling() const { return _instanceCulling; }
+	void setInstanceCulling(InstanceCulling culling) { _instanceCulling = culling; }
+
+	bool animateAssembly() const { return _animateAssembly; }
+	void setAnimateAssembly(bool animate) { _animateAssembly = animate; }
+
 	Colour3f colour() const { return _colour; }
 	void setColour(Colour3f val) { _colour = val; }
 
@@ -164,6 +519,188 @@ public:
 	float smoothing() const { return _smoothing; }
 	void setSmoothing(float val) { _smoothing = val; }
 
+	int torusRings() const { return _torusRings; }
+	void setTorusRings(int rings)
+	{
+		rings = std::min(std::max(rings, 3), int{ MaxTorusResolution });
+		if (_torusRings == rings)
+			return;
+
+		_torusRings = rings;
+		updateTorus();
+	}
+
+	int torusSides() const { return _torusSides; }
+	void setTorusSides(int sides)
+	{
+		sides = std::min(std::max(sides, 3), int{ MaxTorusResolution });
+		if (_torusSides == sides)
+			return;
+
+		_torusSides = sides;
+		updateTorus();
+	}
+
+	float torusRadius0() const { return _torusRadius0; }
+	void setTorusRadius0(float radius)
+	{
+		radius = std::max(radius, 1e-3f);
+		if (_torusRadius0 == radius)
+			return;
+
+		_torusRadius0 = radius;
+		updateTorus();
+	}
+
+	float torusRadius1() const { return _torusRadius1; }
+	void setTorusRadius1(float radius)
+	{
+		radius = std::max(radius, 1e-3f);
+		if (_torusRadius1 == radius)
+			return;
+
+		_torusRadius1 = radius;
+		updateTorus();
+	}
+
+	float lodPixelError() const { return _lodPixelError; }
+	void setLodPixelError(float val) { _lodPixelError = std::max(0.0f, val); }
+
+	void drawUI(Application& app) override
+	{
+		BaseScene::drawUI(app);
+
+		ImGuiWindowFlags corner =
+			ImGuiWindowFlags_NoMove |
+			ImGuiWindowFlags_NoResize |
+			ImGuiWindowFlags_NoCollapse |
+			ImGuiWindowFlags_NoSavedSettings |
+			ImGuiWindowFlags_AlwaysAutoResize |
+			ImGuiWindowFlags_NoTitleBar;
+
+		ImGui::Begin("Statistics", nullptr, corner);
+		ImGui::SetWindowPos({ (float)app.width() - 260, 10 });
+		ImGui::Text("Triangles: %u", _mesh.level(0).NrIndices / 3);
+		ImGui::Text("Vertex pulling: %.1f KB", (_meshPositions->sizeInBytes() + _meshIndices->sizeInBytes()) / 1024.0f);
+		if (_meshGeometryUploaded)
+			ImGui::Text("Vertex buffer: %.1f KB", _meshGeometry->sizeInBytes() / 1024.0f);
+		if (_torusActive)
+			ImGui::Text("Torus: generated in %.3f ms, uploaded in %.3f ms", _torusBuildTime, _uploadTime);
+		if (bvhReady())
+		{
+			const BvhStatistics& bvh = _bvh.statistics();
+			ImGui::Text("BVH: %u nodes, depth %u, built in %.1f ms", bvh.Nodes, bvh.Depth, bvh.BuildMs);
+		}
+		else if (_bvhBuild.valid())
+		{
+			ImGui::Text("BVH: building, picking is disabled");
+		}
+		if (_pick.valid())
+		{
+			ImGui::Text("Picked triangle %u in %.1f us", _pick.Triangle, _pickTime);
+			ImGui::Text("Barycentrics: %.3f, %.3f, %.3f", 1 - _pick.U - _pick.V, _pick.U, _pick.V);
+			ImGui::Text("Position: %.3f, %.3f, %.3f", _pickPosition.x(), _pickPosition.y(), _pickPosition.z());
+		}
+		ImGui::Text("Buffers: %u updated in place, %u allocated", _bufferUpdates, _bufferAllocations);
+		const UploadRingStatistics& uploads = _uploadRing->statistics();
+		ImGui::Text("Constants: %u B in %u blocks per frame, %.1f MB total", uploads.FrameBytes, uploads.FrameAllocations, uploads.TotalBytes / (1024.0 * 1024.0));
+		ImGui::Text("Upload ring: %u fence waits, %.3f ms waited", uploads.FenceWaits, uploads.WaitMs);
+		if (_vertexFormat == VertexFormat::Quantized)
+		{
+			ImGui::Text("Position error: %.2e (bound %.2e)", _quantizationError.Position, _quantizationError.PositionBound);
+			ImGui::Text("Normal error: %.4f deg", _quantizationError.NormalDegrees);
+		}
+		ImGui::Text("Level of detail: %u / %u (%u triangles)", _currentLevel, _mesh.nrLevels(), _mesh.level(_currentLevel).NrIndices / 3);
+		ImGui::Text("Vertex cache: ACMR %.3f, ATVR %.3f (simulated)", _vertexCacheStats.Acmr, _vertexCacheStats.Atvr);
+		if (_renderPath == RenderPath::GeometryShaderIndexed && _instancing == Instancing::Off && _gsInvocations && _gsInvocations->hasResult())
+		{
+			// Only the indexed draw reuses transformed vertices, the other
+			// paths run one invocation per index. The count is some frames
+			// old, it is related to the triangles drawn in its frame.
+			const uint64_t nr_triangles = std::max<uint64_t>(_gsInvocations->tag(), 1);
+			ImGui::Text("Vertex cache: ACMR %.3f (measured)", double(_gsInvocations->count()) / nr_triangles);
+		}
+		if (_optimizationStats.Seconds > 0)
+		{
+			ImGui::Text("Optimized: ACMR %.3f -> %.3f", _optimizationStats.CacheBefore.Acmr, _optimizationStats.CacheAfter.Acmr);
+			ImGui::Text("Overfetch: %.2f -> %.2f (%.3f s)", _optimizationStats.OverfetchBefore, _optimizationStats.OverfetchAfter, _optimizationStats.Seconds);
+		}
+		if (_loadStats.FileSize > 0)
+		{
+			ImGui::Text("Import: %.1f MB/s (%.1f MB in %.3f s)", _loadStats.throughput(), _loadStats.FileSize / (1024.0 * 1024.0), _loadStats.Seconds);
+			ImGui::Text("Peak memory: %.1f MB", _loadStats.PeakMemory / (1024.0 * 1024.0));
+		}
+		if (_cacheStats.FileSize > 0)
+		{
+			ImGui::Text("Cache: %.1f MB (raw %.1f MB, %.2fx)", _cacheStats.FileSize / (1024.0 * 1024.0), _cacheStats.RawSize / (1024.0 * 1024.0), (double)_cacheStats.RawSize / _cacheStats.FileSize);
+			if (_cacheStats.Seconds > 0)
+				ImGui::Text("Cache read: %.3f s", _cacheStats.Seconds);
+		}
+		ImGui::Text("Geometry shader: %.3f ms", _gsTimer->elapsed());
+		ImGui::Text("Geometry shader (indexed): %.3f ms", _gsIndexedTimer->elapsed());
+		ImGui::Text("Vertex pulling:  %.3f ms", _pullTimer->elapsed());
+		if (_renderPath == RenderPath::ProceduralTorus && _instancing == Instancing::Off)
+		{
+			const uint64_t nr_triangles = 2ull * _torusRings * _torusSides;
+			ImGui::Text("Procedural torus: %llu triangles", static_cast<unsigned long long>(nr_triangles));
+			ImGui::Text("Procedural: %.3f ms (%.1f MTri/s)", _proceduralTimer->elapsed(), _proceduralTimer->elapsed() > 0 ? nr_triangles / (1000.0 * _proceduralTimer->elapsed()) : 0.0);
+		}
+		if (_renderPath == RenderPath::VisibilityBuffer)
+		{
+			if (useVisibilityBuffer())
+			{
+				const double ids = _instancing != Instancing::Off ? _instancedTimer->elapsed() : _visibilityTimer->elapsed();
+				ImGui::Text("Visibility IDs:  %.3f ms", ids);
+				ImGui::Text("Resolve:         %.3f ms", _resolveTimer->elapsed());
+			}
+			else
+			{
+				ImGui::Text("Visibility buffer: IDs exceed 32 bits");
+			}
+		}
+		if (_renderPath == RenderPath::MeshletCulling && _instancing == Instancing::Off)
+		{
+			const MeshletRange range = _meshlets.Levels[std::min<size_t>(_currentLevel, _meshlets.Levels.size() - 1)];
+			const uint32_t nr_triangles = _mesh.level(_currentLevel).NrIndices / 3;
+			const uint32_t visible_triangles = std::min((*_visibleMeshlets)[0] / 3, nr_triangles);
+			ImGui::Text("Meshlets: %u / %u visible (built in %.3f s)", (*_visibleMeshlets)[4], range.NrMeshlets, _meshletBuildTime);
+			ImGui::Text("Visible triangles: %u / %u, %.1f%% culled", visible_triangles, nr_triangles, nr_triangles > 0 ? 100.0f * (nr_triangles - visible_triangles) / nr_triangles : 0.0f);
+			ImGui::Text("Meshlet culling: %.3f ms", _meshletCullTimer->elapsed());
+			ImGui::Text("Meshlet drawing: %.3f ms", _meshletTimer->elapsed());
+		}
+		if (_instancing != Instancing::Off && _instanceCulling == InstanceCulling::GpuFrustum)
+		{
+			const uint32_t visible = std::min((*_visibleInstances)[0], _nrInstances);
+			ImGui::Text("Instances: %u visible, %u culled", visible, _nrInstances - visible);
+			ImGui::Text("Culling:   %.3f ms", _cullTimer->elapsed());
+			ImGui::Text("Instanced: %.3f ms", _instancedTimer->elapsed());
+		}
+		if (_instancing != Instancing::Off && _instanceCulling == InstanceCulling::CpuOcclusion)
+		{
+			const OcclusionCullingStatistics& stats = _occlusionCuller->statistics();
+			ImGui::Text("Instances: %u visible, %u outside, %u occluded", stats.Visible, stats.FrustumCulled, stats.Occluded);
+			ImGui::Text("Occluders: %zu triangles, %.3f ms", stats.OccluderTriangles, stats.RasterMs);
+			ImGui::Text("Occlusion tests: %.3f ms", stats.TestMs);
+			ImGui::Text("Instanced: %.3f ms", _instancedTimer->elapsed());
+		}
+		if (_instancing != Instancing::Off)
+		{
+			const TransformHierarchyStatistics& assembly = _assembly.statistics();
+			ImGui::Text("Assembly: %u nodes, %u levels", assembly.Nodes, assembly.Levels);
+			ImGui::Text("Assembly update: %u nodes, %.3f ms", assembly.UpdatedNodes, assembly.UpdateMs);
+			ImGui::Text("Instance transforms: %.3f ms", _transformTime);
+		}
+		if (ImGui::Button("Benchmark transforms"))
+			_transformTimings = benchmarkTransforms();
+		for (const auto& timing : _transformTimings)
+			ImGui::Text("%7u objects: Eigen %.3f ms, batched %.3f ms (%.1fx)", timing.Objects, timing.EigenMs, timing.BatchedMs, timing.EigenMs / std::max(timing.BatchedMs, 1e-6));
+		if (ImGui::Button("Benchmark hierarchy"))
+			_hierarchyTimings = benchmarkHierarchy();
+		for (const auto& timing : _hierarchyTimings)
+			ImGui::Text("%7u nodes: pointers %.3f ms, flat %.3f ms, %u dirty %.3f ms", timing.Nodes, timing.PointerMs, timing.FullMs, timing.DirtyNodes, timing.DirtyMs);
+		ImGui::End();
+	}
+
 public:
 	void onMouseButton(Application& app, int button, int action, int mods)
 	{
@@ -173,6 +710,12 @@ public:
 			glfwGetCursorPos(app.window(), &x, &y);
 			_cameraController->startRotate((float)x / (float)app.width(), (float)y / (float)app.height());
 		}
+		else if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
+		{
+			double x, y;
+			glfwGetCursorPos(app.window(), &x, &y);
+			pick(app, x, y);
+		}
 		else
 		{
 			_cameraController->endRotate();
@@ -188,25 +731,237 @@ public:
 	void draw(Application& app) override
 	{
 		_engine->beginFrame();
+		_uploadRing->beginFrame();
 
 		_engine->clear(0, Eigen::Vector4f{0.0f, 0.0f, 0.0f, 1.0f});
 		_engine->clear(1.0f);
 
 		// View on the scene
-		auto cbuf_camera = _engine->requestPerFrameConstantBuffer<PerFrameCameraData>();
+		auto cbuf_camera = _uploadRing->allocate<PerFrameCameraData>();
 		cbuf_camera->Viewport = vec4(0, 0, app.width(), app.height());
 		cbuf_camera->Frustum;
 		cbuf_camera->ViewMatrix = mat4(_camera->view());
 		cbuf_camera->ProjectionMatrix = mat4(_camera->projection());
-		_engine->setConstantBuffer(0, std::move(cbuf_camera));
+		_uploadRing->bind(0, cbuf_camera);
 
 		Eigen::Matrix4f M = _cameraController->currObjectTransformation();
-		renderScene(Vcl::Graphics::Runtime::PrimitiveType::Trianglelist, _engine.get(), _solidwireframePS, M);
+		_currentLevel = selectLevel(app, M);
+
+		// Cull the instances with the camera of this frame while the frame
+		// is recorded, the instanced draw waits for the result
+		if (_instancing != Instancing::Off && _instanceCulling == InstanceCulling::CpuOcclusion)
+		{
+			_occlusionCuller->kick(_camera->projection() * _camera->view() * M);
+			_occlusionKicked = true;
+		}
+
+		// Render the triangle IDs to the visibility buffer first
+		const bool visibility = useVisibilityBuffer();
+		if (visibility)
+		{
+			auto cbuf_visibility = _uploadRing->allocate<VisibilityBufferData>();
+			cbuf_visibility->InverseProjectionMatrix = mat4(_camera->projection().inverse());
+			cbuf_visibility->TriangleBits = static_cast<int>(visibilityTriangleBits());
+			cbuf_visibility->Instanced = _instancing != Instancing::Off ? 1 : 0;
+			_uploadRing->bind(6, cbuf_visibility);
+
+			_visibilityBuffer->resize(app.width(), app.height());
+			_visibilityBuffer->bind();
+		}
+
+		renderScene(Vcl::Graphics::Runtime::PrimitiveType::Trianglelist, _engine.get(), currentPipelineState(), M);
+
+		if (visibility)
+		{
+			_visibilityBuffer->unbind();
+			resolveVisibilityBuffer(_engine.get());
+		}
+
+		if (_pick.valid() && pickable())
+			drawHighlight(_engine.get());
 		
+		_uploadRing->endFrame();
 		_engine->endFrame();
 	}
 
 private:
+	const std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState>& currentPipelineState() const
+	{
+		const bool quantized = _vertexFormat == VertexFormat::Quantized;
+		if (_instancing != Instancing::Off && useVisibilityBuffer())
+			return quantized ? _visibilityInstQuantPS : _visibilityInstPS;
+		if (_instancing != Instancing::Off)
+			return quantized ? _solidwireframeInstQuantPS : _solidwireframeInstPS;
+		if (_renderPath == RenderPath::VisibilityBuffer)
+			return quantized ? _visibilityQuantPS : _visibilityPS;
+		if (_renderPath == RenderPath::ProceduralTorus)
+			return _proceduralTorusPS;
+		if (_renderPath == RenderPath::VertexPulling)
+			return quantized ? _solidwireframePullQuantPS : _solidwireframePullPS;
+		if (_renderPath == RenderPath::MeshletCulling)
+			return quantized ? _solidwireframeMeshletsQuantPS : _solidwireframeMeshletsPS;
+		if (_vertexLayout == VertexLayout::Position || !hasNormals())
+			return quantized ? _solidwireframeQuantPosPS : _solidwireframePosPS;
+		return quantized ? _solidwireframeQuantPS : _solidwireframePS;
+	}
+
+	//! Picking is supported for the mesh when it is drawn once
+	bool pickable() const
+	{
+		return _instancing == Instancing::Off && _renderPath != RenderPath::ProceduralTorus;
+	}
+
+	/*!
+	 * Pick the triangle under the window position (x, y). A packet of rays
+	 * through the pixel and its neighbours is traced, such that thin parts
+	 * can be picked with a tolerance of a pixel. Picks are ignored while the
+	 * BVH is built.
+	 *
+	 * The BVH covers the finest level of detail. If a coarser level is drawn,
+	 * the picked triangle and position belong to the finest level, they lie
+	 * within the error of the drawn level from the visible surface. The
+	 * highlight draws the triangle of the finest level on top of the scene.
+	 */
+	void pick(const Application& app, double x, double y)
+	{
+		_pick = {};
+		if (!pickable() || !bvhReady())
+			return;
+
+		// Rays in object space, starting at the camera
+		const Eigen::Matrix4f M = _cameraController->currObjectTransformation();
+		const Eigen::Matrix4f inv_MVP = (_camera->projection() * _camera->view() * M).inverse();
+		const Eigen::Vector3f eye = (M.inverse() * _camera->position().homogeneous()).head<3>();
+
+		const float offsets[][2] = { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 }, { -1, -1 }, { 1, 1 }, { 1, -1 } };
+		RayPacket rays;
+		for (int i = 0; i < RayPacket::Size; i++)
+		{
+			const float ndc_x = 2 * (float(x) + 0.5f + offsets[i][0]) / app.width() - 1;
+			const float ndc_y = 1 - 2 * (float(y) + 0.5f + offsets[i][1]) / app.height();
+			const Eigen::Vector4f p = inv_MVP * Eigen::Vector4f{ ndc_x, ndc_y, 0.5f, 1 };
+			const Eigen::Vector3f dir = p.head<3>() / p.w() - eye;
+			for (int k = 0; k < 3; k++)
+			{
+				rays.Origin[k][i] = eye[k];
+				rays.Direction[k][i] = dir[k];
+			}
+			rays.MaxT[i] = std::numeric_limits<float>::infinity();
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		std::array<RayHit, RayPacket::Size> hits;
+		_bvh.intersect(rays, hits.data());
+		_pickTime = 1e6 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		// Prefer the ray through the pixel center, the neighbours only fill in
+		// if it misses. Their directions are of similar length, such that the
+		// distances are comparable.
+		_pick = hits[0];
+		for (int i = 1; i < RayPacket::Size && !hits[0].valid(); i++)
+		{
+			if (hits[i].valid() && (!_pick.valid() || hits[i].T < _pick.T))
+				_pick = hits[i];
+		}
+		if (!_pick.valid())
+			return;
+
+		const uint32_t* idx = _mesh.Indices.data() + 3 * _pick.Triangle;
+		const Eigen::Vector3f p =
+			(1 - _pick.U - _pick.V) * _mesh.Positions[idx[0]] +
+			_pick.U * _mesh.Positions[idx[1]] +
+			_pick.V * _mesh.Positions[idx[2]];
+		_pickPosition = (M * p.homogeneous()).head<3>();
+	}
+
+	//! Build the BVH of the current mesh on a worker thread
+	void startBvhBuild()
+	{
+		cancelBvhBuild();
+		_bvhCancel = false;
+		_bvhBuild = std::async(std::launch::async, [this]()
+		{
+			_bvh.build(_mesh, _mesh.level(0), &_bvhCancel);
+		});
+	}
+
+	//! Stop a running BVH build. The BVH references '_mesh', thus this must
+	//! precede any change of the mesh.
+	void cancelBvhBuild()
+	{
+		if (_bvhBuild.valid())
+		{
+			_bvhCancel = true;
+			_bvhBuild.get();
+		}
+		_bvhValid = false;
+		_pick = {};
+	}
+
+	//! Indicate whether the BVH of the current mesh is built
+	bool bvhReady()
+	{
+		if (!_bvhValid && _bvhBuild.valid() && _bvhBuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			_bvhBuild.get();
+			_bvhValid = !_bvh.empty();
+		}
+		return _bvhValid;
+	}
+
+	//! Draw the picked triangle on top of the scene. Relies on the object
+	//! constants set by 'renderScene'.
+	void drawHighlight(Vcl::Graphics::Runtime::GraphicsEngine* cmd_queue)
+	{
+		const bool quantized = _vertexFormat == VertexFormat::Quantized;
+		cmd_queue->setPipelineState(quantized ? _highlightQuantPS : _highlightPS);
+
+		_uploadRing->bindStorage(0, _meshPositions->id());
+		_uploadRing->bindStorage(1, _meshIndices->id());
+		cmd_queue->setPrimitiveType(Vcl::Graphics::Runtime::PrimitiveType::Trianglelist, 3);
+		cmd_queue->draw(3, 3 * _pick.Triangle);
+	}
+
+	//! Number of bits of a visibility-buffer ID storing the triangle
+	uint32_t visibilityTriangleBits() const
+	{
+		const uint64_t nr_triangles = _mesh.Indices.size() / 3;
+		uint32_t bits = 1;
+		while ((uint64_t{ 1 } << bits) < nr_triangles)
+			bits++;
+		return bits;
+	}
+
+	//! The visibility buffer is used if the triangle and instance IDs fit
+	//! into 32 bits, all ones marking empty pixels
+	bool useVisibilityBuffer() const
+	{
+		if (_renderPath != RenderPath::VisibilityBuffer)
+			return false;
+
+		const uint64_t nr_instances = std::max<uint64_t>(_instancing != Instancing::Off ? _nrInstances : 0, 1);
+		return (nr_instances << visibilityTriangleBits()) <= VisibilityBuffer::Empty;
+	}
+
+	//! Shade the pixels of the visibility buffer. Relies on the object and
+	//! wireframe constants set by 'renderScene'.
+	void resolveVisibilityBuffer(Vcl::Graphics::Runtime::GraphicsEngine* cmd_queue)
+	{
+		const bool quantized = _vertexFormat == VertexFormat::Quantized;
+		cmd_queue->setPipelineState(quantized ? _resolveQuantPS : _resolvePS);
+
+		_resolveTimer->begin();
+		glBindTextureUnit(0, _visibilityBuffer->ids());
+		_uploadRing->bindStorage(0, _meshPositions->id());
+		_uploadRing->bindStorage(1, _meshIndices->id());
+		if (_instancing != Instancing::Off)
+			_uploadRing->bindStorage(2, _instances->id());
+		cmd_queue->setPrimitiveType(Vcl::Graphics::Runtime::PrimitiveType::Trianglelist, 3);
+		cmd_queue->draw(3, 0);
+		glBindTextureUnit(0, 0);
+		_resolveTimer->end();
+	}
+
 	void renderScene
 	(
 		Vcl::Graphics::Runtime::PrimitiveType primitive_type,
@@ -215,82 +970,1275 @@ private:
 		const Eigen::Matrix4f& M
 	)
 	{
+		// Determine the visible instances before the pipeline is bound, the
+		// culling uses its own program
+		if (_instancing != Instancing::Off && _instanceCulling == InstanceCulling::GpuFrustum)
+			cullInstances(cmd_queue, M);
+		else if (_renderPath == RenderPath::MeshletCulling)
+			cullMeshlets(cmd_queue, M);
+
 		// Configure the layout
 		cmd_queue->setPipelineState(ps);
 
 		// View on the scene
-		auto cbuf_transform = cmd_queue->requestPerFrameConstantBuffer<ObjectTransformData>();
+		auto cbuf_transform = _uploadRing->allocate<ObjectTransformData>();
 		cbuf_transform->ModelMatrix = M;
-		cbuf_transform->NormalMatrix = mat4((_camera->view() * M).inverse().transpose());
-		cmd_queue->setConstantBuffer(1, std::move(cbuf_transform));
+		cbuf_transform->NormalMatrix = mat4(normalMatrix(_camera->view() * M));
+		_uploadRing->bind(1, cbuf_transform);
+
+		// Transforms of the instances to view space
+		if (_instancing != Instancing::Off)
+			uploadInstanceTransforms(M);
 
 		// View on the scene
-		auto cbuf_config= cmd_queue->requestPerFrameConstantBuffer<SolidWireframeData>();
+		auto cbuf_config= _uploadRing->allocate<SolidWireframeData>();
 		cbuf_config->Colour.x = _colour.r;
 		cbuf_config->Colour.y = _colour.g;
 		cbuf_config->Colour.z = _colour.b;
 		cbuf_config->Smoothing = _smoothing;
 		cbuf_config->Thickness = _thickness;
-		cmd_queue->setConstantBuffer(2, std::move(cbuf_config));
+		_uploadRing->bind(2, cbuf_config);
 
-		// Render the quad
-		cmd_queue->setVertexBuffer(0, *_meshGeometry, 0, 24);
-		cmd_queue->setPrimitiveType(primitive_type, 3);
-		cmd_queue->draw(_nrMeshVertices);
-	}
-	
-private:
-	std::unique_ptr<Vcl::Graphics::Runtime::GraphicsEngine> _engine;
+		// Restore quantized positions
+		if (_vertexFormat == VertexFormat::Quantized)
+		{
+			auto cbuf_dequant = _uploadRing->allocate<DequantizationData>();
+			cbuf_dequant->PositionOffset = vec4(_bounds.min().x(), _bounds.min().y(), _bounds.min().z(), 0);
+			cbuf_dequant->PositionScale = vec4(_bounds.sizes().x(), _bounds.sizes().y(), _bounds.sizes().z(), 0);
+			_uploadRing->bind(3, cbuf_dequant);
+		}
 
-private:
-	std::unique_ptr<Vcl::Graphics::TrackballCameraController> _cameraController;
+		// Render the instances which passed the CPU culling
+		if (_instancing != Instancing::Off && _instanceCulling == InstanceCulling::CpuOcclusion)
+		{
+			uploadVisibleInstances(M);
 
-private:
-	std::unique_ptr<Vcl::Graphics::Camera> _camera;
+			const MeshLevel level = _mesh.level(0);
+			const GLsizei nr_visible = static_cast<GLsizei>(_occlusionCuller->visible().size());
+			_instancedTimer->begin();
+			_uploadRing->bindStorage(0, _meshPositions->id());
+			_uploadRing->bindStorage(1, _meshIndices->id());
+			_uploadRing->bindStorage(2, _instances->id());
+			_uploadRing->bindStorage(3, _cpuVisibleInstances->id());
+			if (nr_visible > 0)
+				glDrawArraysInstanced(GL_TRIANGLES, level.FirstIndex, level.NrIndices, nr_visible);
+			_instancedTimer->end();
+			return;
+		}
 
-	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _solidwireframePS;
+		// Render the visible instances with the command written by the culling
+		if (_instancing != Instancing::Off)
+		{
+			_instancedTimer->begin();
+			_uploadRing->bindStorage(0, _meshPositions->id());
+			_uploadRing->bindStorage(1, _meshIndices->id());
+			_uploadRing->bindStorage(2, _instances->id());
+			_uploadRing->bindStorage(3, _visibleInstanceIndices->id());
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _drawCommand->id());
+			glDrawArraysIndirect(GL_TRIANGLES, nullptr);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			_instancedTimer->end();
+			return;
+		}
 
-	//! Geometry (position, normal)
-	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer> _meshGeometry;
+		// Render the current level of detail
+		const MeshLevel level = _mesh.level(_currentLevel);
+		switch (_renderPath)
+		{
+		case RenderPath::GeometryShader:
+			_gsTimer->begin();
+			cmd_queue->setVertexBuffer(0, *_meshGeometry, 0, _meshGeometryStride);
+			cmd_queue->setPrimitiveType(primitive_type, 3);
+			cmd_queue->draw(level.NrIndices, level.FirstIndex);
+			_gsTimer->end();
+			break;
+		case RenderPath::GeometryShaderIndexed:
+			_gsIndexedTimer->begin();
+			if (_gsInvocations)
+				_gsInvocations->begin(level.NrIndices / 3);
+			if (interleavedGeometry())
+				cmd_queue->setVertexBuffer(0, *_meshGeometry, 0, _meshGeometryStride);
+			else
+				cmd_queue->setVertexBuffer(0, *_meshPositions, 0, _vertexFormat == VertexFormat::Quantized ? 4 * sizeof(uint16_t) : sizeof(Eigen::Vector3f));
 
-	//! Number of vertices
-	uint32_t _nrMeshVertices;
+			// The engine only issues non-indexed draws. The index buffer is
+			// attached to the vertex array of the pipeline for this draw.
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _meshIndices->id());
+			glDrawElements(GL_TRIANGLES, level.NrIndices, GL_UNSIGNED_INT, reinterpret_cast<const void*>(sizeof(uint32_t) * level.FirstIndex));
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+			if (_gsInvocations)
+				_gsInvocations->end();
+			_gsIndexedTimer->end();
+			break;
+		case RenderPath::VertexPulling:
+			_pullTimer->begin();
+			_uploadRing->bindStorage(0, _meshPositions->id());
+			_uploadRing->bindStorage(1, _meshIndices->id());
+			cmd_queue->setPrimitiveType(primitive_type, 3);
+			cmd_queue->draw(level.NrIndices, level.FirstIndex);
+			_pullTimer->end();
+			break;
+		case RenderPath::VisibilityBuffer:
+			_visibilityTimer->begin();
+			_uploadRing->bindStorage(0, _meshPositions->id());
+			_uploadRing->bindStorage(1, _meshIndices->id());
+			cmd_queue->setPrimitiveType(primitive_type, 3);
+			cmd_queue->draw(level.NrIndices, level.FirstIndex);
+			_visibilityTimer->end();
+			break;
+		case RenderPath::ProceduralTorus:
+		{
+			// No buffers are bound, the vertices are computed from their index
+			auto cbuf_torus = _uploadRing->allocate<ProceduralTorusData>();
+			cbuf_torus->TorusRadius0 = _torusRadius0;
+			cbuf_torus->TorusRadius1 = _torusRadius1;
+			cbuf_torus->TorusRings = _torusRings;
+			cbuf_torus->TorusSides = _torusSides;
+			_uploadRing->bind(7, cbuf_torus);
 
-	//! Colour of the overlay
-	Colour3f _colour{ 0, 0, 0 };
+			_proceduralTimer->begin();
+			cmd_queue->setPrimitiveType(primitive_type, 3);
+			cmd_queue->draw(6 * _torusRings * _torusSides, 0);
+			_proceduralTimer->end();
+			break;
+		}
+		case RenderPath::MeshletCulling:
+			_meshletTimer->begin();
+			_uploadRing->bindStorage(0, _meshPositions->id());
+			_uploadRing->bindStorage(1, _meshIndices->id());
+			_uploadRing->bindStorage(6, _visibleTriangles->id());
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _meshletCommand->id());
+			glDrawArraysIndirect(GL_TRIANGLES, nullptr);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			_meshletTimer->end();
+			break;
+		}
+	}
 
-	//! Smoothness of the generated overlay
-	float _smoothing{ 1.0f };
+	//! Cull the meshlets of the current level of detail on the GPU and
+	//! compact the triangles of the visible ones into an indirect draw
+	void cullMeshlets(Vcl::Graphics::Runtime::GraphicsEngine* cmd_queue, const Eigen::Matrix4f& M)
+	{
+		const MeshletRange range = _meshlets.Levels[std::min<size_t>(_currentLevel, _meshlets.Levels.size() - 1)];
 
-	//! Thickness of the lines
-	float _thickness{ 1.0f };
-};
+		// Reset the draw command and the meshlet counter
+		const GLuint command[] = { 0, 1, 0, 0 };
+		const GLuint counters[] = { 0, 0, 0, 0 };
+		glClearNamedBufferSubData(_meshletCommand->id(), GL_RGBA32UI, 0, 16, GL_RGBA_INTEGER, GL_UNSIGNED_INT, command);
+		glClearNamedBufferSubData(_meshletCommand->id(), GL_RGBA32UI, 16, 16, GL_RGBA_INTEGER, GL_UNSIGNED_INT, counters);
 
-VCL_RTTI_BASES(SolidWireframeExample, BaseScene)
+		// Frustum planes and camera in object space
+		const Eigen::Matrix4f VP = _camera->projection() * _camera->view() * M;
+		const Eigen::Vector3f camera = (M.inverse() * _camera->position().homogeneous()).head<3>();
+		auto cbuf_culling = _uploadRing->allocate<MeshletCullingData>();
+		for (int i = 0; i < 3; i++)
+		{
+			for (int s = 0; s < 2; s++)
+			{
+				Eigen::Vector4f plane = VP.row(3).transpose() + (s == 0 ? 1.0f : -1.0f) * VP.row(i).transpose();
+				plane /= plane.head<3>().norm();
+				cbuf_culling->MeshletFrustumPlanes[2*i + s] = vec4(plane.x(), plane.y(), plane.z(), plane.w());
+			}
+		}
+		cbuf_culling->CameraPosition = vec4(camera.x(), camera.y(), camera.z(), 1);
+		cbuf_culling->FirstMeshlet = static_cast<int>(range.FirstMeshlet);
+		cbuf_culling->NrMeshlets = static_cast<int>(range.NrMeshlets);
+		_uploadRing->bind(5, cbuf_culling);
 
-VCL_RTTI_CTOR_TABLE_BEGIN(SolidWireframeExample)
-	Vcl::RTTI::Constructor<SolidWireframeExample>()
-VCL_RTTI_CTOR_TABLE_END(SolidWireframeExample)
+		// One work group per meshlet, at most 65535 groups per dimension
+		const GLuint groups_x = std::min<GLuint>(std::max<GLuint>(range.NrMeshlets, 1), 65535);
+		const GLuint groups_y = (range.NrMeshlets + groups_x - 1) / groups_x;
 
-VCL_RTTI_ATTR_TABLE_BEGIN(SolidWireframeExample)
-	Vcl::RTTI::Attribute<SolidWireframeExample, Colour3f>{"Colour", &SolidWireframeExample::colour, &SolidWireframeExample::setColour},
-	Vcl::RTTI::Attribute<SolidWireframeExample, float>{"Smoothing", &SolidWireframeExample::smoothing, &SolidWireframeExample::setSmoothing},
-	Vcl::RTTI::Attribute<SolidWireframeExample, float>{"Thickness", &SolidWireframeExample::thickness, &SolidWireframeExample::setThickness}
-VCL_RTTI_ATTR_TABLE_END(SolidWireframeExample)
+		_meshletCullTimer->begin();
+		_uploadRing->bindStorage(5, _meshletBuffer->id());
+		_uploadRing->bindStorage(6, _visibleTriangles->id());
+		_uploadRing->bindStorage(7, _meshletCommand->id());
+		{
+			ScopedComputeProgram program{ *_cullMeshletsProgram };
+			glDispatchCompute(groups_x, groups_y, 1);
+		}
+		_meshletCullTimer->end();
 
-VCL_DEFINE_METAOBJECT(SolidWireframeExample)
-{
-	VCL_RTTI_REGISTER_BASES(SolidWireframeExample);
-	VCL_RTTI_REGISTER_CTORS(SolidWireframeExample);
-	VCL_RTTI_REGISTER_ATTRS(SolidWireframeExample);
-}
+		// Make the results visible to the draw and the statistics
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+		_visibleMeshlets->copy(_meshletCommand->id(), 0);
+	}
+
+	//! Frustum cull the instances on the GPU and write the indirect draw
+	void cullInstances(Vcl::Graphics::Runtime::GraphicsEngine* cmd_queue, const Eigen::Matrix4f& M)
+	{
+		// Reset the draw command. All instances use the finest level, the
+		// instance count is accumulated by the culling.
+		const MeshLevel level = _mesh.level(0);
+		const GLuint command[] = { level.NrIndices, 0, level.FirstIndex, 0 };
+		glClearNamedBufferData(_drawCommand->id(), GL_RGBA32UI, GL_RGBA_INTEGER, GL_UNSIGNED_INT, command);
+
+		// Frustum planes in the space of the instance transforms (Gribb and
+		// Hartmann). The near plane is taken for a depth range of [-1, 1],
+		// which is conservative for [0, 1].
+		const Eigen::Matrix4f VP = _camera->projection() * _camera->view() * M;
+		auto cbuf_culling = _uploadRing->allocate<InstanceCullingData>();
+		for (int i = 0; i < 3; i++)
+		{
+			for (int s = 0; s < 2; s++)
+			{
+				Eigen::Vector4f plane = VP.row(3).transpose() + (s == 0 ? 1.0f : -1.0f) * VP.row(i).transpose();
+				plane /= plane.head<3>().norm();
+				cbuf_culling->FrustumPlanes[2*i + s] = vec4(plane.x(), plane.y(), plane.z(), plane.w());
+			}
+		}
+		cbuf_culling->NrInstances = static_cast<int>(_nrInstances);
+		_uploadRing->bind(4, cbuf_culling);
+
+		_cullTimer->begin();
+		_uploadRing->bindStorage(2, _instances->id());
+		_uploadRing->bindStorage(3, _visibleInstanceIndices->id());
+		_uploadRing->bindStorage(4, _drawCommand->id());
+		{
+			ScopedComputeProgram program{ *_cullInstancesProgram };
+			glDispatchCompute((_nrInstances + 63) / 64, 1, 1);
+		}
+		_cullTimer->end();
+
+		// Make the results visible to the draw and the statistics
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+		_visibleInstances->copy(_drawCommand->id(), sizeof(GLuint));
+	}
+
+	/*!
+	 * Spin the instances of one slab of the assembly about their centers, the
+	 * slab changes every 120 frames. Only the pivots of the slab are marked
+	 * dirty, the update of the hierarchy recomputes them and their children.
+	 */
+	void spinAssembly()
+	{
+		const uint32_t per_slab = _assemblySide * _assemblySide;
+		const uint32_t nr_slabs = (_nrInstances + per_slab - 1) / per_slab;
+		const uint32_t slab = (_assemblyFrame++ / 120) % nr_slabs;
+		_slabSpin[slab] += 0.02f;
+
+		const Eigen::Matrix3f spin = Eigen::AngleAxisf{ _slabSpin[slab], Eigen::Vector3f::UnitZ() }.toRotationMatrix();
+		const uint32_t begin = slab * per_slab;
+		const uint32_t end = std::min(_nrInstances, begin + per_slab);
+		for (uint32_t i = begin; i < end; i++)
+		{
+			Eigen::Matrix4f T = _assembly.local(_instancePivots[i]);
+			T.topLeftCorner<3, 3>() = spin * _instanceOrientations[i];
+			_assembly.setLocal(_instancePivots[i], T);
+		}
+		_assembly.update();
+
+		// The mesh of an instance is the child following its pivot
+		parallelFor(begin, end, 1024, [this](size_t, size_t b, size_t e)
+		{
+			for (size_t i = b; i < e; i++)
+				_instanceTransforms.set(i, _assembly.world(_instancePivots[i] + 1));
+		});
+		_instanceTransformsValid = false;
+	}
+
+	/*!
+	 * Bind the transforms of the instances to view space. They are only
+	 * recomputed if the instances, the camera or the object transformation
+	 * changed, e.g. every frame while the assembly spins. The transforms are
+	 * written to the upload ring and copied on the GPU into
+	 * '_instanceTransformBuffer', which keeps them for the following frames.
+	 */
+	void uploadInstanceTransforms(const Eigen::Matrix4f& M)
+	{
+		// The spin keeps the bounding spheres of the GPU culling, but not the
+		// occluders of the CPU culling
+		if (_animateAssembly && _instanceCulling == InstanceCulling::GpuFrustum)
+			spinAssembly();
+
+		const Eigen::Matrix4f view_model = _camera->view() * M;
+		if (!_instanceTransformsValid || view_model != _instanceViewModel)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			const size_t size = _nrInstances * sizeof(InstanceTransform);
+			auto transforms = _uploadRing->allocate<InstanceTransform>(_nrInstances);
+			_instanceTransforms.compute(view_model, transforms.Data);
+			glCopyNamedBufferSubData(_uploadRing->buffer(), _instanceTransformBuffer->id(), transforms.Offset, 0, static_cast<GLsizeiptr>(size));
+			_instanceViewModel = view_model;
+			_instanceTransformsValid = true;
+			_transformTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		_uploadRing->bindStorage(8, _instanceTransformBuffer->id());
+	}
+
+	//! Upload the indices of the instances which passed the CPU culling
+	void uploadVisibleInstances(const Eigen::Matrix4f& M)
+	{
+		using Vcl::Graphics::Runtime::BufferUsage;
+
+		// Cull synchronously if no job is in flight, e.g. after the scene changed
+		if (!_occlusionKicked)
+			_occlusionCuller->kick(_camera->projection() * _camera->view() * M);
+		_occlusionCuller->wait();
+		_occlusionKicked = false;
+
+		// The buffer is reused across frames and only grows
+		const auto& visible = _occlusionCuller->visible();
+		updateBuffer(_cpuVisibleInstances, BufferUsage::Storage, visible.data(), visible.size() * sizeof(uint32_t));
+	}
+
+	//! Place copies of the mesh with random orientations on a cubic grid
+	void createInstances()
+	{
+		using Vcl::Graphics::Runtime::OpenGL::Buffer;
+		using Vcl::Graphics::Runtime::BufferDescription;
+		using Vcl::Graphics::Runtime::BufferUsage;
+
+		const uint32_t counts[] = { 0, 1000, 10000, MaxInstances };
+		_nrInstances = counts[static_cast<int>(_instancing)];
+		_occlusionKicked = false;
+
+		// The transforms of the instances are recomputed when they change and
+		// sub-allocated from the upload ring with the constants. The ring is
+		// sized for 'MaxInstances' when it is created.
+		_instanceTransforms.resize(_nrInstances);
+		_instanceTransformsValid = false;
+		if (_nrInstances == 0)
+		{
+			_occlusionCuller->setObjects({}, {}, {}, {});
+			_instanceData.clear();
+			_instances.reset();
+			_instanceTransformBuffer.reset();
+			_visibleInstanceIndices.reset();
+			_drawCommand.reset();
+			return;
+		}
+
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(_nrInstances))));
+		const float spacing = 2.5f * _boundingSphere.w();
+		const Eigen::Vector3f center{ _boundingSphere.x(), _boundingSphere.y(), _boundingSphere.z() };
+		const Eigen::Vector3f origin = -0.5f * spacing * (side - 1) * Eigen::Vector3f::Ones();
+
+		std::mt19937 rng{ 5489u };
+		std::uniform_real_distribution<float> angle{ -3.14159265f, 3.14159265f };
+		std::uniform_real_distribution<float> coord{ -1.0f, 1.0f };
+
+		// The instances form an assembly of slabs along z, rows along y and a
+		// pivot per instance. The pivot orients its child, the mesh centered
+		// at the origin.
+		std::vector<uint32_t> parents{ TransformHierarchy::NoParent };
+		std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f>> locals{ Eigen::Affine3f{ Eigen::Translation3f{ origin } }.matrix() };
+		auto add_node = [&parents, &locals](uint32_t parent, const Eigen::Matrix4f& T)
+		{
+			parents.push_back(parent);
+			locals.push_back(T);
+			return static_cast<uint32_t>(parents.size() - 1);
+		};
+		_assemblySide = side;
+		_assemblyFrame = 0;
+		_slabSpin.assign(side, 0.0f);
+		_instancePivots.resize(_nrInstances);
+		_instanceOrientations.resize(_nrInstances);
+
+		std::vector<InstanceData>& instances = _instanceData;
+		instances.resize(_nrInstances);
+		uint32_t slab = 0, row = 0;
+		for (uint32_t i = 0; i < _nrInstances; i++)
+		{
+			const Eigen::Vector3f cell{ float(i % side), float((i / side) % side), float(i / (side * side)) };
+			const Eigen::Vector3f axis = Eigen::Vector3f{ coord(rng), coord(rng), coord(rng) }.normalized();
+			const Eigen::AngleAxisf orientation{ angle(rng), axis.allFinite() ? axis : Eigen::Vector3f::UnitZ() };
+
+			// Rotate about the center of the mesh, then move it into its cell
+			Eigen::Affine3f T = Eigen::Affine3f::Identity();
+			T.translate(origin + spacing * cell);
+			T.rotate(orientation);
+			T.translate(-center);
+
+			if (i % (side * side) == 0)
+				slab = add_node(0, Eigen::Affine3f{ Eigen::Translation3f{ 0, 0, spacing * cell.z() } }.matrix());
+			if (i % side == 0)
+				row = add_node(slab, Eigen::Affine3f{ Eigen::Translation3f{ 0, spacing * cell.y(), 0 } }.matrix());
+			Eigen::Affine3f pivot{ Eigen::Translation3f{ spacing * cell.x(), 0, 0 } };
+			pivot.rotate(orientation);
+			_instancePivots[i] = add_node(row, pivot.matrix());
+			_instanceOrientations[i] = orientation.toRotationMatrix();
+			add_node(_instancePivots[i], Eigen::Affine3f{ Eigen::Translation3f{ -center } }.matrix());
+
+			const Eigen::Vector3f c = T * center;
+			std::copy(T.matrix().data(), T.matrix().data() + 16, instances[i].Transform);
+			instances[i].BoundingSphere[0] = c.x();
+			instances[i].BoundingSphere[1] = c.y();
+			instances[i].BoundingSphere[2] = c.z();
+			instances[i].BoundingSphere[3] = _boundingSphere.w();
+		}
+		_instanceFieldRadius = 0.5f * std::sqrt(3.0f) * spacing * side;
+
+		_assembly.build(parents);
+		for (uint32_t node = 0; node < parents.size(); node++)
+			_assembly.setLocal(node, locals[node]);
+		_assembly.update();
+		for (uint32_t i = 0; i < _nrInstances; i++)
+			_instanceTransforms.set(i, _assembly.world(_instancePivots[i] + 1));
+
+		updateOcclusionObjects();
+		updateBuffer(_instances, BufferUsage::Storage, instances.data(), instances.size() * sizeof(InstanceData));
+
+		BufferDescription visible_desc;
+		visible_desc.Usage = BufferUsage::Storage;
+		visible_desc.SizeInBytes = static_cast<uint32_t>(_nrInstances * sizeof(uint32_t));
+		_visibleInstanceIndices = std::make_unique<Buffer>(visible_desc);
+
+		// Transforms to view space, kept while the view does not change
+		BufferDescription transform_desc;
+		transform_desc.Usage = BufferUsage::Storage | BufferUsage::CopyDst;
+		transform_desc.SizeInBytes = static_cast<uint32_t>(_nrInstances * sizeof(InstanceTransform));
+		_instanceTransformBuffer = std::make_unique<Buffer>(transform_desc);
+
+		// Arguments of 'glDrawArraysIndirect'
+		BufferDescription command_desc;
+		command_desc.Usage = BufferUsage::Storage;
+		command_desc.SizeInBytes = 4 * sizeof(uint32_t);
+		_drawCommand = std::make_unique<Buffer>(command_desc);
+		_uploadRing->resetBindings();
+	}
+
+	//! Hand the instances and the occluder of the current mesh to the CPU culling
+	void updateOcclusionObjects()
+	{
+		// Boxes inside the finest level of detail serve as occluders. The
+		// simplified levels may bulge out of the mesh, they could hide
+		// visible instances.
+		if (!_innerBoxesBuilt)
+		{
+			const MeshLevel finest = _mesh.level(0);
+			buildInnerBoxes(_mesh.Positions, _mesh.Indices.data() + finest.FirstIndex, finest.NrIndices, _innerBoxPositions, _innerBoxIndices);
+			_innerBoxesBuilt = true;
+		}
+
+		OcclusionDetail::Matrix4fArray transforms(_nrInstances);
+		OcclusionDetail::Vector4fArray spheres(_nrInstances);
+		for (uint32_t i = 0; i < _nrInstances; i++)
+		{
+			transforms[i] = Eigen::Map<const Eigen::Matrix4f>(_instanceData[i].Transform);
+			spheres[i] = Eigen::Map<const Eigen::Vector4f>(_instanceData[i].BoundingSphere);
+		}
+		_occlusionCuller->setObjects(_innerBoxPositions, _innerBoxIndices, std::move(transforms), std::move(spheres));
+		_occlusionKicked = false;
+	}
+
+	//! Recompute the bounding spheres of the instances after the mesh changed
+	//! in place. The instance transforms and the layout are kept.
+	void refreshInstanceBounds()
+	{
+		using Vcl::Graphics::Runtime::BufferUsage;
+
+		if (_nrInstances == 0)
+			return;
+
+		const Eigen::Vector4f center{ _boundingSphere.x(), _boundingSphere.y(), _boundingSphere.z(), 1 };
+		for (auto& instance : _instanceData)
+		{
+			const Eigen::Vector4f c = Eigen::Map<const Eigen::Matrix4f>(instance.Transform) * center;
+			instance.BoundingSphere[0] = c.x();
+			instance.BoundingSphere[1] = c.y();
+			instance.BoundingSphere[2] = c.z();
+			instance.BoundingSphere[3] = _boundingSphere.w();
+		}
+
+		updateOcclusionObjects();
+		updateBuffer(_instances, BufferUsage::Storage, _instanceData.data(), _instanceData.size() * sizeof(InstanceData));
+	}
+
+	//! Point the camera at the mesh, or into the field of instances
+	void frameScene()
+	{
+		const Eigen::Vector3f center{ _boundingSphere.x(), _boundingSphere.y(), _boundingSphere.z() };
+		if (_instancing == Instancing::Off)
+			_camera->encloseInFrustum(center, { 0, -1, 1 }, std::max(_boundingSphere.w(), 1e-3f), { 0, 0, 1 });
+		else
+			_camera->encloseInFrustum({ 0, 0, 0 }, { 0, -1, 1 }, std::max(0.25f * _instanceFieldRadius, 1e-3f), { 0, 0, 1 });
+	}
+
+	//! Rebuild the torus after its parameters changed. The procedural path
+	//! does not use the mesh, it is rebuilt once another path is selected.
+	void updateTorus()
+	{
+		if (!_torusActive)
+			return;
+
+		if (_renderPath == RenderPath::ProceduralTorus)
+			_torusDirty = true;
+		else
+			rebuildTorus();
+	}
+
+	/*!
+	 * Generate the torus without levels of detail or reordering, the rings
+	 * are already in a cache friendly order. Unlike 'setMesh', only the
+	 * torus data is updated: the camera, the instance layout and the upload
+	 * ring are kept. If only the radii changed, the vertices are rewritten
+	 * in place, the indices and meshlets stay valid.
+	 */
+	void rebuildTorus()
+	{
+		const bool in_place = _torusMeshRings == _torusRings && _torusMeshSides == _torusSides;
+		cancelBvhBuild();
+
+		const auto start = std::chrono::steady_clock::now();
+		if (in_place)
+			writeTorusVertices(_mesh, _torusRadius0, _torusRadius1, _torusRings, _torusSides);
+		else
+			_mesh = createTorus(_torusRadius0, _torusRadius1, _torusRings, _torusSides);
+		_torusBuildTime = 1000.0 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-int main(int /* argc */, char ** /* argv */)
+		_torusDirty = false;
+		_torusMeshRings = _torusRings;
+		_torusMeshSides = _torusSides;
+		_optimizationStats = {};
+		_cacheStats = {};
+		_meshCache.reset();
+		_innerBoxesBuilt = false;
+
+		// The bounds are known without visiting the vertices
+		_bounds = torusBounds(_torusRadius0, _torusRadius1);
+		_quantizationError = measureQuantizationError(_mesh.Positions, _mesh.Normals, _bounds);
+		_boundingSphere = { _bounds.center().x(), _bounds.center().y(), _bounds.center().z(), 0.5f * _bounds.diagonal().norm() };
+
+		if (in_place)
+		{
+			const auto upload_start = std::chrono::steady_clock::now();
+			uploadVertices(_mesh);
+			if (_meshletsBuilt)
+			{
+				updateMeshletBounds(_mesh, _meshlets);
+				updateBuffer(_meshletBuffer, Vcl::Graphics::Runtime::BufferUsage::Storage, _meshlets.Meshlets.data(), _meshlets.Meshlets.size() * sizeof(Meshlet));
+			}
+			_uploadTime = 1000.0 * std::chrono::duration<double>(std::chrono::steady_clock::now() - upload_start).count();
+		}
+		else
+		{
+			_meshlets = MeshletData{};
+			_meshletsBuilt = false;
+			if (_renderPath == RenderPath::MeshletCulling)
+				partitionMeshlets();
+			uploadMesh(_mesh);
+
+			const MeshLevel finest = _mesh.level(0);
+			_vertexCacheStats = analyzeVertexCache(_mesh.Indices.data() + finest.FirstIndex, finest.NrIndices, _mesh.nrVertices());
+		}
+
+		refreshInstanceBounds();
+		startBvhBuild();
+	}
+
+	//! Coarsest level of detail with a projected error below the threshold
+	uint32_t selectLevel(const Application& app, const Eigen::Matrix4f& M) const
+	{
+		if (_lodPixelError <= 0)
+			return 0;
+
+		// Conservative distance to the bounding sphere of the object
+		const Eigen::Vector3f center = (M * Eigen::Vector4f{ _boundingSphere.x(), _boundingSphere.y(), _boundingSphere.z(), 1 }).head<3>();
+		const float distance = std::max((center - _camera->position()).norm() - _boundingSphere.w(), _camera->nearPlane());
+
+		// Pixels per object space unit at the given distance
+		const float scale = app.height() / (2 * std::tan(0.5f * _camera->fieldOfView()) * distance);
+
+		uint32_t selected = 0;
+		for (uint32_t l = 1; l < _mesh.nrLevels(); l++)
+		{
+			if (_mesh.level(l).Error * scale > _lodPixelError)
+				break;
+			selected = l;
+		}
+		return selected;
+	}
+
+	//! Map the cache in 'path' and decode the data used on the CPU. Returns
+	//! nullptr if there is no valid cache for 'key'.
+	std::unique_ptr<MeshCache::MappedMesh> readMeshCache(const std::string& path, uint64_t key, MeshData& mesh)
+	{
+		auto cache = MeshCache::MappedMesh::open(path, key);
+		if (cache && !cache->decode(mesh, &_cacheStats))
+		{
+			std::cerr << "Mesh cache '" << path << "' is corrupt, rebuilding it" << std::endl;
+			cache.reset();
+			mesh = MeshData{};
+		}
+		return cache;
+	}
+
+	void writeMeshCache(const std::string& path, uint64_t key, const MeshData& mesh)
+	{
+		_cacheStats = {};
+		if (!MeshCache::write(path, key, mesh, &_cacheStats))
+			std::cerr << "Could not write mesh cache '" << path << "'" << std::endl;
+	}
+
+	//! Replace the rendered mesh. 'cache' is the mapped mesh cache 'mesh'
+	//! was decoded from, its vertices are uploaded straight from the mapping.
+	void setMesh(MeshData mesh, std::unique_ptr<MeshCache::MappedMesh> cache = nullptr)
+	{
+		cancelBvhBuild();
+		_mesh = std::move(mesh);
+		_meshCache = std::move(cache);
+		_torusMeshRings = 0;
+		_torusMeshSides = 0;
+
+		// Meshlets are only built for the meshlet path, they dominate the
+		// preparation time of large meshes
+		_meshlets = MeshletData{};
+		_meshletsBuilt = false;
+		_innerBoxesBuilt = false;
+		if (_renderPath == RenderPath::MeshletCulling)
+			partitionMeshlets();
+
+		// Bounds of the geometry, also used to quantize the positions. Cached
+		// vertices keep the box they were quantized with, and the error
+		// measured against the vertices they were created from.
+		if (_meshCache)
+		{
+			_bounds = _meshCache->bounds();
+			_quantizationError = _meshCache->error();
+		}
+		else
+		{
+			_bounds.setEmpty();
+			for (const auto& p : _mesh.Positions)
+				_bounds.extend(p);
+			if (_bounds.isEmpty())
+				_bounds.extend(Eigen::Vector3f::Zero());
+			_quantizationError = measureQuantizationError(_mesh.Positions, _mesh.Normals, _bounds);
+		}
+
+		uploadMesh(_mesh);
+
+		// Efficiency of the stored triangle order, 16 entries approximate
+		// the post-transform cache of current GPUs
+		const MeshLevel finest = _mesh.level(0);
+		_vertexCacheStats = analyzeVertexCache(_mesh.Indices.data() + finest.FirstIndex, finest.NrIndices, _mesh.nrVertices());
+
+		// Frame the new geometry, the instances depend on its bounds
+		_boundingSphere = { _bounds.center().x(), _bounds.center().y(), _bounds.center().z(), 0.5f * _bounds.diagonal().norm() };
+		createInstances();
+		frameScene();
+		startBvhBuild();
+	}
+
+	//! Partition the levels into meshlets, reorders the triangles
+	void partitionMeshlets()
+	{
+		const auto meshlet_start = std::chrono::steady_clock::now();
+		_meshlets = buildMeshlets(_mesh);
+		_meshletBuildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - meshlet_start).count();
+		_meshletsBuilt = true;
+	}
+
+	//! Build the meshlets of the current mesh if they are missing
+	void ensureMeshlets()
+	{
+		if (_meshletsBuilt)
+			return;
+
+		// The triangles are reordered
+		cancelBvhBuild();
+		partitionMeshlets();
+		uploadMesh(_mesh);
+		startBvhBuild();
+
+		const MeshLevel finest = _mesh.level(0);
+		_vertexCacheStats = analyzeVertexCache(_mesh.Indices.data() + finest.FirstIndex, finest.NrIndices, _mesh.nrVertices());
+	}
+
+	/*!
+	 * Write 'size' bytes of 'data' to 'buffer'. The buffer is updated in place
+	 * if it is large enough, its previous content is invalidated first such
+	 * that the driver can orphan it instead of waiting for pending draws.
+	 * Otherwise a new buffer with room for growth is allocated.
+	 */
+	void updateBuffer
+	(
+		std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer>& buffer,
+		Vcl::Graphics::Runtime::BufferUsage usage,
+		const void* data, size_t size
+	)
+	{
+		using Vcl::Graphics::Runtime::OpenGL::Buffer;
+		using Vcl::Graphics::Runtime::BufferDescription;
+		using Vcl::Graphics::Runtime::BufferUsage;
+
+		if (size > 0xffffffffu)
+			throw std::runtime_error("Buffer exceeds 4 GB.");
+
+		if (buffer && size <= buffer->sizeInBytes())
+		{
+			glInvalidateBufferData(buffer->id());
+			_bufferUpdates++;
+		}
+		else
+		{
+			const size_t capacity = buffer ? std::max<size_t>(size, buffer->sizeInBytes() + buffer->sizeInBytes() / 2) : size;
+
+			BufferDescription desc;
+			desc.Usage = usage | BufferUsage::CopyDst;
+			desc.SizeInBytes = static_cast<uint32_t>(std::min<size_t>(std::max<size_t>(capacity, 4), 0xffffffffu));
+			buffer.reset();
+			buffer = std::make_unique<Buffer>(desc);
+			_bufferAllocations++;
+
+			// The name of the deleted buffer may be reused
+			if (_uploadRing)
+				_uploadRing->resetBindings();
+		}
+
+		if (size > 0)
+			glNamedBufferSubData(buffer->id(), 0, static_cast<GLsizeiptr>(size), data);
+	}
+
+	//! The indexed geometry shader path reads the normals from an
+	//! interleaved vertex buffer, otherwise it uses the positions of the
+	//! pulling paths
+	bool interleavedGeometry() const
+	{
+		return _vertexLayout == VertexLayout::PositionNormal && hasNormals();
+	}
+
+	//! Normals of a cached mesh stay in the mapping of '_meshCache'
+	bool hasNormals() const
+	{
+		return !_mesh.Normals.empty() || (_meshCache && _meshCache->hasNormals());
+	}
+
+	//! Indicate whether the current path draws from '_meshGeometry'
+	bool usesGeometryStream() const
+	{
+		return
+			_renderPath == RenderPath::GeometryShader ||
+			(_renderPath == RenderPath::GeometryShaderIndexed && interleavedGeometry());
+	}
+
+	//! Indicate whether '_meshGeometry' lacks the stream of the current path
+	bool geometryStreamStale() const
+	{
+		const bool indexed = _renderPath == RenderPath::GeometryShaderIndexed;
+		return usesGeometryStream() && (!_meshGeometryUploaded || _meshGeometryIndexed != indexed);
+	}
+
+	/*!
+	 * Vertex stream of the geometry shader paths. The de-indexed path gets
+	 * one vertex per index in the optimized triangle order, such that it
+	 * keeps the overdraw order, and only the streams requested by the vertex
+	 * layout. The indexed path gets interleaved positions and normals per
+	 * vertex, drawn with '_meshIndices' such that the transformed vertices
+	 * are reused. Cached vertices are read straight from the mapping.
+	 */
+	void uploadGeometryStream(const MeshData& mesh)
+	{
+		using Vcl::Graphics::Runtime::BufferUsage;
+
+		const bool indexed = _renderPath == RenderPath::GeometryShaderIndexed;
+		const bool with_normals = interleavedGeometry();
+		const size_t nr_vertices = indexed ? mesh.Positions.size() : mesh.Indices.size();
+		auto source = [&](size_t i)
+		{
+			return indexed ? static_cast<uint32_t>(i) : mesh.Indices[i];
+		};
+
+		if (_vertexFormat == VertexFormat::Quantized)
+		{
+			// Positions are padded to four components, which keeps the
+			// stream 4-byte aligned
+			const size_t nr_components = with_normals ? 6 : 4;
+			std::vector<uint16_t> vb(nr_components * nr_vertices);
+			parallelFor(0, nr_vertices, 16384, [&](size_t, size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					const uint32_t idx = source(i);
+					uint16_t* v = vb.data() + nr_components * i;
+					if (_meshCache)
+					{
+						_meshCache->position(idx, v);
+						if (with_normals)
+							_meshCache->normal(idx, reinterpret_cast<int16_t*>(v + 4));
+						continue;
+					}
+
+					const auto p = quantizePosition(mesh.Positions[idx], _bounds);
+					v[0] = p[0]; v[1] = p[1]; v[2] = p[2]; v[3] = 0;
+					if (with_normals)
+					{
+						const auto n = quantizeNormal(mesh.Normals[idx]);
+						v[4] = static_cast<uint16_t>(n[0]);
+						v[5] = static_cast<uint16_t>(n[1]);
+					}
+				}
+			});
+
+			updateBuffer(_meshGeometry, BufferUsage::Vertex, vb.data(), vb.size() * sizeof(uint16_t));
+			_meshGeometryStride = static_cast<uint32_t>(nr_components * sizeof(uint16_t));
+		}
+		else
+		{
+			const size_t nr_components = with_normals ? 6 : 3;
+			std::vector<float> vb(nr_components * nr_vertices);
+			parallelFor(0, nr_vertices, 16384, [&](size_t, size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					const uint32_t idx = source(i);
+					float* v = vb.data() + nr_components * i;
+					std::copy(mesh.Positions[idx].data(), mesh.Positions[idx].data() + 3, v);
+					if (!with_normals)
+						continue;
+
+					Eigen::Vector3f n;
+					if (_meshCache)
+					{
+						int16_t q[2];
+						_meshCache->normal(idx, q);
+						n = dequantizeNormal(q);
+					}
+					else
+					{
+						n = mesh.Normals[idx];
+					}
+					std::copy(n.data(), n.data() + 3, v + 3);
+				}
+			});
+
+			updateBuffer(_meshGeometry, BufferUsage::Vertex, vb.data(), vb.size() * sizeof(float));
+			_meshGeometryStride = static_cast<uint32_t>(nr_components * sizeof(float));
+		}
+		_meshGeometryUploaded = true;
+		_meshGeometryIndexed = indexed;
+	}
+
+	void uploadMesh(const MeshData& mesh)
+	{
+		using Vcl::Graphics::Runtime::BufferUsage;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		uploadVertices(mesh);
+
+		// Indices for the vertex pulling and the indexed geometry shader path
+		updateBuffer(_meshIndices, BufferUsage::Index | BufferUsage::Storage, mesh.Indices.data(), mesh.Indices.size() * sizeof(uint32_t));
+
+		// Meshlets, the compacted triangles of the largest level, and the
+		// indirect draw followed by the number of visible meshlets
+		const std::vector<uint32_t> visible_triangles(mesh.level(0).NrIndices / 3 + 1, 0);
+		const std::vector<uint32_t> meshlet_command(8, 0);
+		updateBuffer(_meshletBuffer, BufferUsage::Storage, _meshlets.Meshlets.data(), _meshlets.Meshlets.size() * sizeof(Meshlet));
+		updateBuffer(_visibleTriangles, BufferUsage::Storage, visible_triangles.data(), visible_triangles.size() * sizeof(uint32_t));
+		updateBuffer(_meshletCommand, BufferUsage::Storage, meshlet_command.data(), meshlet_command.size() * sizeof(uint32_t));
+
+		_uploadTime = 1000.0 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//! Upload the vertex data of 'mesh', the indices are left untouched
+	void uploadVertices(const MeshData& mesh)
+	{
+		using Vcl::Graphics::Runtime::BufferUsage;
+
+		// The stream is only kept for the geometry shader paths
+		if (usesGeometryStream())
+			uploadGeometryStream(mesh);
+		else
+			_meshGeometryUploaded = false;
+
+		if (_vertexFormat == VertexFormat::Quantized && _meshCache)
+		{
+			// Upload the vertices straight from the mapped mesh cache, the
+			// shaders dequantize them
+			updateBuffer(_meshPositions, BufferUsage::Vertex | BufferUsage::Storage, _meshCache->positions(), _meshCache->positionsSize());
+		}
+		else if (_vertexFormat == VertexFormat::Quantized)
+		{
+			std::vector<uint16_t> positions;
+			positions.reserve(4 * mesh.Positions.size());
+			for (const auto& pos : mesh.Positions)
+			{
+				const auto p = quantizePosition(pos, _bounds);
+				positions.insert(positions.end(), { p[0], p[1], p[2], 0 });
+			}
+			updateBuffer(_meshPositions, BufferUsage::Vertex | BufferUsage::Storage, positions.data(), positions.size() * sizeof(uint16_t));
+		}
+		else
+		{
+			updateBuffer(_meshPositions, BufferUsage::Vertex | BufferUsage::Storage, mesh.Positions.data(), mesh.Positions.size() * sizeof(Eigen::Vector3f));
+		}
+	}
+	
+private:
+	std::unique_ptr<Vcl::Graphics::Runtime::GraphicsEngine> _engine;
+
+	//! Per-frame constant data and instance transforms
+	std::unique_ptr<UploadRing> _uploadRing;
+
+	//! Space for the constants of a frame in '_uploadRing'
+	static const size_t ConstantsPerFrame = 1 << 20;
+
+	//! Largest number of instances, their transforms share '_uploadRing'
+	static const uint32_t MaxInstances = 100000;
+
+private:
+	std::unique_ptr<Vcl::Graphics::TrackballCameraController> _cameraController;
+
+private:
+	std::unique_ptr<Vcl::Graphics::Camera> _camera;
+
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _solidwireframePS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _solidwireframePosPS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _solidwireframePullPS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _solidwireframeQuantPS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _solidwireframeQuantPosPS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _solidwireframePullQuantPS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _solidwireframeInstPS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _solidwireframeInstQuantPS;
+
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _solidwireframeMeshletsPS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _solidwireframeMeshletsQuantPS;
+
+	//! Frustum culling of the instances
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::ShaderProgram> _cullInstancesProgram;
+
+	//! Back-face and frustum culling of the meshlets
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::ShaderProgram> _cullMeshletsProgram;
+
+	//! Rendering of the triangle IDs to the visibility buffer
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _visibilityPS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _visibilityQuantPS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _visibilityInstPS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _visibilityInstQuantPS;
+
+	//! Shading of the visibility buffer
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _resolvePS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _resolveQuantPS;
+
+	//! Torus generated in the vertex shader
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _proceduralTorusPS;
+
+	//! Highlight of the picked triangle
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _highlightPS;
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _highlightQuantPS;
+
+	//! Selected rendering technique
+	RenderPath _renderPath{ RenderPath::GeometryShader };
+
+	//! Streams read by the geometry shader path
+	VertexLayout _vertexLayout{ VertexLayout::Position };
+
+	//! Encoding of the uploaded vertex data
+	VertexFormat _vertexFormat{ VertexFormat::Float };
+
+	//! CPU copy of the mesh
+	MeshData _mesh;
+
+	//! Mapped mesh cache '_mesh' was read from, holds the quantized vertex
+	//! streams. Null if the mesh was not read from a cache.
+	std::unique_ptr<MeshCache::MappedMesh> _meshCache;
+
+	//! Performance of the last mesh import
+	MeshLoadStatistics _loadStats;
+
+	//! Size and performance of the mesh cache
+	MeshCache::Statistics _cacheStats;
+
+	//! Effect of the last mesh optimization
+	MeshOptimizationStatistics _optimizationStats;
+
+	//! Simulated vertex cache efficiency of the finest level of detail
+	VertexCacheStatistics _vertexCacheStats;
+
+	//! Vertices of the geometry shader paths, de-indexed (position,
+	//! optionally normal) or interleaved per vertex for the indexed draw
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer> _meshGeometry;
+
+	//! Stride of a vertex in '_meshGeometry'
+	uint32_t _meshGeometryStride;
+
+	//! Indicates that '_meshGeometry' holds the current mesh
+	bool _meshGeometryUploaded{ false };
+
+	//! Indicates that '_meshGeometry' holds the stream of the indexed path
+	bool _meshGeometryIndexed{ false };
+
+	//! Indexed vertex positions, float or quantized
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer> _meshPositions;
+
+	//! Triangle indices
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer> _meshIndices;
+
+	//! GPU time of the de-indexed geometry shader path
+	std::unique_ptr<GpuTimer> _gsTimer;
+
+	//! GPU time of the indexed geometry shader path
+	std::unique_ptr<GpuTimer> _gsIndexedTimer;
+
+	//! Vertex shader invocations of the indexed geometry shader path, measure
+	//! the reuse of the post-transform cache. Requires ARB_pipeline_statistics_query.
+	std::unique_ptr<GpuCounter> _gsInvocations;
+
+	//! GPU time of the vertex pulling path
+	std::unique_ptr<GpuTimer> _pullTimer;
+
+	//! GPU time of the instance culling
+	std::unique_ptr<GpuTimer> _cullTimer;
+
+	//! GPU time of the instanced draw
+	std::unique_ptr<GpuTimer> _instancedTimer;
+
+	//! Number of instances which passed the culling
+	std::unique_ptr<GpuReadback<1>> _visibleInstances;
+
+	//! Number of rendered copies of the mesh
+	Instancing _instancing{ Instancing::Off };
+
+	//! Method determining the visible instances
+	InstanceCulling _instanceCulling{ InstanceCulling::GpuFrustum };
+
+	//! CPU frustum and occlusion culling of the instances
+	std::unique_ptr<OcclusionCuller> _occlusionCuller;
+
+	//! Indicates that a culling job for the current instances and the camera
+	//! of this frame is in flight
+	bool _occlusionKicked{ false };
+
+	//! Conservative occluder of the mesh, boxes inside its finest level
+	std::vector<Eigen::Vector3f> _innerBoxPositions;
+	std::vector<uint32_t> _innerBoxIndices;
+
+	//! Indicates that the inner boxes belong to the current mesh
+	bool _innerBoxesBuilt{ false };
+
+	//! CPU copy of '_instances'
+	std::vector<InstanceData> _instanceData;
+
+	//! Instances which passed the CPU culling
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer> _cpuVisibleInstances;
+
+	//! Number of instances in '_instances'
+	uint32_t _nrInstances{ 0 };
+
+	//! Radius of the sphere enclosing all instances
+	float _instanceFieldRadius{ 0 };
+
+	//! Transforms and bounding spheres of the instances
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer> _instances;
+
+	//! Transforms of the instances for the computation to view space
+	TransformBatch _instanceTransforms;
+
+	//! Transforms of the instances to view space, read by the shaders
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer> _instanceTransformBuffer;
+
+	//! View and object transformation of '_instanceTransformBuffer'
+	Eigen::Matrix4f _instanceViewModel;
+
+	//! Indicates that '_instanceTransformBuffer' holds the current instances
+	bool _instanceTransformsValid{ false };
+
+	//! Scene graph placing the instances
+	TransformHierarchy _assembly;
+
+	//! Node of the assembly orienting each instance
+	std::vector<uint32_t> _instancePivots;
+
+	//! Random orientation of each instance
+	std::vector<Eigen::Matrix3f> _instanceOrientations;
+
+	//! Instances along each side of the assembly
+	uint32_t _assemblySide{ 0 };
+
+	//! Spin one slab of the assembly after the other
+	bool _animateAssembly{ false };
+	uint32_t _assemblyFrame{ 0 };
+	std::vector<float> _slabSpin;
+
+	//! Pointer-based against flat hierarchy updates
+	std::vector<HierarchyTiming> _hierarchyTimings;
+
+	//! CPU time of the last computation of the instance transforms in ms
+	double _transformTime{ 0 };
+
+	//! Batched against per-object transform computation
+	std::vector<TransformTiming> _transformTimings;
+
+	//! Indices of the instances which passed the culling
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer> _visibleInstanceIndices;
+
+	//! Indirect draw written by the culling
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer> _drawCommand;
+
+	//! Meshlets of all levels of detail
+	MeshletData _meshlets;
+
+	//! Time spent partitioning the mesh into meshlets
+	double _meshletBuildTime{ 0 };
+
+	//! Indicates that '_meshlets' belongs to the current mesh
+	bool _meshletsBuilt{ false };
+
+	//! Hierarchy over the finest level of detail used for picking
+	Bvh _bvh;
+
+	//! Indicates that '_bvh' is built for the current mesh and triangle order
+	bool _bvhValid{ false };
+
+	//! Build of '_bvh' in flight
+	std::future<void> _bvhBuild;
+
+	//! Requests the build of '_bvh' to stop
+	std::atomic<bool> _bvhCancel{ false };
+
+	//! Last picked triangle
+	RayHit _pick;
+
+	//! World position of the last pick
+	Eigen::Vector3f _pickPosition{ 0, 0, 0 };
+
+	//! Duration of the last pick query in microseconds
+	double _pickTime{ 0 };
+
+	//! Meshlet bounds and triangle ranges
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer> _meshletBuffer;
+
+	//! Triangles of the meshlets which passed the culling
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer> _visibleTriangles;
+
+	//! Indirect draw of the visible triangles, followed by the number of
+	//! visible meshlets
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Buffer> _meshletCommand;
+
+	//! GPU time of the meshlet culling
+	std::unique_ptr<GpuTimer> _meshletCullTimer;
+
+	//! GPU time of drawing the visible meshlets
+	std::unique_ptr<GpuTimer> _meshletTimer;
+
+	//! Draw command and counters of the meshlet culling
+	std::unique_ptr<GpuReadback<5>> _visibleMeshlets;
+
+	//! Triangle IDs of the visibility-buffer path
+	std::unique_ptr<VisibilityBuffer> _visibilityBuffer;
+
+	//! GPU time of rendering the triangle IDs
+	std::unique_ptr<GpuTimer> _visibilityTimer;
+
+	//! GPU time of shading the visibility buffer
+	std::unique_ptr<GpuTimer> _resolveTimer;
+
+	//! GPU time of drawing the procedural torus
+	std::unique_ptr<GpuTimer> _proceduralTimer;
+
+	//! Largest number of quads along either direction of the torus
+	static const int MaxTorusResolution = 4096;
+
+	//! Number of quads around the ring of the torus
+	int _torusRings{ 20 };
+
+	//! Number of quads around the tube of the torus
+	int _torusSides{ 20 };
+
+	//! Resolution of the torus in '_mesh', zero if '_mesh' is not a torus
+	//! generated by 'rebuildTorus'
+	int _torusMeshRings{ 0 };
+	int _torusMeshSides{ 0 };
+
+	//! Radius of the ring of the torus
+	float _torusRadius0{ 1.0f };
+
+	//! Radius of the tube of the torus
+	float _torusRadius1{ 0.4f };
+
+	//! The displayed mesh is the torus, not an imported mesh
+	bool _torusActive{ true };
+
+	//! The torus parameters changed while the procedural path was selected
+	bool _torusDirty{ false };
+
+	//! CPU time of the last torus generation in ms
+	double _torusBuildTime{ 0 };
+
+	//! CPU time of the last mesh upload in ms
+	double _uploadTime{ 0 };
+
+	//! Buffer updates which reused the existing buffer
+	uint32_t _bufferUpdates{ 0 };
+
+	//! Buffer updates which required a new buffer
+	uint32_t _bufferAllocations{ 0 };
+
+	//! Colour of the overlay
+	Colour3f _colour{ 0, 0, 0 };
+
+	//! Smoothness of the generated overlay
+	float _smoothing{ 1.0f };
+
+	//! Thickness of the lines
+	float _thickness{ 1.0f };
+
+	//! Bounding box of the mesh, frame of the quantized positions
+	Eigen::AlignedBox3f _bounds;
+
+	//! Largest error of the quantized vertex format
+	QuantizationError _quantizationError;
+
+	//! Bounding sphere of the mesh (center, radius)
+	Eigen::Vector4f _boundingSphere{ 0, 0, 0, 1 };
+
+	//! Maximum screen-space error of a level of detail in pixels
+	float _lodPixelError{ 1.0f };
+
+	//! Level of detail used in the last frame
+	uint32_t _currentLevel{ 0 };
+};
+
+VCL_RTTI_BASES(SolidWireframeExample, BaseScene)
+
+VCL_RTTI_CTOR_TABLE_BEGIN(SolidWireframeExample)
+	Vcl::RTTI::Constructor<SolidWireframeExample>()
+VCL_RTTI_CTOR_TABLE_END(SolidWireframeExample)
+
+VCL_RTTI_ATTR_TABLE_BEGIN(SolidWireframeExample)
+	Vcl::RTTI::Attribute<SolidWireframeExample, RenderPath>{"RenderPath", &SolidWireframeExample::renderPath, &SolidWireframeExample::setRenderPath},
+	Vcl::RTTI::Attribute<SolidWireframeExample, VertexLayout>{"VertexLayout", &SolidWireframeExample::vertexLayout, &SolidWireframeExample::setVertexLayout},
+	Vcl::RTTI::Attribute<SolidWireframeExample, VertexFormat>{"VertexFormat", &SolidWireframeExample::vertexFormat, &SolidWireframeExample::setVertexFormat},
+	Vcl::RTTI::Attribute<SolidWireframeExample, Instancing>{"Instancing", &SolidWireframeExample::instancing, &SolidWireframeExample::setInstancing},
+	Vcl::RTTI::Attribute<SolidWireframeExample, InstanceCulling>{"InstanceCulling", &SolidWireframeExample::instanceCulling, &SolidWireframeExample::setInstanceCulling},
+	Vcl::RTTI::Attribute<SolidWireframeExample, bool>{"AnimateAssembly", &SolidWireframeExample::animateAssembly, &SolidWireframeExample::setAnimateAssembly},
+	Vcl::RTTI::Attribute<SolidWireframeExample, Colour3f>{"Colour", &SolidWireframeExample::colour, &SolidWireframeExample::setColour},
+	Vcl::RTTI::Attribute<SolidWireframeExample, float>{"Smoothing", &SolidWireframeExample::smoothing, &SolidWireframeExample::setSmoothing},
+	Vcl::RTTI::Attribute<SolidWireframeExample, float>{"Thickness", &SolidWireframeExample::thickness, &SolidWireframeExample::setThickness},
+	Vcl::RTTI::Attribute<SolidWireframeExample, int>{"TorusRings", &SolidWireframeExample::torusRings, &SolidWireframeExample::setTorusRings},
+	Vcl::RTTI::Attribute<SolidWireframeExample, int>{"TorusSides", &SolidWireframeExample::torusSides, &SolidWireframeExample::setTorusSides},
+	Vcl::RTTI::Attribute<SolidWireframeExample, float>{"TorusRadius0", &SolidWireframeExample::torusRadius0, &SolidWireframeExample::setTorusRadius0},
+	Vcl::RTTI::Attribute<SolidWireframeExample, float>{"TorusRadius1", &SolidWireframeExample::torusRadius1, &SolidWireframeExample::setTorusRadius1},
+	Vcl::RTTI::Attribute<SolidWireframeExample, float>{"LodPixelError", &SolidWireframeExample::lodPixelError, &SolidWireframeExample::setLodPixelError}
+VCL_RTTI_ATTR_TABLE_END(SolidWireframeExample)
+
+VCL_DEFINE_METAOBJECT(SolidWireframeExample)
+{
+	VCL_RTTI_REGISTER_BASES(SolidWireframeExample);
+	VCL_RTTI_REGISTER_CTORS(SolidWireframeExample);
+	VCL_RTTI_REGISTER_ATTRS(SolidWireframeExample);
+}
+
+int main(int argc, char** argv)
 {
 	Application app{ "VCL Solid Wireframe Example", 768, 768 };
 
 	// Demo content
 	SolidWireframeExample scene;
+	if (argc > 1)
+	{
+		try
+		{
+			scene.importMesh(argv[1]);
+		}
+		catch (const std::exception& e)
+		{
+			// The scene keeps showing the torus
+			std::cerr << "Could not import '" << argv[1] << "': " << e.what() << std::endl;
+		}
+	}
 	app.setMouseButtonCallback([&scene](Application& app, int button, int action, int mods) {scene.onMouseButton(app, button, action, mods); });
 	app.setMouseMoveCallback([&scene](Application& app, double xpos, double ypos) {scene.onMouseMove(app, xpos, ypos); });
 	app.setSceneDrawCallback([&scene](Application& app) {scene.draw(app); });
@@ -0,0 +1,78 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/eigen.h>
+
+// C++ standard library
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+//! Range of the index buffer forming one level of detail
+struct MeshLevel
+{
+	//! First index of the level
+	uint32_t FirstIndex;
+
+	//! Number of indices of the level
+	uint32_t NrIndices;
+
+	//! Geometric error of the level in object space units
+	float Error;
+};
+
+/*!
+ * Indexed triangle mesh stored in the layout used by the GPU. Positions and
+ * normals are tightly packed, such that they can be uploaded without copies.
+ */
+struct MeshData
+{
+	//! Vertex positions
+	std::vector<Eigen::Vector3f> Positions;
+
+	//! Vertex normals (optional)
+	std::vector<Eigen::Vector3f> Normals;
+
+	//! Three vertex indices per triangle
+	std::vector<uint32_t> Indices;
+
+	//! Levels of detail stored in 'Indices', finest first. If empty, the
+	//! whole index buffer forms a single level.
+	std::vector<MeshLevel> Levels;
+
+	uint32_t nrVertices() const { return static_cast<uint32_t>(Positions.size()); }
+	uint32_t nrFaces() const { return static_cast<uint32_t>(Indices.size() / 3); }
+	uint32_t nrLevels() const { return std::max<uint32_t>(1, static_cast<uint32_t>(Levels.size())); }
+
+	//! Index range of the level 'l'
+	MeshLevel level(uint32_t l) const
+	{
+		if (Levels.empty())
+			return { 0, static_cast<uint32_t>(Indices.size()), 0.0f };
+		return Levels[std::min<size_t>(l, Levels.size() - 1)];
+	}
+};
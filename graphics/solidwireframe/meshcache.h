@@ -0,0 +1,602 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "../filecache.h"
+#include "../mappedfile.h"
+#include "../parallel.h"
+#include "mesh.h"
+#include "quantization.h"
+
+/*!
+ * Binary cache of an imported mesh.
+ *
+ * Layout (all values little endian):
+ *  - MeshCacheHeader
+ *  - Positions, 4 x uint16 per vertex, relative to the bounding box. The
+ *    fourth component is padding, matching the quantized vertex buffers.
+ *  - Normals, 2 x int16 per vertex (octahedral), if present
+ *  - Levels of detail, 'MeshLevel' entries
+ *  - Index block table, byte offset of each block into the index data
+ *  - Index data, blocks of 'IndicesPerBlock' indices. The first corner of a
+ *    triangle is predicted by the first corner of the previous triangle, the
+ *    other two corners by the first corner of their triangle. Differences
+ *    are zig-zag encoded and written as variable length (LEB128) bytes.
+ *    These bytes are entropy coded with an order-0 rANS coder, each block
+ *    starts with its symbol frequencies. Blocks are decoded in parallel.
+ *
+ * The vertex streams are stored in the layout of the quantized vertex
+ * buffers, such that they are uploaded straight from the mapped file.
+ * Triangles and vertices are stored in the order produced by 'optimizeMesh'.
+ * Caches of older versions are rebuilt.
+ */
+namespace MeshCache
+{
+	const uint32_t Magic = 0x3143564d; // 'MVC1'
+	const uint32_t Version = 5;
+	const uint32_t IndicesPerBlock = 3 * 16384;
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t SourceKey;
+		uint32_t NrVertices;
+		uint32_t NrIndices;
+		uint32_t HasNormals;
+		uint32_t NrIndexBlocks;
+		uint32_t NrLevels;
+		float BoundsMin[3];
+		float BoundsMax[3];
+
+		//! Quantization error measured against the source vertices
+		float PositionError;
+		float PositionErrorBound;
+		float NormalErrorDegrees;
+
+		uint64_t IndexDataSize;
+	};
+
+	//! Performance figures of a cache access
+	struct Statistics
+	{
+		//! Size of the cache file in bytes
+		size_t FileSize{ 0 };
+
+		//! Size of the uncompressed float/uint32 arrays in bytes
+		size_t RawSize{ 0 };
+
+		//! Time to decode the cache in seconds
+		double Seconds{ 0 };
+	};
+
+	//! 64-bit FNV-1a hash
+	inline uint64_t hash(const void* data, size_t size, uint64_t h = 0xcbf29ce484222325ull)
+	{
+		const auto* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			h ^= bytes[i];
+			h *= 0x100000001b3ull;
+		}
+		return h;
+	}
+
+	//! Key identifying the content of a source file, a hash of all its bytes
+	inline uint64_t sourceKey(const std::string& path)
+	{
+		return FileCache::hashFile(path) ^ hash(&Version, sizeof(Version));
+	}
+
+	//! Location of the cache with 'key' in the cache directory of the user
+	inline std::string path(uint64_t key)
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "/%016llx.meshcache", static_cast<unsigned long long>(key));
+		return FileCache::directory("meshcache") + name;
+	}
+
+	inline uint32_t zigzag(int32_t v) { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+	inline int32_t unzigzag(uint32_t v) { return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1); }
+
+	/*!
+	 * Order-0 rANS coder of bytes with 12-bit frequencies and a 32-bit state.
+	 * Duda, Asymmetric numeral systems, 2013, in the byte-wise formulation of
+	 * Giesen, Interleaved entropy coders, 2014.
+	 */
+	namespace Rans
+	{
+		const uint32_t ScaleBits = 12;
+		const uint32_t Scale = 1u << ScaleBits;
+		const uint32_t Lower = 1u << 23;
+
+		//! Symbol frequencies summing up to 'Scale', stored in front of the data
+		using Frequencies = std::array<uint16_t, 256>;
+
+		inline Frequencies normalize(const std::array<uint32_t, 256>& histogram)
+		{
+			uint64_t total = 0;
+			for (uint32_t count : histogram)
+				total += count;
+
+			// Symbols which occur keep a frequency of at least one
+			Frequencies freqs{};
+			uint32_t sum = 0;
+			for (size_t s = 0; s < 256; s++)
+			{
+				if (histogram[s] == 0)
+					continue;
+				freqs[s] = static_cast<uint16_t>(std::max<uint64_t>(1, histogram[s] * Scale / total));
+				sum += freqs[s];
+			}
+
+			// Correct the rounding at the most frequent symbols
+			while (sum != Scale)
+			{
+				size_t largest = 0;
+				for (size_t s = 1; s < 256; s++)
+					if (freqs[s] > freqs[largest])
+						largest = s;
+				if (sum < Scale)
+				{
+					freqs[largest] += static_cast<uint16_t>(Scale - sum);
+					sum = Scale;
+				}
+				else
+				{
+					const uint32_t step = std::min<uint32_t>(sum - Scale, freqs[largest] - 1u);
+					freqs[largest] -= static_cast<uint16_t>(step);
+					sum -= step;
+				}
+			}
+			return freqs;
+		}
+
+		//! Append the frequencies and the coded 'data' to 'out'
+		inline void encode(const std::vector<uint8_t>& data, std::vector<uint8_t>& out)
+		{
+			std::array<uint32_t, 256> histogram{};
+			for (uint8_t b : data)
+				histogram[b]++;
+			const Frequencies freqs = normalize(histogram);
+			std::array<uint32_t, 256> starts{};
+			for (size_t s = 1; s < 256; s++)
+				starts[s] = starts[s - 1] + freqs[s - 1];
+
+			// The coder works backwards, the bytes are reversed at the end
+			std::vector<uint8_t> coded;
+			coded.reserve(data.size() + 4);
+			uint32_t x = Lower;
+			for (size_t i = data.size(); i-- > 0;)
+			{
+				const uint32_t freq = freqs[data[i]];
+				const uint32_t x_max = ((Lower >> ScaleBits) << 8) * freq;
+				while (x >= x_max)
+				{
+					coded.push_back(static_cast<uint8_t>(x & 0xff));
+					x >>= 8;
+				}
+				x = ((x / freq) << ScaleBits) + (x % freq) + starts[data[i]];
+			}
+			for (int shift = 24; shift >= 0; shift -= 8)
+				coded.push_back(static_cast<uint8_t>(x >> shift));
+			std::reverse(coded.begin(), coded.end());
+
+			const auto* table = reinterpret_cast<const uint8_t*>(freqs.data());
+			out.insert(out.end(), table, table + sizeof(Frequencies));
+			out.insert(out.end(), coded.begin(), coded.end());
+		}
+
+		//! Decodes the bytes coded by 'encode'
+		class Decoder
+		{
+		public:
+			//! Returns false if [p, end) is too short to hold a coded block
+			bool init(const uint8_t* p, const uint8_t* end)
+			{
+				if (static_cast<size_t>(end - p) < sizeof(Frequencies) + 4)
+					return false;
+
+				Frequencies freqs;
+				std::memcpy(freqs.data(), p, sizeof(Frequencies));
+				uint32_t start = 0;
+				for (size_t s = 0; s < 256; s++)
+				{
+					if (start + freqs[s] > Scale)
+						return false;
+					_freqs[s] = freqs[s];
+					_starts[s] = start;
+					std::fill(_symbols.begin() + start, _symbols.begin() + start + freqs[s], static_cast<uint8_t>(s));
+					start += freqs[s];
+				}
+				if (start != Scale)
+					return false;
+
+				_p = p + sizeof(Frequencies);
+				_end = end;
+				_x = 0;
+				for (int b = 0; b < 4; b++)
+					_x |= static_cast<uint32_t>(*(_p++)) << (8 * b);
+				return true;
+			}
+
+			//! Decode the next byte, returns false if the data is exhausted
+			bool next(uint8_t& value)
+			{
+				const uint32_t slot = _x & (Scale - 1);
+				value = _symbols[slot];
+				_x = _freqs[value] * (_x >> ScaleBits) + slot - _starts[value];
+				while (_x < Lower)
+				{
+					if (_p == _end)
+						return false;
+					_x = (_x << 8) | *(_p++);
+				}
+				return true;
+			}
+
+		private:
+			std::array<uint32_t, 256> _freqs;
+			std::array<uint32_t, 256> _starts;
+			std::array<uint8_t, Scale> _symbols;
+			const uint8_t* _p{ nullptr };
+			const uint8_t* _end{ nullptr };
+			uint32_t _x{ 0 };
+		};
+	}
+
+	//! Write the mesh to 'path' via a temporary file, returns false on I/O errors
+	inline bool write(const std::string& path, uint64_t key, const MeshData& mesh, Statistics* stats = nullptr)
+	{
+		Eigen::AlignedBox3f bounds;
+		for (const auto& p : mesh.Positions)
+			bounds.extend(p);
+		if (bounds.isEmpty())
+			bounds.extend(Eigen::Vector3f::Zero());
+
+		const bool has_normals = mesh.Normals.size() == mesh.Positions.size() && !mesh.Normals.empty();
+		std::vector<uint16_t> positions(4 * mesh.Positions.size());
+		std::vector<int16_t> normals(has_normals ? 2 * mesh.Normals.size() : 0);
+		parallelFor(0, mesh.Positions.size(), 1 << 16, [&](size_t, size_t b, size_t e)
+		{
+			for (size_t v = b; v < e; v++)
+			{
+				const auto q = quantizePosition(mesh.Positions[v], bounds);
+				std::copy(q.begin(), q.end(), positions.begin() + 4 * v);
+				positions[4 * v + 3] = 0;
+				if (has_normals)
+				{
+					const auto n = quantizeNormal(mesh.Normals[v]);
+					std::copy(n.begin(), n.end(), normals.begin() + 2 * v);
+				}
+			}
+		});
+		const QuantizationError error = measureQuantizationError(mesh.Positions, has_normals ? mesh.Normals : std::vector<Eigen::Vector3f>{}, bounds);
+
+		// Encode the index blocks independently, then concatenate them
+		const size_t nr_blocks = (mesh.Indices.size() + IndicesPerBlock - 1) / IndicesPerBlock;
+		std::vector<std::vector<uint8_t>> blocks(nr_blocks);
+		parallelFor(0, nr_blocks, 1, [&](size_t, size_t b, size_t e)
+		{
+			for (size_t blk = b; blk < e; blk++)
+			{
+				const size_t first = blk * IndicesPerBlock;
+				const size_t last = std::min(mesh.Indices.size(), first + IndicesPerBlock);
+
+				std::vector<uint8_t> bytes;
+				bytes.reserve(2 * (last - first));
+				uint32_t prev = 0;
+				for (size_t i = first; i < last; i++)
+				{
+					const uint32_t pred = prev;
+					if (i % 3 == 0)
+						prev = mesh.Indices[i];
+
+					uint32_t v = zigzag(static_cast<int32_t>(mesh.Indices[i] - pred));
+					while (v >= 0x80)
+					{
+						bytes.push_back(static_cast<uint8_t>(v | 0x80));
+						v >>= 7;
+					}
+					bytes.push_back(static_cast<uint8_t>(v));
+				}
+				Rans::encode(bytes, blocks[blk]);
+			}
+		});
+
+		std::vector<uint64_t> block_offsets(nr_blocks);
+		uint64_t index_data_size = 0;
+		for (size_t blk = 0; blk < nr_blocks; blk++)
+		{
+			block_offsets[blk] = index_data_size;
+			index_data_size += blocks[blk].size();
+		}
+
+		Header header{};
+		header.Magic = Magic;
+		header.Version = Version;
+		header.SourceKey = key;
+		header.NrVertices = mesh.nrVertices();
+		header.NrIndices = static_cast<uint32_t>(mesh.Indices.size());
+		header.HasNormals = has_normals ? 1 : 0;
+		header.NrIndexBlocks = static_cast<uint32_t>(nr_blocks);
+		header.NrLevels = static_cast<uint32_t>(mesh.Levels.size());
+		std::copy(bounds.min().data(), bounds.min().data() + 3, header.BoundsMin);
+		std::copy(bounds.max().data(), bounds.max().data() + 3, header.BoundsMax);
+		header.PositionError = error.Position;
+		header.PositionErrorBound = error.PositionBound;
+		header.NormalErrorDegrees = error.NormalDegrees;
+		header.IndexDataSize = index_data_size;
+
+		const std::string tmp = FileCache::temporaryPath(path);
+		std::ofstream file{ tmp, std::ios::binary | std::ios::trunc };
+		if (!file)
+			return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(positions.data()), positions.size() * sizeof(uint16_t));
+		file.write(reinterpret_cast<const char*>(normals.data()), normals.size() * sizeof(int16_t));
+		file.write(reinterpret_cast<const char*>(mesh.Levels.data()), mesh.Levels.size() * sizeof(MeshLevel));
+		file.write(reinterpret_cast<const char*>(block_offsets.data()), block_offsets.size() * sizeof(uint64_t));
+		for (const auto& block : blocks)
+			file.write(reinterpret_cast<const char*>(block.data()), block.size());
+
+		const auto file_size = static_cast<size_t>(file.tellp());
+		file.close();
+		if (!file)
+		{
+			std::remove(tmp.c_str());
+			return false;
+		}
+		if (!FileCache::replace(tmp, path))
+			return false;
+
+		if (stats)
+		{
+			stats->FileSize = file_size;
+			stats->RawSize = mesh.Positions.size() * sizeof(Eigen::Vector3f) + (has_normals ? mesh.Normals.size() * sizeof(Eigen::Vector3f) : 0) + mesh.Indices.size() * sizeof(uint32_t);
+		}
+
+		return true;
+	}
+
+	/*!
+	 * Mapped cache file. The quantized vertex streams are read in place, the
+	 * mapping lives as long as the vertices are needed.
+	 */
+	class MappedMesh
+	{
+	public:
+		//! Map the cache in 'path', throws if the file is not a valid cache
+		explicit MappedMesh(const std::string& path)
+		: _file{ path }
+		{
+			if (_file.size() < sizeof(Header))
+				throw std::runtime_error("Invalid mesh cache: " + path);
+			std::memcpy(&_header, _file.data(), sizeof(Header));
+			if (_header.Magic != Magic || _header.Version != Version)
+				throw std::runtime_error("Invalid mesh cache: " + path);
+
+			_positionsSize = 4 * sizeof(uint16_t) * _header.NrVertices;
+			_normalsSize = _header.HasNormals ? 2 * sizeof(int16_t) * _header.NrVertices : 0;
+			const size_t levels_size = sizeof(MeshLevel) * _header.NrLevels;
+			const size_t table_size = sizeof(uint64_t) * _header.NrIndexBlocks;
+			const uint64_t expected_size = sizeof(Header) + _positionsSize + _normalsSize + levels_size + table_size + _header.IndexDataSize;
+			if (_file.size() != expected_size || _header.NrIndexBlocks != (_header.NrIndices + IndicesPerBlock - 1) / IndicesPerBlock)
+				throw std::runtime_error("Invalid mesh cache: " + path);
+
+			_bounds =
+			{
+				Eigen::Vector3f{ _header.BoundsMin[0], _header.BoundsMin[1], _header.BoundsMin[2] },
+				Eigen::Vector3f{ _header.BoundsMax[0], _header.BoundsMax[1], _header.BoundsMax[2] }
+			};
+		}
+
+		MappedMesh(const MappedMesh&) = delete;
+		MappedMesh& operator=(const MappedMesh&) = delete;
+
+		/*!
+		 * Map the cache in 'path' if it exists and was created with 'key'.
+		 * Returns nullptr otherwise, also for damaged files, which are
+		 * rebuilt by the caller.
+		 */
+		static std::unique_ptr<MappedMesh> open(const std::string& path, uint64_t key)
+		{
+			struct stat st;
+			if (stat(path.c_str(), &st) != 0)
+				return nullptr;
+
+			try
+			{
+				auto cache = std::make_unique<MappedMesh>(path);
+				if (cache->_header.SourceKey != key)
+					return nullptr;
+				return cache;
+			}
+			catch (const std::runtime_error&)
+			{
+				return nullptr;
+			}
+		}
+
+		uint32_t nrVertices() const { return _header.NrVertices; }
+		bool hasNormals() const { return _header.HasNormals != 0; }
+
+		//! Box the positions are relative to
+		const Eigen::AlignedBox3f& bounds() const { return _bounds; }
+
+		//! Error of the stored vertices against the vertices they were created from
+		QuantizationError error() const
+		{
+			QuantizationError error;
+			error.Position = _header.PositionError;
+			error.PositionBound = _header.PositionErrorBound;
+			error.NormalDegrees = _header.NormalErrorDegrees;
+			return error;
+		}
+
+		//! Quantized positions in the mapping, 4 x uint16 per vertex
+		const void* positions() const { return _file.data() + sizeof(Header); }
+		size_t positionsSize() const { return _positionsSize; }
+
+		//! Octahedral normals in the mapping, 2 x int16 per vertex
+		const void* normals() const { return _file.data() + sizeof(Header) + _positionsSize; }
+		size_t normalsSize() const { return _normalsSize; }
+
+		//! Quantized position of vertex 'v', including the padding
+		void position(size_t v, uint16_t* q) const
+		{
+			std::memcpy(q, static_cast<const char*>(positions()) + 4 * sizeof(uint16_t) * v, 4 * sizeof(uint16_t));
+		}
+
+		//! Quantized normal of vertex 'v'
+		void normal(size_t v, int16_t* q) const
+		{
+			std::memcpy(q, static_cast<const char*>(normals()) + 2 * sizeof(int16_t) * v, 2 * sizeof(int16_t));
+		}
+
+		/*!
+		 * Decode the levels and the indices into 'mesh'. The positions are
+		 * dequantized for the CPU side, e.g. picking and culling. The
+		 * normals are only read from the mapping. Returns false if the
+		 * index data is corrupt.
+		 */
+		bool decode(MeshData& mesh, Statistics* stats = nullptr) const
+		{
+			const auto start = std::chrono::steady_clock::now();
+
+			const size_t levels_size = sizeof(MeshLevel) * _header.NrLevels;
+			const char* levels = static_cast<const char*>(normals()) + _normalsSize;
+			const char* table = levels + levels_size;
+			const uint8_t* index_data = reinterpret_cast<const uint8_t*>(table + sizeof(uint64_t) * _header.NrIndexBlocks);
+
+			mesh.Positions.resize(_header.NrVertices);
+			mesh.Normals.clear();
+			mesh.Indices.resize(_header.NrIndices);
+			mesh.Levels.resize(_header.NrLevels);
+			if (levels_size > 0)
+				std::memcpy(mesh.Levels.data(), levels, levels_size);
+			for (const auto& level : mesh.Levels)
+				if (static_cast<uint64_t>(level.FirstIndex) + level.NrIndices > _header.NrIndices)
+					return false;
+
+			parallelFor(0, _header.NrVertices, 1 << 16, [&](size_t, size_t b, size_t e)
+			{
+				for (size_t v = b; v < e; v++)
+				{
+					uint16_t q[4];
+					position(v, q);
+					mesh.Positions[v] = dequantizePosition(q, _bounds);
+				}
+			});
+
+			std::atomic<bool> corrupt{ false };
+			parallelFor(0, _header.NrIndexBlocks, 1, [&](size_t, size_t b, size_t e)
+			{
+				for (size_t blk = b; blk < e; blk++)
+				{
+					uint64_t offset, next;
+					std::memcpy(&offset, table + blk * sizeof(uint64_t), sizeof(uint64_t));
+					next = _header.IndexDataSize;
+					if (blk + 1 < _header.NrIndexBlocks)
+						std::memcpy(&next, table + (blk + 1) * sizeof(uint64_t), sizeof(uint64_t));
+
+					Rans::Decoder decoder;
+					if (offset > next || next > _header.IndexDataSize || !decoder.init(index_data + offset, index_data + next))
+					{
+						corrupt = true;
+						return;
+					}
+
+					const size_t first = blk * IndicesPerBlock;
+					const size_t last = std::min<size_t>(_header.NrIndices, first + IndicesPerBlock);
+					uint32_t prev = 0;
+					for (size_t i = first; i < last; i++)
+					{
+						uint32_t v = 0;
+						int shift = 0;
+						uint8_t byte;
+						do
+						{
+							if (shift > 28 || !decoder.next(byte))
+							{
+								corrupt = true;
+								return;
+							}
+							v |= static_cast<uint32_t>(byte & 0x7f) << shift;
+							shift += 7;
+						} while (byte & 0x80);
+
+						const uint32_t idx = prev + static_cast<uint32_t>(unzigzag(v));
+						if (idx >= _header.NrVertices)
+						{
+							corrupt = true;
+							return;
+						}
+						if (i % 3 == 0)
+							prev = idx;
+						mesh.Indices[i] = idx;
+					}
+				}
+			});
+			if (corrupt)
+				return false;
+
+			if (stats)
+			{
+				stats->FileSize = _file.size();
+				stats->RawSize = (hasNormals() ? 2 : 1) * mesh.Positions.size() * sizeof(Eigen::Vector3f) + mesh.Indices.size() * sizeof(uint32_t);
+				stats->Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+
+			return true;
+		}
+
+	private:
+		MappedFile _file;
+		Header _header;
+		Eigen::AlignedBox3f _bounds;
+
+		//! Sizes of the vertex streams in bytes
+		size_t _positionsSize{ 0 };
+		size_t _normalsSize{ 0 };
+	};
+}
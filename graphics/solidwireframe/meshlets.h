@@ -0,0 +1,340 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/eigen.h>
+
+// C++ standard library
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../parallel.h"
+#include "mesh.h"
+#include "meshoptimization.h"
+
+//! Cluster of consecutive triangles of the index buffer, matches 'Meshlet'
+//! in meshlets.glsl
+struct Meshlet
+{
+	//! Sphere (center, radius) enclosing the vertices of the meshlet
+	float BoundingSphere[4];
+
+	//! Average normal of the triangles
+	float ConeAxis[3];
+
+	//! Cosine of the largest angle between the axis and a triangle normal,
+	//! negative if the normals spread over more than a hemisphere
+	float ConeCosAngle;
+
+	//! First triangle in the index buffer
+	uint32_t FirstTriangle;
+
+	//! Number of triangles
+	uint32_t NrTriangles;
+
+	//! Number of distinct vertices
+	uint32_t NrVertices;
+
+	uint32_t Padding;
+};
+
+//! Meshlets of one level of detail
+struct MeshletRange
+{
+	uint32_t FirstMeshlet;
+	uint32_t NrMeshlets;
+};
+
+//! Meshlets of all levels of detail of a mesh
+struct MeshletData
+{
+	//! Upper bounds of a meshlet, chosen to fit mesh shader limits
+	static const uint32_t MaxVertices = 64;
+	static const uint32_t MaxTriangles = 124;
+
+	std::vector<Meshlet> Meshlets;
+
+	//! Meshlets of the level of detail 'l'
+	std::vector<MeshletRange> Levels;
+};
+
+namespace MeshletDetail
+{
+	inline void computeBounds(const MeshData& mesh, const std::vector<uint32_t>& vertices, Meshlet& meshlet)
+	{
+		// Sphere around the center of the bounding box
+		Eigen::AlignedBox3f box;
+		for (const auto v : vertices)
+			box.extend(mesh.Positions[v]);
+
+		const Eigen::Vector3f center = box.center();
+		float radius = 0;
+		for (const auto v : vertices)
+			radius = std::max(radius, (mesh.Positions[v] - center).norm());
+
+		meshlet.BoundingSphere[0] = center.x();
+		meshlet.BoundingSphere[1] = center.y();
+		meshlet.BoundingSphere[2] = center.z();
+		meshlet.BoundingSphere[3] = radius;
+
+		// Cone containing all triangle normals
+		const uint32_t* indices = mesh.Indices.data() + 3 * meshlet.FirstTriangle;
+		std::vector<Eigen::Vector3f> normals;
+		normals.reserve(meshlet.NrTriangles);
+		Eigen::Vector3f axis = Eigen::Vector3f::Zero();
+		for (uint32_t t = 0; t < meshlet.NrTriangles; t++)
+		{
+			const Eigen::Vector3f& p0 = mesh.Positions[indices[3*t + 0]];
+			const Eigen::Vector3f& p1 = mesh.Positions[indices[3*t + 1]];
+			const Eigen::Vector3f& p2 = mesh.Positions[indices[3*t + 2]];
+			const Eigen::Vector3f n = (p1 - p0).cross(p2 - p0);
+			if (n.squaredNorm() == 0)
+				continue;
+
+			normals.emplace_back(n.normalized());
+			axis += normals.back();
+		}
+
+		float cos_angle = -1;
+		if (axis.squaredNorm() > 0)
+		{
+			axis.normalize();
+			cos_angle = 1;
+			for (const auto& n : normals)
+				cos_angle = std::min(cos_angle, axis.dot(n));
+		}
+
+		meshlet.ConeAxis[0] = axis.x();
+		meshlet.ConeAxis[1] = axis.y();
+		meshlet.ConeAxis[2] = axis.z();
+		meshlet.ConeCosAngle = cos_angle;
+	}
+}
+
+/*!
+ * Partition the index buffer of each level of detail into meshlets of at
+ * most 'MaxVertices' vertices and 'MaxTriangles' triangles, and reorder the
+ * triangles such that each meshlet is a consecutive range. Meshlets grow
+ * over shared vertices, preferring triangles which add few vertices, lie
+ * close to the meshlet and face in its direction, which keeps the normal
+ * cones tight. Seeds follow the existing triangle order. The triangles of
+ * each meshlet are then reordered for the post-transform vertex cache, such
+ * that the partitioning keeps most of the gain of 'optimizeVertexCache'.
+ */
+inline MeshletData buildMeshlets(MeshData& mesh)
+{
+	using MeshOptimizationDetail::Adjacency;
+
+	MeshletData data;
+	data.Levels.reserve(mesh.nrLevels());
+
+	// Meshlet which referenced a vertex last
+	std::vector<uint32_t> owner(mesh.nrVertices(), ~0u);
+	std::vector<uint32_t> vertices;
+	vertices.reserve(MeshletData::MaxVertices);
+
+	for (uint32_t l = 0; l < mesh.nrLevels(); l++)
+	{
+		const MeshLevel level = mesh.level(l);
+		const uint32_t first_triangle = level.FirstIndex / 3;
+		const uint32_t nr_triangles = level.NrIndices / 3;
+		const uint32_t* indices = mesh.Indices.data() + level.FirstIndex;
+
+		Adjacency adjacency{ indices, level.NrIndices, mesh.nrVertices() };
+		std::vector<Eigen::Vector3f> centroids(nr_triangles);
+		std::vector<Eigen::Vector3f> normals(nr_triangles);
+		for (uint32_t t = 0; t < nr_triangles; t++)
+		{
+			const Eigen::Vector3f& p0 = mesh.Positions[indices[3*t + 0]];
+			const Eigen::Vector3f& p1 = mesh.Positions[indices[3*t + 1]];
+			const Eigen::Vector3f& p2 = mesh.Positions[indices[3*t + 2]];
+			centroids[t] = (p0 + p1 + p2) / 3.0f;
+			normals[t] = (p1 - p0).cross(p2 - p0).normalized();
+			if (!normals[t].allFinite())
+				normals[t].setZero();
+		}
+
+		std::vector<bool> emitted(nr_triangles, false);
+		std::vector<uint32_t> order;
+		order.reserve(nr_triangles);
+
+		// Number of triangles per vertex not assigned to a meshlet
+		std::vector<uint32_t>& live = adjacency.Counts;
+
+		MeshletRange range = { static_cast<uint32_t>(data.Meshlets.size()), 0 };
+		uint32_t next_seed = 0;
+		uint32_t seed = 0;
+		while (order.size() < nr_triangles)
+		{
+			// Continue at the border of the previous meshlet, preferring
+			// triangles with few remaining neighbours to avoid islands. Fall
+			// back to the next triangle in index order.
+			if (seed == ~0u)
+			{
+				while (emitted[next_seed])
+					next_seed++;
+				seed = next_seed;
+			}
+
+			const uint32_t id = static_cast<uint32_t>(data.Meshlets.size());
+			Meshlet meshlet = {};
+			meshlet.FirstTriangle = first_triangle + static_cast<uint32_t>(order.size());
+			Eigen::Vector3f center_sum = Eigen::Vector3f::Zero();
+			Eigen::Vector3f normal_sum = Eigen::Vector3f::Zero();
+
+			uint32_t next = seed;
+			while (next != ~0u)
+			{
+				// Add the triangle to the meshlet
+				emitted[next] = true;
+				live[indices[3*next + 0]]--;
+				live[indices[3*next + 1]]--;
+				live[indices[3*next + 2]]--;
+				order.push_back(next);
+				meshlet.NrTriangles++;
+				center_sum += centroids[next];
+				normal_sum += normals[next];
+				for (int k = 0; k < 3; k++)
+				{
+					const uint32_t v = indices[3*next + k];
+					if (owner[v] != id)
+					{
+						owner[v] = id;
+						vertices.push_back(v);
+					}
+				}
+				if (meshlet.NrTriangles == MeshletData::MaxTriangles)
+					break;
+
+				// Find the best triangle sharing a vertex with the meshlet
+				const Eigen::Vector3f center = center_sum / float(meshlet.NrTriangles);
+				const Eigen::Vector3f axis = normal_sum.normalized();
+				const size_t free_vertices = MeshletData::MaxVertices - vertices.size();
+				uint32_t best_extra = 3;
+				float best_score = std::numeric_limits<float>::max();
+				next = ~0u;
+				for (const auto v : vertices)
+				{
+					for (uint32_t j = adjacency.Offsets[v]; j < adjacency.Offsets[v + 1]; j++)
+					{
+						const uint32_t t = adjacency.Triangles[j];
+						if (emitted[t])
+							continue;
+
+						const uint32_t* tri = indices + 3*t;
+						const uint32_t extra = (owner[tri[0]] != id) + (owner[tri[1]] != id) + (owner[tri[2]] != id);
+						if (extra > free_vertices || extra > best_extra)
+							continue;
+
+						const float score = (centroids[t] - center).norm() * (2 - normals[t].dot(axis));
+						if (extra < best_extra || score < best_score)
+						{
+							best_extra = extra;
+							best_score = score;
+							next = t;
+						}
+					}
+				}
+			}
+
+			seed = ~0u;
+			uint32_t best_live = std::numeric_limits<uint32_t>::max();
+			for (const auto v : vertices)
+			{
+				for (uint32_t j = adjacency.Offsets[v]; j < adjacency.Offsets[v + 1]; j++)
+				{
+					const uint32_t t = adjacency.Triangles[j];
+					const uint32_t* tri = indices + 3*t;
+					const uint32_t nr_live = live[tri[0]] + live[tri[1]] + live[tri[2]];
+					if (!emitted[t] && nr_live < best_live)
+					{
+						best_live = nr_live;
+						seed = t;
+					}
+				}
+			}
+
+			meshlet.NrVertices = static_cast<uint32_t>(vertices.size());
+			vertices.clear();
+			data.Meshlets.push_back(meshlet);
+			range.NrMeshlets++;
+		}
+		data.Levels.push_back(range);
+
+		// Store the triangles in meshlet order
+		std::vector<uint32_t> reordered;
+		reordered.reserve(level.NrIndices);
+		for (const auto t : order)
+			reordered.insert(reordered.end(), indices + 3*t, indices + 3*t + 3);
+		std::copy(reordered.begin(), reordered.end(), mesh.Indices.begin() + level.FirstIndex);
+
+		// Bounds and vertex cache order of the meshlets of the level. The
+		// cache optimization runs on meshlet-local vertex indices, which
+		// keeps its per-vertex arrays small.
+		std::vector<uint32_t> local;
+		for (uint32_t m = range.FirstMeshlet; m < range.FirstMeshlet + range.NrMeshlets; m++)
+		{
+			Meshlet& meshlet = data.Meshlets[m];
+			uint32_t* tris = mesh.Indices.data() + 3 * meshlet.FirstTriangle;
+			vertices.assign(tris, tris + 3 * meshlet.NrTriangles);
+			std::sort(vertices.begin(), vertices.end());
+			vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+			MeshletDetail::computeBounds(mesh, vertices, meshlet);
+
+			local.resize(3 * meshlet.NrTriangles);
+			for (size_t i = 0; i < local.size(); i++)
+				local[i] = static_cast<uint32_t>(std::lower_bound(vertices.begin(), vertices.end(), tris[i]) - vertices.begin());
+			optimizeVertexCache(local.data(), local.size(), vertices.size());
+			for (size_t i = 0; i < local.size(); i++)
+				tris[i] = vertices[local[i]];
+		}
+		vertices.clear();
+	}
+
+	return data;
+}
+
+//! Recompute the bounding spheres and normal cones of the meshlets after the
+//! vertices of 'mesh' moved. The partitioning and triangle order are kept.
+inline void updateMeshletBounds(const MeshData& mesh, MeshletData& data)
+{
+	parallelFor(0, data.Meshlets.size(), 256, [&](size_t, size_t b, size_t e)
+	{
+		std::vector<uint32_t> vertices;
+		for (size_t m = b; m < e; m++)
+		{
+			Meshlet& meshlet = data.Meshlets[m];
+			const uint32_t* tris = mesh.Indices.data() + 3 * meshlet.FirstTriangle;
+			vertices.assign(tris, tris + 3 * meshlet.NrTriangles);
+			std::sort(vertices.begin(), vertices.end());
+			vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+			MeshletDetail::computeBounds(mesh, vertices, meshlet);
+		}
+	});
+}
@@ -0,0 +1,687 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#	include <psapi.h>
+#else
+#	include <sys/resource.h>
+#endif
+
+#include "../mappedfile.h"
+#include "../parallel.h"
+#include "mesh.h"
+
+//! Performance figures of a mesh import
+struct MeshLoadStatistics
+{
+	//! Size of the parsed file in bytes
+	size_t FileSize{ 0 };
+
+	//! Wall-clock parse time in seconds
+	double Seconds{ 0 };
+
+	//! Peak resident memory of the process after the import in bytes
+	size_t PeakMemory{ 0 };
+
+	//! Parse throughput in MB/s
+	double throughput() const { return Seconds > 0 ? FileSize / (1024.0 * 1024.0) / Seconds : 0; }
+};
+
+//! Peak resident set size of the current process in bytes
+inline size_t peakMemoryUsage()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#	ifdef __APPLE__
+	return static_cast<size_t>(usage.ru_maxrss);
+#	else
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#	endif
+#endif
+}
+
+namespace MeshLoaderDetail
+{
+	inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+	inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+	inline const char* skipSpace(const char* p, const char* end)
+	{
+		while (p < end && isSpace(*p))
+			++p;
+		return p;
+	}
+
+	inline const char* skipToken(const char* p, const char* end)
+	{
+		while (p < end && !isSpace(*p) && *p != '\n')
+			++p;
+		return p;
+	}
+
+	//! Locale independent float parser working on non-terminated ranges
+	inline const char* parseFloat(const char* p, const char* end, float& value)
+	{
+		static const double powers[] =
+		{
+			1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		p = skipSpace(p, end);
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *(p++) == '-';
+
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		int digits = 0;
+		for (; p < end && isDigit(*p); ++p)
+		{
+			if (digits < 19)
+			{
+				mantissa = 10 * mantissa + (*p - '0');
+				digits += mantissa > 0 ? 1 : 0;
+			}
+			else
+				exponent++;
+		}
+		if (p < end && *p == '.')
+		{
+			for (++p; p < end && isDigit(*p); ++p)
+			{
+				if (digits < 19)
+				{
+					mantissa = 10 * mantissa + (*p - '0');
+					digits += mantissa > 0 ? 1 : 0;
+					exponent--;
+				}
+			}
+		}
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			++p;
+			bool negative_exp = false;
+			if (p < end && (*p == '-' || *p == '+'))
+				negative_exp = *(p++) == '-';
+
+			int e = 0;
+			for (; p < end && isDigit(*p); ++p)
+				e = std::min(10 * e + (*p - '0'), 1000);
+			exponent += negative_exp ? -e : e;
+		}
+
+		double v = static_cast<double>(mantissa);
+		if (exponent < 0)
+			v = -exponent <= 22 ? v / powers[-exponent] : v * std::pow(10.0, exponent);
+		else if (exponent > 0)
+			v = exponent <= 22 ? v * powers[exponent] : v * std::pow(10.0, exponent);
+
+		value = static_cast<float>(negative ? -v : v);
+		return p;
+	}
+
+	//! Parse the vertex index of a face corner ('v', 'v/vt', 'v//vn' or 'v/vt/vn')
+	inline const char* parseIndex(const char* p, const char* end, int64_t& value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *(p++) == '-';
+
+		int64_t v = 0;
+		for (; p < end && isDigit(*p); ++p)
+			v = 10 * v + (*p - '0');
+		value = negative ? -v : v;
+
+		// Skip texture coordinate and normal indices
+		return skipToken(p, end);
+	}
+
+	//! Invoke 'func(line_begin, line_end)' for each line, the end excludes comments
+	template<typename Func>
+	void forEachLine(const char* begin, const char* end, Func&& func)
+	{
+		const char* p = begin;
+		while (p < end)
+		{
+			const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+			if (!eol)
+				eol = end;
+
+			const char* comment = static_cast<const char*>(std::memchr(p, '#', eol - p));
+			func(skipSpace(p, eol), comment ? comment : eol);
+			p = eol + 1;
+		}
+	}
+
+	inline bool isVertexLine(const char* p, const char* eol)
+	{
+		return eol - p > 1 && p[0] == 'v' && isSpace(p[1]);
+	}
+
+	inline bool isFaceLine(const char* p, const char* eol)
+	{
+		return eol - p > 1 && p[0] == 'f' && isSpace(p[1]);
+	}
+
+	//! Meshes are addressed with 32-bit vertex indices and index counts
+	inline void checkMeshSize(size_t nr_vertices, size_t nr_indices, const std::string& path)
+	{
+		if (nr_vertices > 0xffffffffu || nr_indices > 0xffffffffu)
+			throw std::runtime_error("Mesh exceeds the 32-bit index range: " + path);
+	}
+
+	//! Number of corners of a face line
+	inline uint32_t countCorners(const char* p, const char* eol)
+	{
+		uint32_t corners = 0;
+		p = skipSpace(p + 1, eol);
+		while (p < eol)
+		{
+			corners++;
+			p = skipSpace(skipToken(p, eol), eol);
+		}
+		return corners;
+	}
+}
+
+/*!
+ * Load a Wavefront OBJ file. Only vertex positions and faces are read,
+ * polygons are triangulated as fans. The file is memory mapped and split
+ * into line-aligned chunks, which are counted and then parsed in parallel
+ * directly into the output arrays.
+ */
+inline MeshData loadObj(const std::string& path, MeshLoadStatistics* stats = nullptr)
+{
+	using namespace MeshLoaderDetail;
+
+	const auto start = std::chrono::steady_clock::now();
+	MappedFile file{ path };
+	const char* const data = file.data();
+	const size_t size = file.size();
+
+	// Split the file into chunks aligned to line starts
+	const size_t min_chunk_size = 1 << 20;
+	const size_t nr_chunks = std::max<size_t>(1, std::min<size_t>(4 * hardwareThreads(), size / min_chunk_size));
+	std::vector<const char*> bounds(nr_chunks + 1, data + size);
+	bounds[0] = data;
+	for (size_t c = 1; c < nr_chunks; c++)
+	{
+		const char* p = std::max(bounds[c - 1], data + c * (size / nr_chunks));
+		const char* eol = static_cast<const char*>(std::memchr(p, '\n', data + size - p));
+		bounds[c] = eol ? eol + 1 : data + size;
+	}
+
+	// Count the vertices and triangles per chunk
+	std::vector<size_t> nr_vertices(nr_chunks + 1, 0);
+	std::vector<size_t> nr_triangles(nr_chunks + 1, 0);
+	parallelFor(0, nr_chunks, 1, [&](size_t, size_t b, size_t e)
+	{
+		for (size_t c = b; c < e; c++)
+		{
+			forEachLine(bounds[c], bounds[c + 1], [&](const char* p, const char* eol)
+			{
+				if (isVertexLine(p, eol))
+					nr_vertices[c + 1]++;
+				else if (isFaceLine(p, eol))
+					nr_triangles[c + 1] += std::max(countCorners(p, eol), 2u) - 2;
+			});
+		}
+	});
+	for (size_t c = 0; c < nr_chunks; c++)
+	{
+		nr_vertices[c + 1] += nr_vertices[c];
+		nr_triangles[c + 1] += nr_triangles[c];
+	}
+
+	checkMeshSize(nr_vertices.back(), 3 * nr_triangles.back(), path);
+
+	MeshData mesh;
+	mesh.Positions.resize(nr_vertices.back());
+	mesh.Indices.resize(3 * nr_triangles.back());
+
+	// Parse the chunks into their slice of the output
+	std::atomic<bool> invalid_index{ false };
+	parallelFor(0, nr_chunks, 1, [&](size_t, size_t b, size_t e)
+	{
+		for (size_t c = b; c < e; c++)
+		{
+			size_t v = nr_vertices[c];
+			uint32_t* idx = mesh.Indices.data() + 3 * nr_triangles[c];
+			forEachLine(bounds[c], bounds[c + 1], [&](const char* p, const char* eol)
+			{
+				if (isVertexLine(p, eol))
+				{
+					auto& pos = mesh.Positions[v++];
+					p = parseFloat(p + 1, eol, pos.x());
+					p = parseFloat(p, eol, pos.y());
+					p = parseFloat(p, eol, pos.z());
+				}
+				else if (isFaceLine(p, eol))
+				{
+					uint32_t corner = 0;
+					uint32_t first = 0;
+					uint32_t prev = 0;
+					p = skipSpace(p + 1, eol);
+					while (p < eol)
+					{
+						int64_t i;
+						p = skipSpace(parseIndex(p, eol, i), eol);
+
+						// Resolve one-based and relative indices, zero is invalid
+						const bool zero = i == 0;
+						i = i > 0 ? i - 1 : static_cast<int64_t>(v) + i;
+						if (zero || i < 0 || i >= static_cast<int64_t>(mesh.Positions.size()))
+						{
+							invalid_index = true;
+							i = 0;
+						}
+
+						const uint32_t curr = static_cast<uint32_t>(i);
+						if (corner == 0)
+							first = curr;
+						else if (corner >= 2)
+						{
+							*(idx++) = first;
+							*(idx++) = prev;
+							*(idx++) = curr;
+						}
+						prev = curr;
+						corner++;
+					}
+				}
+			});
+		}
+	});
+	if (invalid_index)
+		throw std::runtime_error("Invalid vertex index in OBJ file: " + path);
+
+	if (stats)
+	{
+		stats->FileSize = size;
+		stats->Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		stats->PeakMemory = peakMemoryUsage();
+	}
+
+	return mesh;
+}
+
+namespace MeshLoaderDetail
+{
+	struct PlyProperty
+	{
+		std::string Name;
+		size_t Size{ 0 };
+		bool IsFloat{ false };
+		bool IsList{ false };
+		size_t CountSize{ 0 };
+	};
+
+	struct PlyElement
+	{
+		std::string Name;
+		size_t Count{ 0 };
+		std::vector<PlyProperty> Properties;
+
+		//! Size of a record, zero if the element contains lists
+		size_t stride() const
+		{
+			size_t s = 0;
+			for (const auto& prop : Properties)
+			{
+				if (prop.IsList)
+					return 0;
+				s += prop.Size;
+			}
+			return s;
+		}
+	};
+
+	inline size_t plyTypeSize(const std::string& type, bool* is_float = nullptr)
+	{
+		if (is_float)
+			*is_float = type == "float" || type == "float32" || type == "double" || type == "float64";
+
+		if (type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+			return 1;
+		if (type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+			return 2;
+		if (type == "int" || type == "uint" || type == "int32" || type == "uint32" || type == "float" || type == "float32")
+			return 4;
+		if (type == "double" || type == "float64")
+			return 8;
+		throw std::runtime_error("Unsupported PLY property type: " + type);
+	}
+
+	//! Read an unsigned integer of 'size' bytes (little endian)
+	inline uint32_t readUInt(const char* p, size_t size)
+	{
+		switch (size)
+		{
+		case 1: { uint8_t v;  std::memcpy(&v, p, 1); return v; }
+		case 2: { uint16_t v; std::memcpy(&v, p, 2); return v; }
+		default: { uint32_t v; std::memcpy(&v, p, 4); return v; }
+		}
+	}
+
+	//! Whether 'count' records of 'stride' bytes fit into 'available' bytes
+	inline bool fitsInto(size_t count, size_t stride, size_t available)
+	{
+		return stride == 0 || count <= available / stride;
+	}
+
+	inline float readFloat(const char* p, size_t size)
+	{
+		if (size == 8)
+		{
+			double v;
+			std::memcpy(&v, p, 8);
+			return static_cast<float>(v);
+		}
+		float v;
+		std::memcpy(&v, p, 4);
+		return v;
+	}
+}
+
+/*!
+ * Load a binary little-endian PLY file. Only the vertex positions and the
+ * vertex index lists of the faces are read, polygons are triangulated as
+ * fans. Vertices are decoded in parallel; pure triangle meshes, which have
+ * fixed-size face records, are decoded in parallel as well.
+ */
+inline MeshData loadPly(const std::string& path, MeshLoadStatistics* stats = nullptr)
+{
+	using namespace MeshLoaderDetail;
+
+	const auto start = std::chrono::steady_clock::now();
+	MappedFile file{ path };
+	const char* const data = file.data();
+	const char* const end = data + file.size();
+
+	// Parse the header
+	std::vector<PlyElement> elements;
+	const char* p = data;
+	bool little_endian = false;
+	while (true)
+	{
+		const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+		if (!eol)
+			throw std::runtime_error("Invalid PLY header: " + path);
+
+		std::vector<std::string> tokens;
+		for (const char* t = skipSpace(p, eol); t < eol; t = skipSpace(t, eol))
+		{
+			const char* t_end = skipToken(t, eol);
+			tokens.emplace_back(t, t_end);
+			t = t_end;
+		}
+		p = eol + 1;
+
+		if (tokens.empty())
+			continue;
+		if (tokens[0] == "end_header")
+			break;
+		if (tokens[0] == "format" && tokens.size() > 1)
+			little_endian = tokens[1] == "binary_little_endian";
+		else if (tokens[0] == "element" && tokens.size() > 2)
+		{
+			elements.emplace_back();
+			elements.back().Name = tokens[1];
+			elements.back().Count = std::stoull(tokens[2]);
+		}
+		else if (tokens[0] == "property" && !elements.empty())
+		{
+			PlyProperty prop;
+			if (tokens.size() > 4 && tokens[1] == "list")
+			{
+				prop.IsList = true;
+				prop.CountSize = plyTypeSize(tokens[2]);
+				prop.Size = plyTypeSize(tokens[3], &prop.IsFloat);
+				prop.Name = tokens[4];
+			}
+			else if (tokens.size() > 2)
+			{
+				prop.Size = plyTypeSize(tokens[1], &prop.IsFloat);
+				prop.Name = tokens[2];
+			}
+			elements.back().Properties.push_back(prop);
+		}
+	}
+	if (!little_endian)
+		throw std::runtime_error("Only binary little-endian PLY files are supported: " + path);
+
+	MeshData mesh;
+	bool truncated = false;
+	std::atomic<bool> invalid_index{ false };
+	for (const auto& element : elements)
+	{
+		const size_t stride = element.stride();
+		if (element.Name == "vertex")
+		{
+			if (stride == 0)
+				throw std::runtime_error("PLY vertices must not contain lists: " + path);
+
+			// Locate the position components
+			size_t offsets[3] = { 0, 0, 0 };
+			size_t sizes[3] = { 0, 0, 0 };
+			size_t offset = 0;
+			for (const auto& prop : element.Properties)
+			{
+				const int c = prop.Name == "x" ? 0 : (prop.Name == "y" ? 1 : (prop.Name == "z" ? 2 : -1));
+				if (c >= 0 && prop.IsFloat)
+				{
+					offsets[c] = offset;
+					sizes[c] = prop.Size;
+				}
+				offset += prop.Size;
+			}
+			if (sizes[0] == 0 || sizes[1] == 0 || sizes[2] == 0)
+				throw std::runtime_error("PLY vertices require floating point x, y, z: " + path);
+			if (!fitsInto(element.Count, stride, end - p))
+			{
+				truncated = true;
+				break;
+			}
+			checkMeshSize(element.Count, 0, path);
+
+			mesh.Positions.resize(element.Count);
+			const char* base = p;
+			parallelFor(0, element.Count, 1 << 16, [&](size_t, size_t b, size_t e)
+			{
+				for (size_t v = b; v < e; v++)
+				{
+					const char* record = base + v * stride;
+					mesh.Positions[v] = Eigen::Vector3f
+					{
+						readFloat(record + offsets[0], sizes[0]),
+						readFloat(record + offsets[1], sizes[1]),
+						readFloat(record + offsets[2], sizes[2])
+					};
+				}
+			});
+			p += element.Count * stride;
+		}
+		else if (element.Name == "face")
+		{
+			const auto& props = element.Properties;
+			const auto list = std::find_if(props.begin(), props.end(), [](const PlyProperty& prop)
+			{
+				return prop.IsList && (prop.Name == "vertex_indices" || prop.Name == "vertex_index");
+			});
+			if (list == props.end())
+				throw std::runtime_error("PLY faces require a vertex index list: " + path);
+
+			const size_t nr_vertices = mesh.Positions.size();
+			const auto store = [&](uint32_t* idx, uint32_t i)
+			{
+				if (i >= nr_vertices)
+				{
+					invalid_index = true;
+					i = 0;
+				}
+				*idx = i;
+			};
+
+			// Fast path, triangles stored in fixed-size records
+			const size_t tri_stride = list->CountSize + 3 * list->Size;
+			bool all_triangles = props.size() == 1 && fitsInto(element.Count, tri_stride, end - p);
+			if (all_triangles)
+			{
+				std::atomic<bool> non_triangle{ false };
+				parallelFor(0, element.Count, 1 << 16, [&](size_t, size_t b, size_t e)
+				{
+					for (size_t f = b; f < e && !non_triangle; f++)
+						if (readUInt(p + f * tri_stride, list->CountSize) != 3)
+							non_triangle = true;
+				});
+				all_triangles = !non_triangle;
+			}
+
+			if (all_triangles)
+			{
+				checkMeshSize(nr_vertices, 3 * element.Count, path);
+				mesh.Indices.resize(3 * element.Count);
+				const char* base = p + list->CountSize;
+				parallelFor(0, element.Count, 1 << 16, [&](size_t, size_t b, size_t e)
+				{
+					for (size_t f = b; f < e; f++)
+					{
+						const char* record = base + f * tri_stride;
+						store(&mesh.Indices[3 * f + 0], readUInt(record + 0 * list->Size, list->Size));
+						store(&mesh.Indices[3 * f + 1], readUInt(record + 1 * list->Size, list->Size));
+						store(&mesh.Indices[3 * f + 2], readUInt(record + 2 * list->Size, list->Size));
+					}
+				});
+				p += element.Count * tri_stride;
+			}
+			else
+			{
+				// General polygons, records need to be visited in order. Each
+				// record holds at least its count, which bounds the reservation.
+				const size_t max_faces = (end - p) / std::max<size_t>(list->CountSize, 1);
+				mesh.Indices.reserve(3 * std::min(element.Count, max_faces));
+				for (size_t f = 0; f < element.Count && !truncated; f++)
+				{
+					for (const auto& prop : props)
+					{
+						if (prop.IsList && static_cast<size_t>(end - p) < prop.CountSize)
+						{
+							truncated = true;
+							break;
+						}
+
+						const size_t count = prop.IsList ? readUInt(p, prop.CountSize) : 1;
+						const size_t header = prop.IsList ? prop.CountSize : 0;
+						if (!fitsInto(count, prop.Size, end - p - header))
+						{
+							truncated = true;
+							break;
+						}
+						const size_t bytes = header + count * prop.Size;
+
+						if (&prop == &*list)
+						{
+							const char* values = p + prop.CountSize;
+							const uint32_t first = readUInt(values, prop.Size);
+							checkMeshSize(nr_vertices, mesh.Indices.size() + 3 * (std::max<size_t>(count, 2) - 2), path);
+							for (size_t c = 2; c < count; c++)
+							{
+								const size_t base = mesh.Indices.size();
+								mesh.Indices.resize(base + 3);
+								store(&mesh.Indices[base + 0], first);
+								store(&mesh.Indices[base + 1], readUInt(values + (c - 1) * prop.Size, prop.Size));
+								store(&mesh.Indices[base + 2], readUInt(values + c * prop.Size, prop.Size));
+							}
+						}
+						p += bytes;
+					}
+				}
+			}
+		}
+		else
+		{
+			// Skip elements which are not of interest
+			if (stride == 0)
+				throw std::runtime_error("Unsupported PLY element: " + element.Name);
+			if (!fitsInto(element.Count, stride, end - p))
+			{
+				truncated = true;
+				break;
+			}
+			p += element.Count * stride;
+		}
+
+		if (truncated)
+			break;
+	}
+	if (truncated)
+		throw std::runtime_error("Truncated PLY file: " + path);
+	if (invalid_index)
+		throw std::runtime_error("Invalid vertex index in PLY file: " + path);
+
+	if (stats)
+	{
+		stats->FileSize = file.size();
+		stats->Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		stats->PeakMemory = peakMemoryUsage();
+	}
+
+	return mesh;
+}
+
+//! Load a mesh, the format is selected by the file extension
+inline MeshData loadMesh(const std::string& path, MeshLoadStatistics* stats = nullptr)
+{
+	const auto dot = path.find_last_of('.');
+	std::string ext = dot != std::string::npos ? path.substr(dot + 1) : "";
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+
+	if (ext == "obj")
+		return loadObj(path, stats);
+	if (ext == "ply")
+		return loadPly(path, stats);
+	throw std::runtime_error("Unsupported mesh format: " + path);
+}
@@ -0,0 +1,463 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/eigen.h>
+
+// C++ standard library
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "../parallel.h"
+#include "mesh.h"
+
+//! Efficiency of an index sequence for a FIFO post-transform vertex cache
+struct VertexCacheStatistics
+{
+	//! Average number of transformed vertices per triangle (0.5 - 3)
+	float Acmr{ 0 };
+
+	//! Average number of transformations per referenced vertex (1 - 6)
+	float Atvr{ 0 };
+};
+
+//! Effect of 'optimizeMesh' on the finest level of detail
+struct MeshOptimizationStatistics
+{
+	VertexCacheStatistics CacheBefore;
+	VertexCacheStatistics CacheAfter;
+
+	//! Bytes loaded through a 64-byte line cache per byte of vertex data
+	float OverfetchBefore{ 0 };
+	float OverfetchAfter{ 0 };
+
+	//! Time spent in 'optimizeMesh'
+	double Seconds{ 0 };
+};
+
+namespace MeshOptimizationDetail
+{
+	//! Size of the cache modelled by the Forsyth ordering
+	const uint32_t MaxCacheSize = 32;
+
+	//! Score of a vertex with cache position 'pos' and 'remaining' triangles
+	inline float vertexScore(int pos, uint32_t remaining)
+	{
+		if (remaining == 0)
+			return -1.0f;
+
+		float score = 0;
+		if (pos >= 0)
+		{
+			// The last triangle's vertices are penalized to avoid strips
+			// bouncing back and forth
+			if (pos < 3)
+				score = 0.75f;
+			else
+				score = std::pow(1.0f - float(pos - 3) / float(MaxCacheSize - 3), 1.5f);
+		}
+
+		// Prefer vertices with few remaining triangles to avoid leaving
+		// isolated triangles behind
+		return score + 2.0f / std::sqrt(float(remaining));
+	}
+
+	//! Triangle adjacency of the vertices referenced by an index range
+	struct Adjacency
+	{
+		Adjacency(const uint32_t* indices, size_t nr_indices, size_t nr_vertices)
+		: Offsets(nr_vertices + 1, 0)
+		, Counts(nr_vertices, 0)
+		{
+			for (size_t i = 0; i < nr_indices; i++)
+				Counts[indices[i]]++;
+			for (size_t v = 0; v < nr_vertices; v++)
+				Offsets[v + 1] = Offsets[v] + Counts[v];
+
+			Triangles.resize(nr_indices);
+			std::vector<uint32_t> fill(Offsets.begin(), Offsets.end() - 1);
+			for (size_t i = 0; i < nr_indices; i++)
+				Triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<uint32_t> Offsets;
+		std::vector<uint32_t> Counts;
+		std::vector<uint32_t> Triangles;
+	};
+
+	//! Number of vertex transformations of a FIFO cache for each triangle
+	inline void simulateFifo
+	(
+		const uint32_t* indices, size_t nr_indices, size_t nr_vertices, uint32_t cache_size,
+		std::vector<uint8_t>& misses
+	)
+	{
+		std::vector<uint32_t> timestamps(nr_vertices, 0);
+		uint32_t time = cache_size + 1;
+
+		misses.assign(nr_indices / 3, 0);
+		for (size_t i = 0; i < nr_indices; i++)
+		{
+			const uint32_t v = indices[i];
+			if (time - timestamps[v] > cache_size)
+			{
+				timestamps[v] = time++;
+				misses[i / 3]++;
+			}
+		}
+	}
+}
+
+//! Simulate a FIFO post-transform cache of 'cache_size' entries
+inline VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t nr_indices, size_t nr_vertices, uint32_t cache_size = 16)
+{
+	VertexCacheStatistics stats;
+	if (nr_indices < 3)
+		return stats;
+
+	std::vector<uint8_t> misses;
+	MeshOptimizationDetail::simulateFifo(indices, nr_indices, nr_vertices, cache_size, misses);
+
+	std::vector<bool> referenced(nr_vertices, false);
+	size_t nr_referenced = 0;
+	for (size_t i = 0; i < nr_indices; i++)
+	{
+		if (!referenced[indices[i]])
+		{
+			referenced[indices[i]] = true;
+			nr_referenced++;
+		}
+	}
+
+	const size_t nr_transformed = std::accumulate(misses.begin(), misses.end(), size_t{ 0 });
+	stats.Acmr = float(nr_transformed) / float(nr_indices / 3);
+	stats.Atvr = float(nr_transformed) / float(nr_referenced);
+	return stats;
+}
+
+//! Ratio of bytes loaded through a direct-mapped cache of 64 lines of 64
+//! bytes to the size of the referenced vertex data
+inline float analyzeVertexFetch(const uint32_t* indices, size_t nr_indices, size_t nr_vertices, size_t vertex_size)
+{
+	const size_t LineSize = 64;
+	const size_t NrLines = 64;
+
+	std::vector<size_t> lines(NrLines, ~size_t{ 0 });
+	std::vector<bool> referenced(nr_vertices, false);
+	size_t nr_loaded = 0;
+	size_t nr_referenced = 0;
+	for (size_t i = 0; i < nr_indices; i++)
+	{
+		const size_t v = indices[i];
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			nr_referenced++;
+		}
+
+		// A vertex may straddle two lines
+		const size_t first = v * vertex_size / LineSize;
+		const size_t last = (v * vertex_size + vertex_size - 1) / LineSize;
+		for (size_t line = first; line <= last; line++)
+		{
+			if (lines[line % NrLines] != line)
+			{
+				lines[line % NrLines] = line;
+				nr_loaded++;
+			}
+		}
+	}
+
+	return nr_referenced > 0 ? float(nr_loaded * LineSize) / float(nr_referenced * vertex_size) : 0.0f;
+}
+
+/*!
+ * Reorder the triangles of an index range for the post-transform vertex
+ * cache (Forsyth, 'Linear-Speed Vertex Cache Optimisation', 2006). The
+ * ordering does not depend on the exact cache size of the hardware.
+ */
+inline void optimizeVertexCache(uint32_t* indices, size_t nr_indices, size_t nr_vertices)
+{
+	using namespace MeshOptimizationDetail;
+
+	const size_t nr_triangles = nr_indices / 3;
+	if (nr_triangles == 0)
+		return;
+
+	Adjacency adjacency{ indices, nr_indices, nr_vertices };
+	std::vector<uint32_t>& remaining = adjacency.Counts;
+
+	std::vector<float> vertex_score(nr_vertices);
+	for (size_t v = 0; v < nr_vertices; v++)
+		vertex_score[v] = vertexScore(-1, remaining[v]);
+
+	std::vector<float> triangle_score(nr_triangles);
+	for (size_t t = 0; t < nr_triangles; t++)
+		triangle_score[t] = vertex_score[indices[3*t + 0]] + vertex_score[indices[3*t + 1]] + vertex_score[indices[3*t + 2]];
+
+	std::vector<bool> emitted(nr_triangles, false);
+	std::vector<uint32_t> output;
+	output.reserve(nr_indices);
+
+	// LRU cache, with room for the three vertices of the emitted triangle
+	std::vector<uint32_t> cache, next_cache;
+	cache.reserve(MaxCacheSize + 3);
+	next_cache.reserve(MaxCacheSize + 3);
+
+	size_t next_unemitted = 0;
+	uint32_t best = 0;
+	while (true)
+	{
+		// Emit the triangle and remove it from the adjacency of its vertices
+		emitted[best] = true;
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t v = indices[3*best + k];
+			output.push_back(v);
+
+			uint32_t* tris = adjacency.Triangles.data() + adjacency.Offsets[v];
+			uint32_t* last = tris + remaining[v];
+			*std::find(tris, last, best) = *(last - 1);
+			remaining[v]--;
+		}
+
+		// Move the vertices of the triangle to the front of the cache
+		next_cache.clear();
+		next_cache.insert(next_cache.end(), indices + 3*best, indices + 3*best + 3);
+		for (const auto v : cache)
+			if (v != next_cache[0] && v != next_cache[1] && v != next_cache[2])
+				next_cache.push_back(v);
+		std::swap(cache, next_cache);
+
+		// Update the scores of the cached vertices and their triangles
+		float best_score = -1;
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			const uint32_t v = cache[i];
+			const int pos = i < MaxCacheSize ? static_cast<int>(i) : -1;
+			const float delta = vertexScore(pos, remaining[v]) - vertex_score[v];
+			vertex_score[v] += delta;
+			for (uint32_t j = 0; j < remaining[v]; j++)
+			{
+				const uint32_t t = adjacency.Triangles[adjacency.Offsets[v] + j];
+				triangle_score[t] += delta;
+				if (triangle_score[t] > best_score)
+				{
+					best_score = triangle_score[t];
+					best = t;
+				}
+			}
+		}
+		if (cache.size() > MaxCacheSize)
+			cache.resize(MaxCacheSize);
+
+		// Restart at the next unemitted triangle if the cache is exhausted
+		if (best_score < 0)
+		{
+			while (next_unemitted < nr_triangles && emitted[next_unemitted])
+				next_unemitted++;
+			if (next_unemitted == nr_triangles)
+				break;
+			best = static_cast<uint32_t>(next_unemitted);
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+/*!
+ * Reorder clusters of a cache optimized index range such that outward facing
+ * clusters are drawn first (Sander et al., 'Fast Triangle Reordering for
+ * Vertex Locality and Reduced Overdraw', 2007). Clusters end where the
+ * vertex cache restarts or where their ACMR drops below 'threshold' times
+ * the ACMR of the range, which bounds the loss in cache efficiency.
+ */
+inline void optimizeOverdraw
+(
+	uint32_t* indices, size_t nr_indices,
+	const std::vector<Eigen::Vector3f>& positions,
+	float threshold = 1.05f, uint32_t cache_size = 16
+)
+{
+	const size_t nr_triangles = nr_indices / 3;
+	if (nr_triangles < 2)
+		return;
+
+	std::vector<uint8_t> misses;
+	MeshOptimizationDetail::simulateFifo(indices, nr_indices, positions.size(), cache_size, misses);
+	const float acmr = float(std::accumulate(misses.begin(), misses.end(), size_t{ 0 })) / float(nr_triangles);
+
+	// Split into hard clusters at cache restarts, then into soft clusters.
+	// The cache is flushed at the start of each cluster, as its predecessor
+	// changes after sorting.
+	std::vector<uint32_t> clusters;
+	std::vector<uint32_t> timestamps(positions.size(), 0);
+	uint32_t time = cache_size + 1;
+	uint32_t cluster_start = 0;
+	uint32_t cluster_misses = 0;
+	for (uint32_t t = 0; t < nr_triangles; t++)
+	{
+		const bool restart = misses[t] == 3;
+		const uint32_t cluster_size = t - cluster_start;
+		const bool efficient = cluster_size > 0 && float(cluster_misses) <= threshold * acmr * float(cluster_size);
+		if (t == 0 || restart || efficient)
+		{
+			clusters.push_back(t);
+			cluster_start = t;
+			cluster_misses = 0;
+			time += cache_size + 1;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t v = indices[3*t + k];
+			if (time - timestamps[v] > cache_size)
+			{
+				timestamps[v] = time++;
+				cluster_misses++;
+			}
+		}
+	}
+	clusters.push_back(static_cast<uint32_t>(nr_triangles));
+
+	// Area weighted centroid of the range and of each cluster
+	const size_t nr_clusters = clusters.size() - 1;
+	std::vector<Eigen::Vector3f> centroids(nr_clusters, Eigen::Vector3f::Zero());
+	std::vector<Eigen::Vector3f> normals(nr_clusters, Eigen::Vector3f::Zero());
+	Eigen::Vector3f mesh_centroid = Eigen::Vector3f::Zero();
+	float mesh_area = 0;
+	for (size_t c = 0; c < nr_clusters; c++)
+	{
+		float area = 0;
+		for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const Eigen::Vector3f& p0 = positions[indices[3*t + 0]];
+			const Eigen::Vector3f& p1 = positions[indices[3*t + 1]];
+			const Eigen::Vector3f& p2 = positions[indices[3*t + 2]];
+			const Eigen::Vector3f n = (p1 - p0).cross(p2 - p0);
+			const float a = n.norm();
+
+			centroids[c] += a * (p0 + p1 + p2) / 3.0f;
+			normals[c] += n;
+			area += a;
+		}
+
+		mesh_centroid += centroids[c];
+		mesh_area += area;
+		if (area > 0)
+			centroids[c] /= area;
+	}
+	if (mesh_area > 0)
+		mesh_centroid /= mesh_area;
+
+	// Clusters facing away from the center occlude the others
+	std::vector<float> sort_key(nr_clusters);
+	for (size_t c = 0; c < nr_clusters; c++)
+		sort_key[c] = (centroids[c] - mesh_centroid).dot(normals[c].normalized());
+
+	std::vector<uint32_t> order(nr_clusters);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&sort_key](uint32_t a, uint32_t b)
+	{
+		return sort_key[a] > sort_key[b];
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(nr_indices);
+	for (const auto c : order)
+		output.insert(output.end(), indices + 3*clusters[c], indices + 3*clusters[c + 1]);
+	std::copy(output.begin(), output.end(), indices);
+}
+
+/*!
+ * Reorder the vertices in the order of their first use in the index buffer,
+ * such that vertex fetches access memory sequentially. Unreferenced vertices
+ * are moved to the end.
+ */
+inline void optimizeVertexFetch(MeshData& mesh)
+{
+	const uint32_t nr_vertices = mesh.nrVertices();
+	std::vector<uint32_t> remap(nr_vertices, ~0u);
+	uint32_t next = 0;
+	for (auto& idx : mesh.Indices)
+	{
+		if (remap[idx] == ~0u)
+			remap[idx] = next++;
+		idx = remap[idx];
+	}
+	for (auto& r : remap)
+		if (r == ~0u)
+			r = next++;
+
+	std::vector<Eigen::Vector3f> positions(nr_vertices);
+	for (uint32_t v = 0; v < nr_vertices; v++)
+		positions[remap[v]] = mesh.Positions[v];
+	mesh.Positions = std::move(positions);
+
+	if (!mesh.Normals.empty())
+	{
+		std::vector<Eigen::Vector3f> normals(nr_vertices);
+		for (uint32_t v = 0; v < nr_vertices; v++)
+			normals[remap[v]] = mesh.Normals[v];
+		mesh.Normals = std::move(normals);
+	}
+}
+
+/*!
+ * Optimize the triangle order of each level of detail for the vertex cache
+ * and overdraw, then the vertex order for fetch locality. The levels are
+ * processed in parallel. Returns the statistics of the finest level.
+ */
+inline MeshOptimizationStatistics optimizeMesh(MeshData& mesh)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	MeshOptimizationStatistics stats;
+	const MeshLevel finest = mesh.level(0);
+	stats.CacheBefore = analyzeVertexCache(mesh.Indices.data() + finest.FirstIndex, finest.NrIndices, mesh.nrVertices());
+	stats.OverfetchBefore = analyzeVertexFetch(mesh.Indices.data() + finest.FirstIndex, finest.NrIndices, mesh.nrVertices(), sizeof(Eigen::Vector3f));
+
+	parallelFor(0, mesh.nrLevels(), 1, [&mesh](size_t, size_t b, size_t e)
+	{
+		for (size_t l = b; l < e; l++)
+		{
+			const MeshLevel level = mesh.level(static_cast<uint32_t>(l));
+			uint32_t* indices = mesh.Indices.data() + level.FirstIndex;
+			optimizeVertexCache(indices, level.NrIndices, mesh.nrVertices());
+			optimizeOverdraw(indices, level.NrIndices, mesh.Positions);
+		}
+	});
+	optimizeVertexFetch(mesh);
+
+	stats.CacheAfter = analyzeVertexCache(mesh.Indices.data() + finest.FirstIndex, finest.NrIndices, mesh.nrVertices());
+	stats.OverfetchAfter = analyzeVertexFetch(mesh.Indices.data() + finest.FirstIndex, finest.NrIndices, mesh.nrVertices(), sizeof(Eigen::Vector3f));
+	stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
@@ -0,0 +1,491 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/eigen.h>
+
+// C++ standard library
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+namespace MeshSimplificationDetail
+{
+	//! Symmetric 4x4 error quadric (Garland and Heckbert, 1997)
+	struct Quadric
+	{
+		double m[10] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+		Quadric() = default;
+
+		//! Quadric measuring the squared distance to the plane ax + by + cz + d = 0
+		Quadric(double a, double b, double c, double d, double w = 1)
+		{
+			m[0] = w*a*a; m[1] = w*a*b; m[2] = w*a*c; m[3] = w*a*d;
+			              m[4] = w*b*b; m[5] = w*b*c; m[6] = w*b*d;
+			                            m[7] = w*c*c; m[8] = w*c*d;
+			                                          m[9] = w*d*d;
+		}
+
+		Quadric& operator+=(const Quadric& q)
+		{
+			for (int i = 0; i < 10; i++)
+				m[i] += q.m[i];
+			return *this;
+		}
+
+		Quadric operator+(const Quadric& q) const
+		{
+			Quadric r = *this;
+			r += q;
+			return r;
+		}
+
+		double error(const Eigen::Vector3d& v) const
+		{
+			const double x = v.x(), y = v.y(), z = v.z();
+			return
+				m[0]*x*x + 2*m[1]*x*y + 2*m[2]*x*z + 2*m[3]*x +
+				m[4]*y*y + 2*m[5]*y*z + 2*m[6]*y +
+				m[7]*z*z + 2*m[8]*z +
+				m[9];
+		}
+
+		//! Position minimizing the error, returns false if the system is singular
+		bool optimum(Eigen::Vector3d& v) const
+		{
+			Eigen::Matrix3d A;
+			A << m[0], m[1], m[2],
+			     m[1], m[4], m[5],
+			     m[2], m[5], m[7];
+			const Eigen::Vector3d b{ -m[3], -m[6], -m[8] };
+
+			const double det = A.determinant();
+			if (std::abs(det) < 1e-12 * std::max(1.0, A.cwiseAbs().maxCoeff()))
+				return false;
+
+			v = A.inverse() * b;
+			return true;
+		}
+	};
+
+	struct Triangle
+	{
+		uint32_t V[3];
+		double Error[4];
+		Eigen::Vector3d Normal;
+		bool Deleted{ false };
+		bool Dirty{ false };
+	};
+
+	struct Vertex
+	{
+		Eigen::Vector3d Position;
+		Quadric Q;
+		uint32_t RefStart{ 0 };
+		uint32_t RefCount{ 0 };
+		bool Border{ false };
+	};
+
+	//! Reference from a vertex to an incident triangle
+	struct Reference
+	{
+		uint32_t Triangle;
+		uint32_t Corner;
+	};
+
+	/*!
+	 * Edge-collapse simplification driven by quadric error metrics. Instead of
+	 * maintaining a global priority queue, all edges with an error below a
+	 * growing threshold are collapsed in sweeps over the mesh, which is much
+	 * faster for large meshes at a small loss of quality. Vertices on open
+	 * boundaries are never moved or removed.
+	 */
+	class Simplifier
+	{
+	public:
+		Simplifier(const std::vector<Eigen::Vector3f>& positions, const std::vector<uint32_t>& indices)
+		{
+			_vertices.resize(positions.size());
+			for (size_t v = 0; v < positions.size(); v++)
+				_vertices[v].Position = positions[v].cast<double>();
+
+			_triangles.resize(indices.size() / 3);
+			for (size_t t = 0; t < _triangles.size(); t++)
+				std::copy(indices.begin() + 3 * t, indices.begin() + 3 * t + 3, _triangles[t].V);
+		}
+
+		//! Collapse edges until at most 'target' triangles remain. Returns the
+		//! largest quadric error of all collapsed edges.
+		double simplify(size_t target, double aggressiveness = 7)
+		{
+			size_t nr_deleted = 0;
+			double max_error = 0;
+			std::vector<bool> deleted0, deleted1;
+
+			for (int iteration = 0; iteration < 100; iteration++)
+			{
+				if (_triangles.size() - nr_deleted <= target)
+					break;
+
+				// Remove deleted triangles and rebuild the references
+				if (iteration % 5 == 0)
+				{
+					update(iteration == 0);
+					nr_deleted = 0;
+				}
+
+				for (auto& t : _triangles)
+					t.Dirty = false;
+
+				// Collapse all edges below an increasing threshold
+				const double threshold = 1e-9 * std::pow(iteration + 3.0, aggressiveness);
+				for (size_t tid = 0; tid < _triangles.size(); tid++)
+				{
+					const auto& t = _triangles[tid];
+					if (t.Deleted || t.Dirty || t.Error[3] > threshold)
+						continue;
+
+					for (int j = 0; j < 3; j++)
+					{
+						if (t.Error[j] > threshold)
+							continue;
+
+						const uint32_t i0 = t.V[j];
+						const uint32_t i1 = t.V[(j + 1) % 3];
+						auto& v0 = _vertices[i0];
+						auto& v1 = _vertices[i1];
+						if (v0.Border || v1.Border)
+							continue;
+
+						Eigen::Vector3d p;
+						const double error = edgeError(i0, i1, p);
+
+						// Reject collapses which would flip triangles
+						deleted0.assign(v0.RefCount, false);
+						deleted1.assign(v1.RefCount, false);
+						if (flipped(p, i1, v0, deleted0) || flipped(p, i0, v1, deleted1))
+							continue;
+
+						v0.Position = p;
+						v0.Q += v1.Q;
+
+						const uint32_t ref_start = static_cast<uint32_t>(_refs.size());
+						updateTriangles(i0, v0, deleted0, nr_deleted);
+						updateTriangles(i0, v1, deleted1, nr_deleted);
+						const uint32_t ref_count = static_cast<uint32_t>(_refs.size()) - ref_start;
+
+						// Reuse the reference storage of 'v0' if possible
+						if (ref_count <= v0.RefCount)
+						{
+							if (ref_count > 0)
+								std::copy(_refs.begin() + ref_start, _refs.end(), _refs.begin() + v0.RefStart);
+							_refs.resize(ref_start);
+						}
+						else
+							v0.RefStart = ref_start;
+						v0.RefCount = ref_count;
+
+						max_error = std::max(max_error, error);
+						break;
+					}
+
+					if (_triangles.size() - nr_deleted <= target)
+						break;
+				}
+			}
+
+			compact();
+			return max_error;
+		}
+
+		//! Write the simplified mesh, unreferenced vertices are removed
+		void result(std::vector<Eigen::Vector3f>& positions, std::vector<uint32_t>& indices, std::vector<uint32_t>& vertex_map) const
+		{
+			vertex_map.assign(_vertices.size(), ~0u);
+			positions.clear();
+			indices.clear();
+			indices.reserve(3 * _triangles.size());
+			for (const auto& t : _triangles)
+			{
+				for (const auto v : t.V)
+				{
+					if (vertex_map[v] == ~0u)
+					{
+						vertex_map[v] = static_cast<uint32_t>(positions.size());
+						positions.emplace_back(_vertices[v].Position.cast<float>());
+					}
+					indices.push_back(vertex_map[v]);
+				}
+			}
+		}
+
+	private:
+		double edgeError(uint32_t i0, uint32_t i1, Eigen::Vector3d& p) const
+		{
+			const auto& v0 = _vertices[i0];
+			const auto& v1 = _vertices[i1];
+			const Quadric q = v0.Q + v1.Q;
+
+			if (q.optimum(p))
+				return q.error(p);
+
+			// Fall back to the end points and the mid point
+			const Eigen::Vector3d mid = 0.5 * (v0.Position + v1.Position);
+			const double e0 = q.error(v0.Position);
+			const double e1 = q.error(v1.Position);
+			const double em = q.error(mid);
+			const double e = std::min(e0, std::min(e1, em));
+			p = e == e0 ? v0.Position : (e == e1 ? v1.Position : mid);
+			return e;
+		}
+
+		//! Check whether moving 'v' to 'p' flips one of its triangles. Triangles
+		//! shared with 'other' collapse and are marked in 'deleted'.
+		bool flipped(const Eigen::Vector3d& p, uint32_t other, const Vertex& v, std::vector<bool>& deleted) const
+		{
+			for (uint32_t k = 0; k < v.RefCount; k++)
+			{
+				const auto& r = _refs[v.RefStart + k];
+				const auto& t = _triangles[r.Triangle];
+				if (t.Deleted)
+					continue;
+
+				const uint32_t id1 = t.V[(r.Corner + 1) % 3];
+				const uint32_t id2 = t.V[(r.Corner + 2) % 3];
+				if (id1 == other || id2 == other)
+				{
+					deleted[k] = true;
+					continue;
+				}
+
+				const Eigen::Vector3d d1 = (_vertices[id1].Position - p).normalized();
+				const Eigen::Vector3d d2 = (_vertices[id2].Position - p).normalized();
+				if (std::abs(d1.dot(d2)) > 0.999)
+					return true;
+
+				const Eigen::Vector3d n = d1.cross(d2).normalized();
+				if (n.dot(t.Normal) < 0.2)
+					return true;
+			}
+			return false;
+		}
+
+		//! Redirect the triangles of 'v' to 'i0' and delete collapsed triangles
+		void updateTriangles(uint32_t i0, const Vertex& v, const std::vector<bool>& deleted, size_t& nr_deleted)
+		{
+			for (uint32_t k = 0; k < v.RefCount; k++)
+			{
+				const Reference r = _refs[v.RefStart + k];
+				auto& t = _triangles[r.Triangle];
+				if (t.Deleted)
+					continue;
+
+				if (deleted[k])
+				{
+					t.Deleted = true;
+					nr_deleted++;
+					continue;
+				}
+
+				t.V[r.Corner] = i0;
+				t.Dirty = true;
+				updateErrors(t);
+				_refs.push_back(r);
+			}
+		}
+
+		void updateErrors(Triangle& t) const
+		{
+			Eigen::Vector3d p;
+			t.Error[0] = edgeError(t.V[0], t.V[1], p);
+			t.Error[1] = edgeError(t.V[1], t.V[2], p);
+			t.Error[2] = edgeError(t.V[2], t.V[0], p);
+			t.Error[3] = std::min(t.Error[0], std::min(t.Error[1], t.Error[2]));
+		}
+
+		void update(bool init)
+		{
+			if (!init)
+			{
+				_triangles.erase(std::remove_if(_triangles.begin(), _triangles.end(), [](const Triangle& t) { return t.Deleted; }), _triangles.end());
+			}
+
+			// Build the vertex to triangle references
+			for (auto& v : _vertices)
+			{
+				v.RefStart = 0;
+				v.RefCount = 0;
+			}
+			for (const auto& t : _triangles)
+				for (const auto v : t.V)
+					_vertices[v].RefCount++;
+
+			uint32_t start = 0;
+			for (auto& v : _vertices)
+			{
+				v.RefStart = start;
+				start += v.RefCount;
+				v.RefCount = 0;
+			}
+
+			_refs.resize(start);
+			for (uint32_t tid = 0; tid < _triangles.size(); tid++)
+			{
+				const auto& t = _triangles[tid];
+				for (uint32_t j = 0; j < 3; j++)
+				{
+					auto& v = _vertices[t.V[j]];
+					_refs[v.RefStart + v.RefCount++] = { tid, j };
+				}
+			}
+
+			if (!init)
+				return;
+
+			// Boundary vertices have an edge used by a single triangle
+			std::vector<uint32_t> neighbours, counts;
+			for (uint32_t vid = 0; vid < _vertices.size(); vid++)
+			{
+				auto& v = _vertices[vid];
+				neighbours.clear();
+				counts.clear();
+				for (uint32_t k = 0; k < v.RefCount; k++)
+				{
+					const auto& t = _triangles[_refs[v.RefStart + k].Triangle];
+					for (const auto n : t.V)
+					{
+						if (n == vid)
+							continue;
+
+						const auto it = std::find(neighbours.begin(), neighbours.end(), n);
+						if (it == neighbours.end())
+						{
+							neighbours.push_back(n);
+							counts.push_back(1);
+						}
+						else
+							counts[it - neighbours.begin()]++;
+					}
+				}
+				v.Border = std::find(counts.begin(), counts.end(), 1u) != counts.end();
+			}
+
+			// Initial quadrics from the supporting planes of the triangles
+			for (auto& t : _triangles)
+			{
+				const auto& p0 = _vertices[t.V[0]].Position;
+				const auto& p1 = _vertices[t.V[1]].Position;
+				const auto& p2 = _vertices[t.V[2]].Position;
+				const Eigen::Vector3d n = (p1 - p0).cross(p2 - p0);
+				const double area = n.norm();
+				t.Normal = area > 0 ? Eigen::Vector3d(n / area) : Eigen::Vector3d::Zero();
+
+				// Unweighted planes, such that errors are squared distances
+				const Quadric q{ t.Normal.x(), t.Normal.y(), t.Normal.z(), -t.Normal.dot(p0) };
+				for (const auto v : t.V)
+					_vertices[v].Q += q;
+			}
+
+			for (auto& t : _triangles)
+				updateErrors(t);
+		}
+
+		void compact()
+		{
+			_triangles.erase(std::remove_if(_triangles.begin(), _triangles.end(), [](const Triangle& t) { return t.Deleted; }), _triangles.end());
+		}
+
+		std::vector<Vertex> _vertices;
+		std::vector<Triangle> _triangles;
+		std::vector<Reference> _refs;
+	};
+}
+
+/*!
+ * Build a chain of up to 'max_levels' levels of detail. Each level has about
+ * a quarter of the triangles of its predecessor and is appended to the vertex
+ * and index arrays of the returned mesh. The levels store the index range and
+ * the geometric error (distance in object space) relative to the input.
+ * Each level is simplified from its predecessor, thus the error is bounded
+ * by the sum of the errors of the individual steps (triangle inequality).
+ */
+inline MeshData buildLodChain(const MeshData& mesh, uint32_t max_levels = 6, uint32_t min_triangles = 256)
+{
+	using MeshSimplificationDetail::Simplifier;
+
+	MeshData chain = mesh;
+	chain.Levels.clear();
+	chain.Levels.push_back({ 0, static_cast<uint32_t>(mesh.Indices.size()), 0.0f });
+
+	std::vector<Eigen::Vector3f> positions = mesh.Positions;
+	std::vector<Eigen::Vector3f> normals = mesh.Normals;
+	std::vector<uint32_t> indices = mesh.Indices;
+	std::vector<uint32_t> vertex_map;
+	double error = 0;
+	while (chain.Levels.size() < max_levels && indices.size() / 3 / 4 >= min_triangles)
+	{
+		const size_t nr_triangles = indices.size() / 3;
+
+		Simplifier simplifier{ positions, indices };
+		error += std::sqrt(simplifier.simplify(nr_triangles / 4));
+
+		std::vector<Eigen::Vector3f> level_positions;
+		std::vector<uint32_t> level_indices;
+		simplifier.result(level_positions, level_indices, vertex_map);
+
+		// Stop if the boundary constraints prevent further reduction
+		if (level_indices.size() / 3 > nr_triangles * 3 / 4)
+			break;
+
+		std::vector<Eigen::Vector3f> level_normals;
+		if (!normals.empty())
+		{
+			level_normals.resize(level_positions.size());
+			for (size_t v = 0; v < vertex_map.size(); v++)
+				if (vertex_map[v] != ~0u)
+					level_normals[vertex_map[v]] = normals[v];
+		}
+
+		// Append the level to the chain
+		const uint32_t base_vertex = chain.nrVertices();
+		const uint32_t first_index = static_cast<uint32_t>(chain.Indices.size());
+		chain.Positions.insert(chain.Positions.end(), level_positions.begin(), level_positions.end());
+		chain.Normals.insert(chain.Normals.end(), level_normals.begin(), level_normals.end());
+		for (const auto idx : level_indices)
+			chain.Indices.push_back(base_vertex + idx);
+		chain.Levels.push_back({ first_index, static_cast<uint32_t>(level_indices.size()), static_cast<float>(error) });
+
+		positions = std::move(level_positions);
+		normals = std::move(level_normals);
+		indices = std::move(level_indices);
+	}
+
+	return chain;
+}
@@ -0,0 +1,720 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/eigen.h>
+
+// C++ standard library
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../parallel.h"
+#include "../simd.h"
+#include "meshoptimization.h"
+
+namespace OcclusionDetail
+{
+	using Simd::FloatV;
+
+	using Matrix4fArray = std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f>>;
+	using Vector4fArray = std::vector<Eigen::Vector4f, Eigen::aligned_allocator<Eigen::Vector4f>>;
+
+	//! Screen-space triangle prepared for rasterization
+	struct Triangle
+	{
+		//! Edge functions a*x + b*y + c, positive inside
+		float EdgeA[3], EdgeB[3], EdgeC[3];
+
+		//! Plane of the interpolated inverse depth
+		float DepthA, DepthB, DepthC;
+
+		//! Pixel bounds, inclusive
+		int MinX, MinY, MaxX, MaxY;
+	};
+}
+
+/*!
+ * Low resolution depth buffer rasterized on the CPU. Stores the inverse
+ * view-space depth (1/w), which is linear in screen space and independent
+ * of the depth range of the projection. Larger values are closer, zero is
+ * empty. The screen is divided into tiles rasterized in parallel.
+ */
+class OcclusionBuffer
+{
+public:
+	static const int Width = 320;
+	static const int Height = 192;
+	static const int TileWidth = 64;
+	static const int TileHeight = 32;
+	static const int TilesX = Width / TileWidth;
+	static const int TilesY = Height / TileHeight;
+
+	OcclusionBuffer()
+	: _depth(Width * Height + OcclusionDetail::FloatV::Width)
+	, _bins(TilesX * TilesY)
+	{
+	}
+
+	//! Rasterize triangles given by positions and indices, transformed by
+	//! the column-major matrices in 'transforms' and the view-projection 'VP'
+	void render
+	(
+		const Eigen::Matrix4f& VP,
+		const std::vector<Eigen::Vector3f>& positions,
+		const uint32_t* indices, size_t nr_indices,
+		const OcclusionDetail::Matrix4fArray& transforms
+	)
+	{
+		using namespace OcclusionDetail;
+
+		std::fill(_depth.begin(), _depth.end(), 0.0f);
+		_triangles.clear();
+		for (auto& bin : _bins)
+			bin.clear();
+
+		// Setup and binning
+		OcclusionDetail::Vector4fArray clip(positions.size());
+		for (const auto& T : transforms)
+		{
+			const Eigen::Matrix4f MVP = VP * T;
+			for (size_t v = 0; v < positions.size(); v++)
+				clip[v] = MVP * positions[v].homogeneous();
+
+			for (size_t i = 0; i + 2 < nr_indices; i += 3)
+				setup(clip[indices[i + 0]], clip[indices[i + 1]], clip[indices[i + 2]]);
+		}
+
+		// Rasterize the tiles
+		parallelFor(0, _bins.size(), 1, [this](size_t, size_t b, size_t e)
+		{
+			for (size_t t = b; t < e; t++)
+				rasterizeTile(static_cast<int>(t));
+		});
+	}
+
+	//! Test whether a box, given by its projected pixel bounds and largest
+	//! inverse depth, is in front of any rasterized pixel
+	bool isVisible(int min_x, int min_y, int max_x, int max_y, float inv_w) const
+	{
+		using OcclusionDetail::FloatV;
+
+		min_x = std::max(min_x, 0);
+		min_y = std::max(min_y, 0);
+		max_x = std::min(max_x, Width - 1);
+		max_y = std::min(max_y, Height - 1);
+		if (min_x > max_x || min_y > max_y)
+			return false;
+
+		const FloatV depth = FloatV::set(inv_w);
+		const FloatV lanes = FloatV::lanes();
+		const FloatV first = FloatV::set(float(min_x) - 0.5f);
+		const FloatV last = FloatV::set(float(max_x) + 0.5f);
+		const int start = min_x - min_x % FloatV::Width;
+		for (int y = min_y; y <= max_y; y++)
+		{
+			const float* row = _depth.data() + y * Width;
+			for (int x = start; x <= max_x; x += FloatV::Width)
+			{
+				const FloatV px = FloatV::set(float(x)) + lanes;
+				const FloatV inside = (px >= first) & (px <= last);
+				if (any(inside & (FloatV::load(row + x) <= depth)))
+					return true;
+			}
+		}
+		return false;
+	}
+
+	//! Number of triangles rasterized in the last frame
+	size_t nrTriangles() const { return _triangles.size(); }
+
+private:
+	void setup(const Eigen::Vector4f& c0, const Eigen::Vector4f& c1, const Eigen::Vector4f& c2)
+	{
+		using OcclusionDetail::Triangle;
+
+		// Occluders crossing the near plane are skipped, which is conservative
+		const float near_w = 1e-4f;
+		if (c0.w() < near_w || c1.w() < near_w || c2.w() < near_w)
+			return;
+
+		// Pixel coordinates, y pointing up as in normalized device coordinates
+		const Eigen::Vector3f s[] =
+		{
+			{ (c0.x() / c0.w() * 0.5f + 0.5f) * Width, (c0.y() / c0.w() * 0.5f + 0.5f) * Height, 1 / c0.w() },
+			{ (c1.x() / c1.w() * 0.5f + 0.5f) * Width, (c1.y() / c1.w() * 0.5f + 0.5f) * Height, 1 / c1.w() },
+			{ (c2.x() / c2.w() * 0.5f + 0.5f) * Width, (c2.y() / c2.w() * 0.5f + 0.5f) * Height, 1 / c2.w() },
+		};
+
+		// Only counter-clockwise, front facing triangles are rasterized
+		const float area = (s[1].x() - s[0].x()) * (s[2].y() - s[0].y()) - (s[2].x() - s[0].x()) * (s[1].y() - s[0].y());
+		if (!(area > 0))
+			return;
+
+		Triangle tri;
+		tri.MinX = std::max(0, static_cast<int>(std::floor(std::min({ s[0].x(), s[1].x(), s[2].x() }))));
+		tri.MinY = std::max(0, static_cast<int>(std::floor(std::min({ s[0].y(), s[1].y(), s[2].y() }))));
+		tri.MaxX = std::min(Width - 1, static_cast<int>(std::ceil(std::max({ s[0].x(), s[1].x(), s[2].x() }))));
+		tri.MaxY = std::min(Height - 1, static_cast<int>(std::ceil(std::max({ s[0].y(), s[1].y(), s[2].y() }))));
+		if (tri.MinX > tri.MaxX || tri.MinY > tri.MaxY)
+			return;
+
+		for (int e = 0; e < 3; e++)
+		{
+			const Eigen::Vector3f& a = s[e];
+			const Eigen::Vector3f& b = s[(e + 1) % 3];
+			tri.EdgeA[e] = a.y() - b.y();
+			tri.EdgeB[e] = b.x() - a.x();
+			tri.EdgeC[e] = a.x() * b.y() - a.y() * b.x();
+		}
+
+		// Inverse depth interpolated by the barycentric coordinates
+		const float inv_area = 1 / area;
+		tri.DepthA = (tri.EdgeA[1] * s[0].z() + tri.EdgeA[2] * s[1].z() + tri.EdgeA[0] * s[2].z()) * inv_area;
+		tri.DepthB = (tri.EdgeB[1] * s[0].z() + tri.EdgeB[2] * s[1].z() + tri.EdgeB[0] * s[2].z()) * inv_area;
+		tri.DepthC = (tri.EdgeC[1] * s[0].z() + tri.EdgeC[2] * s[1].z() + tri.EdgeC[0] * s[2].z()) * inv_area;
+
+		// Occluders must only cover pixels lying entirely inside them. Moving
+		// the edges inwards by half a pixel turns the test at the pixel
+		// center into a test of the whole pixel (inner coverage). The depth
+		// is lowered to the farthest value over the pixel.
+		for (int e = 0; e < 3; e++)
+			tri.EdgeC[e] -= 0.5f * (std::abs(tri.EdgeA[e]) + std::abs(tri.EdgeB[e]));
+		tri.DepthC -= 0.5f * (std::abs(tri.DepthA) + std::abs(tri.DepthB));
+
+		const uint32_t idx = static_cast<uint32_t>(_triangles.size());
+		_triangles.push_back(tri);
+		for (int ty = tri.MinY / TileHeight; ty <= tri.MaxY / TileHeight; ty++)
+			for (int tx = tri.MinX / TileWidth; tx <= tri.MaxX / TileWidth; tx++)
+				_bins[ty * TilesX + tx].push_back(idx);
+	}
+
+	void rasterizeTile(int tile)
+	{
+		using OcclusionDetail::FloatV;
+
+		const int tile_x = (tile % TilesX) * TileWidth;
+		const int tile_y = (tile / TilesX) * TileHeight;
+		const FloatV lanes = FloatV::lanes();
+		const FloatV zero = FloatV::set(0);
+
+		for (const auto idx : _bins[tile])
+		{
+			const auto& tri = _triangles[idx];
+			const int min_x = std::max(tri.MinX, tile_x) & ~(FloatV::Width - 1);
+			const int max_x = std::min(tri.MaxX, tile_x + TileWidth - 1);
+			const int min_y = std::max(tri.MinY, tile_y);
+			const int max_y = std::min(tri.MaxY, tile_y + TileHeight - 1);
+
+			const FloatV a0 = FloatV::set(tri.EdgeA[0]), b0 = FloatV::set(tri.EdgeB[0]), c0 = FloatV::set(tri.EdgeC[0]);
+			const FloatV a1 = FloatV::set(tri.EdgeA[1]), b1 = FloatV::set(tri.EdgeB[1]), c1 = FloatV::set(tri.EdgeC[1]);
+			const FloatV a2 = FloatV::set(tri.EdgeA[2]), b2 = FloatV::set(tri.EdgeB[2]), c2 = FloatV::set(tri.EdgeC[2]);
+			const FloatV da = FloatV::set(tri.DepthA), db = FloatV::set(tri.DepthB), dc = FloatV::set(tri.DepthC);
+
+			// Sample at the pixel centers, the edges and the depth are offset
+			// for inner coverage
+			for (int y = min_y; y <= max_y; y++)
+			{
+				const FloatV py = FloatV::set(float(y) + 0.5f);
+				const FloatV e0_row = b0 * py + c0;
+				const FloatV e1_row = b1 * py + c1;
+				const FloatV e2_row = b2 * py + c2;
+				const FloatV d_row = db * py + dc;
+
+				float* row = _depth.data() + y * Width;
+				for (int x = min_x; x <= max_x; x += FloatV::Width)
+				{
+					const FloatV px = FloatV::set(float(x) + 0.5f) + lanes;
+					const FloatV inside = (a0 * px + e0_row >= zero) & (a1 * px + e1_row >= zero) & (a2 * px + e2_row >= zero);
+					const FloatV depth = FloatV::load(row + x);
+					select(inside, max(depth, da * px + d_row), depth).store(row + x);
+				}
+			}
+		}
+	}
+
+	//! Inverse depth, padded for the last vector of a row
+	std::vector<float> _depth;
+
+	//! Triangles of the current frame
+	std::vector<OcclusionDetail::Triangle> _triangles;
+
+	//! Triangles overlapping each tile
+	std::vector<std::vector<uint32_t>> _bins;
+};
+
+//! Results of the last culling job
+struct OcclusionCullingStatistics
+{
+	uint32_t FrustumCulled{ 0 };
+	uint32_t Occluded{ 0 };
+	uint32_t Visible{ 0 };
+
+	//! Number of rasterized triangles
+	size_t OccluderTriangles{ 0 };
+
+	//! Time spent rasterizing the occluders and testing the objects
+	double RasterMs{ 0 };
+	double TestMs{ 0 };
+};
+
+/*!
+ * Build conservative occluders for a closed mesh: boxes which lie inside the
+ * solid. The bounds are divided into 'resolution'^3 cells. A cell is inside
+ * if no triangle bounding box touches it and its center is inside the mesh,
+ * determined by the parity of the crossings of a ray along x. Interior cells
+ * are merged greedily into boxes, of which the 'max_boxes' largest are kept.
+ * Meshes with open or non-manifold edges do not bound a solid, they result
+ * in no occluders.
+ */
+inline void buildInnerBoxes
+(
+	const std::vector<Eigen::Vector3f>& positions,
+	const uint32_t* indices, size_t nr_indices,
+	std::vector<Eigen::Vector3f>& box_positions,
+	std::vector<uint32_t>& box_indices,
+	int resolution = 16, size_t max_boxes = 32
+)
+{
+	using MeshOptimizationDetail::Adjacency;
+
+	box_positions.clear();
+	box_indices.clear();
+	if (nr_indices < 3 || resolution < 1)
+		return;
+
+	// Every edge must be shared by exactly two triangles
+	const Adjacency adjacency{ indices, nr_indices, positions.size() };
+	std::atomic<bool> closed{ true };
+	parallelFor(0, nr_indices / 3, 1 << 14, [&](size_t, size_t b, size_t e)
+	{
+		for (size_t t = b; t < e && closed; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const uint32_t v0 = indices[3*t + k];
+				const uint32_t v1 = indices[3*t + (k + 1) % 3];
+				uint32_t nr_shared = 0;
+				for (uint32_t j = adjacency.Offsets[v0]; j < adjacency.Offsets[v0 + 1]; j++)
+				{
+					const uint32_t* tri = indices + 3 * adjacency.Triangles[j];
+					nr_shared += tri[0] == v1 || tri[1] == v1 || tri[2] == v1;
+				}
+				if (nr_shared != 2)
+					closed = false;
+			}
+		}
+	});
+	if (!closed)
+		return;
+
+	Eigen::AlignedBox3f bounds;
+	for (size_t i = 0; i < nr_indices; i++)
+		bounds.extend(positions[indices[i]]);
+	const Eigen::Vector3f cell = bounds.sizes() / float(resolution);
+	if (!(cell.minCoeff() > 0))
+		return;
+
+	const int n = resolution;
+	auto cell_index = [n](int x, int y, int z) { return (size_t(z) * n + y) * n + x; };
+	auto to_cell = [&](float v, int axis) { return std::min(std::max(int((v - bounds.min()[axis]) / cell[axis]), 0), n - 1); };
+
+	// Cells touched by a triangle and the crossings of the rays through the
+	// cell centers, one ray per row of cells along x
+	std::vector<bool> boundary(size_t(n) * n * n, false);
+	std::vector<std::vector<float>> crossings(size_t(n) * n);
+	for (size_t t = 0; t + 2 < nr_indices; t += 3)
+	{
+		const uint32_t tri[] = { indices[t + 0], indices[t + 1], indices[t + 2] };
+		Eigen::AlignedBox3f box;
+		for (const auto v : tri)
+			box.extend(positions[v]);
+
+		const Eigen::Vector3i lo{ to_cell(box.min().x(), 0), to_cell(box.min().y(), 1), to_cell(box.min().z(), 2) };
+		const Eigen::Vector3i hi{ to_cell(box.max().x(), 0), to_cell(box.max().y(), 1), to_cell(box.max().z(), 2) };
+		for (int z = lo.z(); z <= hi.z(); z++)
+			for (int y = lo.y(); y <= hi.y(); y++)
+				for (int x = lo.x(); x <= hi.x(); x++)
+					boundary[cell_index(x, y, z)] = true;
+
+		for (int z = lo.z(); z <= hi.z(); z++)
+		{
+			for (int y = lo.y(); y <= hi.y(); y++)
+			{
+				// Edge functions in the yz-plane. Each edge is evaluated with
+				// its endpoints in index order, such that triangles sharing
+				// the edge get the same value, and points on an edge are
+				// assigned to exactly one side.
+				const double py = bounds.min().y() + (y + 0.5) * cell.y();
+				const double pz = bounds.min().z() + (z + 0.5) * cell.z();
+				double w[3];
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t a = tri[(k + 1) % 3], c = tri[(k + 2) % 3];
+					const bool flip = a > c;
+					if (flip)
+						std::swap(a, c);
+					const double ay = positions[a].y(), az = positions[a].z();
+					const double cy = positions[c].y(), cz = positions[c].z();
+					double edge = (cy - ay) * (pz - az) - (cz - az) * (py - ay);
+					if (edge == 0)
+						edge = (cy > ay || (cy == ay && cz > az)) ? 1e-300 : -1e-300;
+					w[k] = flip ? -edge : edge;
+				}
+
+				const bool positive = w[0] > 0 && w[1] > 0 && w[2] > 0;
+				const bool negative = w[0] < 0 && w[1] < 0 && w[2] < 0;
+				if (!positive && !negative)
+					continue;
+
+				const double sum = w[0] + w[1] + w[2];
+				const double x = (w[0] * positions[tri[0]].x() + w[1] * positions[tri[1]].x() + w[2] * positions[tri[2]].x()) / sum;
+				crossings[size_t(z) * n + y].push_back(static_cast<float>(x));
+			}
+		}
+	}
+
+	// Classify the cell centers by the number of crossings in front of them.
+	// A row with an odd number of crossings has hit an edge case, it is
+	// treated as outside.
+	std::vector<bool> inside(size_t(n) * n * n, false);
+	for (int z = 0; z < n; z++)
+	{
+		for (int y = 0; y < n; y++)
+		{
+			auto& row = crossings[size_t(z) * n + y];
+			if (row.size() % 2 != 0)
+				continue;
+			std::sort(row.begin(), row.end());
+
+			size_t nr_before = 0;
+			for (int x = 0; x < n; x++)
+			{
+				const float px = bounds.min().x() + (x + 0.5f) * cell.x();
+				while (nr_before < row.size() && row[nr_before] < px)
+					nr_before++;
+				const size_t c = cell_index(x, y, z);
+				inside[c] = nr_before % 2 == 1 && !boundary[c];
+			}
+		}
+	}
+
+	// Merge the interior cells into boxes, growing along x, then y, then z
+	std::vector<std::pair<Eigen::Vector3i, Eigen::Vector3i>> boxes;
+	for (int z = 0; z < n; z++)
+	{
+		for (int y = 0; y < n; y++)
+		{
+			for (int x = 0; x < n; x++)
+			{
+				if (!inside[cell_index(x, y, z)])
+					continue;
+
+				auto free = [&](int x0, int x1, int y0, int y1, int z0, int z1)
+				{
+					for (int k = z0; k <= z1; k++)
+						for (int j = y0; j <= y1; j++)
+							for (int i = x0; i <= x1; i++)
+								if (!inside[cell_index(i, j, k)])
+									return false;
+					return true;
+				};
+
+				Eigen::Vector3i hi{ x, y, z };
+				while (hi.x() + 1 < n && free(hi.x() + 1, hi.x() + 1, y, y, z, z))
+					hi.x()++;
+				while (hi.y() + 1 < n && free(x, hi.x(), hi.y() + 1, hi.y() + 1, z, z))
+					hi.y()++;
+				while (hi.z() + 1 < n && free(x, hi.x(), y, hi.y(), hi.z() + 1, hi.z() + 1))
+					hi.z()++;
+
+				for (int k = z; k <= hi.z(); k++)
+					for (int j = y; j <= hi.y(); j++)
+						for (int i = x; i <= hi.x(); i++)
+							inside[cell_index(i, j, k)] = false;
+				boxes.emplace_back(Eigen::Vector3i{ x, y, z }, hi);
+			}
+		}
+	}
+
+	auto volume = [](const std::pair<Eigen::Vector3i, Eigen::Vector3i>& box) { return (box.second - box.first + Eigen::Vector3i::Ones()).prod(); };
+	std::stable_sort(boxes.begin(), boxes.end(), [&volume](const auto& a, const auto& b) { return volume(a) > volume(b); });
+	if (boxes.size() > max_boxes)
+		boxes.resize(max_boxes);
+
+	// Twelve triangles per box
+	const uint32_t faces[] =
+	{
+		0, 2, 3, 0, 3, 1,  4, 5, 7, 4, 7, 6,  0, 1, 5, 0, 5, 4,
+		2, 6, 7, 2, 7, 3,  0, 4, 6, 0, 6, 2,  1, 3, 7, 1, 7, 5,
+	};
+	for (const auto& box : boxes)
+	{
+		const Eigen::Vector3f lo = bounds.min() + cell.cwiseProduct(box.first.cast<float>());
+		const Eigen::Vector3f hi = bounds.min() + cell.cwiseProduct((box.second + Eigen::Vector3i::Ones()).cast<float>());
+		const uint32_t base = static_cast<uint32_t>(box_positions.size());
+		for (int c = 0; c < 8; c++)
+			box_positions.emplace_back(c & 1 ? hi.x() : lo.x(), c & 2 ? hi.y() : lo.y(), c & 4 ? hi.z() : lo.z());
+		for (const auto f : faces)
+			box_indices.push_back(base + f);
+	}
+}
+
+/*!
+ * Culls objects, given by bounding spheres, against the view frustum and
+ * against a CPU depth buffer of the closest objects. The work runs on a
+ * worker thread: 'kick' starts a job, 'wait' blocks until it is done.
+ * Calling 'kick' at the start of a frame, with the camera of that frame,
+ * overlaps the culling with recording the rest of the frame. The draw
+ * waits for the result, such that no object appears late.
+ */
+class OcclusionCuller
+{
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+
+	//! Number of closest objects rasterized as occluders
+	static const uint32_t MaxOccluders = 32;
+
+	OcclusionCuller()
+	{
+		_worker = std::thread{ [this]() { run(); } };
+	}
+	~OcclusionCuller()
+	{
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			_quit = true;
+		}
+		_wakeup.notify_all();
+		_worker.join();
+	}
+	OcclusionCuller(const OcclusionCuller&) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+	/*!
+	 * Set the objects to cull. All objects share the occluder mesh, given in
+	 * object space, and are placed by 'transforms'. 'spheres' are the world
+	 * space bounds of the objects.
+	 */
+	void setObjects
+	(
+		std::vector<Eigen::Vector3f> occluder_positions,
+		std::vector<uint32_t> occluder_indices,
+		OcclusionDetail::Matrix4fArray transforms,
+		OcclusionDetail::Vector4fArray spheres
+	)
+	{
+		wait();
+
+		_occluderPositions = std::move(occluder_positions);
+		_occluderIndices = std::move(occluder_indices);
+		_transforms = std::move(transforms);
+		_spheres = std::move(spheres);
+		_visible.clear();
+		_stats = {};
+	}
+
+	//! Start culling the objects for the view-projection matrix 'VP'
+	void kick(const Eigen::Matrix4f& VP)
+	{
+		wait();
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			_viewProjection = VP;
+			_pending = true;
+		}
+		_wakeup.notify_all();
+	}
+
+	//! Wait for the last job to finish
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock{ _mutex };
+		_done.wait(lock, [this]() { return !_pending; });
+	}
+
+	//! Indices of the visible objects of the last job, call 'wait' first
+	const std::vector<uint32_t>& visible() const { return _visible; }
+
+	//! Statistics of the last job, call 'wait' first
+	const OcclusionCullingStatistics& statistics() const { return _stats; }
+
+	//! Depth buffer of the last job, call 'wait' first
+	const OcclusionBuffer& buffer() const { return _buffer; }
+
+private:
+	void run()
+	{
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock{ _mutex };
+				_wakeup.wait(lock, [this]() { return _pending || _quit; });
+				if (_quit)
+					return;
+			}
+
+			cull();
+
+			{
+				std::unique_lock<std::mutex> lock{ _mutex };
+				_pending = false;
+			}
+			_done.notify_all();
+		}
+	}
+
+	void cull()
+	{
+		using clock = std::chrono::steady_clock;
+
+		const Eigen::Matrix4f VP = _viewProjection;
+		const uint32_t nr_objects = static_cast<uint32_t>(_spheres.size());
+
+		// Frustum planes (Gribb and Hartmann)
+		Eigen::Vector4f planes[6];
+		for (int i = 0; i < 3; i++)
+		{
+			planes[2*i + 0] = VP.row(3).transpose() + VP.row(i).transpose();
+			planes[2*i + 1] = VP.row(3).transpose() - VP.row(i).transpose();
+		}
+		for (auto& plane : planes)
+			plane /= plane.head<3>().norm();
+
+		// Frustum culling, ordered by the depth of the centers
+		std::vector<std::pair<float, uint32_t>> candidates;
+		candidates.reserve(nr_objects);
+		for (uint32_t i = 0; i < nr_objects; i++)
+		{
+			const Eigen::Vector4f c{ _spheres[i].x(), _spheres[i].y(), _spheres[i].z(), 1 };
+			bool inside = true;
+			for (const auto& plane : planes)
+				inside = inside && plane.dot(c) >= -_spheres[i].w();
+			if (inside)
+				candidates.emplace_back(VP.row(3).dot(c), i);
+		}
+
+		// Rasterize the closest objects
+		const auto raster_start = clock::now();
+		const size_t nr_occluders = std::min<size_t>(MaxOccluders, candidates.size());
+		std::nth_element(candidates.begin(), candidates.begin() + nr_occluders, candidates.end());
+		OcclusionDetail::Matrix4fArray occluders;
+		occluders.reserve(nr_occluders);
+		for (size_t i = 0; i < nr_occluders; i++)
+			occluders.push_back(_transforms[candidates[i].second]);
+		_buffer.render(VP, _occluderPositions, _occluderIndices.data(), _occluderIndices.size(), occluders);
+
+		// Test the boxes enclosing the spheres against the depth buffer
+		const auto test_start = clock::now();
+		std::vector<std::vector<uint32_t>> visible(hardwareThreads());
+		parallelFor(0, candidates.size(), 1024, [this, &VP, &candidates, &visible](size_t chunk, size_t b, size_t e)
+		{
+			for (size_t c = b; c < e; c++)
+			{
+				const uint32_t i = candidates[c].second;
+				if (isVisible(VP, _spheres[i]))
+					visible[chunk].push_back(i);
+			}
+		});
+
+		_visible.clear();
+		for (const auto& v : visible)
+			_visible.insert(_visible.end(), v.begin(), v.end());
+
+		const auto end = clock::now();
+		_stats.FrustumCulled = nr_objects - static_cast<uint32_t>(candidates.size());
+		_stats.Visible = static_cast<uint32_t>(_visible.size());
+		_stats.Occluded = static_cast<uint32_t>(candidates.size() - _visible.size());
+		_stats.OccluderTriangles = _buffer.nrTriangles();
+		_stats.RasterMs = std::chrono::duration<double, std::milli>(test_start - raster_start).count();
+		_stats.TestMs = std::chrono::duration<double, std::milli>(end - test_start).count();
+	}
+
+	bool isVisible(const Eigen::Matrix4f& VP, const Eigen::Vector4f& sphere) const
+	{
+		float min_x = std::numeric_limits<float>::max(), max_x = -min_x;
+		float min_y = min_x, max_y = -min_x;
+		float max_inv_w = 0;
+
+		// Corners of the box enclosing the sphere, offsets along the axes
+		// are added in clip space
+		const Eigen::Vector4f center = VP * Eigen::Vector4f{ sphere.x(), sphere.y(), sphere.z(), 1 };
+		const Eigen::Vector4f axes[] = { sphere.w() * VP.col(0), sphere.w() * VP.col(1), sphere.w() * VP.col(2) };
+		for (int k = 0; k < 8; k++)
+		{
+			const Eigen::Vector4f clip =
+				center +
+				((k & 1) ? axes[0] : -axes[0]) +
+				((k & 2) ? axes[1] : -axes[1]) +
+				((k & 4) ? axes[2] : -axes[2]);
+
+			// Boxes crossing the near plane are visible
+			if (clip.w() <= 1e-4f)
+				return true;
+
+			const float x = (clip.x() / clip.w() * 0.5f + 0.5f) * OcclusionBuffer::Width;
+			const float y = (clip.y() / clip.w() * 0.5f + 0.5f) * OcclusionBuffer::Height;
+			min_x = std::min(min_x, x); max_x = std::max(max_x, x);
+			min_y = std::min(min_y, y); max_y = std::max(max_y, y);
+			max_inv_w = std::max(max_inv_w, 1 / clip.w());
+		}
+
+		return _buffer.isVisible
+		(
+			static_cast<int>(std::floor(min_x)), static_cast<int>(std::floor(min_y)),
+			static_cast<int>(std::floor(max_x)), static_cast<int>(std::floor(max_y)),
+			max_inv_w
+		);
+	}
+
+	//! Worker running the culling jobs
+	std::thread _worker;
+	std::mutex _mutex;
+	std::condition_variable _wakeup;
+	std::condition_variable _done;
+	bool _pending{ false };
+	bool _quit{ false };
+
+	//! Input of the current job
+	Eigen::Matrix4f _viewProjection;
+	std::vector<Eigen::Vector3f> _occluderPositions;
+	std::vector<uint32_t> _occluderIndices;
+	OcclusionDetail::Matrix4fArray _transforms;
+	OcclusionDetail::Vector4fArray _spheres;
+
+	//! Output of the last job
+	OcclusionBuffer _buffer;
+	std::vector<uint32_t> _visible;
+	OcclusionCullingStatistics _stats;
+};
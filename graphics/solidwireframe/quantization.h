@@ -0,0 +1,167 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/eigen.h>
+
+// C++ standard library
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../parallel.h"
+
+//! Map 'v' in [0, 1] to a 16-bit unsigned normalized integer
+inline uint16_t quantizeUnorm16(float v)
+{
+	return static_cast<uint16_t>(std::lround(std::min(std::max(v, 0.0f), 1.0f) * 65535.0f));
+}
+
+inline float dequantizeUnorm16(uint16_t v)
+{
+	return v / 65535.0f;
+}
+
+//! Map 'v' in [-1, 1] to a 16-bit signed normalized integer
+inline int16_t quantizeSnorm16(float v)
+{
+	return static_cast<int16_t>(std::lround(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f));
+}
+
+inline float dequantizeSnorm16(int16_t v)
+{
+	return std::max(v / 32767.0f, -1.0f);
+}
+
+//! Position relative to an axis-aligned box, quantized to 16 bits per component
+inline std::array<uint16_t, 3> quantizePosition(const Eigen::Vector3f& p, const Eigen::AlignedBox3f& bounds)
+{
+	const Eigen::Vector3f extent = bounds.sizes().cwiseMax(Eigen::Vector3f::Constant(1e-20f));
+	const Eigen::Vector3f rel = (p - bounds.min()).cwiseQuotient(extent);
+	return { quantizeUnorm16(rel.x()), quantizeUnorm16(rel.y()), quantizeUnorm16(rel.z()) };
+}
+
+inline Eigen::Vector3f dequantizePosition(const uint16_t* q, const Eigen::AlignedBox3f& bounds)
+{
+	const Eigen::Vector3f rel{ dequantizeUnorm16(q[0]), dequantizeUnorm16(q[1]), dequantizeUnorm16(q[2]) };
+	return bounds.min() + rel.cwiseProduct(bounds.sizes());
+}
+
+/*!
+ * Octahedral normal encoding: the unit sphere is projected onto an
+ * octahedron, which is unfolded into the square [-1, 1]^2.
+ * Cigolle et al., A Survey of Efficient Representations for Independent
+ * Unit Vectors, JCGT 2014
+ */
+inline Eigen::Vector2f octEncode(const Eigen::Vector3f& n)
+{
+	const Eigen::Vector3f p = n / (std::abs(n.x()) + std::abs(n.y()) + std::abs(n.z()));
+	if (p.z() >= 0)
+		return { p.x(), p.y() };
+
+	return
+	{
+		(1 - std::abs(p.y())) * (p.x() >= 0 ? 1.0f : -1.0f),
+		(1 - std::abs(p.x())) * (p.y() >= 0 ? 1.0f : -1.0f)
+	};
+}
+
+inline Eigen::Vector3f octDecode(const Eigen::Vector2f& e)
+{
+	Eigen::Vector3f n{ e.x(), e.y(), 1 - std::abs(e.x()) - std::abs(e.y()) };
+	if (n.z() < 0)
+	{
+		const float x = n.x();
+		n.x() = (1 - std::abs(n.y())) * (x >= 0 ? 1.0f : -1.0f);
+		n.y() = (1 - std::abs(x)) * (n.y() >= 0 ? 1.0f : -1.0f);
+	}
+	return n.normalized();
+}
+
+//! Octahedral normal quantized to two 16-bit signed normalized integers
+inline std::array<int16_t, 2> quantizeNormal(const Eigen::Vector3f& n)
+{
+	const Eigen::Vector2f e = octEncode(n);
+	return { quantizeSnorm16(e.x()), quantizeSnorm16(e.y()) };
+}
+
+inline Eigen::Vector3f dequantizeNormal(const int16_t* q)
+{
+	return octDecode({ dequantizeSnorm16(q[0]), dequantizeSnorm16(q[1]) });
+}
+
+//! Largest deviation introduced by the quantized vertex formats
+struct QuantizationError
+{
+	//! Distance between original and quantized positions in object space
+	float Position{ 0 };
+
+	//! Upper bound of the position error, half a quantization step per axis
+	float PositionBound{ 0 };
+
+	//! Angle between original and quantized normals in degrees
+	float NormalDegrees{ 0 };
+};
+
+//! Measure the error of quantizing the given positions and normals. The
+//! vertices are processed in parallel chunks, each keeps its own maximum.
+inline QuantizationError measureQuantizationError
+(
+	const std::vector<Eigen::Vector3f>& positions,
+	const std::vector<Eigen::Vector3f>& normals,
+	const Eigen::AlignedBox3f& bounds
+)
+{
+	QuantizationError error;
+	error.PositionBound = 0.5f * bounds.sizes().norm() / 65535.0f;
+
+	std::vector<float> max_distance(hardwareThreads(), 0.0f);
+	std::vector<float> min_cos(hardwareThreads(), 1.0f);
+	parallelFor(0, std::max(positions.size(), normals.size()), 1 << 14, [&](size_t chunk, size_t b, size_t e)
+	{
+		for (size_t v = b; v < e; v++)
+		{
+			if (v < positions.size())
+			{
+				const auto q = quantizePosition(positions[v], bounds);
+				max_distance[chunk] = std::max(max_distance[chunk], (dequantizePosition(q.data(), bounds) - positions[v]).norm());
+			}
+			if (v < normals.size() && normals[v].squaredNorm() > 0)
+			{
+				const auto q = quantizeNormal(normals[v]);
+				min_cos[chunk] = std::min(min_cos[chunk], dequantizeNormal(q.data()).dot(normals[v].normalized()));
+			}
+		}
+	});
+
+	error.Position = *std::max_element(max_distance.begin(), max_distance.end());
+	const float cos_angle = *std::min_element(min_cos.begin(), min_cos.end());
+	error.NormalDegrees = std::acos(std::min(std::max(cos_angle, -1.0f), 1.0f)) * 180.0f / 3.14159265f;
+
+	return error;
+}
@@ -0,0 +1,65 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#version 430 core
+#extension GL_ARB_enhanced_layouts : enable
+
+#include "solidwireframe.h"
+#include "solidwireframe.glsl"
+
+////////////////////////////////////////////////////////////////////////////////
+// Shader Input
+////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) in VertexData
+{
+	// View space position
+	vec3 Position;
+
+	// View space surface normal
+	vec3 Normal;
+	
+	// Barycentric coordinates
+	vec2 BarycentricCoords;
+} In;
+
+////////////////////////////////////////////////////////////////////////////////
+// Shader Output
+////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) out vec4 FragColour;
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+// Colour of the highlighted face
+const vec3 highlight = vec3(1.0f, 0.5f, 0.0f);
+
+void main(void)
+{
+	vec3 baryc;
+	baryc.xy = In.BarycentricCoords;
+	baryc.z = 1 - In.BarycentricCoords.x - In.BarycentricCoords.y;
+
+	FragColour = vec4(solidWireframe(baryc, highlight, Smoothing, Thickness, Colour), 1);
+}
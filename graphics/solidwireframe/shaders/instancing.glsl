@@ -0,0 +1,77 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef GLSL_INSTANCING
+#define GLSL_INSTANCING
+
+#include "drawcommand.glsl"
+
+struct InstanceData
+{
+	// Transform of the instance
+	mat4 Transform;
+
+	// Bounding sphere (center, radius) after applying the transform
+	vec4 BoundingSphere;
+};
+
+layout(std430, binding = 2) buffer SceneInstances
+{
+	InstanceData Instances[];
+};
+
+layout(std430, binding = 3) buffer SceneVisibleInstances
+{
+	// Indices into 'Instances' which passed the culling
+	uint VisibleInstances[];
+};
+
+layout(std430, binding = 4) buffer SceneDrawCommand
+{
+	DrawCommand Command;
+};
+
+struct InstanceTransform
+{
+	// Rows of the affine transform to view space
+	vec4 ModelView[3];
+
+	// Rows of the inverse-transpose of the upper 3x3 block of 'ModelView'
+	vec4 Normal[3];
+};
+
+layout(std430, binding = 8) readonly buffer SceneInstanceTransforms
+{
+	// Transforms of the instances, computed on the CPU each frame
+	InstanceTransform InstanceTransforms[];
+};
+
+// Transform of an instance to view space
+mat4 instanceModelView(uint instance)
+{
+	const InstanceTransform T = InstanceTransforms[instance];
+	return transpose(mat4(T.ModelView[0], T.ModelView[1], T.ModelView[2], vec4(0, 0, 0, 1)));
+}
+
+#endif // GLSL_INSTANCING
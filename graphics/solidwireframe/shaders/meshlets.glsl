@@ -0,0 +1,65 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef GLSL_MESHLETS
+#define GLSL_MESHLETS
+
+#include "drawcommand.glsl"
+
+// Matches 'Meshlet' in meshlets.h
+struct Meshlet
+{
+	// Sphere (center, radius) enclosing the vertices of the meshlet
+	vec4 BoundingSphere;
+
+	// Average triangle normal and cosine of the cone angle around it
+	vec4 Cone;
+
+	// Range of triangles in the index buffer
+	uint FirstTriangle;
+	uint NrTriangles;
+	uint NrVertices;
+	uint Padding;
+};
+
+layout(std430, binding = 5) readonly buffer MeshMeshlets
+{
+	Meshlet Meshlets[];
+};
+
+layout(std430, binding = 6) buffer MeshVisibleTriangles
+{
+	// Triangles of the meshlets which passed the culling
+	uint VisibleTriangles[];
+};
+
+layout(std430, binding = 7) buffer MeshletDrawCommand
+{
+	DrawCommand MeshletCommand;
+
+	// Number of meshlets which passed the culling
+	uint VisibleMeshlets;
+};
+
+#endif // GLSL_MESHLETS
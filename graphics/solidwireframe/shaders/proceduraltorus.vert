@@ -0,0 +1,91 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#version 430 core
+#extension GL_ARB_enhanced_layouts : enable
+
+#include "solidwireframe.h"
+
+// Torus generated from the vertex index without any vertex or index buffer.
+// The torus is split into 'TorusRings' x 'TorusSides' quads of two triangles
+// each, the mesh is drawn with three vertices per triangle.
+
+////////////////////////////////////////////////////////////////////////////////
+// Shader Output
+////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) out VertexData
+{
+	// View space position
+	vec3 Position;
+
+	// View space surface normal
+	vec3 Normal;
+
+	// Barycentric coordinates
+	vec2 BarycentricCoords;
+} Out;
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+const float pi = 3.14159265358979f;
+
+// Grid offsets of the corners of the two triangles of a quad, counter-clockwise
+// when seen from outside
+const uvec2 quad_corners[] = {
+	uvec2(0, 0), uvec2(1, 0), uvec2(1, 1),
+	uvec2(0, 0), uvec2(1, 1), uvec2(0, 1)
+};
+
+const vec2 barycentric_coords[] = {
+	vec2(1, 0),
+	vec2(0, 1),
+	vec2(0, 0)
+};
+
+void main()
+{
+	const uint rings = uint(TorusRings);
+	const uint sides = uint(TorusSides);
+
+	const uint tri = uint(gl_VertexID) / 3;
+	const uint corner = uint(gl_VertexID) % 3;
+	const uint quad = tri / 2;
+	const uvec2 grid = uvec2(quad % rings, quad / rings) + quad_corners[3*(tri % 2) + corner];
+
+	// Angle around the axis of the torus and around the tube
+	const float u = 2 * pi * float(grid.x % rings) / float(rings);
+	const float v = 2 * pi * float(grid.y % sides) / float(sides);
+
+	const vec3 n = vec3(cos(v) * cos(u), cos(v) * sin(u), sin(v));
+	const vec3 p = vec3(TorusRadius0 * cos(u), TorusRadius0 * sin(u), 0) + TorusRadius1 * n;
+
+	// Pass data
+	const vec4 pos_vs = ViewMatrix * ModelMatrix * vec4(p, 1);
+	Out.Position = pos_vs.xyz;
+	Out.Normal = (NormalMatrix * vec4(n, 0)).xyz;
+	Out.BarycentricCoords = barycentric_coords[corner];
+
+	gl_Position = ProjectionMatrix * pos_vs;
+}
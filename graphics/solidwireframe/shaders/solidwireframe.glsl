@@ -28,13 +28,14 @@
 // Generate a solid wireframe based on the barycentric coordinates of the
 // triangle. Base concept can be found here:
 // https://catlikecoding.com/unity/tutorials/advanced-rendering/flat-and-wireframe-shading/
+// The screen-space rate of change of the coordinates, 'deltas', determines the
+// width of the lines in pixels.
 vec3 solidWireframe
 (
-	vec3 baryc, vec3 ground_colour,
+	vec3 baryc, vec3 deltas, vec3 ground_colour,
 	float smoothing, float thickness, vec3 wireframe_colour
 )
 {
-	vec3 deltas = fwidth(baryc);
 	vec3 s = deltas * smoothing;
 	vec3 t = deltas * thickness;
 	baryc = smoothstep(t, t+ s, baryc);
@@ -43,4 +44,13 @@ vec3 solidWireframe
 	return mix(wireframe_colour, ground_colour, min_baryc);
 }
 
+vec3 solidWireframe
+(
+	vec3 baryc, vec3 ground_colour,
+	float smoothing, float thickness, vec3 wireframe_colour
+)
+{
+	return solidWireframe(baryc, fwidth(baryc), ground_colour, smoothing, thickness, wireframe_colour);
+}
+
 #endif // GLSL_SOLIDWIREFRAME
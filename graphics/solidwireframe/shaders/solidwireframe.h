@@ -67,4 +67,59 @@ UNIFORM_BUFFER(2) SolidWireframeData
 	float Thickness;
 };
 
+UNIFORM_BUFFER(3) DequantizationData
+{
+	// Minimum corner of the bounding box of quantized positions
+	vec4 PositionOffset;
+
+	// Extent of the bounding box of quantized positions
+	vec4 PositionScale;
+};
+
+UNIFORM_BUFFER(4) InstanceCullingData
+{
+	// Frustum planes (normal, distance) in the space of the instance transforms
+	vec4 FrustumPlanes[6];
+
+	// Number of instances to cull
+	int NrInstances;
+};
+
+UNIFORM_BUFFER(5) MeshletCullingData
+{
+	// Frustum planes (normal, distance) in object space
+	vec4 MeshletFrustumPlanes[6];
+
+	// Camera position in object space
+	vec4 CameraPosition;
+
+	// Range of meshlets to cull
+	int FirstMeshlet;
+	int NrMeshlets;
+};
+
+UNIFORM_BUFFER(6) VisibilityBufferData
+{
+	// Transform from screen to view space
+	mat4 InverseProjectionMatrix;
+
+	// Number of low bits of an ID storing the triangle, the high bits store
+	// the instance
+	int TriangleBits;
+
+	// Non-zero if the IDs refer to 'Instances'
+	int Instanced;
+};
+
+UNIFORM_BUFFER(7) ProceduralTorusData
+{
+	// Radius of the ring and of the tube
+	float TorusRadius0;
+	float TorusRadius1;
+
+	// Number of quads around the ring and around the tube
+	int TorusRings;
+	int TorusSides;
+};
+
 #endif // GLSL_SOLIDWIREFRAME_H
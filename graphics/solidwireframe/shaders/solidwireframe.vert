@@ -27,6 +27,13 @@
 
 #include "solidwireframe.h"
 
+////////////////////////////////////////////////////////////////////////////////
+// Shader Configuration
+////////////////////////////////////////////////////////////////////////////////
+// Whether the vertex stream holds normals. Position-only streams specialize
+// this to 0, which removes the fetch of the normal.
+layout(constant_id = 0) const uint VertexNormals = 1;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Shader Input
 ////////////////////////////////////////////////////////////////////////////////
@@ -56,7 +63,10 @@ void main()
 
 	// Pass data
 	Out.Position  = pos_vs.xyz;
-	Out.Normal    = (NormalMatrix * vec4(normal, 0)).xyz;
+	if (VertexNormals != 0)
+		Out.Normal = (NormalMatrix * vec4(normal, 0)).xyz;
+	else
+		Out.Normal = vec3(0);
 
 	// Transform the point to view space
 	gl_Position = ProjectionMatrix * pos_vs;
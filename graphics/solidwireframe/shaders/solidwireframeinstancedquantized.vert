@@ -0,0 +1,47 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#version 430 core
+#extension GL_ARB_enhanced_layouts : enable
+
+#define SOLIDWIREFRAME_INSTANCED
+
+#include "solidwireframepull.glsl"
+#include "quantization.glsl"
+
+////////////////////////////////////////////////////////////////////////////////
+// Vertex positions
+////////////////////////////////////////////////////////////////////////////////
+layout(std430, binding = 0) readonly buffer MeshPositions
+{
+	// Vertex positions, 4 x 16-bit normalized relative to the bounding box
+	uvec2 Positions[];
+};
+
+vec3 loadPosition(uint idx)
+{
+	const vec2 xy = unpackUnorm2x16(Positions[idx].x);
+	const vec2 zw = unpackUnorm2x16(Positions[idx].y);
+	return dequantizePosition(vec3(xy, zw.x), PositionOffset, PositionScale);
+}
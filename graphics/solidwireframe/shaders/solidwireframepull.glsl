@@ -0,0 +1,115 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef GLSL_SOLIDWIREFRAMEPULL
+#define GLSL_SOLIDWIREFRAMEPULL
+
+// Solid wireframe without geometry shader. The mesh is drawn without vertex
+// buffers, the vertex data is pulled from storage buffers.
+//
+// SOLIDWIREFRAME_INSTANCED: Transform by the culled instances of instancing.glsl
+// SOLIDWIREFRAME_MESHLETS:  Draw the culled triangles of meshlets.glsl
+
+#include "solidwireframe.h"
+#ifdef SOLIDWIREFRAME_INSTANCED
+#	include "instancing.glsl"
+#endif
+#ifdef SOLIDWIREFRAME_MESHLETS
+#	include "meshlets.glsl"
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Shader Input
+////////////////////////////////////////////////////////////////////////////////
+layout(std430, binding = 1) readonly buffer MeshIndices
+{
+	// Three vertex indices per triangle
+	uint Indices[];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Shader Output
+////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) out VertexData
+{
+	// View space position
+	vec3 Position;
+
+	// View space surface normal
+	vec3 Normal;
+
+	// Barycentric coordinates
+	vec2 BarycentricCoords;
+} Out;
+
+// Triangle and instance drawn, consumed by the visibility buffer
+layout(location = 3) flat out uvec2 PrimitiveID;
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+const vec2 barycentric_coords[] = {
+	vec2(1, 0),
+	vec2(0, 1),
+	vec2(0, 0)
+};
+
+// Object space position of the vertex 'idx', defined by the including shader
+vec3 loadPosition(uint idx);
+
+void main()
+{
+	// The mesh is drawn without vertex buffers and three vertices per triangle,
+	// the vertex data is pulled using the index buffer
+#ifdef SOLIDWIREFRAME_MESHLETS
+	const uint tri = VisibleTriangles[uint(gl_VertexID) / 3];
+#else
+	const uint tri = uint(gl_VertexID) / 3;
+#endif
+	const uint corner = uint(gl_VertexID) % 3;
+
+#ifdef SOLIDWIREFRAME_INSTANCED
+	// Each instance is one of the instances which passed the culling
+	const uint instance = VisibleInstances[gl_InstanceID];
+	const mat4 MV = instanceModelView(instance);
+#else
+	const uint instance = 0;
+	const mat4 MV = ViewMatrix * ModelMatrix;
+#endif
+	const vec3 p0 = (MV * vec4(loadPosition(Indices[3*tri + 0]), 1)).xyz;
+	const vec3 p1 = (MV * vec4(loadPosition(Indices[3*tri + 1]), 1)).xyz;
+	const vec3 p2 = (MV * vec4(loadPosition(Indices[3*tri + 2]), 1)).xyz;
+	const vec3 pos_vs = corner == 0 ? p0 : (corner == 1 ? p1 : p2);
+
+	// Pass data
+	Out.Position = pos_vs;
+	Out.Normal = normalize(cross(p1 - p0, p2 - p0));
+	Out.BarycentricCoords = barycentric_coords[corner];
+	PrimitiveID = uvec2(tri, instance);
+
+	// Transform the point to view space
+	gl_Position = ProjectionMatrix * vec4(pos_vs, 1);
+}
+
+#endif // GLSL_SOLIDWIREFRAMEPULL
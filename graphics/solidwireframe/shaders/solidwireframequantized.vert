@@ -0,0 +1,78 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#version 430 core
+#extension GL_ARB_enhanced_layouts : enable
+
+#include "solidwireframe.h"
+#include "quantization.glsl"
+
+////////////////////////////////////////////////////////////////////////////////
+// Shader Configuration
+////////////////////////////////////////////////////////////////////////////////
+// Whether the vertex stream holds normals. Position-only streams specialize
+// this to 0, which removes the fetch of the normal.
+layout(constant_id = 0) const uint VertexNormals = 1;
+
+////////////////////////////////////////////////////////////////////////////////
+// Shader Input
+////////////////////////////////////////////////////////////////////////////////
+// 16-bit normalized position relative to the bounding box
+layout(location = 0) in vec4 position;
+
+// Octahedral normal, 2 x 16-bit signed normalized
+layout(location = 1) in vec2 normal;
+
+////////////////////////////////////////////////////////////////////////////////
+// Shader Output
+////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) out VertexData
+{
+	// View space position
+	vec3 Position;
+
+	// View space surface normal
+	vec3 Normal;
+
+} Out;
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+void main()
+{
+	vec3 pos = dequantizePosition(position.xyz, PositionOffset, PositionScale);
+	vec4 pos_vs = ViewMatrix * ModelMatrix * vec4(pos, 1);
+
+	// Pass data
+	Out.Position  = pos_vs.xyz;
+	if (VertexNormals != 0)
+		Out.Normal = (NormalMatrix * vec4(octDecode(normal), 0)).xyz;
+	else
+		Out.Normal = vec3(0);
+
+	// Transform the point to view space
+	gl_Position = ProjectionMatrix * pos_vs;
+}
@@ -0,0 +1,126 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef GLSL_VISIBILITYRESOLVE
+#define GLSL_VISIBILITYRESOLVE
+
+// Shade the solid wireframe from the visibility buffer. The barycentric
+// coordinates are reconstructed by intersecting the view ray of each pixel
+// with the triangle stored in the visibility buffer.
+
+#include "solidwireframe.h"
+#include "solidwireframe.glsl"
+#include "instancing.glsl"
+
+////////////////////////////////////////////////////////////////////////////////
+// Shader Input
+////////////////////////////////////////////////////////////////////////////////
+layout(binding = 0) uniform usampler2D VisibilityIDs;
+
+layout(std430, binding = 1) readonly buffer MeshIndices
+{
+	// Three vertex indices per triangle
+	uint Indices[];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Shader Output
+////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) out vec4 FragColour;
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+// Light position (point-light)
+const vec4 point_light = vec4(-1, 0, 1, 1);
+
+// Object space position of the vertex 'idx', defined by the including shader
+vec3 loadPosition(uint idx);
+
+// View space direction of the ray through the window position 'frag_coord'
+vec3 viewRay(vec2 frag_coord)
+{
+	const vec2 ndc = 2 * (frag_coord - Viewport.xy) / Viewport.zw - 1;
+	const vec4 p = InverseProjectionMatrix * vec4(ndc, 1, 1);
+	return p.xyz / p.w;
+}
+
+// Barycentric coordinates of the intersection of the ray from the view space
+// origin along 'dir' with the plane of the triangle (p0, p1, p2)
+vec3 rayBarycentrics(vec3 dir, vec3 p0, vec3 p1, vec3 p2)
+{
+	const vec3 e1 = p1 - p0;
+	const vec3 e2 = p2 - p0;
+	const vec3 p = cross(dir, e2);
+	const vec3 t = -p0;
+	const vec3 q = cross(t, e1);
+	const float inv_det = 1.0f / dot(e1, p);
+	const float u = dot(t, p) * inv_det;
+	const float v = dot(dir, q) * inv_det;
+	return vec3(1 - u - v, u, v);
+}
+
+void main(void)
+{
+	const uint id = texelFetch(VisibilityIDs, ivec2(gl_FragCoord.xy), 0).r;
+	if (id == 0xffffffff)
+		discard;
+
+	const uint tri = id & ((1u << uint(TriangleBits)) - 1u);
+	const uint instance = id >> uint(TriangleBits);
+
+	const mat4 MV = Instanced != 0 ? instanceModelView(instance) : ViewMatrix * ModelMatrix;
+
+	const vec3 p0 = (MV * vec4(loadPosition(Indices[3*tri + 0]), 1)).xyz;
+	const vec3 p1 = (MV * vec4(loadPosition(Indices[3*tri + 1]), 1)).xyz;
+	const vec3 p2 = (MV * vec4(loadPosition(Indices[3*tri + 2]), 1)).xyz;
+
+	// Barycentric coordinates of the pixel and its neighbours. The screen-space
+	// derivatives are computed analytically, as the neighbouring pixels may
+	// belong to other triangles.
+	const vec3 baryc = rayBarycentrics(viewRay(gl_FragCoord.xy), p0, p1, p2);
+	const vec3 baryc_x = rayBarycentrics(viewRay(gl_FragCoord.xy + vec2(1, 0)), p0, p1, p2);
+	const vec3 baryc_y = rayBarycentrics(viewRay(gl_FragCoord.xy + vec2(0, 1)), p0, p1, p2);
+	const vec3 deltas = abs(baryc_x - baryc) + abs(baryc_y - baryc);
+
+	vec3 albedo = vec3(0.7f, 0.7f, 0.7f);
+	vec3 specular = vec3(0.2f, 0.2f, 0.2f);
+	float shininess = 32;
+
+	albedo = solidWireframe(baryc, deltas, albedo, Smoothing, Thickness, Colour);
+
+	const vec3 position = baryc.x * p0 + baryc.y * p1 + baryc.z * p2;
+	const vec3 N = normalize(cross(p1 - p0, p2 - p0));
+
+	const vec3 view_dir = -normalize(position);
+	const vec3 light_dir = normalize(position - (ViewMatrix * point_light).xyz);
+
+	const float diff_refl = max(0, dot(N, -light_dir));
+	const float spec_refl = pow(max(0, dot(reflect(-light_dir, N), -view_dir)), shininess);
+
+	FragColour = vec4(albedo*diff_refl + specular*spec_refl, 1);
+}
+
+#endif // GLSL_VISIBILITYRESOLVE
@@ -0,0 +1,117 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/eigen.h>
+
+// C++ standard library
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+// Project
+#include "../parallel.h"
+#include "mesh.h"
+
+/*!
+ * Write the vertices of a torus with 'rings' x 'sides' vertices, see
+ * 'createTorus', into 'mesh'. Changing only the radii of an existing torus
+ * keeps its indices valid, such that only the vertices are rewritten.
+ */
+inline void writeTorusVertices(MeshData& mesh, float radius0, float radius1, uint32_t rings, uint32_t sides)
+{
+	const float two_pi = 6.28318530718f;
+	const size_t nr_vertices = size_t{ rings } * sides;
+	mesh.Positions.resize(nr_vertices);
+	mesh.Normals.resize(nr_vertices);
+
+	parallelFor(0, rings, 16, [&](size_t, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const float u = two_pi * i / rings;
+			const float cos_u = std::cos(u);
+			const float sin_u = std::sin(u);
+			const size_t i0 = i * sides;
+			for (uint32_t j = 0; j < sides; j++)
+			{
+				const float v = two_pi * j / sides;
+				const Eigen::Vector3f n{ std::cos(v) * cos_u, std::cos(v) * sin_u, std::sin(v) };
+				mesh.Positions[i0 + j] = Eigen::Vector3f{ radius0 * cos_u, radius0 * sin_u, 0 } + radius1 * n;
+				mesh.Normals[i0 + j] = n;
+			}
+		}
+	});
+}
+
+//! Box enclosing a torus, independent of its resolution
+inline Eigen::AlignedBox3f torusBounds(float radius0, float radius1)
+{
+	const float r = std::abs(radius0) + std::abs(radius1);
+	return { Eigen::Vector3f{ -r, -r, -std::abs(radius1) }, Eigen::Vector3f{ r, r, std::abs(radius1) } };
+}
+
+/*!
+ * Create a torus around the z-axis with 'rings' x 'sides' quads of two
+ * triangles each. 'radius0' is the radius of the ring, 'radius1' the radius
+ * of the tube. The rings are generated in parallel, each writes a disjoint
+ * range of the vertices and indices. The triangles match the ones computed
+ * by 'proceduraltorus.vert'.
+ */
+inline MeshData createTorus(float radius0, float radius1, uint32_t rings, uint32_t sides)
+{
+	if (rings < 3 || sides < 3)
+		throw std::runtime_error("A torus requires at least three rings and sides.");
+	if (uint64_t{ rings } * sides * 6 > 0xffffffffu)
+		throw std::runtime_error("Torus exceeds 32-bit indices.");
+
+	const size_t nr_vertices = size_t{ rings } * sides;
+
+	MeshData mesh;
+	writeTorusVertices(mesh, radius0, radius1, rings, sides);
+	mesh.Indices.resize(6 * nr_vertices);
+
+	parallelFor(0, rings, 16, [&](size_t, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const uint32_t i0 = static_cast<uint32_t>(i * sides);
+			const uint32_t i1 = static_cast<uint32_t>(((i + 1) % rings) * sides);
+
+			uint32_t* indices = mesh.Indices.data() + 6 * i0;
+			for (uint32_t j = 0; j < sides; j++)
+			{
+				// Quad (i, j), (i + 1, j), (i + 1, j + 1), (i, j + 1)
+				const uint32_t j1 = (j + 1) % sides;
+				const uint32_t quad[] = { i0 + j, i1 + j, i1 + j1, i0 + j1 };
+				*indices++ = quad[0]; *indices++ = quad[1]; *indices++ = quad[2];
+				*indices++ = quad[0]; *indices++ = quad[2]; *indices++ = quad[3];
+			}
+		}
+	});
+
+	return mesh;
+}
@@ -0,0 +1,258 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/eigen.h>
+
+// C++ standard library
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "../parallel.h"
+#include "../simd.h"
+
+//! Transform of an object to view space, matches 'InstanceTransform' in instancing.glsl
+struct InstanceTransform
+{
+	//! Rows of the affine transform to view space
+	float ModelView[3][4];
+
+	//! Rows of the inverse-transpose of the upper 3x3 block of 'ModelView',
+	//! the fourth column is padding
+	float Normal[3][4];
+};
+static_assert(sizeof(InstanceTransform) == 96, "Instance transforms are expected to be 96 bytes.");
+
+//! Time to compute the transforms of a number of objects
+struct TransformTiming
+{
+	//! Number of transformed objects
+	uint32_t Objects;
+
+	//! One Eigen 4x4 inverse per object
+	double EigenMs;
+
+	//! SIMD kernels on the structure-of-arrays storage
+	double BatchedMs;
+};
+
+//! Inverse-transpose of the upper 3x3 block of an affine transform
+inline Eigen::Matrix4f normalMatrix(const Eigen::Matrix4f& model_view)
+{
+	Eigen::Matrix4f N = Eigen::Matrix4f::Identity();
+	N.topLeftCorner<3, 3>() = model_view.topLeftCorner<3, 3>().inverse().transpose();
+	return N;
+}
+
+/*!
+ * Affine object transforms in structure-of-arrays layout. Each of the twelve
+ * elements of the upper 3x4 block is stored in its own array, such that the
+ * kernels transform one object per SIMD lane without shuffling. The model-view
+ * and normal matrices of all objects are computed in parallel chunks and
+ * written object by object, which suits write-combined mapped memory.
+ */
+class TransformBatch
+{
+	using FloatV = Simd::FloatV;
+
+public:
+	size_t size() const { return _size; }
+
+	//! Resize the batch, new objects have a zero transform
+	void resize(size_t nr_objects)
+	{
+		_size = nr_objects;
+		_stride = (nr_objects + FloatV::Width - 1) / FloatV::Width * FloatV::Width;
+		_elements.assign(12 * _stride, 0.0f);
+	}
+
+	//! Store the affine part of the transform of an object
+	void set(size_t i, const Eigen::Matrix4f& T)
+	{
+		for (int r = 0; r < 3; r++)
+			for (int c = 0; c < 4; c++)
+				_elements[(4 * r + c) * _stride + i] = T(r, c);
+	}
+
+	Eigen::Matrix4f get(size_t i) const
+	{
+		Eigen::Matrix4f T = Eigen::Matrix4f::Identity();
+		for (int r = 0; r < 3; r++)
+			for (int c = 0; c < 4; c++)
+				T(r, c) = _elements[(4 * r + c) * _stride + i];
+		return T;
+	}
+
+	//! Compute the transforms of all objects to view space. 'view_model' is
+	//! applied after the object transforms and must be affine.
+	void compute(const Eigen::Matrix4f& view_model, InstanceTransform* out) const
+	{
+		const size_t nr_blocks = _stride / FloatV::Width;
+		parallelFor(0, nr_blocks, 256, [&](size_t, size_t begin, size_t end)
+		{
+			for (size_t b = begin; b < end; b++)
+				computeBlock(view_model, b * FloatV::Width, out);
+		});
+	}
+
+	//! Reference path with one full 4x4 inverse per object
+	void computeReference(const Eigen::Matrix4f& view_model, InstanceTransform* out) const
+	{
+		for (size_t i = 0; i < _size; i++)
+		{
+			const Eigen::Matrix4f MV = view_model * get(i);
+			const Eigen::Matrix4f N = MV.inverse().transpose();
+			for (int r = 0; r < 3; r++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					out[i].ModelView[r][c] = MV(r, c);
+					out[i].Normal[r][c] = c < 3 ? N(r, c) : 0.0f;
+				}
+			}
+		}
+	}
+
+private:
+	void computeBlock(const Eigen::Matrix4f& V, size_t first, InstanceTransform* out) const
+	{
+		FloatV o[12];
+		for (int k = 0; k < 12; k++)
+			o[k] = FloatV::load(&_elements[k * _stride + first]);
+
+		// Model-view: the rows of 'V' times the columns of the object transforms
+		FloatV mv[12];
+		for (int r = 0; r < 3; r++)
+		{
+			const FloatV v0 = FloatV::set(V(r, 0));
+			const FloatV v1 = FloatV::set(V(r, 1));
+			const FloatV v2 = FloatV::set(V(r, 2));
+			for (int c = 0; c < 4; c++)
+			{
+				const FloatV t = FloatV::set(c == 3 ? V(r, 3) : 0.0f);
+				mv[4 * r + c] = madd(v0, o[c], madd(v1, o[4 + c], madd(v2, o[8 + c], t)));
+			}
+		}
+
+		// The inverse-transpose equals the cofactor matrix divided by the determinant
+		const FloatV a00 = mv[0], a01 = mv[1], a02 = mv[2];
+		const FloatV a10 = mv[4], a11 = mv[5], a12 = mv[6];
+		const FloatV a20 = mv[8], a21 = mv[9], a22 = mv[10];
+		FloatV n[9] =
+		{
+			a11 * a22 - a12 * a21, a12 * a20 - a10 * a22, a10 * a21 - a11 * a20,
+			a02 * a21 - a01 * a22, a00 * a22 - a02 * a20, a01 * a20 - a00 * a21,
+			a01 * a12 - a02 * a11, a02 * a10 - a00 * a12, a00 * a11 - a01 * a10
+		};
+		const FloatV det = madd(a00, n[0], madd(a01, n[1], a02 * n[2]));
+		const FloatV zero = FloatV::set(0.0f);
+		const FloatV one = FloatV::set(1.0f);
+		const FloatV inv_det = select((det < zero) | (det > zero), one / det, one);
+		for (auto& e : n)
+			e = e * inv_det;
+
+		// Rows of the output in the order of 'InstanceTransform'
+		FloatV rows[24];
+		std::copy(mv, mv + 12, rows);
+		for (int r = 0; r < 3; r++)
+		{
+			std::copy(n + 3 * r, n + 3 * r + 3, rows + 12 + 4 * r);
+			rows[12 + 4 * r + 3] = zero;
+		}
+
+		// Transpose groups of rows to contiguous pieces of the objects, such
+		// that each object is written sequentially
+		const size_t count = std::min<size_t>(FloatV::Width, _size - first);
+		for (int g = 0; g < 24; g += FloatV::Width)
+		{
+			FloatV group[FloatV::Width];
+			std::copy(rows + g, rows + g + FloatV::Width, group);
+			Simd::transpose(group);
+			for (size_t l = 0; l < count; l++)
+				group[l].store(reinterpret_cast<float*>(out + first + l) + g);
+		}
+	}
+
+	//! Number of objects
+	size_t _size{ 0 };
+
+	//! Distance between the element arrays, a multiple of the SIMD width
+	size_t _stride{ 0 };
+
+	//! Arrays of the elements of the upper 3x4 block of the transforms
+	std::vector<float> _elements;
+};
+
+/*!
+ * Compare the batched and the per-object path for 1k to 1M random objects.
+ * The results are written to heap memory, each timing is the best of three
+ * runs.
+ */
+inline std::vector<TransformTiming> benchmarkTransforms()
+{
+	using ms = std::chrono::duration<double, std::milli>;
+
+	std::mt19937 rng{ 5489u };
+	std::uniform_real_distribution<float> coord{ -1.0f, 1.0f };
+
+	Eigen::Affine3f view = Eigen::Affine3f::Identity();
+	view.translate(Eigen::Vector3f{ 0, 0, -10 });
+	view.rotate(Eigen::AngleAxisf{ 0.5f, Eigen::Vector3f::UnitX() });
+
+	std::vector<TransformTiming> timings;
+	for (uint32_t nr_objects = 1000; nr_objects <= 1000000; nr_objects *= 10)
+	{
+		TransformBatch batch;
+		batch.resize(nr_objects);
+		for (uint32_t i = 0; i < nr_objects; i++)
+		{
+			Eigen::Affine3f T = Eigen::Affine3f::Identity();
+			T.translate(10.0f * Eigen::Vector3f{ coord(rng), coord(rng), coord(rng) });
+			T.rotate(Eigen::AngleAxisf{ 3.14159265f * coord(rng), Eigen::Vector3f{ coord(rng), coord(rng), 1.0f }.normalized() });
+			T.scale(1.5f + coord(rng));
+			batch.set(i, T.matrix());
+		}
+
+		std::vector<InstanceTransform> out(nr_objects);
+		TransformTiming timing{ nr_objects, 1e30, 1e30 };
+		for (int run = 0; run < 3; run++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			batch.computeReference(view.matrix(), out.data());
+			timing.EigenMs = std::min(timing.EigenMs, ms(std::chrono::steady_clock::now() - start).count());
+
+			start = std::chrono::steady_clock::now();
+			batch.compute(view.matrix(), out.data());
+			timing.BatchedMs = std::min(timing.BatchedMs, ms(std::chrono::steady_clock::now() - start).count());
+		}
+		timings.push_back(timing);
+	}
+
+	return timings;
+}
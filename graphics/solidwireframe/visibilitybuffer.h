@@ -0,0 +1,118 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/opengl.h>
+
+// C++ standard library
+#include <cstdint>
+#include <stdexcept>
+
+/*!
+ * Render target of the visibility-buffer path: a 32-bit integer target
+ * storing the ID of the closest triangle per pixel and a depth buffer.
+ */
+class VisibilityBuffer
+{
+public:
+	//! Value of pixels not covered by any triangle
+	static const uint32_t Empty = 0xffffffff;
+
+	VisibilityBuffer() = default;
+	~VisibilityBuffer()
+	{
+		release();
+	}
+	VisibilityBuffer(const VisibilityBuffer&) = delete;
+	VisibilityBuffer& operator=(const VisibilityBuffer&) = delete;
+
+	//! (Re-)create the targets if the size changed
+	void resize(uint32_t width, uint32_t height)
+	{
+		if (width == _width && height == _height)
+			return;
+
+		release();
+		_width = width;
+		_height = height;
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &_ids);
+		glTextureStorage2D(_ids, 1, GL_R32UI, width, height);
+		glCreateTextures(GL_TEXTURE_2D, 1, &_depth);
+		glTextureStorage2D(_depth, 1, GL_DEPTH_COMPONENT32F, width, height);
+
+		glCreateFramebuffers(1, &_framebuffer);
+		glNamedFramebufferTexture(_framebuffer, GL_COLOR_ATTACHMENT0, _ids, 0);
+		glNamedFramebufferTexture(_framebuffer, GL_DEPTH_ATTACHMENT, _depth, 0);
+		if (glCheckNamedFramebufferStatus(_framebuffer, GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			throw std::runtime_error("Visibility buffer is incomplete.");
+	}
+
+	//! Bind the targets for rendering and reset them
+	void bind()
+	{
+		const GLuint empty[] = { Empty, 0, 0, 0 };
+		const GLfloat far_depth = 1.0f;
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _framebuffer);
+		glClearNamedFramebufferuiv(_framebuffer, GL_COLOR, 0, empty);
+		glClearNamedFramebufferfv(_framebuffer, GL_DEPTH, 0, &far_depth);
+	}
+
+	//! Restore the default framebuffer
+	void unbind()
+	{
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	}
+
+	//! Integer texture holding the triangle IDs
+	GLuint ids() const { return _ids; }
+
+private:
+	void release()
+	{
+		if (_framebuffer)
+		{
+			glDeleteFramebuffers(1, &_framebuffer);
+			glDeleteTextures(1, &_ids);
+			glDeleteTextures(1, &_depth);
+		}
+		_framebuffer = _ids = _depth = 0;
+		_width = _height = 0;
+	}
+
+	//! Framebuffer combining the targets
+	GLuint _framebuffer{ 0 };
+
+	//! Triangle IDs
+	GLuint _ids{ 0 };
+
+	//! Depth buffer
+	GLuint _depth{ 0 };
+
+	//! Size of the targets
+	uint32_t _width{ 0 };
+	uint32_t _height{ 0 };
+};
@@ -0,0 +1,271 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "blockcompression.h"
+#include "filecache.h"
+#include "mappedfile.h"
+#include "mipmaps.h"
+
+//! Texel layout of the levels of a texture container
+enum class TextureFormat : uint32_t
+{
+	R8,
+	RGB8,
+	RGBA8,
+	R16,
+	R32F,
+	BC1,
+	BC4,
+	BC5,
+	BC7
+};
+
+inline bool isBlockCompressed(TextureFormat format)
+{
+	return format >= TextureFormat::BC1;
+}
+
+inline TextureFormat textureFormat(BcFormat format)
+{
+	return static_cast<TextureFormat>(static_cast<uint32_t>(TextureFormat::BC1) + static_cast<uint32_t>(format));
+}
+
+inline BcFormat blockFormat(TextureFormat format)
+{
+	return static_cast<BcFormat>(static_cast<uint32_t>(format) - static_cast<uint32_t>(TextureFormat::BC1));
+}
+
+//! Bytes of a level of 'format'
+inline size_t textureLevelSize(TextureFormat format, uint32_t width, uint32_t height)
+{
+	static const size_t texel_sizes[] = { 1, 3, 4, 2, 4 };
+	if (isBlockCompressed(format))
+		return bcLevelSize(blockFormat(format), width, height);
+	return size_t{ width } * height * texel_sizes[static_cast<uint32_t>(format)];
+}
+
+//! Level of a texture in memory owned by someone else
+struct TextureLevelView
+{
+	uint32_t Width;
+	uint32_t Height;
+	const void* Data;
+	size_t Size;
+};
+
+//! All levels of a texture, the finest first
+struct TextureView
+{
+	TextureFormat Format;
+	std::vector<TextureLevelView> Levels;
+};
+
+//! View of the levels of a mip chain with 8-bit, 16-bit or float channels
+template<typename T>
+TextureView textureView(const MipChain<T>& chain)
+{
+	TextureView view;
+	if (sizeof(T) == 1)
+		view.Format = chain.Channels == 1 ? TextureFormat::R8 : (chain.Channels == 3 ? TextureFormat::RGB8 : TextureFormat::RGBA8);
+	else
+		view.Format = sizeof(T) == 2 ? TextureFormat::R16 : TextureFormat::R32F;
+	if (sizeof(T) > 1 && chain.Channels != 1)
+		throw std::runtime_error("Unsupported texture format.");
+
+	for (size_t l = 0; l < chain.Levels.size(); l++)
+		view.Levels.push_back({ chain.Levels[l].Width, chain.Levels[l].Height, chain.level(l), chain.levelSize(l) * sizeof(T) });
+	return view;
+}
+
+inline TextureView textureView(const CompressedMipChain& chain)
+{
+	TextureView view;
+	view.Format = textureFormat(chain.Format);
+	for (size_t l = 0; l < chain.Levels.size(); l++)
+		view.Levels.push_back({ chain.Levels[l].Width, chain.Levels[l].Height, chain.level(l), chain.levelSize(l) });
+	return view;
+}
+
+/*!
+ * Texture stored in the layout the GPU consumes, such that the levels can be
+ * uploaded straight from a memory mapping of the file.
+ *
+ * Layout (all values little endian):
+ *  - TextureContainer::Header
+ *  - TextureContainer::Level per mip level, the finest first
+ *  - Texels of the levels, each starting at a multiple of 'Alignment'
+ *
+ * 'Key' identifies the source the texture was created from, the container
+ * is rebuilt if the key of the source changes.
+ */
+class TextureContainer
+{
+public:
+	static const uint32_t Magic = 0x31435456; // 'VTC1'
+	static const uint32_t Version = 1;
+	static const size_t Alignment = 64;
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t Key;
+		uint32_t Format;
+		uint32_t NrLevels;
+	};
+
+	struct Level
+	{
+		uint32_t Width;
+		uint32_t Height;
+		uint64_t Offset;
+		uint64_t Size;
+	};
+
+	//! Map the container in 'path', throws if the file is not a valid container
+	explicit TextureContainer(const std::string& path)
+	: _file{ path }
+	{
+		if (_file.size() < sizeof(Header))
+			throw std::runtime_error("Invalid texture container: " + path);
+		std::memcpy(&_header, _file.data(), sizeof(Header));
+		if (_header.Magic != Magic || _header.Version != Version || _header.Format > static_cast<uint32_t>(TextureFormat::BC7))
+			throw std::runtime_error("Invalid texture container: " + path);
+
+		const size_t table_size = sizeof(Level) * _header.NrLevels;
+		if (_header.NrLevels == 0 || _file.size() < sizeof(Header) + table_size)
+			throw std::runtime_error("Invalid texture container: " + path);
+		_levels.resize(_header.NrLevels);
+		std::memcpy(_levels.data(), _file.data() + sizeof(Header), table_size);
+
+		for (const auto& level : _levels)
+		{
+			if (level.Size != textureLevelSize(format(), level.Width, level.Height) || level.Offset > _file.size() || level.Size > _file.size() - level.Offset)
+				throw std::runtime_error("Invalid texture container: " + path);
+		}
+	}
+
+	uint64_t key() const { return _header.Key; }
+	TextureFormat format() const { return static_cast<TextureFormat>(_header.Format); }
+	size_t fileSize() const { return _file.size(); }
+
+	//! Levels pointing into the mapping, valid as long as the container lives
+	TextureView view() const
+	{
+		TextureView view;
+		view.Format = format();
+		for (const auto& level : _levels)
+			view.Levels.push_back({ level.Width, level.Height, _file.data() + level.Offset, static_cast<size_t>(level.Size) });
+		return view;
+	}
+
+	/*!
+	 * Write 'texture' to 'path', returns false on I/O errors. The container
+	 * is written to a temporary file and renamed over 'path', so a process
+	 * mapping the old container never sees a partially written one.
+	 */
+	static bool write(const std::string& path, uint64_t key, const TextureView& texture)
+	{
+		Header header;
+		header.Magic = Magic;
+		header.Version = Version;
+		header.Key = key;
+		header.Format = static_cast<uint32_t>(texture.Format);
+		header.NrLevels = static_cast<uint32_t>(texture.Levels.size());
+
+		std::vector<Level> levels;
+		uint64_t offset = sizeof(Header) + sizeof(Level) * texture.Levels.size();
+		for (const auto& level : texture.Levels)
+		{
+			offset = (offset + Alignment - 1) / Alignment * Alignment;
+			levels.push_back({ level.Width, level.Height, offset, level.Size });
+			offset += level.Size;
+		}
+
+		const std::string tmp = FileCache::temporaryPath(path);
+		{
+			std::ofstream file{ tmp, std::ios::binary | std::ios::trunc };
+			if (!file)
+				return false;
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(Level));
+			const char padding[Alignment] = {};
+			for (size_t l = 0; l < levels.size(); l++)
+			{
+				file.write(padding, static_cast<std::streamsize>(levels[l].Offset - static_cast<uint64_t>(file.tellp())));
+				file.write(static_cast<const char*>(texture.Levels[l].Data), texture.Levels[l].Size);
+			}
+			file.close();
+			if (!file)
+			{
+				std::remove(tmp.c_str());
+				return false;
+			}
+		}
+		return FileCache::replace(tmp, path);
+	}
+
+	/*!
+	 * Map the container in 'path' if it exists and was created with 'key'.
+	 * Returns nullptr otherwise, also for damaged files, which are rebuilt
+	 * by the caller.
+	 */
+	static std::unique_ptr<TextureContainer> open(const std::string& path, uint64_t key)
+	{
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0)
+			return nullptr;
+
+		try
+		{
+			auto container = std::make_unique<TextureContainer>(path);
+			if (container->key() != key)
+				return nullptr;
+			return container;
+		}
+		catch (const std::runtime_error&)
+		{
+			return nullptr;
+		}
+	}
+
+private:
+	MappedFile _file;
+	Header _header;
+	std::vector<Level> _levels;
+};
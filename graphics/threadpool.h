@@ -0,0 +1,147 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! Number of worker threads used by the parallel algorithms
+inline unsigned int hardwareThreads()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/*!
+ * Persistent workers executing the chunks of 'parallelFor'. Starting threads
+ * for each call costs more than the per-frame work of many callers. Threads
+ * waiting for their chunks to finish execute pending chunks of the same call
+ * themselves, so nested calls cannot exhaust the workers. They never pick up
+ * the chunks of other calls, which would keep e.g. the GL thread busy with
+ * the work of a background build.
+ */
+class ThreadPool
+{
+public:
+	//! Pool shared by all parallel algorithms, the calling thread is the last worker
+	static ThreadPool& instance()
+	{
+		static ThreadPool pool{ hardwareThreads() - 1 };
+		return pool;
+	}
+
+	explicit ThreadPool(unsigned int nr_workers)
+	{
+		_workers.reserve(nr_workers);
+		for (unsigned int w = 0; w < nr_workers; w++)
+			_workers.emplace_back([this]() { work(); });
+	}
+	~ThreadPool()
+	{
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			_stop = true;
+		}
+		_signal.notify_all();
+		for (auto& worker : _workers)
+			worker.join();
+	}
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/*!
+	 * Queue a task, it must not throw. Tasks of a 'group' are also executed
+	 * by the threads waiting for that group.
+	 */
+	void push(std::function<void()> task, const void* group = nullptr)
+	{
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			_tasks.push_back({ std::move(task), group });
+		}
+		_signal.notify_one();
+	}
+
+	//! Execute the queued tasks of 'group' until 'remaining' reaches zero
+	void wait(const std::atomic<size_t>& remaining, const void* group)
+	{
+		std::unique_lock<std::mutex> lock{ _mutex };
+		while (remaining.load() > 0)
+		{
+			auto task = std::find_if(_tasks.begin(), _tasks.end(), [group](const Task& t) { return t.Group == group; });
+			if (task == _tasks.end())
+			{
+				_signal.wait(lock);
+				continue;
+			}
+			run(lock, task);
+		}
+	}
+
+private:
+	void work()
+	{
+		std::unique_lock<std::mutex> lock{ _mutex };
+		while (!_stop)
+		{
+			if (_tasks.empty())
+			{
+				_signal.wait(lock);
+				continue;
+			}
+			run(lock, _tasks.begin());
+		}
+	}
+
+	struct Task
+	{
+		std::function<void()> Func;
+		const void* Group;
+	};
+
+	//! Execute 'task' and wake up the threads waiting for it
+	void run(std::unique_lock<std::mutex>& lock, std::deque<Task>::iterator task)
+	{
+		std::function<void()> func = std::move(task->Func);
+		_tasks.erase(task);
+		lock.unlock();
+		func();
+		lock.lock();
+		_signal.notify_all();
+	}
+
+	std::vector<std::thread> _workers;
+	std::deque<Task> _tasks;
+	std::mutex _mutex;
+	std::condition_variable _signal;
+	bool _stop{ false };
+};
@@ -0,0 +1,423 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/eigen.h>
+
+// C++ standard library
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel.h"
+#include "simd.h"
+
+//! Counters of the last update of a transform hierarchy
+struct TransformHierarchyStatistics
+{
+	//! Nodes of the hierarchy
+	uint32_t Nodes{ 0 };
+
+	//! Depth of the deepest node plus one
+	uint32_t Levels{ 0 };
+
+	//! Nodes whose world transform was recomputed
+	uint32_t UpdatedNodes{ 0 };
+
+	//! Time of the update in ms
+	double UpdateMs{ 0 };
+};
+
+//! Time to update the world transforms of a hierarchy
+struct HierarchyTiming
+{
+	//! Number of nodes
+	uint32_t Nodes;
+
+	//! Recursive update of a tree of heap-allocated nodes
+	double PointerMs;
+
+	//! Update of all nodes of the flat hierarchy
+	double FullMs;
+
+	//! Update of a few dirty subtrees of the flat hierarchy
+	double DirtyMs;
+
+	//! Nodes within the dirty subtrees
+	uint32_t DirtyNodes;
+};
+
+/*!
+ * Scene graph of affine transforms stored as flat arrays. The nodes are
+ * sorted breadth-first, such that all nodes of a level are contiguous and
+ * their parents reside in the level before. The children of a node, and the
+ * descendants of a subtree within each level, are contiguous as well.
+ *
+ * Each of the twelve elements of the upper 3x4 block of the local and the
+ * world transforms is stored in its own array. The world transforms are
+ * updated level by level, the nodes of a level in parallel chunks with one
+ * node per SIMD lane. Each level starts at a multiple of the SIMD width.
+ *
+ * Changing a local transform marks the node dirty. An update recomputes the
+ * dirty nodes and their descendants and skips SIMD blocks without any.
+ */
+class TransformHierarchy
+{
+	using FloatV = Simd::FloatV;
+
+public:
+	//! Parent of the root nodes
+	static const uint32_t NoParent = ~0u;
+
+	/*!
+	 * Build the hierarchy from the parent of each node, 'NoParent' for the
+	 * roots. The nodes keep their indices in 'parents'. All local transforms
+	 * are reset to the identity.
+	 */
+	void build(const std::vector<uint32_t>& parents)
+	{
+		const uint32_t nr_nodes = static_cast<uint32_t>(parents.size());
+
+		// Children of each node in compressed rows
+		std::vector<uint32_t> first_child(nr_nodes + 1, 0);
+		for (uint32_t node = 0; node < nr_nodes; node++)
+		{
+			if (parents[node] == NoParent)
+				continue;
+			if (parents[node] >= nr_nodes || parents[node] == node)
+				throw std::runtime_error("Invalid parent in transform hierarchy.");
+			first_child[parents[node] + 1]++;
+		}
+		std::partial_sum(first_child.begin(), first_child.end(), first_child.begin());
+		std::vector<uint32_t> children(first_child.back());
+		std::vector<uint32_t> fill(first_child.begin(), first_child.end() - 1);
+		for (uint32_t node = 0; node < nr_nodes; node++)
+			if (parents[node] != NoParent)
+				children[fill[parents[node]]++] = node;
+
+		// Breadth-first order, starting with the roots
+		std::vector<uint32_t> order;
+		order.reserve(nr_nodes);
+		for (uint32_t node = 0; node < nr_nodes; node++)
+			if (parents[node] == NoParent)
+				order.push_back(node);
+
+		_slots.assign(nr_nodes, uint32_t{ NoParent });
+		_levels.assign(1, 0);
+		_parents.clear();
+		size_t level_begin = 0;
+		while (level_begin < order.size())
+		{
+			const size_t level_end = order.size();
+			for (size_t i = level_begin; i < level_end; i++)
+			{
+				_slots[order[i]] = static_cast<uint32_t>(_parents.size());
+				_parents.push_back(parents[order[i]] == NoParent ? uint32_t{ NoParent } : _slots[parents[order[i]]]);
+				for (uint32_t c = first_child[order[i]]; c < first_child[order[i] + 1]; c++)
+					order.push_back(children[c]);
+			}
+
+			// Padding nodes are their own parents and never dirty
+			while (_parents.size() % FloatV::Width != 0)
+				_parents.push_back(static_cast<uint32_t>(_parents.size()));
+			_levels.push_back(_parents.size());
+			level_begin = level_end;
+		}
+		if (order.size() != nr_nodes)
+			throw std::runtime_error("Transform hierarchy contains a cycle.");
+
+		_stride = _parents.size();
+		_local.assign(12 * _stride, 0.0f);
+		for (size_t slot = 0; slot < _stride; slot++)
+		{
+			_local[0 * _stride + slot] = 1.0f;
+			_local[5 * _stride + slot] = 1.0f;
+			_local[10 * _stride + slot] = 1.0f;
+		}
+		_world = _local;
+		_dirty.assign(_stride, 0);
+		_anyDirty = false;
+
+		_stats = {};
+		_stats.Nodes = nr_nodes;
+		_stats.Levels = static_cast<uint32_t>(_levels.size() - 1);
+	}
+
+	size_t size() const { return _slots.size(); }
+	size_t nrLevels() const { return _levels.size() - 1; }
+
+	//! Store the affine part of the transform of a node relative to its parent
+	void setLocal(uint32_t node, const Eigen::Matrix4f& T)
+	{
+		const size_t slot = _slots[node];
+		for (int r = 0; r < 3; r++)
+			for (int c = 0; c < 4; c++)
+				_local[(4 * r + c) * _stride + slot] = T(r, c);
+		_dirty[slot] = 1;
+		_anyDirty = true;
+	}
+
+	Eigen::Matrix4f local(uint32_t node) const { return element(_local, _slots[node]); }
+
+	//! Transform of a node relative to the roots as of the last update
+	Eigen::Matrix4f world(uint32_t node) const { return element(_world, _slots[node]); }
+
+	//! Mark all nodes dirty
+	void invalidate()
+	{
+		for (size_t level = 0; level < nrLevels(); level++)
+			std::fill(_dirty.begin() + _levels[level], _dirty.begin() + _levels[level] + levelNodes(level), uint8_t{ 1 });
+		_anyDirty = true;
+	}
+
+	/*!
+	 * Recompute the world transforms of the dirty nodes and their
+	 * descendants. Returns the number of recomputed nodes.
+	 */
+	uint32_t update()
+	{
+		const auto start = std::chrono::steady_clock::now();
+		std::atomic<uint32_t> updated{ 0 };
+		if (_anyDirty)
+		{
+			for (size_t level = 0; level < nrLevels(); level++)
+			{
+				const size_t first_block = _levels[level] / FloatV::Width;
+				const size_t last_block = _levels[level + 1] / FloatV::Width;
+				parallelFor(first_block, last_block, 64, [this, level, &updated](size_t, size_t begin, size_t end)
+				{
+					uint32_t count = 0;
+					for (size_t b = begin; b < end; b++)
+						count += updateBlock(level, b * FloatV::Width);
+					updated += count;
+				});
+			}
+			std::fill(_dirty.begin(), _dirty.end(), uint8_t{ 0 });
+			_anyDirty = false;
+		}
+
+		_stats.UpdatedNodes = updated;
+		_stats.UpdateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return updated;
+	}
+
+	const TransformHierarchyStatistics& statistics() const { return _stats; }
+
+private:
+	Eigen::Matrix4f element(const std::vector<float>& elements, size_t slot) const
+	{
+		Eigen::Matrix4f T = Eigen::Matrix4f::Identity();
+		for (int r = 0; r < 3; r++)
+			for (int c = 0; c < 4; c++)
+				T(r, c) = elements[(4 * r + c) * _stride + slot];
+		return T;
+	}
+
+	//! Number of nodes of a level without the padding
+	size_t levelNodes(size_t level) const
+	{
+		size_t end = _levels[level + 1];
+		while (end > _levels[level] && _parents[end - 1] == end - 1)
+			end--;
+		return end - _levels[level];
+	}
+
+	//! Update the world transforms of the nodes in one SIMD block, returns
+	//! the number of dirty nodes
+	uint32_t updateBlock(size_t level, size_t first)
+	{
+		// Nodes are dirty themselves or through their parent, which was
+		// handled with the previous level
+		uint32_t count = 0;
+		for (size_t slot = first; slot < first + FloatV::Width; slot++)
+		{
+			if (level > 0)
+				_dirty[slot] |= _dirty[_parents[slot]];
+			count += _dirty[slot];
+		}
+		if (count == 0)
+			return 0;
+
+		if (level == 0)
+		{
+			for (int k = 0; k < 12; k++)
+				FloatV::load(&_local[k * _stride + first]).store(&_world[k * _stride + first]);
+			return count;
+		}
+
+		// Gather the world transforms of the parents, siblings share them
+		alignas(32) float gathered[12][FloatV::Width];
+		for (int l = 0; l < FloatV::Width; l++)
+		{
+			const size_t parent = _parents[first + l];
+			for (int k = 0; k < 12; k++)
+				gathered[k][l] = _world[k * _stride + parent];
+		}
+
+		FloatV p[12], o[12];
+		for (int k = 0; k < 12; k++)
+		{
+			p[k] = FloatV::load(gathered[k]);
+			o[k] = FloatV::load(&_local[k * _stride + first]);
+		}
+
+		// World: the rows of the parents times the columns of the locals
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				const FloatV t = c == 3 ? p[4 * r + 3] : FloatV::set(0.0f);
+				const FloatV w = madd(p[4 * r + 0], o[c], madd(p[4 * r + 1], o[4 + c], madd(p[4 * r + 2], o[8 + c], t)));
+				w.store(&_world[(4 * r + c) * _stride + first]);
+			}
+		}
+		return count;
+	}
+
+	//! Slot of each node in the breadth-first order
+	std::vector<uint32_t> _slots;
+
+	//! Slot of the parent of each slot, 'NoParent' for roots
+	std::vector<uint32_t> _parents;
+
+	//! First slot of each level, followed by the number of slots
+	std::vector<size_t> _levels;
+
+	//! Distance between the element arrays, the number of slots
+	size_t _stride{ 0 };
+
+	//! Arrays of the elements of the upper 3x4 block of the transforms
+	std::vector<float> _local;
+	std::vector<float> _world;
+
+	//! Slots whose world transform needs to be recomputed
+	std::vector<uint8_t> _dirty;
+	bool _anyDirty{ false };
+
+	TransformHierarchyStatistics _stats;
+};
+
+namespace HierarchyDetail
+{
+	//! Heap-allocated node of the reference tree
+	struct Node
+	{
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+		Eigen::Matrix4f Local;
+		Eigen::Matrix4f World;
+		std::vector<Node*> Children;
+	};
+
+	inline void update(Node* node, const Eigen::Matrix4f& parent)
+	{
+		node->World = parent * node->Local;
+		for (Node* child : node->Children)
+			update(child, node->World);
+	}
+}
+
+/*!
+ * Compare the update of a tree of heap-allocated nodes with the flat
+ * hierarchy for 1k to 1M nodes. The trees have eight children per node and
+ * nodes in shuffled order, as if they were created by an editor. The dirty
+ * update changes the local transforms of eight nodes on the third level.
+ * Each timing is the best of three runs.
+ */
+inline std::vector<HierarchyTiming> benchmarkHierarchy()
+{
+	using ms = std::chrono::duration<double, std::milli>;
+
+	std::mt19937 rng{ 5489u };
+	std::uniform_real_distribution<float> coord{ -1.0f, 1.0f };
+	auto random_transform = [&rng, &coord]()
+	{
+		Eigen::Affine3f T = Eigen::Affine3f::Identity();
+		T.translate(Eigen::Vector3f{ coord(rng), coord(rng), coord(rng) });
+		T.rotate(Eigen::AngleAxisf{ 3.14159265f * coord(rng), Eigen::Vector3f{ coord(rng), coord(rng), 1.0f }.normalized() });
+		return T.matrix();
+	};
+
+	std::vector<HierarchyTiming> timings;
+	for (uint32_t nr_nodes = 1000; nr_nodes <= 1000000; nr_nodes *= 10)
+	{
+		// Node 'ids[i]' is the i-th node of a complete tree of degree eight
+		std::vector<uint32_t> ids(nr_nodes);
+		std::iota(ids.begin(), ids.end(), 0u);
+		std::shuffle(ids.begin() + 1, ids.end(), rng);
+
+		std::vector<uint32_t> parents(nr_nodes, TransformHierarchy::NoParent);
+		for (uint32_t i = 1; i < nr_nodes; i++)
+			parents[ids[i]] = ids[(i - 1) / 8];
+
+		TransformHierarchy hierarchy;
+		hierarchy.build(parents);
+
+		std::vector<std::unique_ptr<HierarchyDetail::Node>> nodes(nr_nodes);
+		for (uint32_t id = 0; id < nr_nodes; id++)
+		{
+			nodes[id] = std::make_unique<HierarchyDetail::Node>();
+			nodes[id]->Local = random_transform();
+			hierarchy.setLocal(id, nodes[id]->Local);
+		}
+		for (uint32_t id = 0; id < nr_nodes; id++)
+			if (parents[id] != TransformHierarchy::NoParent)
+				nodes[parents[id]]->Children.push_back(nodes[id].get());
+
+		// Roots of the dirty subtrees are on the third level
+		std::vector<uint32_t> dirty;
+		for (uint32_t i = 9; i < std::min(nr_nodes, 73u); i += 8)
+			dirty.push_back(ids[i]);
+
+		HierarchyTiming timing{ nr_nodes, 1e30, 1e30, 1e30, 0 };
+		for (int run = 0; run < 3; run++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			HierarchyDetail::update(nodes[ids[0]].get(), Eigen::Matrix4f::Identity());
+			timing.PointerMs = std::min(timing.PointerMs, ms(std::chrono::steady_clock::now() - start).count());
+
+			hierarchy.invalidate();
+			start = std::chrono::steady_clock::now();
+			hierarchy.update();
+			timing.FullMs = std::min(timing.FullMs, ms(std::chrono::steady_clock::now() - start).count());
+
+			for (uint32_t id : dirty)
+				hierarchy.setLocal(id, nodes[id]->Local);
+			start = std::chrono::steady_clock::now();
+			timing.DirtyNodes = hierarchy.update();
+			timing.DirtyMs = std::min(timing.DirtyMs, ms(std::chrono::steady_clock::now() - start).count());
+		}
+		timings.push_back(timing);
+	}
+
+	return timings;
+}
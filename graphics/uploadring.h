@@ -0,0 +1,275 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/opengl.h>
+
+// C++ standard library
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+
+//! Per-frame data allocated from an 'UploadRing'
+template<typename T>
+struct UploadBlock
+{
+	//! Write location in the mapped memory
+	T* Data;
+
+	//! Offset of the data in the buffer of the ring
+	GLintptr Offset;
+
+	//! Number of elements
+	size_t Count;
+
+	T& operator*() const { return *Data; }
+	T* operator->() const { return Data; }
+};
+
+//! Activity of an 'UploadRing'
+struct UploadRingStatistics
+{
+	//! Bytes allocated in the last completed frame
+	uint32_t FrameBytes{ 0 };
+
+	//! Allocations in the last completed frame
+	uint32_t FrameAllocations{ 0 };
+
+	//! Bytes allocated since creation
+	uint64_t TotalBytes{ 0 };
+
+	//! Frames which had to wait for the GPU to release their memory
+	uint32_t FenceWaits{ 0 };
+
+	//! Accumulated time spent waiting in ms
+	double WaitMs{ 0 };
+};
+
+/*!
+ * Persistently and coherently mapped buffer for data written once per frame,
+ * such as constants and per-object transforms. The buffer is split into one
+ * region per frame in flight. Each frame allocates linearly from its region
+ * and binds the allocations as ranges of the single buffer. A region is
+ * reused once the fence placed at the end of the frame which last used it
+ * has signaled.
+ *
+ * Storage buffers which live longer than a frame are bound through the ring
+ * as well. It tracks the bindings of the storage binding points and skips
+ * binds which would not change them.
+ */
+class UploadRing
+{
+public:
+	//! Number of frames the CPU may run ahead of the GPU
+	static const int NrFrames = 3;
+
+	//! Storage binding points whose bindings are tracked
+	static const GLuint NrStorageBindings = 16;
+
+	explicit UploadRing(size_t frame_size = 1 << 20)
+	{
+		GLint uniform_alignment = 256;
+		GLint storage_alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment);
+		_alignment = static_cast<size_t>(std::max({ uniform_alignment, storage_alignment, 16 }));
+		_frameSize = alignUp(frame_size);
+
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glCreateBuffers(1, &_buffer);
+		glNamedBufferStorage(_buffer, NrFrames * _frameSize, nullptr, flags);
+		_memory = static_cast<uint8_t*>(glMapNamedBufferRange(_buffer, 0, NrFrames * _frameSize, flags));
+		if (!_memory)
+			throw std::runtime_error("Failed to map the upload ring.");
+	}
+	~UploadRing()
+	{
+		for (auto& fence : _fences)
+			if (fence)
+				glDeleteSync(fence);
+		glUnmapNamedBuffer(_buffer);
+		glDeleteBuffers(1, &_buffer);
+	}
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+
+	//! Wait until the region of the frame is no longer used by the GPU
+	void beginFrame()
+	{
+		GLsync& fence = _fences[_frame];
+		if (fence)
+		{
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+				{
+				}
+				_stats.FenceWaits++;
+				_stats.WaitMs += 1000.0 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		_offset = 0;
+		_allocations = 0;
+
+		// Other code may have changed the bindings between the frames
+		resetBindings();
+	}
+
+	//! Fence the region of the frame after all its commands were issued
+	void endFrame()
+	{
+		_fences[_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		_frame = (_frame + 1) % NrFrames;
+
+		_stats.FrameBytes = static_cast<uint32_t>(_offset);
+		_stats.FrameAllocations = _allocations;
+	}
+
+	//! Allocate 'count' elements of per-frame data in the current frame
+	template<typename T>
+	UploadBlock<T> allocate(size_t count = 1)
+	{
+		const size_t offset = alignUp(_offset);
+		const size_t size = count * sizeof(T);
+		if (offset + size > _frameSize)
+			throw std::runtime_error("Upload ring is exhausted.");
+
+		_offset = offset + size;
+		_allocations++;
+		_stats.TotalBytes += size;
+
+		const size_t position = _frame * _frameSize + offset;
+		T* data = reinterpret_cast<T*>(_memory + position);
+		for (size_t i = 0; i < count; i++)
+			new (data + i) T;
+
+		return { data, static_cast<GLintptr>(position), count };
+	}
+
+	//! Bind an allocation to the uniform buffer binding point 'index'
+	template<typename T>
+	void bind(GLuint index, const UploadBlock<T>& block) const
+	{
+		glBindBufferRange(GL_UNIFORM_BUFFER, index, _buffer, block.Offset, block.Count * sizeof(T));
+	}
+
+	//! Bind an allocation to the shader storage binding point 'index'
+	template<typename T>
+	void bindStorage(GLuint index, const UploadBlock<T>& block)
+	{
+		bindStorage(index, _buffer, block.Offset, static_cast<GLsizeiptr>(block.Count * sizeof(T)));
+	}
+
+	//! Bind the whole storage buffer 'buffer' to the binding point 'index'
+	void bindStorage(GLuint index, GLuint buffer)
+	{
+		bindStorage(index, buffer, 0, 0);
+	}
+
+	/*!
+	 * Forget the tracked storage bindings. Required after a bound buffer
+	 * was deleted, as its name may be reused by a new buffer.
+	 */
+	void resetBindings()
+	{
+		_storageBindings.fill({ 0, 0, 0 });
+	}
+
+	//! Alignment of the allocations
+	size_t alignment() const { return _alignment; }
+
+	//! Buffer holding the regions of all frames, e.g. to bind it as pixel unpack buffer
+	GLuint buffer() const { return _buffer; }
+
+	const UploadRingStatistics& statistics() const { return _stats; }
+
+private:
+	//! Range bound to a storage binding point, a size of zero binds the whole buffer
+	struct StorageBinding
+	{
+		GLuint Buffer;
+		GLintptr Offset;
+		GLsizeiptr Size;
+	};
+
+	size_t alignUp(size_t offset) const
+	{
+		return (offset + _alignment - 1) / _alignment * _alignment;
+	}
+
+	void bindStorage(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		if (index < NrStorageBindings)
+		{
+			StorageBinding& binding = _storageBindings[index];
+			if (binding.Buffer == buffer && binding.Offset == offset && binding.Size == size)
+				return;
+			binding = { buffer, offset, size };
+		}
+
+		if (size > 0)
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, index, buffer, offset, size);
+		else
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, buffer);
+	}
+
+	//! Buffer holding the regions of all frames
+	GLuint _buffer{ 0 };
+
+	//! Mapped memory of '_buffer'
+	uint8_t* _memory{ nullptr };
+
+	//! Size of the region of a frame
+	size_t _frameSize{ 0 };
+
+	//! Required alignment of bound uniform and storage ranges
+	size_t _alignment{ 256 };
+
+	//! Region of the current frame
+	int _frame{ 0 };
+
+	//! Next free byte in the region of the current frame
+	size_t _offset{ 0 };
+
+	//! Allocations in the current frame
+	uint32_t _allocations{ 0 };
+
+	//! Fences of the frames using the regions
+	std::array<GLsync, NrFrames> _fences{ { nullptr, nullptr, nullptr } };
+
+	//! Current bindings of the tracked storage binding points
+	std::array<StorageBinding, NrStorageBindings> _storageBindings{};
+
+	//! Counters
+	UploadRingStatistics _stats;
+};
@@ -28,7 +28,11 @@
 #include <vcl/config/opengl.h>
 
 // C++ standard library
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <limits>
+#include <string>
 
 // VCL
 #include <vcl/core/enum.h>
@@ -44,6 +48,15 @@
 
 #include "../application.h"
 #include "../basescene.h"
+#include "../blockcompression.h"
+#include "../commandlist.h"
+#include "../drawlist.h"
+#include "../mipmaps.h"
+#include "../texturecontainer.h"
+#include "../uploadring.h"
+
+#include "textureconversion.h"
+#include "texturestreamer.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -60,8 +73,6 @@ extern "C"
 	_declspec(dllexport) unsigned int NvOptimusEnablement = 0x00000001;
 }
 
-using ImageType = std::unique_ptr<uint8_t[], void(*)(void*)>;
-
 VCL_DECLARE_ENUM(Scene,
 	Pyramid, 
 	Wall,
@@ -76,6 +87,27 @@ VCL_DECLARE_ENUM(DetailMethod,
 	Displacements
 )
 
+// Issuing the commands of the gallery
+VCL_DECLARE_ENUM(Submission,
+	Immediate,
+	Recorded,
+	Parallel
+)
+
+// Reduction of the height maps to their mip levels
+VCL_DECLARE_ENUM(HeightMipmaps,
+	Average,
+	Maximum
+)
+
+// Block compression of the 8-bit textures
+VCL_DECLARE_ENUM(TextureCompression,
+	Off,
+	Fast,
+	Normal,
+	High
+)
+
 class WrinkledSurfacesExample : public BaseScene
 {
 	VCL_DECLARE_METAOBJECT(WrinkledSurfacesExample)
@@ -101,6 +133,9 @@ public:
 		Vcl::Graphics::OpenGL::Context::initExtensions();
 		Vcl::Graphics::OpenGL::Context::setupDebugMessaging();
 		_engine = std::make_unique<Vcl::Graphics::Runtime::OpenGL::GraphicsEngine>();
+		// Room for the transforms of the largest gallery at 256-byte alignment
+		_uploadRing = std::make_unique<UploadRing>((MaxTiles * MaxTiles + 64) * 256);
+		_streamer = std::make_unique<TextureStreamer>(size_t{ 1024 } * _uploadBudget);
 
 		// Check availability of features
 		if (!Shader::isSpirvSupported())
@@ -108,7 +143,7 @@ public:
 
 		// Initialize content
 		_camera = std::make_unique<Camera>(std::make_shared<Vcl::Graphics::OpenGL::MatrixFactory>());
-		_camera->encloseInFrustum({ 0, 0, 0 }, { 0, -1, 1 }, 2.0f, { 0, 0, 1 });
+		frameScene();
 
 		_cameraController = std::make_unique<Vcl::Graphics::TrackballCameraController>();
 		_cameraController->setCamera(_camera.get());
@@ -175,33 +210,114 @@ public:
 		_displacementPS = std::make_unique<PipelineState>(disp_ps_desc);
 		_displacementPS->program().setUniform("DetailModeUniform", 4u);
 
-		// Create a linear sampler
+		// Create a trilinear sampler
 		SamplerDescription desc;
-		desc.Filter = FilterType::MinMagLinearMipPoint;
+		desc.Filter = FilterType::MinMagMipLinear;
 		_linearSampler = std::make_unique<Sampler>(desc);
 
-		// Load texture resources
-		auto textures = createPyramidTextures(2, 0.1f, 256, 8);
-		_diffuseMap  [0] = std::move(textures[0]);
-		_normalObjMap[0] = std::move(textures[1]);
-		_normalTanMap[0] = std::move(textures[2]);
-		_heightMap   [0] = std::move(textures[3]);
-
-		_diffuseMap  [1] = loadTexture("textures/wall/diffuse.png");
-		_normalObjMap[1] = loadTexture("textures/wall/normal_obj.png");
-		_normalTanMap[1] = loadTexture("textures/wall/normal_tan.png");
-		_heightMap   [1] = loadTexture("textures/wall/height.png");
-
-		_diffuseMap  [2] = loadTexture("textures/dome/diffuse.png");
-		_normalObjMap[2] = loadTexture("textures/dome/normal_obj.png");
-		_normalTanMap[2] = loadTexture("textures/dome/normal_tan.png");
-		_heightMap   [2] = loadTexture("textures/dome/height.png");
+		// Load texture resources, the placeholders are bound until the
+		// streamed textures are uploaded
+		createPlaceholders();
+		createTextures();
 	}
 
 	Scene scene() const { return _scene; }
-	void setScene(Scene scene) { _scene = scene; }
+	void setScene(Scene scene) { _scene = scene; _commandsValid = false; requestTextures(); }
 	DetailMethod detailMethod() const { return _detailMethod; }
-	void setDetailMethod(DetailMethod method) { _detailMethod = method; }
+	void setDetailMethod(DetailMethod method) { _detailMethod = method; _commandsValid = false; }
+
+	int tiles() const { return _tiles; }
+	void setTiles(int tiles)
+	{
+		_tiles = std::max(1, std::min(tiles, int{ MaxTiles }));
+		_commandsValid = false;
+		frameScene();
+		requestTextures();
+	}
+
+	bool sortDraws() const { return _sortDraws; }
+	void setSortDraws(bool sort) { _sortDraws = sort; _commandsValid = false; }
+
+	Submission submission() const { return _submission; }
+	void setSubmission(Submission submission) { _submission = submission; _commandsValid = false; }
+
+	int recordThreads() const { return _recordThreads; }
+	void setRecordThreads(int threads) { _recordThreads = std::max(1, std::min(threads, 64)); }
+
+	HeightMipmaps heightMipmaps() const { return _heightMipmaps; }
+	void setHeightMipmaps(HeightMipmaps mipmaps)
+	{
+		if (_heightMipmaps == mipmaps)
+			return;
+
+		_heightMipmaps = mipmaps;
+		_commandsValid = false;
+		createTextures();
+	}
+
+	TextureCompression textureCompression() const { return _textureCompression; }
+	void setTextureCompression(TextureCompression compression)
+	{
+		if (_textureCompression == compression)
+			return;
+
+		_textureCompression = compression;
+		_commandsValid = false;
+		createTextures();
+	}
+
+	//! Bytes of texture data uploaded per frame in KB
+	int uploadBudget() const { return _uploadBudget; }
+	void setUploadBudget(int budget)
+	{
+		_uploadBudget = std::max(budget, static_cast<int>(TextureStreamer::MinFrameBudget / 1024));
+		_streamer->setFrameBudget(size_t{ 1024 } * _uploadBudget);
+	}
+
+	void drawUI(Application& app) override
+	{
+		BaseScene::drawUI(app);
+
+		ImGuiWindowFlags corner =
+			ImGuiWindowFlags_NoMove |
+			ImGuiWindowFlags_NoResize |
+			ImGuiWindowFlags_NoCollapse |
+			ImGuiWindowFlags_NoSavedSettings |
+			ImGuiWindowFlags_AlwaysAutoResize |
+			ImGuiWindowFlags_NoTitleBar;
+
+		const DrawListStatistics& stats = _drawList.statistics();
+		ImGui::Begin("Statistics", nullptr, corner);
+		ImGui::SetWindowPos({ (float)app.width() - 260, 10 });
+		ImGui::Text("Draws: %u", stats.Draws);
+		ImGui::Text("Pipeline changes: %u (%u avoided)", stats.PipelineChanges, stats.PipelineChangesAvoided);
+		ImGui::Text("Material changes: %u (%u avoided)", stats.MaterialChanges, stats.MaterialChangesAvoided);
+		ImGui::Text("Sorting: %.3f ms", stats.SortMs);
+		ImGui::Text("Submission: immediate %.3f ms, replay %.3f ms", _immediateTime, _replayTime);
+		ImGui::Text("Parallel: %.3f ms", _parallelTime);
+		const auto& streaming = _streamer->statistics();
+		ImGui::Text("Texture setup: %.1f ms, %u of %u from containers", _textureLoadTime, _cacheHits, _cacheHits + _cacheMisses);
+		ImGui::Text("Streaming: %u loading, %u uploading, %u failed", streaming.Loading, streaming.Uploading, streaming.Failed);
+		ImGui::Text("Uploads: %.1f KB in %.3f ms, staging %.1f MB", streaming.FrameBytes / 1024.0, streaming.FrameMs, streaming.StagingBytes / (1024.0 * 1024.0));
+		ImGui::Text("Mip generation: %.1f ms, block compression %.1f ms", _encodingStats.MipMs, _encodingStats.CompressionMs);
+		ImGui::Text("Textures: %.1f MB (uncompressed %.1f MB)", _textureBytes / (1024.0 * 1024.0), _uncompressedTextureBytes / (1024.0 * 1024.0));
+		if (_submission == Submission::Recorded)
+		{
+			const CommandListStatistics& commands = _commands.statistics();
+			ImGui::Text("Command list: %u commands, %.1f KB constants", commands.Commands, commands.ConstantBytes / 1024.0f);
+		}
+		if (_submission == Submission::Parallel)
+		{
+			const ParallelRecordingStatistics& parallel = _recorder.statistics();
+			ImGui::Text("Command lists: %u, %u commands", parallel.Lists, parallel.Commands.Commands);
+			ImGui::Text("Recording: %.3f ms, replay %.3f ms", parallel.RecordMs, parallel.ReplayMs);
+		}
+		if (ImGui::Button("Benchmark recording"))
+			benchmarkRecording();
+		for (size_t t = 0; t < _recordingScaling.size(); t++)
+			ImGui::Text("%2zu threads: %.3f ms (%.2fx)", t + 1, _recordingScaling[t], _recordingScaling[0] / std::max(_recordingScaling[t], 1e-6));
+		ImGui::End();
+	}
 
 public:
 	void onMouseButton(Application& app, int button, int action, int mods)
@@ -227,131 +343,537 @@ public:
 	void draw(Application& app) override
 	{
 		_engine->beginFrame();
+		_uploadRing->beginFrame();
+
+		// Textures finishing their upload invalidate the recorded commands
+		_streamer->update();
 
 		_engine->clear(0, Eigen::Vector4f{0.0f, 0.0f, 0.0f, 1.0f});
 		_engine->clear(1.0f);
 
 		// View on the scene
-		auto cbuf_camera = _engine->requestPerFrameConstantBuffer<PerFrameCameraData>();
+		auto cbuf_camera = _uploadRing->allocate<PerFrameCameraData>();
 		cbuf_camera->Viewport = vec4(0, 0, (float)app.width(), (float)app.height());
 		cbuf_camera->Frustum;
 		cbuf_camera->ViewMatrix = mat4(_camera->view());
 		cbuf_camera->ProjectionMatrix = mat4(_camera->projection());
-		_engine->setConstantBuffer(0, std::move(cbuf_camera));
+		_uploadRing->bind(0, cbuf_camera);
 
 		Eigen::Matrix4f M = _cameraController->currObjectTransformation();
-		switch (_detailMethod)
+
+		// Parameters of the displacement mapping, read by the tessellation stages
+		auto cbuf_tess = _uploadRing->allocate<TessellationData>();
+		cbuf_tess->Level = 64;
+		cbuf_tess->Midlevel = 127.0f/255.0f;
+		cbuf_tess->HeightScale = 0.01f;
+		_uploadRing->bind(2, cbuf_tess);
+
+		const auto start = std::chrono::steady_clock::now();
+		switch (_submission)
 		{
-		case DetailMethod::None:
-			renderScene(Vcl::Graphics::Runtime::PrimitiveType::Trianglelist, _engine.get(), _simplePS, M);
-			break;
-		case DetailMethod::ObjectSpace:
-			renderScene(Vcl::Graphics::Runtime::PrimitiveType::Trianglelist, _engine.get(), _objectNormalmapPS, M);
-			break;
-		case DetailMethod::TangentSpace:
-			renderScene(Vcl::Graphics::Runtime::PrimitiveType::Trianglelist, _engine.get(), _tangentNormalmapPS, M);
+		case Submission::Immediate:
+		{
+			submitScene(_engine.get(), *_uploadRing, M, true);
+			_immediateTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 			break;
-		case DetailMethod::Mikkelsen:
-			renderScene(Vcl::Graphics::Runtime::PrimitiveType::Trianglelist, _engine.get(), _perturbNormalPS, M);
+		}
+		case Submission::Recorded:
+		{
+			// Replay the recorded commands if only the view changed since the
+			// recording, which only requires patching the transforms. The
+			// recording contains all tiles, as the view may change, and keeps
+			// its order of the draws.
+			if (!_commandsValid)
+			{
+				_commands.reset(_uploadRing->alignment());
+				_tileTransforms.resize(_tiles * _tiles);
+				submitScene(&_commands, _commands, M, false);
+				_commandsValid = true;
+				_recordedModel = M;
+				_recordedView = _camera->view();
+			}
+			else if (M != _recordedModel || _camera->view() != _recordedView)
+			{
+				for (uint32_t tile = 0; tile < _tileTransforms.size(); tile++)
+					writeTileTransform(*_tileTransforms[tile], M, tile);
+				_recordedModel = M;
+				_recordedView = _camera->view();
+			}
+			_commands.replay(_engine.get(), *_uploadRing);
+			_replayTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 			break;
-		case DetailMethod::Displacements:
+		}
+		case Submission::Parallel:
 		{
-			auto cbuf_tess = _engine->requestPerFrameConstantBuffer<TessellationData>();
-			cbuf_tess->Level = 64;
-			cbuf_tess->Midlevel = 127.0f/255.0f;
-			cbuf_tess->HeightScale = 0.01f;
-			_engine->setConstantBuffer(2, std::move(cbuf_tess));
-
-			renderScene(Vcl::Graphics::Runtime::PrimitiveType::Patch, _engine.get(), _displacementPS, M);
+			recordParallel(M, _recordThreads);
+			_recorder.replay(_engine.get(), *_uploadRing);
+			_parallelTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 			break;
 		}
 		}
-		
+
+		_uploadRing->endFrame();
 		_engine->endFrame();
 	}
 
 private:
-	void renderScene
+	/*!
+	 * Issue the commands drawing the gallery, either directly to the engine
+	 * with constants from the upload ring, or into a command list.
+	 */
+	template<typename Queue, typename Constants>
+	void submitScene(Queue* cmd_queue, Constants& constants, const Eigen::Matrix4f& M, bool cull)
+	{
+		// Samplers are shared by all materials
+		for (int s = 0; s < 4; s++)
+			cmd_queue->setSampler(s, *_linearSampler);
+
+		// Queue the visible tiles in grid order
+		Eigen::Vector4f planes[6];
+		frustumPlanes(M, planes);
+		_drawList.clear();
+		for (uint32_t tile = 0; tile < static_cast<uint32_t>(_tiles * _tiles); tile++)
+		{
+			const uint64_t key = tileKey(tile, M, cull ? planes : nullptr);
+			if (key != Culled)
+				_drawList.add(key, tile);
+		}
+		if (_sortDraws)
+			_drawList.sort();
+
+		_drawList.submit(
+			[this, cmd_queue](uint32_t pipeline) { bindTechnique(cmd_queue, pipeline); },
+			[this, cmd_queue](uint32_t material) { bindMaterial(cmd_queue, material); },
+			[this, cmd_queue, &constants, &M](uint32_t tile) { trackTileTransform(tile, drawTile(cmd_queue, constants, M, tile)); });
+	}
+
+	/*!
+	 * Fork/join recording of the gallery. The keys and culling of the tiles
+	 * are computed in parallel. After sorting, contiguous ranges of the draws
+	 * are recorded into one command list per thread, including the setup of
+	 * their constants.
+	 */
+	void recordParallel(const Eigen::Matrix4f& M, size_t nr_threads)
+	{
+		const uint32_t nr_tiles = static_cast<uint32_t>(_tiles * _tiles);
+		Eigen::Vector4f planes[6];
+		frustumPlanes(M, planes);
+		_tileKeys.resize(nr_tiles);
+		parallelChunks(0, nr_tiles, nr_threads, [this, &M, &planes](size_t, size_t begin, size_t end)
+		{
+			for (size_t tile = begin; tile < end; tile++)
+				_tileKeys[tile] = tileKey(static_cast<uint32_t>(tile), M, planes);
+		});
+
+		_drawList.clear();
+		for (uint32_t tile = 0; tile < nr_tiles; tile++)
+			if (_tileKeys[tile] != Culled)
+				_drawList.add(_tileKeys[tile], tile);
+		if (_sortDraws)
+			_drawList.sort();
+
+		std::vector<DrawListStatistics> range_stats(nr_threads);
+		_recorder.record(_drawList.size(), nr_threads, _uploadRing->alignment(), [this, &M, &range_stats](size_t range, CommandList& list, size_t begin, size_t end)
+		{
+			for (int s = 0; s < 4; s++)
+				list.setSampler(s, *_linearSampler);
+
+			_drawList.submit(begin, end,
+				[this, &list](uint32_t pipeline) { bindTechnique(&list, pipeline); },
+				[this, &list](uint32_t material) { bindMaterial(&list, material); },
+				[this, &list, &M](uint32_t tile) { drawTile(&list, list, M, tile); },
+				range_stats[range]);
+		});
+
+		DrawListStatistics stats;
+		for (const auto& range : range_stats)
+		{
+			stats.Draws += range.Draws;
+			stats.PipelineChanges += range.PipelineChanges;
+			stats.MaterialChanges += range.MaterialChanges;
+		}
+		_drawList.complete(stats);
+	}
+
+	//! Time the parallel recording of the current view with one to all threads
+	void benchmarkRecording()
+	{
+		const Eigen::Matrix4f M = _cameraController->currObjectTransformation();
+		_recordingScaling.clear();
+		for (unsigned int threads = 1; threads <= hardwareThreads(); threads++)
+		{
+			double best = std::numeric_limits<double>::max();
+			for (int run = 0; run < 5; run++)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				recordParallel(M, threads);
+				best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			}
+			_recordingScaling.push_back(best);
+		}
+	}
+
+	template<typename Queue>
+	void bindTechnique(Queue* cmd_queue, uint32_t pipeline)
+	{
+		const auto method = static_cast<DetailMethod>(pipeline);
+		cmd_queue->setPipelineState(pipelineState(method));
+		cmd_queue->setPrimitiveType(method == DetailMethod::Displacements ? Vcl::Graphics::Runtime::PrimitiveType::Patch : Vcl::Graphics::Runtime::PrimitiveType::Trianglelist, 3);
+	}
+
+	template<typename Queue>
+	void bindMaterial(Queue* cmd_queue, uint32_t material)
+	{
+		cmd_queue->setTexture(0, texture(_diffuseMap[material], TextureContent::Albedo));
+		cmd_queue->setTexture(1, texture(_heightMap[material], TextureContent::Height));
+		cmd_queue->setTexture(2, texture(_normalObjMap[material], TextureContent::ObjectNormals));
+		cmd_queue->setTexture(3, texture(_normalTanMap[material], TextureContent::TangentNormals));
+	}
+
+	//! 'map' or the placeholder of 'content' while 'map' is streamed
+	const Vcl::Graphics::Runtime::OpenGL::Texture2D& texture(const std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D>& map, TextureContent content) const
+	{
+		return map ? *map : *_placeholders[static_cast<size_t>(content)];
+	}
+
+	//! Draw a single tile, returns the block holding its transform
+	template<typename Queue, typename Constants>
+	auto drawTile(Queue* cmd_queue, Constants& constants, const Eigen::Matrix4f& M, uint32_t tile) -> decltype(constants.template allocate<ObjectTransformData>())
+	{
+		auto cbuf_transform = constants.template allocate<ObjectTransformData>();
+		writeTileTransform(*cbuf_transform, M, tile);
+		constants.bind(1, cbuf_transform);
+
+		cmd_queue->draw(6);
+		return cbuf_transform;
+	}
+
+	//! Frustum planes in the space of the gallery (Gribb and Hartmann)
+	void frustumPlanes(const Eigen::Matrix4f& M, Eigen::Vector4f (&planes)[6]) const
+	{
+		const Eigen::Matrix4f VP = _camera->projection() * _camera->view() * M;
+		for (int i = 0; i < 3; i++)
+		{
+			planes[2*i + 0] = VP.row(3).transpose() + VP.row(i).transpose();
+			planes[2*i + 1] = VP.row(3).transpose() - VP.row(i).transpose();
+		}
+		for (auto& plane : planes)
+			plane /= plane.head<3>().norm();
+	}
+
+	/*!
+	 * Sort key of a tile. It orders the tiles by technique, then by texture
+	 * set, then front to back. Returns 'Culled' if the tile is outside the
+	 * frustum given by 'planes', if any.
+	 */
+	uint64_t tileKey(uint32_t tile, const Eigen::Matrix4f& M, const Eigen::Vector4f* planes) const
+	{
+		const Eigen::Vector3f offset = tileOffset(tile);
+		const Eigen::Vector4f center{ offset.x(), offset.y(), offset.z(), 1 };
+		if (planes)
+		{
+			for (int p = 0; p < 6; p++)
+				if (planes[p].dot(center) < -TileRadius)
+					return Culled;
+		}
+
+		DetailMethod method;
+		Scene scene;
+		tileContent(tile, method, scene);
+
+		const float depth = -(_camera->view() * M * center).z();
+		return DrawKey::make(0, static_cast<uint32_t>(method), static_cast<uint32_t>(scene), DrawKey::depthBits(depth));
+	}
+
+	//! Transform of a tile within the gallery
+	void writeTileTransform(ObjectTransformData& data, const Eigen::Matrix4f& M, uint32_t tile) const
+	{
+		const Eigen::Matrix4f T = M * Eigen::Affine3f{ Eigen::Translation3f{ tileOffset(tile) } }.matrix();
+		data.ModelMatrix = T;
+		data.NormalMatrix = mat4((_camera->view() * T).inverse().transpose());
+	}
+
+	//! Keep the location of recorded transforms to patch them when the view changes
+	void trackTileTransform(uint32_t tile, const RecordedBlock<ObjectTransformData>& block) { _tileTransforms[tile] = block; }
+	void trackTileTransform(uint32_t, const UploadBlock<ObjectTransformData>&) {}
+
+	//! Technique and texture set of a tile. A single tile shows the selected
+	//! ones, larger galleries mix all of them.
+	void tileContent(uint32_t tile, DetailMethod& method, Scene& scene) const
+	{
+		if (_tiles == 1)
+		{
+			method = _detailMethod;
+			scene = _scene;
+			return;
+		}
+
+		const uint32_t hash = tile * 2654435761u;
+		method = static_cast<DetailMethod>((hash >> 16) % 5);
+		scene = static_cast<Scene>((hash >> 24) % 3);
+	}
+
+	//! Center of a tile, the grid is centered at the origin
+	Eigen::Vector3f tileOffset(uint32_t tile) const
+	{
+		const float origin = -0.5f * TileSpacing * (_tiles - 1);
+		return { origin + TileSpacing * (tile % _tiles), origin + TileSpacing * (tile / _tiles), 0 };
+	}
+
+	Vcl::ref_ptr<Vcl::Graphics::Runtime::PipelineState> pipelineState(DetailMethod method)
+	{
+		switch (method)
+		{
+		case DetailMethod::ObjectSpace: return _objectNormalmapPS;
+		case DetailMethod::TangentSpace: return _tangentNormalmapPS;
+		case DetailMethod::Mikkelsen: return _perturbNormalPS;
+		case DetailMethod::Displacements: return _displacementPS;
+		default: return _simplePS;
+		}
+	}
+
+	//! Point the camera at the gallery
+	void frameScene()
+	{
+		const float radius = std::max(2.0f, 0.75f * TileSpacing * _tiles);
+		_camera->encloseInFrustum({ 0, 0, 0 }, { 0, -1, 1 }, radius, { 0, 0, 1 });
+	}
+
+	/*!
+	 * Generate the textures of the pyramid and stream the textures of the
+	 * other scenes. Pending loads of previous attributes are dropped.
+	 */
+	void createTextures()
+	{
+		const auto start = std::chrono::steady_clock::now();
+		_streamer->cancel();
+		_encodingStats = {};
+		_cacheHits = 0;
+		_cacheMisses = 0;
+		_textureBytes = 0;
+		_uncompressedTextureBytes = 0;
+
+		auto textures = createPyramidTextures(2, 0.1f, 256, 8);
+		_diffuseMap  [0] = std::move(textures[0]);
+		_normalObjMap[0] = std::move(textures[1]);
+		_normalTanMap[0] = std::move(textures[2]);
+		_heightMap   [0] = std::move(textures[3]);
+		_requested[0] = true;
+
+		for (size_t s = 1; s < _requested.size(); s++)
+		{
+			_diffuseMap  [s] = nullptr;
+			_normalObjMap[s] = nullptr;
+			_normalTanMap[s] = nullptr;
+			_heightMap   [s] = nullptr;
+			_requested[s] = false;
+		}
+		requestTextures();
+
+		_textureLoadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//! Stream the textures of the shown scenes, a gallery shows all scenes
+	void requestTextures()
+	{
+		static const char* const directories[] = { nullptr, "textures/wall/", "textures/dome/" };
+		for (size_t s = 0; s < _requested.size(); s++)
+		{
+			if (_requested[s] || (_tiles == 1 && static_cast<size_t>(_scene) != s))
+				continue;
+
+			const std::string dir = directories[s];
+			streamTexture(dir + "diffuse.png", TextureContent::Albedo, _diffuseMap[s]);
+			streamTexture(dir + "normal_obj.png", TextureContent::ObjectNormals, _normalObjMap[s]);
+			streamTexture(dir + "normal_tan.png", TextureContent::TangentNormals, _normalTanMap[s]);
+			streamTexture(dir + "height.png", TextureContent::Height, _heightMap[s]);
+			_requested[s] = true;
+		}
+	}
+
+	//! Encoding of 'content' with the current attributes
+	TextureEncoding encoding(TextureContent content) const
+	{
+		const BcQuality quality =
+			_textureCompression == TextureCompression::Fast ? BcQuality::Fast :
+			(_textureCompression == TextureCompression::Normal ? BcQuality::Normal : BcQuality::High);
+		const MipFilter height_filter = _heightMipmaps == HeightMipmaps::Maximum ? MipFilter::Maximum : MipFilter::Average;
+		return textureEncoding(content, _textureCompression != TextureCompression::Off, quality, height_filter);
+	}
+
+	//! Create a texture with the full mip chain of 'src' encoded according to 'content'
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D> createTexture
 	(
-		Vcl::Graphics::Runtime::PrimitiveType primitive_type,
-		Vcl::Graphics::Runtime::GraphicsEngine* cmd_queue,
-		Vcl::ref_ptr<Vcl::Graphics::Runtime::PipelineState> ps,
-		const Eigen::Matrix4f& M
+		uint32_t w, uint32_t h, Vcl::Graphics::SurfaceFormat tgt_fmt,
+		const void* src, Vcl::Graphics::SurfaceFormat src_fmt, TextureContent content
 	)
 	{
-		// Configure the layout
-		cmd_queue->setPipelineState(ps);
+		using Vcl::Graphics::SurfaceFormat;
 
-		// View on the scene
-		auto cbuf_transform = cmd_queue->requestPerFrameConstantBuffer<ObjectTransformData>();
-		cbuf_transform->ModelMatrix = M;
-		cbuf_transform->NormalMatrix = mat4((_camera->view() * M).inverse().transpose());
-		cmd_queue->setConstantBuffer(1, std::move(cbuf_transform));
-
-		// Samplers
-		cmd_queue->setSampler(0, *_linearSampler);
-		cmd_queue->setSampler(1, *_linearSampler);
-		cmd_queue->setSampler(2, *_linearSampler);
-		cmd_queue->setSampler(3, *_linearSampler);
-
-		// Textures
-		cmd_queue->setTexture(0, *_diffuseMap[(int)_scene]);
-		cmd_queue->setTexture(1, *_heightMap[(int)_scene]);
-		cmd_queue->setTexture(2, *_normalObjMap[(int)_scene]);
-		cmd_queue->setTexture(3, *_normalTanMap[(int)_scene]);
-
-		// Render the quad
-		cmd_queue->setPrimitiveType(primitive_type, 3);
-		cmd_queue->draw(6);
+		switch (src_fmt)
+		{
+		case SurfaceFormat::R8G8B8A8_UNORM:
+			return createTexture(w, h, tgt_fmt, static_cast<const uint8_t*>(src), 4, content);
+		case SurfaceFormat::R8G8B8_UNORM:
+			return createTexture(w, h, tgt_fmt, static_cast<const uint8_t*>(src), 3, content);
+		case SurfaceFormat::R8_UNORM:
+			return createTexture(w, h, tgt_fmt, static_cast<const uint8_t*>(src), 1, content);
+		case SurfaceFormat::R16_UNORM:
+			return createTexture(w, h, tgt_fmt, static_cast<const uint16_t*>(src), 1, content);
+		case SurfaceFormat::R32_FLOAT:
+			return createTexture(w, h, tgt_fmt, static_cast<const float*>(src), 1, content);
+		default:
+			throw std::runtime_error("Unsupported texture format.");
+		}
 	}
 
+	/*!
+	 * Block-compressed textures are cached on disk under the key of the
+	 * source texels, such that a cache hit skips the mip generation and the
+	 * encoding and the levels are uploaded from the mapped cache file.
+	 */
+	template<typename T>
 	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D> createTexture
 	(
 		uint32_t w, uint32_t h, Vcl::Graphics::SurfaceFormat tgt_fmt,
-		const void* src, Vcl::Graphics::SurfaceFormat src_fmt
-	) const
+		const T* src, uint32_t channels, TextureContent content
+	)
 	{
-		using Vcl::Graphics::Runtime::OpenGL::Texture2D;
-		using Vcl::Graphics::Runtime::Texture2DDescription;
-		using Vcl::Graphics::Runtime::TextureResource;
+		const TextureEncoding enc = encoding(content);
+		if (!enc.Compressed || sizeof(T) > 1)
+			return createTexture(encodeTexture(src, w, h, channels, enc, &_encodingStats).view(), tgt_fmt);
 
-		Texture2DDescription diffuse_tex_desc;
-		diffuse_tex_desc.Width = w;
-		diffuse_tex_desc.Height = h;
-		diffuse_tex_desc.MipLevels = 1;
-		diffuse_tex_desc.ArraySize = 1;
-		diffuse_tex_desc.Format = tgt_fmt;
+		const uint64_t key = TextureCache::key(src, size_t{ w } * h * channels * sizeof(T), w, h, channels, enc.Filter, enc.Format, enc.Quality);
+		const std::string cache_path = TextureCache::path(key);
+		if (auto container = TextureContainer::open(cache_path, key))
+		{
+			_cacheHits++;
+			return createTexture(container->view(), tgt_fmt);
+		}
+
+		_cacheMisses++;
+		const auto texture = encodeTexture(src, w, h, channels, enc, &_encodingStats);
+		if (!TextureContainer::write(cache_path, key, texture.view()))
+			std::cout << "Could not write '" << cache_path << "'" << std::endl;
+		return createTexture(texture.view(), tgt_fmt);
+	}
 
-		TextureResource diffuse_res;
-		diffuse_res.Width = w;
-		diffuse_res.Height = h;
-		diffuse_res.Format = src_fmt;
-		diffuse_res.Data = stdext::make_span(reinterpret_cast<const uint8_t*>(src), w*h*Vcl::Graphics::sizeInBytes(src_fmt));
+	/*!
+	 * Create a texture from the levels in 'texture'. The levels are uploaded
+	 * straight from the memory of the view, e.g. a mapped container.
+	 * 'tgt_fmt' is the format of uncompressed textures.
+	 */
+	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D> createTexture(const TextureView& texture, Vcl::Graphics::SurfaceFormat tgt_fmt)
+	{
+		countTextureBytes(texture, tgt_fmt);
+
+		const TextureUploadFormat format = textureUploadFormat(texture.Format, tgt_fmt);
+		auto gpu_texture = createTextureStorage(texture, format);
 
-		return std::make_unique<Texture2D>(diffuse_tex_desc, &diffuse_res);
+		// Levels are tightly packed rows
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (size_t l = 0; l < texture.Levels.size(); l++)
+		{
+			const TextureLevelView& level = texture.Levels[l];
+			uploadTextureRows(gpu_texture->id(), format, static_cast<GLint>(l), level.Width, 0, level.Height, level.Size, level.Data);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		return gpu_texture;
+	}
+
+	//! Add the GPU memory of 'texture' to the statistics
+	void countTextureBytes(const TextureView& texture, Vcl::Graphics::SurfaceFormat tgt_fmt)
+	{
+		using Vcl::Graphics::SurfaceFormat;
+
+		const size_t tgt_texel_size = tgt_fmt == SurfaceFormat::R8_UNORM ? 1 : (tgt_fmt == SurfaceFormat::R16_UNORM ? 2 : 4);
+		for (const auto& level : texture.Levels)
+		{
+			_textureBytes += isBlockCompressed(texture.Format) ? level.Size : size_t{ level.Width } * level.Height * tgt_texel_size;
+			_uncompressedTextureBytes += size_t{ level.Width } * level.Height * tgt_texel_size;
+		}
+	}
+
+	//! 1x1 textures bound in place of textures which are not uploaded yet
+	void createPlaceholders()
+	{
+		using RGBA8 = std::array<uint8_t, 4>;
+
+		// Grey albedo, unperturbed normals and the height of the base surface
+		const std::array<RGBA8, 4> texels =
+		{{
+			{ 128, 128, 128, 255 },
+			{ 128, 128, 255, 255 },
+			{ 128, 128, 255, 255 },
+			{ 127, 127, 127, 255 }
+		}};
+		for (size_t c = 0; c < texels.size(); c++)
+		{
+			TextureView texture;
+			texture.Format = TextureFormat::RGBA8;
+			texture.Levels.push_back({ 1, 1, texels[c].data(), sizeof(RGBA8) });
+
+			const TextureUploadFormat format = textureUploadFormat(texture.Format, Vcl::Graphics::SurfaceFormat::R8G8B8A8_UNORM);
+			_placeholders[c] = createTextureStorage(texture, format);
+			uploadTextureRows(_placeholders[c]->id(), format, 0, 1, 0, 1, sizeof(RGBA8), texels[c].data());
+		}
 	}
 
-	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D> loadTexture(const char* filename) const
+	/*!
+	 * Stream the container of 'filename' into 'map'. A worker maps the
+	 * container, whose levels are uploaded from the mapping, or converts
+	 * the image if the container is missing or outdated. See also the
+	 * 'wrinkledsurfaces_textures' converter.
+	 */
+	void streamTexture(const std::string& filename, TextureContent content, std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D>& map)
 	{
+		using Vcl::Graphics::Runtime::OpenGL::Texture2D;
 		using Vcl::Graphics::SurfaceFormat;
 
-		int force_channels = 0;
-		int w, h, n;
-		ImageType diffuse_data(stbi_load(filename, &w, &h, &n, force_channels), stbi_image_free);
-		SurfaceFormat input_format = SurfaceFormat::R8G8B8A8_UNORM;
-		if (n == 1)
-			input_format = SurfaceFormat::R8_UNORM;
-		if (n == 3)
-			input_format = SurfaceFormat::R8G8B8_UNORM;
+		struct Outcome
+		{
+			bool FromContainer{ false };
+			EncodingStatistics Encoding;
+		};
+		auto outcome = std::make_shared<Outcome>();
 
-		return createTexture(w, h, SurfaceFormat::R8G8B8A8_UNORM, diffuse_data.get(), input_format);
+		const TextureEncoding enc = encoding(content);
+		auto load = [filename, enc, outcome](StagingPool& pool, StagedTexture& staged)
+		{
+			const uint64_t key = containerKey(filename, enc);
+			const std::string path = containerPath(filename, enc, key);
+			if (auto container = TextureContainer::open(path, key))
+			{
+				outcome->FromContainer = true;
+				staged.map(std::move(container));
+				return;
+			}
+
+			const Image image = loadImage(filename);
+			const auto texture = encodeTexture(image.Data.get(), image.Width, image.Height, image.Channels, enc, &outcome->Encoding);
+			if (!TextureContainer::write(path, key, texture.view()))
+				std::cout << "Could not write '" << path << "'" << std::endl;
+			staged.assign(pool, texture.view());
+		};
+		auto ready = [this, &map, outcome](std::unique_ptr<Texture2D> texture, const StagedTexture& staged)
+		{
+			(outcome->FromContainer ? _cacheHits : _cacheMisses)++;
+			_encodingStats.MipMs += outcome->Encoding.MipMs;
+			_encodingStats.CompressionMs += outcome->Encoding.CompressionMs;
+			countTextureBytes(staged.view(), SurfaceFormat::R8G8B8A8_UNORM);
+
+			map = std::move(texture);
+			_commandsValid = false;
+		};
+		_streamer->request(load, SurfaceFormat::R8G8B8A8_UNORM, ready);
 	}
 
 	std::array<std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D>, 4>
 		createPyramidTextures
 		(
 			float size, float height, size_t resolution, size_t bumpmap_bpp
-		) const
+		)
 	{
 		using Vcl::Graphics::Runtime::OpenGL::Texture2D;
 		using Vcl::Graphics::SurfaceFormat;
@@ -363,7 +885,7 @@ private:
 		RGBA8 blue = {   0,   0,   0, 255 };
 		RGBA8 grey = { 127, 127, 127, 255 };
 		std::vector<RGBA8> albedo_map(resolution*resolution, grey);
-		textures[0] = createTexture(resolution, resolution, SurfaceFormat::R8G8B8A8_UNORM, albedo_map.data(), SurfaceFormat::R8G8B8A8_UNORM);
+		textures[0] = createTexture(resolution, resolution, SurfaceFormat::R8G8B8A8_UNORM, albedo_map.data(), SurfaceFormat::R8G8B8A8_UNORM, TextureContent::Albedo);
 		
 		const float incr = size / (resolution - 1);
 		const float lower = 0.1f * size;
@@ -443,8 +965,8 @@ private:
 				}
 			}
 		}
-		textures[1] = createTexture(resolution, resolution, SurfaceFormat::R8G8B8A8_UNORM, normal_map.data(), SurfaceFormat::R8G8B8A8_UNORM);
-		textures[2] = createTexture(resolution, resolution, SurfaceFormat::R8G8B8A8_UNORM, normal_map.data(), SurfaceFormat::R8G8B8A8_UNORM);
+		textures[1] = createTexture(resolution, resolution, SurfaceFormat::R8G8B8A8_UNORM, normal_map.data(), SurfaceFormat::R8G8B8A8_UNORM, TextureContent::ObjectNormals);
+		textures[2] = createTexture(resolution, resolution, SurfaceFormat::R8G8B8A8_UNORM, normal_map.data(), SurfaceFormat::R8G8B8A8_UNORM, TextureContent::TangentNormals);
 
 		if (bumpmap_bpp == 8)
 		{
@@ -453,7 +975,7 @@ private:
 			{
 				return std::numeric_limits<uint8_t>::max() * h / height;
 			});			
-			textures[3] = createTexture(resolution, resolution, SurfaceFormat::R8_UNORM, quantized_height_map.data(), SurfaceFormat::R8_UNORM);
+			textures[3] = createTexture(resolution, resolution, SurfaceFormat::R8_UNORM, quantized_height_map.data(), SurfaceFormat::R8_UNORM, TextureContent::Height);
 		}
 		else if (bumpmap_bpp == 16)
 		{
@@ -462,7 +984,7 @@ private:
 			{
 				return std::numeric_limits<uint16_t>::max() * h / height;
 			});
-			textures[3] = createTexture(resolution, resolution, SurfaceFormat::R16_UNORM, quantized_height_map.data(), SurfaceFormat::R16_UNORM);
+			textures[3] = createTexture(resolution, resolution, SurfaceFormat::R16_UNORM, quantized_height_map.data(), SurfaceFormat::R16_UNORM, TextureContent::Height);
 		}
 		else if (bumpmap_bpp == 32)
 		{
@@ -471,7 +993,7 @@ private:
 			{
 				return h / height;
 			});
-			textures[3] = createTexture(resolution, resolution, SurfaceFormat::R32_FLOAT, quantized_height_map.data(), SurfaceFormat::R32_FLOAT);
+			textures[3] = createTexture(resolution, resolution, SurfaceFormat::R32_FLOAT, quantized_height_map.data(), SurfaceFormat::R32_FLOAT, TextureContent::Height);
 		}
 
 		return textures;
@@ -480,6 +1002,15 @@ private:
 private:
 	std::unique_ptr<Vcl::Graphics::Runtime::GraphicsEngine> _engine;
 
+	//! Per-frame constant data
+	std::unique_ptr<UploadRing> _uploadRing;
+
+	//! Loads the textures of the wall and the dome in the background
+	std::unique_ptr<TextureStreamer> _streamer;
+
+	//! Bytes of texture data uploaded per frame in KB
+	int _uploadBudget{ 4096 };
+
 private:
 	std::unique_ptr<Vcl::Graphics::TrackballCameraController> _cameraController;
 
@@ -492,13 +1023,93 @@ private:
 	//! Selected bump-mapping technique
 	DetailMethod _detailMethod{ DetailMethod::None };
 
+	//! Number of quads along each side of the gallery
+	int _tiles{ 1 };
+
+	//! Largest number of quads along each side
+	static const int MaxTiles = 320;
+
+	//! Distance between the centers of neighbouring quads
+	static constexpr float TileSpacing = 2.5f;
+
+	//! Bounding sphere of a quad including its displacements
+	static constexpr float TileRadius = 1.5f;
+
+	//! Key of tiles outside the frustum
+	static const uint64_t Culled = ~uint64_t{ 0 };
+
+	//! Submit the draws ordered by their sort keys
+	bool _sortDraws{ true };
+
+	//! Draws of the current frame
+	DrawList _drawList;
+
+	//! Selected way of issuing the commands
+	Submission _submission{ Submission::Immediate };
+
+	//! Commands drawing the gallery
+	CommandList _commands;
+
+	//! Whether '_commands' matches the current attributes
+	bool _commandsValid{ false };
+
+	//! Transforms of the tiles in '_commands'
+	std::vector<RecordedBlock<ObjectTransformData>> _tileTransforms;
+
+	//! Object transformation and view of the transforms in '_commands'
+	Eigen::Matrix4f _recordedModel{ Eigen::Matrix4f::Identity() };
+	Eigen::Matrix4f _recordedView{ Eigen::Matrix4f::Identity() };
+
+	//! Threads recording the commands in parallel
+	int _recordThreads{ static_cast<int>(hardwareThreads()) };
+
+	//! Command lists recorded in parallel
+	ParallelRecorder _recorder;
+
+	//! Keys of all tiles, 'Culled' for tiles outside the frustum
+	std::vector<uint64_t> _tileKeys;
+
+	//! CPU time of issuing the commands of the gallery in ms
+	double _immediateTime{ 0 };
+	double _replayTime{ 0 };
+	double _parallelTime{ 0 };
+
+	//! Time of the parallel recording using one to all threads in ms
+	std::vector<double> _recordingScaling;
+
 	std::array<std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D>, 3> _diffuseMap;
 	std::array<std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D>, 3> _normalObjMap;
 	std::array<std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D>, 3> _normalTanMap;
 	std::array<std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D>, 3> _heightMap;
 
+	//! Whether the textures of a scene were created or requested
+	std::array<bool, 3> _requested{ { false, false, false } };
+
+	//! Textures bound while the texture of a 'TextureContent' is streamed
+	std::array<std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D>, 4> _placeholders;
+
 	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Sampler> _linearSampler;
 
+	//! Reduction of the height maps to their mip levels
+	HeightMipmaps _heightMipmaps{ HeightMipmaps::Average };
+
+	//! Block compression of the 8-bit textures
+	TextureCompression _textureCompression{ TextureCompression::Normal };
+
+	//! CPU time of encoding the textures without an up-to-date container
+	EncodingStatistics _encodingStats;
+
+	//! Time the GL thread spent creating the textures in ms
+	double _textureLoadTime{ 0 };
+
+	//! Textures uploaded from containers and textures encoded on load
+	unsigned int _cacheHits{ 0 };
+	unsigned int _cacheMisses{ 0 };
+
+	//! GPU memory of all textures and of their uncompressed equivalents
+	size_t _textureBytes{ 0 };
+	size_t _uncompressedTextureBytes{ 0 };
+
 	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _simplePS;
 	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _objectNormalmapPS;
 	std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::PipelineState> _tangentNormalmapPS;
@@ -514,7 +1125,14 @@ VCL_RTTI_CTOR_TABLE_END(WrinkledSurfacesExample)
 
 VCL_RTTI_ATTR_TABLE_BEGIN(WrinkledSurfacesExample)
 	Vcl::RTTI::Attribute<WrinkledSurfacesExample, Scene>{"Scene", &WrinkledSurfacesExample::scene, &WrinkledSurfacesExample::setScene},
-	Vcl::RTTI::Attribute<WrinkledSurfacesExample, DetailMethod>{"DetailMethod", &WrinkledSurfacesExample::detailMethod, &WrinkledSurfacesExample::setDetailMethod}
+	Vcl::RTTI::Attribute<WrinkledSurfacesExample, DetailMethod>{"DetailMethod", &WrinkledSurfacesExample::detailMethod, &WrinkledSurfacesExample::setDetailMethod},
+	Vcl::RTTI::Attribute<WrinkledSurfacesExample, int>{"Tiles", &WrinkledSurfacesExample::tiles, &WrinkledSurfacesExample::setTiles},
+	Vcl::RTTI::Attribute<WrinkledSurfacesExample, bool>{"SortDraws", &WrinkledSurfacesExample::sortDraws, &WrinkledSurfacesExample::setSortDraws},
+	Vcl::RTTI::Attribute<WrinkledSurfacesExample, Submission>{"Submission", &WrinkledSurfacesExample::submission, &WrinkledSurfacesExample::setSubmission},
+	Vcl::RTTI::Attribute<WrinkledSurfacesExample, int>{"RecordThreads", &WrinkledSurfacesExample::recordThreads, &WrinkledSurfacesExample::setRecordThreads},
+	Vcl::RTTI::Attribute<WrinkledSurfacesExample, HeightMipmaps>{"HeightMipmaps", &WrinkledSurfacesExample::heightMipmaps, &WrinkledSurfacesExample::setHeightMipmaps},
+	Vcl::RTTI::Attribute<WrinkledSurfacesExample, TextureCompression>{"TextureCompression", &WrinkledSurfacesExample::textureCompression, &WrinkledSurfacesExample::setTextureCompression},
+	Vcl::RTTI::Attribute<WrinkledSurfacesExample, int>{"UploadBudget", &WrinkledSurfacesExample::uploadBudget, &WrinkledSurfacesExample::setUploadBudget}
 VCL_RTTI_ATTR_TABLE_END(WrinkledSurfacesExample)
 
 VCL_DEFINE_METAOBJECT(WrinkledSurfacesExample)
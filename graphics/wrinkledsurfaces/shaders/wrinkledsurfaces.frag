@@ -94,7 +94,10 @@ void main(void)
 	}	
 	case 2: // Tangents space normal mapping
 	{
-		vec3 N_ts = 2 * texture(NormalTanMap, In.TexCoords).xyz - 1;
+		// Block-compressed maps only store x and y, z is positive in tangent space
+		vec3 N_ts;
+		N_ts.xy = 2 * texture(NormalTanMap, In.TexCoords).xy - 1;
+		N_ts.z = sqrt(max(0, 1 - dot(N_ts.xy, N_ts.xy)));
 
 		vec3 T_vs, B_vs, N_ws;
 		T_vs = In.Tangent;
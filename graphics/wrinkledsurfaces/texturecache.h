@@ -0,0 +1,89 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "../blockcompression.h"
+#include "../filecache.h"
+#include "../mipmaps.h"
+
+/*!
+ * Keys and locations of texture containers created by the demo. All
+ * containers are stored in the cache directory of the user, see 'directory'.
+ * Textures generated at runtime are named after the key of their texels.
+ * Containers of image files are keyed by the content of the file, see
+ * 'sourceKey'.
+ */
+namespace TextureCache
+{
+	const uint32_t Version = 2;
+
+	//! Directory of the cached textures, created if necessary
+	inline std::string directory()
+	{
+		return FileCache::directory("texturecache");
+	}
+
+	//! 64-bit FNV-1a hash
+	inline uint64_t hash(const void* data, size_t size, uint64_t h = 0xcbf29ce484222325ull)
+	{
+		const auto* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			h ^= bytes[i];
+			h *= 0x100000001b3ull;
+		}
+		return h;
+	}
+
+	/*!
+	 * Key of a texture encoded from the finest level 'src'. Mip filter, format
+	 * and quality are part of the key, as is the version of the cache, such
+	 * that changes of the encoders invalidate old entries.
+	 */
+	inline uint64_t key(const void* src, size_t size, uint32_t width, uint32_t height, uint32_t channels, MipFilter filter, BcFormat format, BcQuality quality)
+	{
+		const uint32_t params[] = { Version, width, height, channels, static_cast<uint32_t>(filter), static_cast<uint32_t>(format), static_cast<uint32_t>(quality) };
+		return hash(src, size, hash(params, sizeof(params)));
+	}
+
+	//! Key identifying the content of an image file, a hash of all its bytes
+	inline uint64_t sourceKey(const std::string& path)
+	{
+		return hash(&Version, sizeof(Version), FileCache::hashFile(path));
+	}
+
+	//! Path of the cached texture of 'key'
+	inline std::string path(uint64_t key)
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "/%016llx.vtc", static_cast<unsigned long long>(key));
+		return directory() + name;
+	}
+}
@@ -0,0 +1,204 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// C++ standard library
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "../blockcompression.h"
+#include "../mipmaps.h"
+#include "../texturecontainer.h"
+#include "stb_image.h"
+#include "texturecache.h"
+
+//! Interpretation of a texture, selects its mip filter and block format
+enum class TextureContent
+{
+	Albedo,
+	ObjectNormals,
+	TangentNormals,
+	Height
+};
+
+//! Processing of the texels of a texture before they are stored
+struct TextureEncoding
+{
+	MipFilter Filter{ MipFilter::Average };
+
+	//! Block-compress 8-bit textures with 'Format' and 'Quality'
+	bool Compressed{ false };
+	BcFormat Format{ BcFormat::BC1 };
+	BcQuality Quality{ BcQuality::Normal };
+};
+
+/*!
+ * Encoding of 'content'. Tangent-space normals keep x and y in BC5, the
+ * shader reconstructs z. Object-space normals point in all directions and
+ * need all three channels.
+ */
+inline TextureEncoding textureEncoding(TextureContent content, bool compressed, BcQuality quality, MipFilter height_filter)
+{
+	TextureEncoding encoding;
+	encoding.Compressed = compressed;
+	encoding.Quality = quality;
+	switch (content)
+	{
+	case TextureContent::Albedo:
+		encoding.Filter = MipFilter::Srgb;
+		encoding.Format = quality == BcQuality::Fast ? BcFormat::BC1 : BcFormat::BC7;
+		break;
+	case TextureContent::ObjectNormals:
+		encoding.Filter = MipFilter::Normal;
+		encoding.Format = quality == BcQuality::Fast ? BcFormat::BC1 : BcFormat::BC7;
+		break;
+	case TextureContent::TangentNormals:
+		encoding.Filter = MipFilter::Normal;
+		encoding.Format = BcFormat::BC5;
+		break;
+	case TextureContent::Height:
+		encoding.Filter = height_filter;
+		encoding.Format = BcFormat::BC4;
+		break;
+	}
+	return encoding;
+}
+
+/*!
+ * Container of the image 'image' encoded with 'encoding', in the texture
+ * cache directory. The name holds the image name, the encoding and the key
+ * of the container, e.g. 'diffuse.srgb-bc7-normal.0123456789abcdef.vtc',
+ * such that images of the same name in different directories do not
+ * replace each other's containers.
+ */
+inline std::string containerPath(const std::string& image, const TextureEncoding& encoding, uint64_t key)
+{
+	static const char* const filters[] = { "average", "srgb", "normal", "maximum" };
+	static const char* const formats[] = { "bc1", "bc4", "bc5", "bc7" };
+	static const char* const qualities[] = { "fast", "normal", "high" };
+
+	const size_t name_begin = image.find_last_of("/\\") + 1;
+	const size_t name_end = image.find_last_of('.');
+	std::string path = TextureCache::directory() + "/";
+	path += image.substr(name_begin, name_end != std::string::npos && name_end > name_begin ? name_end - name_begin : std::string::npos);
+	path += ".";
+	path += filters[static_cast<uint32_t>(encoding.Filter)];
+	if (encoding.Compressed)
+	{
+		path += "-";
+		path += formats[static_cast<uint32_t>(encoding.Format)];
+		path += "-";
+		path += qualities[static_cast<uint32_t>(encoding.Quality)];
+	}
+
+	char name[32];
+	std::snprintf(name, sizeof(name), ".%016llx.vtc", static_cast<unsigned long long>(key));
+	return path + name;
+}
+
+//! Key of the container of 'image', changes with the image and the encoding
+inline uint64_t containerKey(const std::string& image, const TextureEncoding& encoding)
+{
+	const uint32_t params[] = { static_cast<uint32_t>(encoding.Filter), encoding.Compressed ? 1u : 0u, static_cast<uint32_t>(encoding.Format), static_cast<uint32_t>(encoding.Quality) };
+	return TextureCache::hash(params, sizeof(params), TextureCache::sourceKey(image));
+}
+
+//! CPU time spent encoding textures in ms
+struct EncodingStatistics
+{
+	double MipMs{ 0 };
+	double CompressionMs{ 0 };
+};
+
+//! Mip chain of a texture, block-compressed if requested and possible
+template<typename T>
+struct EncodedTexture
+{
+	MipChain<T> Mips;
+	CompressedMipChain Blocks;
+	bool Compressed{ false };
+
+	TextureView view() const { return Compressed ? textureView(Blocks) : textureView(Mips); }
+};
+
+/*!
+ * Generate the mip chain of 'src' and compress it according to 'encoding'.
+ * BC4 stores 8-bit endpoints, thus 16-bit and float textures stay
+ * uncompressed.
+ */
+template<typename T>
+EncodedTexture<T> encodeTexture(const T* src, uint32_t width, uint32_t height, uint32_t channels, const TextureEncoding& encoding, EncodingStatistics* stats = nullptr)
+{
+	EncodedTexture<T> texture;
+
+	auto start = std::chrono::steady_clock::now();
+	texture.Mips = generateMipChain(src, width, height, channels, encoding.Filter);
+	auto end = std::chrono::steady_clock::now();
+	if (stats)
+		stats->MipMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+	if (encoding.Compressed && sizeof(T) == 1)
+	{
+		start = end;
+		texture.Blocks = compressMipChain(texture.Mips, encoding.Format, encoding.Quality);
+		texture.Compressed = true;
+		if (stats)
+			stats->CompressionMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+	return texture;
+}
+
+//! Decoded image file, channels are kept as stored in the file
+struct Image
+{
+	std::unique_ptr<uint8_t[], void(*)(void*)> Data{ nullptr, stbi_image_free };
+	uint32_t Width{ 0 };
+	uint32_t Height{ 0 };
+	uint32_t Channels{ 0 };
+};
+
+inline Image loadImage(const std::string& path)
+{
+	int w, h, n;
+	Image image;
+	image.Data.reset(stbi_load(path.c_str(), &w, &h, &n, 0));
+	if (!image.Data)
+		throw std::runtime_error("Could not load image: " + path);
+
+	// Grey images with alpha are expanded, two channels are not a texture format
+	if (n == 2)
+	{
+		image.Data.reset(stbi_load(path.c_str(), &w, &h, &n, 4));
+		n = 4;
+	}
+
+	image.Width = static_cast<uint32_t>(w);
+	image.Height = static_cast<uint32_t>(h);
+	image.Channels = static_cast<uint32_t>(n);
+	return image;
+}
@@ -0,0 +1,138 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// C++ standard library
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "textureconversion.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+/*
+ * Converts the images of the demo to texture containers in the texture cache
+ * directory of the user, such that the demo maps them instead of decoding the
+ * images on start. The content of an image
+ * is derived from its name, e.g. 'textures/wall/normal_tan.png'. Containers
+ * are only valid for the encoding they were converted with, the demo
+ * converts missing encodings itself.
+ */
+
+namespace
+{
+	void printUsage()
+	{
+		std::cout
+			<< "Usage: wrinkledsurfaces_textures [options] image..." << std::endl
+			<< "  --compression off|fast|normal|high   Block compression (default: normal)" << std::endl
+			<< "  --height-mipmaps average|maximum     Reduction of height maps (default: average)" << std::endl;
+	}
+
+	TextureContent contentOf(const std::string& path)
+	{
+		const size_t begin = path.find_last_of("/\\") == std::string::npos ? 0 : path.find_last_of("/\\") + 1;
+		const std::string stem = path.substr(begin, path.find_last_of('.') - begin);
+		if (stem == "diffuse")
+			return TextureContent::Albedo;
+		if (stem == "normal_obj")
+			return TextureContent::ObjectNormals;
+		if (stem == "normal_tan")
+			return TextureContent::TangentNormals;
+		if (stem == "height")
+			return TextureContent::Height;
+		throw std::runtime_error("Unknown texture content: " + path);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool compressed = true;
+	BcQuality quality = BcQuality::Normal;
+	MipFilter height_filter = MipFilter::Average;
+
+	int first_image = 1;
+	for (; first_image + 1 < argc && std::strncmp(argv[first_image], "--", 2) == 0; first_image += 2)
+	{
+		const std::string option = argv[first_image];
+		const std::string value = argv[first_image + 1];
+		if (option == "--compression" && value == "off")
+			compressed = false;
+		else if (option == "--compression" && value == "fast")
+			quality = BcQuality::Fast;
+		else if (option == "--compression" && value == "normal")
+			quality = BcQuality::Normal;
+		else if (option == "--compression" && value == "high")
+			quality = BcQuality::High;
+		else if (option == "--height-mipmaps" && value == "average")
+			height_filter = MipFilter::Average;
+		else if (option == "--height-mipmaps" && value == "maximum")
+			height_filter = MipFilter::Maximum;
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	if (first_image >= argc)
+	{
+		printUsage();
+		return 1;
+	}
+
+	try
+	{
+		for (int i = first_image; i < argc; i++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+
+			const std::string image_path = argv[i];
+			const TextureEncoding encoding = textureEncoding(contentOf(image_path), compressed, quality, height_filter);
+			const uint64_t key = containerKey(image_path, encoding);
+			const std::string path = containerPath(image_path, encoding, key);
+
+			const Image image = loadImage(image_path);
+			EncodingStatistics stats;
+			const auto texture = encodeTexture(image.Data.get(), image.Width, image.Height, image.Channels, encoding, &stats);
+			if (!TextureContainer::write(path, key, texture.view()))
+				throw std::runtime_error("Could not write: " + path);
+
+			const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			std::cout << image_path << " -> " << path << ": "
+				<< image.Width << "x" << image.Height << ", " << texture.view().Levels.size() << " levels, "
+				<< "mips " << stats.MipMs << " ms, compression " << stats.CompressionMs << " ms, total " << ms << " ms" << std::endl;
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,529 @@
+/*
+ * This file is part of the Visual Computing Library (VCL) release under the
+ * MIT license.
+ *
+ * Copyright (c) 2018 Basil Fierz
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+// VCL configuration
+#include <vcl/config/global.h>
+#include <vcl/config/opengl.h>
+
+// C++ standard library
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// VCL
+#include <vcl/graphics/runtime/opengl/resource/texture2d.h>
+
+#include "../threadpool.h"
+#include "../texturecontainer.h"
+#include "../uploadring.h"
+
+//! Formats of the storage and of the uploaded levels of a texture
+struct TextureUploadFormat
+{
+	//! Format of the texture storage
+	Vcl::Graphics::SurfaceFormat Storage;
+
+	//! Format and type of the uploaded texels, 'Type' is unused for compressed textures
+	GLenum Format;
+	GLenum Type;
+
+	bool Compressed;
+};
+
+//! Upload format of 'format', 'tgt_fmt' is the storage of uncompressed textures
+inline TextureUploadFormat textureUploadFormat(TextureFormat format, Vcl::Graphics::SurfaceFormat tgt_fmt)
+{
+	using Vcl::Graphics::SurfaceFormat;
+
+	switch (format)
+	{
+	case TextureFormat::R8:    return { tgt_fmt, GL_RED, GL_UNSIGNED_BYTE, false };
+	case TextureFormat::RGB8:  return { tgt_fmt, GL_RGB, GL_UNSIGNED_BYTE, false };
+	case TextureFormat::RGBA8: return { tgt_fmt, GL_RGBA, GL_UNSIGNED_BYTE, false };
+	case TextureFormat::R16:   return { tgt_fmt, GL_RED, GL_UNSIGNED_SHORT, false };
+	case TextureFormat::R32F:  return { tgt_fmt, GL_RED, GL_FLOAT, false };
+	case TextureFormat::BC1:   return { SurfaceFormat::BC1_UNORM, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, true };
+	case TextureFormat::BC4:   return { SurfaceFormat::BC4_UNORM, GL_COMPRESSED_RED_RGTC1, 0, true };
+	case TextureFormat::BC5:   return { SurfaceFormat::BC5_UNORM, GL_COMPRESSED_RG_RGTC2, 0, true };
+	case TextureFormat::BC7:   return { SurfaceFormat::BC7_UNORM, GL_COMPRESSED_RGBA_BPTC_UNORM, 0, true };
+	default: throw std::runtime_error("Unsupported texture format.");
+	}
+}
+
+//! Create a texture with uninitialized storage for all levels of 'texture'
+inline std::unique_ptr<Vcl::Graphics::Runtime::OpenGL::Texture2D> createTextureStorage(const TextureView& texture, const TextureUploadFormat& format)
+{
+	Vcl::Graphics::Runtime::Texture2DDescription desc;
+	desc.Width = texture.Levels[0].Width;
+	desc.Height = texture.Levels[0].Height;
+	desc.MipLevels = static_cast<uint32_t>(texture.Levels.size());
+	desc.ArraySize = 1;
+	desc.Format = format.Storage;
+	return std::make_unique<Vcl::Graphics::Runtime::OpenGL::Texture2D>(desc);
+}
+
+/*!
+ * Upload 'rows' texel rows of 'level' starting at row 'y'. 'data' is a
+ * client pointer or an offset into the bound pixel unpack buffer holding
+ * 'size' bytes of tightly packed rows. Compressed uploads start at a
+ * multiple of four rows.
+ */
+inline void uploadTextureRows
+(
+	GLuint texture, const TextureUploadFormat& format, GLint level,
+	uint32_t width, uint32_t y, uint32_t rows, size_t size, const void* data
+)
+{
+	if (format.Compressed)
+		glCompressedTextureSubImage2D(texture, level, 0, y, width, rows, format.Format, static_cast<GLsizei>(size), data);
+	else
+		glTextureSubImage2D(texture, level, 0, y, width, rows, format.Format, format.Type, data);
+}
+
+/*!
+ * Reusable memory of decoded textures. Loads allocate their staging memory
+ * from here, such that streaming textures of similar size does not hit the
+ * allocator for every texture.
+ */
+class StagingPool
+{
+public:
+	//! Number of released buffers kept for reuse
+	static const size_t MaxBuffers = 8;
+
+	//! Buffer of 'size' bytes, reusing the smallest released one that fits
+	std::vector<uint8_t> acquire(size_t size)
+	{
+		std::vector<uint8_t> buffer;
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			auto best = _buffers.end();
+			for (auto b = _buffers.begin(); b != _buffers.end(); ++b)
+			{
+				if (b->capacity() >= size && (best == _buffers.end() || b->capacity() < best->capacity()))
+					best = b;
+			}
+			if (best == _buffers.end() && !_buffers.empty())
+				best = std::max_element(_buffers.begin(), _buffers.end(), [](const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) { return a.capacity() < b.capacity(); });
+			if (best != _buffers.end())
+			{
+				buffer = std::move(*best);
+				_buffers.erase(best);
+				_bytes -= buffer.capacity();
+			}
+		}
+
+		buffer.resize(size);
+		return buffer;
+	}
+
+	//! Return 'buffer' to the pool, drops the smallest buffer beyond 'MaxBuffers'
+	void release(std::vector<uint8_t>&& buffer)
+	{
+		if (buffer.capacity() == 0)
+			return;
+
+		std::unique_lock<std::mutex> lock{ _mutex };
+		_bytes += buffer.capacity();
+		_buffers.emplace_back(std::move(buffer));
+		if (_buffers.size() > MaxBuffers)
+		{
+			auto smallest = std::min_element(_buffers.begin(), _buffers.end(), [](const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) { return a.capacity() < b.capacity(); });
+			_bytes -= smallest->capacity();
+			_buffers.erase(smallest);
+		}
+	}
+
+	//! Memory held by released buffers
+	size_t bytes() const
+	{
+		std::unique_lock<std::mutex> lock{ _mutex };
+		return _bytes;
+	}
+
+private:
+	mutable std::mutex _mutex;
+	std::vector<std::vector<uint8_t>> _buffers;
+	size_t _bytes{ 0 };
+};
+
+/*!
+ * Levels of a texture in staging memory, the finest first. The levels are
+ * either copied into a buffer of a 'StagingPool' or read from a mapped
+ * texture container, which is kept alive until the upload completed.
+ */
+struct StagedTexture
+{
+	TextureFormat Format{ TextureFormat::RGBA8 };
+
+	//! Levels with their offsets in bytes into 'Data'
+	std::vector<MipLevelLayout> Levels;
+	std::vector<uint8_t> Data;
+
+	//! Container holding the levels in place of 'Data'
+	std::unique_ptr<TextureContainer> Container;
+
+	//! Copy the levels of 'texture' into a buffer of 'pool'
+	void assign(StagingPool& pool, const TextureView& texture)
+	{
+		size_t size = 0;
+		for (const auto& level : texture.Levels)
+			size += level.Size;
+
+		Format = texture.Format;
+		Levels.clear();
+		Container.reset();
+		Data = pool.acquire(size);
+
+		size_t offset = 0;
+		for (const auto& level : texture.Levels)
+		{
+			Levels.push_back({ level.Width, level.Height, offset });
+			std::memcpy(Data.data() + offset, level.Data, level.Size);
+			offset += level.Size;
+		}
+	}
+
+	/*!
+	 * Upload the levels straight from the mapping of 'container'. Reads a
+	 * byte of every page, such that the file is read by the calling worker
+	 * and not by the GL thread copying the levels.
+	 */
+	void map(std::unique_ptr<TextureContainer> container)
+	{
+		const TextureView texture = container->view();
+		uint8_t touched = 0;
+		for (const auto& level : texture.Levels)
+		{
+			const auto* data = static_cast<const uint8_t*>(level.Data);
+			for (size_t b = 0; b < level.Size; b += 4096)
+				touched ^= data[b];
+		}
+		static volatile uint8_t sink;
+		sink = touched;
+
+		Format = texture.Format;
+		Levels.clear();
+		Data.clear();
+		Container = std::move(container);
+	}
+
+	//! Whether no levels were staged
+	bool empty() const { return !Container && Levels.empty(); }
+
+	TextureView view() const
+	{
+		if (Container)
+			return Container->view();
+
+		TextureView texture;
+		texture.Format = Format;
+		for (size_t l = 0; l < Levels.size(); l++)
+		{
+			const size_t end = l + 1 < Levels.size() ? Levels[l + 1].Offset : Data.size();
+			texture.Levels.push_back({ Levels[l].Width, Levels[l].Height, Data.data() + Levels[l].Offset, end - Levels[l].Offset });
+		}
+		return texture;
+	}
+};
+
+struct TextureStreamingStatistics
+{
+	//! Textures waiting for or being loaded by the workers
+	uint32_t Loading{ 0 };
+
+	//! Loaded textures with levels left to upload
+	uint32_t Uploading{ 0 };
+
+	//! Textures handed out and textures which failed to load
+	uint32_t Completed{ 0 };
+	uint32_t Failed{ 0 };
+
+	//! Bytes uploaded in the last frame and in total
+	size_t FrameBytes{ 0 };
+	size_t TotalBytes{ 0 };
+
+	//! CPU time of the last 'update' in ms
+	double FrameMs{ 0 };
+
+	//! Memory of the staged textures and of the staging pool
+	size_t StagingBytes{ 0 };
+};
+
+/*!
+ * Loads textures on worker threads and uploads them over several frames.
+ *
+ * Workers run the loaders, which decode into memory of a 'StagingPool' or
+ * map a texture container. 'update' copies at most 'frameBudget' bytes per
+ * frame into a persistently mapped pixel unpack buffer and uploads them from
+ * there, split into rows or rows of blocks. The GL thread thus never runs the
+ * decoder and its per-frame cost does not depend on the size of the textures.
+ * The finished texture is handed to the ready callback on the GL thread.
+ */
+class TextureStreamer
+{
+public:
+	using Texture = Vcl::Graphics::Runtime::OpenGL::Texture2D;
+
+	//! Runs on a worker and stages the levels of a texture, may throw
+	using Loader = std::function<void(StagingPool&, StagedTexture&)>;
+
+	//! Runs on the GL thread with the texture once all its levels are uploaded
+	using Ready = std::function<void(std::unique_ptr<Texture>, const StagedTexture&)>;
+
+	//! Smallest per-frame budget, holds a row of blocks of a 16K texture
+	static const size_t MinFrameBudget = 256 * 1024;
+
+	explicit TextureStreamer(size_t frame_budget = 4 << 20, unsigned int nr_workers = 2)
+	: _frameBudget{ std::max(frame_budget, MinFrameBudget) }
+	, _ring{ std::make_unique<UploadRing>(_frameBudget) }
+	, _workers{ nr_workers }
+	{
+	}
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	size_t frameBudget() const { return _frameBudget; }
+
+	//! Bytes uploaded per frame, takes effect with the next 'update'
+	void setFrameBudget(size_t budget)
+	{
+		budget = std::max(budget, MinFrameBudget);
+		if (budget == _frameBudget)
+			return;
+
+		// The GL keeps the buffer alive until pending uploads completed
+		_frameBudget = budget;
+		_ring = std::make_unique<UploadRing>(_frameBudget);
+	}
+
+	//! Load a texture on a worker, 'tgt_fmt' is the storage of uncompressed textures
+	void request(Loader load, Vcl::Graphics::SurfaceFormat tgt_fmt, Ready ready)
+	{
+		auto job = std::make_shared<Job>();
+		job->Generation = _generation.load();
+		job->Load = std::move(load);
+		job->Target = tgt_fmt;
+		job->OnReady = std::move(ready);
+		_loading++;
+
+		_workers.push([this, job]()
+		{
+			if (job->Generation == _generation.load())
+			{
+				try
+				{
+					job->Load(_staging, job->Staged);
+				}
+				catch (const std::exception& e)
+				{
+					job->Error = e.what();
+				}
+			}
+
+			std::unique_lock<std::mutex> lock{ _mutex };
+			_loaded.push_back(job);
+		});
+	}
+
+	//! Drop all requested textures which were not handed out yet
+	void cancel()
+	{
+		_generation++;
+		for (auto& job : _uploading)
+			_staging.release(std::move(job->Staged.Data));
+		_uploading.clear();
+	}
+
+	//! Upload the next slices of the loaded textures, call once per frame on the GL thread
+	void update()
+	{
+		const auto start = std::chrono::steady_clock::now();
+		_ring->beginFrame();
+
+		std::deque<std::shared_ptr<Job>> loaded;
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			loaded.swap(_loaded);
+		}
+		for (auto& job : loaded)
+		{
+			_loading--;
+			if (job->Generation != _generation.load())
+			{
+				_staging.release(std::move(job->Staged.Data));
+			}
+			else if (!job->Error.empty() || job->Staged.empty())
+			{
+				std::cout << "Could not load texture: " << job->Error << std::endl;
+				_staging.release(std::move(job->Staged.Data));
+				_stats.Failed++;
+			}
+			else
+			{
+				job->View = job->Staged.view();
+				job->Format = textureUploadFormat(job->View.Format, job->Target);
+				_uploading.emplace_back(std::move(job));
+			}
+		}
+
+		const size_t alignment = _ring->alignment();
+		size_t used = 0;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _ring->buffer());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		while (!_uploading.empty())
+		{
+			Job& job = *_uploading.front();
+			if (!job.Result)
+				job.Result = createTextureStorage(job.View, job.Format);
+
+			// Slices are rows of texels or rows of blocks
+			const TextureLevelView& level = job.View.Levels[job.Level];
+			const uint32_t slice_rows = job.Format.Compressed ? 4 : 1;
+			const uint32_t nr_slices = (level.Height + slice_rows - 1) / slice_rows;
+			const size_t slice_size = level.Size / nr_slices;
+
+			const size_t offset = (used + alignment - 1) / alignment * alignment;
+			const size_t available = offset < _frameBudget ? _frameBudget - offset : 0;
+			const uint32_t nr_uploaded = static_cast<uint32_t>(std::min<size_t>(nr_slices - job.Slice, available / slice_size));
+			if (nr_uploaded == 0 && used > 0)
+				break;
+			if (nr_uploaded == 0)
+			{
+				std::cout << "Could not upload texture: a slice exceeds the budget" << std::endl;
+				_staging.release(std::move(job.Staged.Data));
+				_uploading.pop_front();
+				_stats.Failed++;
+				continue;
+			}
+
+			const size_t size = nr_uploaded * slice_size;
+			auto block = _ring->allocate<uint8_t>(size);
+			std::memcpy(block.Data, static_cast<const uint8_t*>(level.Data) + job.Slice * slice_size, size);
+
+			const uint32_t y = job.Slice * slice_rows;
+			const uint32_t rows = std::min(nr_uploaded * slice_rows, level.Height - y);
+			uploadTextureRows(job.Result->id(), job.Format, static_cast<GLint>(job.Level), level.Width, y, rows, size, reinterpret_cast<const void*>(block.Offset));
+			used = offset + size;
+			_stats.TotalBytes += size;
+
+			job.Slice += nr_uploaded;
+			if (job.Slice < nr_slices)
+				continue;
+
+			job.Slice = 0;
+			if (++job.Level < job.View.Levels.size())
+				continue;
+
+			auto finished = std::move(_uploading.front());
+			_uploading.pop_front();
+			finished->OnReady(std::move(finished->Result), finished->Staged);
+			_staging.release(std::move(finished->Staged.Data));
+			_stats.Completed++;
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		_ring->endFrame();
+
+		_stats.Loading = _loading;
+		_stats.Uploading = static_cast<uint32_t>(_uploading.size());
+		_stats.FrameBytes = _ring->statistics().FrameBytes;
+		_stats.FrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		_stats.StagingBytes = _staging.bytes();
+		for (const auto& job : _uploading)
+			_stats.StagingBytes += job->Staged.Data.capacity();
+	}
+
+	//! Whether textures are still loading or uploading
+	bool busy() const { return _loading > 0 || !_uploading.empty(); }
+
+	const TextureStreamingStatistics& statistics() const { return _stats; }
+
+private:
+	struct Job
+	{
+		//! Value of '_generation' when the texture was requested
+		uint64_t Generation{ 0 };
+
+		Loader Load;
+		Ready OnReady;
+		Vcl::Graphics::SurfaceFormat Target;
+
+		//! Result of the loader
+		StagedTexture Staged;
+		std::string Error;
+
+		//! Levels of 'Staged' and their upload format
+		TextureView View;
+		TextureUploadFormat Format;
+
+		//! Texture receiving the uploads
+		std::unique_ptr<Texture> Result;
+
+		//! Next slice to upload
+		size_t Level{ 0 };
+		uint32_t Slice{ 0 };
+	};
+
+	//! Bytes uploaded per frame
+	size_t _frameBudget;
+
+	//! Pixel unpack memory of the frames
+	std::unique_ptr<UploadRing> _ring;
+
+	//! Memory of the staged textures
+	StagingPool _staging;
+
+	//! Incremented by 'cancel', jobs of older generations are dropped
+	std::atomic<uint64_t> _generation{ 0 };
+
+	//! Jobs finished by the workers
+	std::mutex _mutex;
+	std::deque<std::shared_ptr<Job>> _loaded;
+
+	//! Requested jobs not yet collected by 'update'
+	uint32_t _loading{ 0 };
+
+	//! Jobs with levels left to upload, the oldest first
+	std::deque<std::shared_ptr<Job>> _uploading;
+
+	TextureStreamingStatistics _stats;
+
+	//! Destroyed first, joins the running loaders before the state they use
+	ThreadPool _workers;
+};